@@ -23,11 +23,19 @@ add_executable(mzvm_v2_fixtures
   "${CMAKE_CURRENT_SOURCE_DIR}/tests/v2/fixtures_privilege.cpp"
   "${CMAKE_CURRENT_SOURCE_DIR}/tests/v2/fixtures_paging.cpp"
   "${CMAKE_CURRENT_SOURCE_DIR}/tests/v2/fixtures_traps.cpp"
-  "${CMAKE_CURRENT_SOURCE_DIR}/tests/v2/fixtures_interrupts.cpp")
+  "${CMAKE_CURRENT_SOURCE_DIR}/tests/v2/fixtures_interrupts.cpp"
+  "${CMAKE_CURRENT_SOURCE_DIR}/tests/v2/fixtures_jit.cpp"
+  "${CMAKE_CURRENT_SOURCE_DIR}/tests/v2/fixtures_snapshot.cpp"
+  "${CMAKE_CURRENT_SOURCE_DIR}/tests/v2/fixtures_batch.cpp"
+  "${CMAKE_CURRENT_SOURCE_DIR}/tests/v2/fixtures_cost.cpp"
+  "${CMAKE_CURRENT_SOURCE_DIR}/tests/v2/fixtures_profile.cpp"
+  "${CMAKE_CURRENT_SOURCE_DIR}/tests/v2/fixtures_perf.cpp")
 target_include_directories(mzvm_v2_fixtures PRIVATE
   "${CMAKE_CURRENT_SOURCE_DIR}/src/v2"
   "${CMAKE_CURRENT_SOURCE_DIR}/tests/v2")
 set_property(TARGET mzvm_v2_fixtures PROPERTY CXX_STANDARD 20)
+target_link_libraries(mzvm_v2_fixtures PRIVATE Threads::Threads ${MAIZE_V2_HOST_LIBRARIES})
+target_compile_definitions(mzvm_v2_fixtures PRIVATE ${_maize_dispatch_definition})
 
 if (MAIZE_SANITIZE)
   target_compile_options(mzvm_v2_fixtures PRIVATE ${_maize_san_flags})
@@ -54,6 +62,7 @@ set(MAIZE_V2_FIXTURES
   jump_call_and_return
   select_leaves_the_destination_alone
   halt_stops_the_machine
+  a_fused_pair_is_two_instructions_to_everything_but_the_dispatch
   loads_and_stores_at_every_width
   memory_faults_report_the_lowest_inaccessible_address
   a_trapping_access_writes_nothing
@@ -62,13 +71,28 @@ set(MAIZE_V2_FIXTURES
   block_memory_operand_validity
   block_memory_completion_and_overlap
   block_memory_restart_invariant
+  block_memory_over_many_pages_matches_the_byte_at_a_time_transfer
+  a_store_over_a_decoded_instruction_is_fetched_next_time
+  memory_is_committed_on_touch_and_reads_zero_where_it_was_given_back
   device_machine_block_identification_and_presence
   device_unpopulated_ports_read_zero_and_discard_write
   device_console_reset_state
   device_console_output_accumulates_bytes
+  device_console_sink_takes_the_bytes_the_buffer_would_have
+  device_console_stream_writes_every_byte_in_order_through_a_small_buffer
+  device_console_stream_drops_rather_than_waits_once_its_stream_fails
+  device_console_source_is_asked_only_by_a_guest_reading_input
   device_console_input_is_permanently_absent
   device_console_acknowledge_clears_transient_bits_only
   device_interrupt_control_reads_back_what_it_stores
+  device_block_storage_moves_blocks_between_its_image_and_guest_memory
+  device_block_storage_refuses_what_it_cannot_transfer_whole
+  device_block_storage_completes_asynchronously_and_raises_its_line
+  device_framebuffer_claims_presents_and_scans_out
+  device_framebuffer_presents_headless_and_into_a_shared_segment
+  device_network_moves_frames_between_machines_through_a_switch
+  device_network_switch_rings_take_frames_from_many_threads_at_once
+  device_entropy_reads_a_word_a_port_read_and_refills_in_bulk
   port_instructions_reach_the_port_space
   port_in_port_out_privileged
   csr_access_rules_apply_in_the_chapters_order
@@ -116,8 +140,14 @@ set(MAIZE_V2_FIXTURES
   tlb_maintenance_is_privileged_and_faults_at_nothing
   a_cached_translation_is_rechecked_on_every_use
   the_translation_cache_neither_over_flushes_nor_under_flushes
+  the_translation_cache_holds_a_working_set_wider_than_the_old_scan
+  a_loop_on_one_code_page_fetches_without_translating
+  one_code_page_under_two_mappings_runs_at_each_mappings_address
+  a_block_transfer_follows_each_virtual_page_to_its_own_physical_page
   a_fetch_page_fault_beats_an_interrupt_deliverable_at_the_same_boundary
   a_block_interrupt_and_the_page_fault_after_it_compose_and_lose_nothing
+  translation_walks_cost_the_same_with_the_jit_as_without
+  a_compiled_block_runs_at_each_mappings_address
   interrupt_cause_numbers_and_register_layout_are_the_specified_ones
   interrupt_enable_zero_rejects_the_non_maskable_synchronous_causes
   pending_is_set_while_the_cause_is_masked_at_the_cpu
@@ -134,7 +164,34 @@ set(MAIZE_V2_FIXTURES
   timer_refuses_a_zero_period_written_while_counting_is_already_enabled
   timer_period_written_mid_interval_takes_effect_at_the_next_expiry
   console_asserts_its_line_only_while_a_byte_is_waiting
-  a_wait_with_nothing_armed_suspends_rather_than_spinning)
+  a_wait_with_nothing_armed_suspends_rather_than_spinning
+  a_wait_on_console_input_sleeps_on_the_host_until_a_byte_arrives
+  a_wait_on_the_network_sleeps_on_the_host_until_a_frame_arrives
+  published_lines_follow_every_path_that_moves_a_level
+  a_run_settles_the_clock_at_the_same_boundaries_a_single_step_does
+  jit_runs_a_hot_loop_to_the_interpreters_state
+  jit_stops_on_the_step_budget_where_the_interpreter_does
+  jit_runs_a_patched_instruction_rather_than_its_stale_compile
+  jit_keeps_timer_interrupts_on_their_instruction_boundaries
+  jit_check_passes_a_faithful_block_and_catches_an_injected_miscompile
+  jit_stops_on_the_cycle_limit_where_the_interpreter_does
+  jit_templates_match_the_interpreter_on_every_operand_and_predicate
+  an_incremental_snapshot_carries_exactly_the_pages_written_since_the_last
+  a_restored_snapshot_chain_runs_on_to_the_original_machines_end
+  a_cloned_memory_shares_its_pages_until_either_side_touches_them
+  a_clone_copies_the_pages_it_writes_and_none_it_only_reads
+  cloned_machines_fan_out_from_a_warm_parent_and_run_independently
+  a_batch_runs_every_job_and_reports_each_in_job_order
+  a_failing_job_is_that_jobs_failure_alone
+  a_batch_network_carries_frames_between_its_machines
+  a_machine_waiting_on_a_network_its_peers_have_left_is_suspended
+  cycles_are_charged_by_opcode_and_by_block_byte
+  a_cycle_limit_stops_run_at_the_boundary_that_reaches_it
+  cycles_carry_across_a_snapshot_and_a_clone
+  a_profile_counts_opcodes_blocks_traps_and_block_bytes
+  a_profile_reports_as_text_and_as_json
+  samples_follow_calls_and_traps_into_folded_stacks
+  the_perf_registry_counts_the_run_from_start_and_keeps_peak_rates)
 
 foreach(_fixture ${MAIZE_V2_FIXTURES})
   add_test(NAME "v2_${_fixture}" COMMAND mzvm_v2_fixtures "${_fixture}")
@@ -153,9 +210,11 @@ set_tests_properties("v2_fixture_registry" PROPERTIES LABELS "v2" TIMEOUT 60)
 #
 # decode_v2.cpp is linked in as the shape-and-length oracle for the corpus fixture. It was
 # written on maize-418, independently of everything here, and is untouched by this card, which
-# is the whole reason it can serve as one.
+# is the whole reason it can serve as one. memory_v2.cpp rides along because the oracle decodes
+# out of a MemoryV2, whose host mapping lives there since user-006.
 add_executable(mzasm_tests
   "${CMAKE_CURRENT_SOURCE_DIR}/src/v2/decode_v2.cpp"
+  "${CMAKE_CURRENT_SOURCE_DIR}/src/v2/memory_v2.cpp"
   "${CMAKE_CURRENT_SOURCE_DIR}/tests/v2/appendix_a.cpp"
   "${CMAKE_CURRENT_SOURCE_DIR}/tests/v2/mzasm_test_support.cpp"
   "${CMAKE_CURRENT_SOURCE_DIR}/tests/v2/mzasm_conformance.cpp"
@@ -194,10 +253,13 @@ set(MAIZE_MZASM_FIXTURES
   include_paths_normalize_identically_at_both_sites
   flat_output_takes_the_mzi_suffix
   mzvm_runs_what_mzasm_wrote
+  mzvm_samples_stacks_named_from_the_symbols_mzasm_wrote
+  mzvm_show_perf_reports_each_source_after_the_run
   mzvm_prints_hello_world
+  mzvm_batch_reports_every_machine_in_manifest_order
   mzvm_refuses_out_of_range_numeric_arguments
   mzvm_leading_whitespace_cannot_hide_a_minus_sign
-  mzvmg_help_names_itself_and_says_it_has_no_display
+  mzvmg_help_names_itself_and_says_it_opens_no_window
   mzvm_help_does_not_mention_the_graphical_twin
   mzvmg_diagnostics_name_the_binary_that_printed_them
   nothing_in_the_v2_assembler_names_the_v1_suffix
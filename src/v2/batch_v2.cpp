@@ -0,0 +1,247 @@
+// batch_v2.cpp (user-009): the work-stealing pool behind run_batch.
+
+#include "batch_v2.h"
+
+#include <atomic>
+#include <cstdio>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <thread>
+
+#include "network_v2.h"
+
+namespace maize::v2 {
+namespace {
+
+// One worker's run of job indices. The owner pops the back and a thief the front, under the
+// run's own lock, which the owner takes uncontended unless somebody has run out of work.
+struct WorkRun {
+    std::mutex lock;
+    std::deque<std::size_t> jobs;
+};
+
+bool read_image(const std::string& path, std::vector<std::uint8_t>& bytes) {
+    std::FILE* file = std::fopen(path.c_str(), "rb");
+    if (file == nullptr) {
+        return false;
+    }
+    std::uint8_t buffer[4096];
+    std::size_t got = 0;
+    while ((got = std::fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        bytes.insert(bytes.end(), buffer, buffer + got);
+    }
+    const bool ok = std::ferror(file) == 0;
+    std::fclose(file);
+    return ok;
+}
+
+void run_job(const BatchJobV2& job, const BatchOptionsV2& options, NetworkLinkV2* link,
+             BatchResultV2& out) {
+    std::vector<std::uint8_t> read;
+    if (job.image.empty() && !read_image(job.image_path, read)) {
+        out.error = "cannot read '" + job.image_path + "'";
+        return;
+    }
+    const std::vector<std::uint8_t>& image = job.image.empty() ? read : job.image;
+
+    // A memory the host refuses is this job's failure and no other's, so it is caught here
+    // rather than taking the pool down with it (maize-467, D-1).
+    std::unique_ptr<MemoryV2> memory;
+    try {
+        memory = std::make_unique<MemoryV2>(job.memory_bytes);
+    } catch (const std::length_error&) {
+    } catch (const std::bad_alloc&) {
+    }
+    if (memory == nullptr) {
+        out.error = "cannot allocate " + std::to_string(job.memory_bytes) +
+                    " bytes of memory for the machine";
+        return;
+    }
+    if (!memory->load_image(job.load_address, image.data(), image.size())) {
+        out.error = "the image does not fit in memory at the load address";
+        return;
+    }
+
+    InterpreterV2 machine(*memory, job.start_address);
+    if (link != nullptr) {
+        machine.device_surface().network().host_attach_link(link);
+    }
+    // A host with no backend runs the job interpreted, as mzvm does.
+    if (options.jit) {
+        machine.enable_jit(options.jit_options);
+    }
+    out.ran = true;
+    out.result = run_until(machine, job.max_steps);
+    machine.device_surface().network().host_attach_link(nullptr);
+    out.pc = machine.pc();
+    out.steps = machine.steps_taken();
+    if (machine.jit() != nullptr) {
+        out.jit_check_failure = machine.jit()->check_failure();
+    }
+
+    const std::vector<std::uint8_t>& console = machine.device_surface().console_output();
+    if (job.output_path.empty()) {
+        out.console = console;
+        return;
+    }
+    std::FILE* file = std::fopen(job.output_path.c_str(), "wb");
+    bool written = file != nullptr &&
+                   std::fwrite(console.data(), 1, console.size(), file) == console.size();
+    if (file != nullptr && std::fclose(file) != 0) {
+        written = false;
+    }
+    if (!written) {
+        out.error = "cannot write '" + job.output_path + "'";
+    }
+}
+
+}  // namespace
+
+StepResult run_until(InterpreterV2& machine, std::uint64_t limit) {
+    StepResult result;
+    result.pc = machine.pc();
+    for (;;) {
+        if ((limit != 0 && machine.steps_taken() >= limit) || machine.cycle_limit_reached()) {
+            return result;
+        }
+        result = machine.run(limit == 0 ? 0 : limit - machine.steps_taken());
+        if (result.status != StepStatus::Trapped ||
+            result.disposition != TrapDisposition::Delivered) {
+            return result;
+        }
+    }
+}
+
+std::vector<BatchResultV2> run_batch(const std::vector<BatchJobV2>& jobs,
+                                     const BatchOptionsV2& options, BatchStatsV2* stats) {
+    std::vector<BatchResultV2> results(jobs.size());
+
+    // One switch per network named, and every port connected before any machine runs. The
+    // networked jobs are set aside for threads of their own, and the pool deals out the rest.
+    std::map<std::string, std::unique_ptr<VirtualSwitchV2>> networks;
+    std::vector<NetworkLinkV2*> links(jobs.size(), nullptr);
+    std::vector<std::size_t> pooled;
+    pooled.reserve(jobs.size());
+    for (std::size_t i = 0; i < jobs.size(); ++i) {
+        if (jobs[i].network.empty()) {
+            pooled.push_back(i);
+            continue;
+        }
+        std::unique_ptr<VirtualSwitchV2>& network = networks[jobs[i].network];
+        if (network == nullptr) {
+            network = std::make_unique<VirtualSwitchV2>();
+        }
+        links[i] = network->connect();
+    }
+
+    unsigned threads =
+        options.threads != 0 ? options.threads : std::thread::hardware_concurrency();
+    if (threads == 0) {
+        threads = 1;
+    }
+
+    // Networked machines come out of the same budget as the pool. Each needs a thread of its own
+    // for as long as it runs, so a batch with more of them than the budget allows runs none of
+    // them, and says why; what is left of the budget goes to the pool, which when nothing is
+    // left waits for the networked machines and then runs on the calling thread alone.
+    const std::size_t networking = jobs.size() - pooled.size();
+    const bool networks_fit = networking <= threads;
+    std::vector<std::thread> networked;
+    for (std::size_t i = 0; i < jobs.size(); ++i) {
+        if (links[i] == nullptr) {
+            continue;
+        }
+        if (!networks_fit) {
+            results[i].error = std::to_string(networking) +
+                               " networked machines need a thread each, and the batch has " +
+                               std::to_string(threads);
+            continue;
+        }
+        // Hung up however the job ends, built or not, so no peer waits on a machine that is
+        // never coming.
+        networked.emplace_back([&jobs, &options, &links, &results, i] {
+            run_job(jobs[i], options, links[i], results[i]);
+            links[i]->hang_up();
+        });
+    }
+    const bool pool_waits = networks_fit && networking >= threads;
+    if (pool_waits) {
+        for (std::thread& machine : networked) {
+            machine.join();
+        }
+        networked.clear();
+        threads = 1;
+    } else if (networks_fit) {
+        threads -= static_cast<unsigned>(networking);
+    }
+
+    // More workers than jobs would only start threads with nothing to do.
+    if (threads > pooled.size()) {
+        threads = pooled.empty() ? 1 : static_cast<unsigned>(pooled.size());
+    }
+
+    // Contiguous runs, so neighbouring jobs, which in a manifest tend to be alike, start out on
+    // the same worker. Each is built back to front, because the back is what its owner takes
+    // next: the owner walks its jobs first to last, and a thief takes the last of them.
+    std::vector<WorkRun> runs(threads);
+    for (std::size_t i = 0; i < pooled.size(); ++i) {
+        runs[i * threads / pooled.size()].jobs.push_front(pooled[i]);
+    }
+
+    std::atomic<std::uint64_t> stolen{0};
+    const auto take = [&runs, &stolen, threads](unsigned self, std::size_t& job) {
+        {
+            std::lock_guard<std::mutex> guard(runs[self].lock);
+            if (!runs[self].jobs.empty()) {
+                job = runs[self].jobs.back();
+                runs[self].jobs.pop_back();
+                return true;
+            }
+        }
+        // Nothing is ever added to a run once the pool starts, so a worker that finds every
+        // run empty in one pass is done: no job can appear behind it.
+        for (unsigned step = 1; step < threads; ++step) {
+            WorkRun& victim = runs[(self + step) % threads];
+            std::lock_guard<std::mutex> guard(victim.lock);
+            if (!victim.jobs.empty()) {
+                job = victim.jobs.front();
+                victim.jobs.pop_front();
+                stolen.fetch_add(1, std::memory_order_relaxed);
+                return true;
+            }
+        }
+        return false;
+    };
+    const auto work = [&](unsigned self) {
+        std::size_t job = 0;
+        while (take(self, job)) {
+            run_job(jobs[job], options, nullptr, results[job]);
+        }
+    };
+
+    // The calling thread is worker zero, so a one-thread batch starts no thread at all.
+    std::vector<std::thread> workers;
+    workers.reserve(threads - 1);
+    for (unsigned self = 1; self < threads; ++self) {
+        workers.emplace_back(work, self);
+    }
+    work(0);
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    for (std::thread& machine : networked) {
+        machine.join();
+    }
+
+    if (stats != nullptr) {
+        stats->threads = threads;
+        stats->stolen = stolen.load();
+    }
+    return results;
+}
+
+}  // namespace maize::v2
@@ -0,0 +1,107 @@
+// batch_v2.h (user-009): running many independent machines across the host's cores.
+//
+// A conformance or evaluation run is tens of thousands of small guests, each of which halts
+// after a few thousand instructions. Run one per process and the run is process start-up with a
+// little execution in between; run them one after another in one process and it is one core's
+// worth of execution on a host with dozens. run_batch() is the alternative: every job is its own
+// MemoryV2 and InterpreterV2, nothing is shared between them, and a pool of worker threads takes
+// jobs until none are left.
+//
+// THE POOL STEALS WORK. Jobs are dealt out to the workers in contiguous runs up front, and a
+// worker takes from the back of its own run, so a worker mostly runs jobs no other thread is
+// looking at and the lock it takes is one nobody else wants. A worker whose run is empty takes
+// from the FRONT of another's, the end its owner will reach last. Guests vary by orders of
+// magnitude in how long they run, and a static split leaves cores idle behind the worker that
+// drew the long ones; stealing is what keeps every core busy to the end without a shared queue
+// every worker contends on for every job.
+//
+// Results come back in job order whatever order the jobs ran in, so a report built from them
+// is the same from one run to the next and from one thread count to another. A job's outcome
+// depends only on the job: a machine never observes another, or the thread it ran on.
+//
+// THE ONE EXCEPTION IS A NETWORK (user-020). Jobs that name the same network get a network
+// device each, all plugged into one VirtualSwitchV2, and exchange frames while they run. They
+// have to run at once for that to mean anything, which a pool of fewer workers than jobs cannot
+// promise, so networked jobs do not go to the pool: each runs on a thread of its own beside it.
+// Those threads come out of the batch's budget, and a batch with more networked jobs than the
+// budget runs none of them and says why in each one's error. A machine that ends, however it
+// ends, hangs up its port, and a peer parked waiting on the link with no one left to hear from
+// is woken and reports Suspended rather than waiting for ever. Their outcomes depend on each
+// other and on timing, as a distributed program's do, which is what asking for a network asks
+// for.
+
+#ifndef MAIZE_V2_BATCH_V2_H
+#define MAIZE_V2_BATCH_V2_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "interpreter_v2.h"
+#include "jit_v2.h"
+
+namespace maize::v2 {
+
+struct BatchJobV2 {
+    // The image's bytes, or, when they are empty, the file to read them from. The file is read
+    // by the worker that runs the job, so a batch of many images reads them in parallel and
+    // never holds more than one per worker at a time.
+    std::string image_path;
+    std::vector<std::uint8_t> image;
+    std::size_t memory_bytes = std::size_t{1} << 20;
+    std::uint64_t load_address = 0x1000;
+    std::uint64_t start_address = 0x1000;
+    // A step count the machine stops at, as mzvm's --max-steps; zero for none.
+    std::uint64_t max_steps = 0;
+    // When set, the guest's console output goes to this file rather than into the result.
+    std::string output_path;
+    // When set, the machine carries a network device on the switch every job naming this
+    // network shares.
+    std::string network;
+};
+
+struct BatchOptionsV2 {
+    // Zero is one per hardware thread the host reports, and one where it reports none. The
+    // networked jobs' threads are counted in it, and the pool has what is left.
+    unsigned threads = 0;
+    bool jit = false;
+    JitOptionsV2 jit_options{};
+};
+
+struct BatchResultV2 {
+    // Whether the machine was built and run. When it was not, `error` says why and nothing
+    // else here is meaningful.
+    bool ran = false;
+    // The reason the machine never ran, or that its output file could not be written, in the
+    // words mzvm would use; empty when neither happened.
+    std::string error;
+    StepResult result{};
+    std::uint64_t pc = 0;
+    std::uint64_t steps = 0;
+    // Empty when the job named an output file.
+    std::vector<std::uint8_t> console;
+    // Set when --jit-check found a compiled block that disagreed with the interpreter.
+    std::string jit_check_failure;
+};
+
+struct BatchStatsV2 {
+    unsigned threads = 0;
+    std::uint64_t stolen = 0;  // jobs a worker took from another's run
+};
+
+// Run every job to its stop and return one result per job, in job order.
+std::vector<BatchResultV2> run_batch(const std::vector<BatchJobV2>& jobs,
+                                     const BatchOptionsV2& options, BatchStatsV2* stats = nullptr);
+
+// Run until the machine stops or its step count reaches `limit`, zero for no limit, running on
+// past every delivered trap (maize-464): run() hands control back at a delivery so a host can
+// see it, but the machine is already on its handler and has not stopped. The limit is a step
+// count rather than a budget, so a machine restored partway through a run stops where the
+// original would have. It stops too at the machine's own cycle limit (user-022), which is
+// judged the same way. Shared by mzvm's single run and every job here.
+StepResult run_until(InterpreterV2& machine, std::uint64_t limit);
+
+}  // namespace maize::v2
+
+#endif  // MAIZE_V2_BATCH_V2_H
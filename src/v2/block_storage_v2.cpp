@@ -0,0 +1,332 @@
+// block_storage_v2.cpp (user-018): block storage's transfers, its worker thread, and the file
+// image mzvm backs it with.
+
+#include "block_storage_v2.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+#include "memory_v2.h"
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#else
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace maize::v2 {
+
+// The worker an asynchronous device hands its transfers to. One transfer at a time, because the
+// device accepts one command at a time: submit() gives it the transfer and the staging buffer,
+// the worker does the image's read or write on its own thread, and collect() gives the buffer
+// back with the count once done() says so. Started with the device's first asynchronous transfer
+// and stopped with the device.
+class BlockWorkerV2 {
+  public:
+    BlockWorkerV2() : thread_(&BlockWorkerV2::work, this) {}
+
+    ~BlockWorkerV2() {
+        {
+            std::lock_guard<std::mutex> guard(lock_);
+            stopping_ = true;
+        }
+        wake_.notify_one();
+        thread_.join();
+    }
+
+    BlockWorkerV2(const BlockWorkerV2&) = delete;
+    BlockWorkerV2& operator=(const BlockWorkerV2&) = delete;
+
+    void submit(BlockImageV2* image, bool reading, std::uint64_t offset,
+                std::vector<std::uint8_t>& staging) {
+        {
+            std::lock_guard<std::mutex> guard(lock_);
+            image_ = image;
+            reading_ = reading;
+            offset_ = offset;
+            staging_.swap(staging);
+            moved_ = 0;
+            submitted_ = true;
+            done_.store(false, std::memory_order_relaxed);
+        }
+        wake_.notify_one();
+    }
+
+    // One load, because the machine asks at every settle while a transfer is in flight.
+    bool done() const { return done_.load(std::memory_order_acquire); }
+
+    void wait(std::uint64_t nanoseconds) {
+        std::unique_lock<std::mutex> guard(lock_);
+        const auto finished = [this] { return done_.load(std::memory_order_relaxed); };
+        if (nanoseconds == UINT64_MAX) {
+            finished_.wait(guard, finished);
+            return;
+        }
+        finished_.wait_for(guard, std::chrono::nanoseconds(nanoseconds), finished);
+    }
+
+    std::size_t collect(std::vector<std::uint8_t>& staging) {
+        std::lock_guard<std::mutex> guard(lock_);
+        staging.swap(staging_);
+        done_.store(false, std::memory_order_relaxed);
+        return moved_;
+    }
+
+  private:
+    void work() {
+        std::unique_lock<std::mutex> guard(lock_);
+        for (;;) {
+            wake_.wait(guard, [this] { return submitted_ || stopping_; });
+            if (stopping_) {
+                return;
+            }
+            submitted_ = false;
+            // The staging buffer is this thread's until done is set, so the I/O, which is the
+            // whole reason the thread exists, runs with nothing held.
+            guard.unlock();
+            const std::size_t moved =
+                reading_ ? image_->read(offset_, staging_.data(), staging_.size())
+                         : image_->write(offset_, staging_.data(), staging_.size());
+            guard.lock();
+            moved_ = moved;
+            done_.store(true, std::memory_order_release);
+            finished_.notify_all();
+        }
+    }
+
+    std::mutex lock_;
+    std::condition_variable wake_;
+    std::condition_variable finished_;
+    BlockImageV2* image_ = nullptr;
+    bool reading_ = false;
+    std::uint64_t offset_ = 0;
+    std::vector<std::uint8_t> staging_;
+    std::size_t moved_ = 0;
+    bool submitted_ = false;
+    bool stopping_ = false;
+    std::atomic<bool> done_{false};
+    std::thread thread_;
+};
+
+BlockStorageDeviceV2::BlockStorageDeviceV2() : DeviceClassV2(device_class::kBlockStorage) {}
+
+BlockStorageDeviceV2::~BlockStorageDeviceV2() = default;
+
+void BlockStorageDeviceV2::host_attach_image(BlockImageV2* image, bool asynchronous) {
+    host_finish_transfer();
+    image_ = image;
+    asynchronous_ = asynchronous;
+    capacity_ = image == nullptr ? 0 : image->size() / kBlockBytes;
+    if (!asynchronous) {
+        worker_.reset();
+    }
+}
+
+void BlockStorageDeviceV2::issue(std::uint64_t command) {
+    // device-surface.md: a block number plus length past the capacity, a length of zero, or an
+    // unregistered buffer is "a defined, non-transferring failure that sets the invalid-request
+    // status bit", and so is a command issued while busy, with "the transfer already in flight
+    // ... unaffected". A buffer that is not wholly populated memory is the bulk-transfer rule's
+    // version of the same failure, and a command the contract does not name is refused with it
+    // too rather than taken for one it does. The length is bounded by the capacity before it is
+    // multiplied, so the byte count cannot wrap.
+    const bool named = command == block_storage_offset::kCommandRead ||
+                       command == block_storage_offset::kCommandWrite;
+    std::uint64_t unused = 0;
+    if (in_flight_ || !named || image_ == nullptr || memory_ == nullptr || length_ == 0 ||
+        length_ > capacity_ || block_number_ > capacity_ - length_ || !buffer_registered_ ||
+        !memory_->check_range(buffer_base_, length_ * kBlockBytes, unused)) {
+        acknowledgeable_status_ |= status_mask(block_storage_status_bit::kInvalidRequest);
+        return;
+    }
+
+    const bool reading = command == block_storage_offset::kCommandRead;
+    const std::uint64_t offset = block_number_ * kBlockBytes;
+    const std::uint64_t bytes = length_ * kBlockBytes;
+    if (!asynchronous_) {
+        // Straight between the image and the buffer's own bytes. A read tells every page of the
+        // buffer it is written before the image fills it, whether or not the read then delivers
+        // every byte, which costs a page generation at worst and never misses a write. Either
+        // way the run comes back with every page committed, including the ones the guest never
+        // touched, because the host call reads or writes it in the kernel, where an access to
+        // a page Windows has only reserved fails rather than faulting (user-006).
+        const std::size_t moved =
+            reading ? image_->read(offset, memory_->host_range_for_write(buffer_base_, bytes),
+                                   static_cast<std::size_t>(bytes))
+                    : image_->write(offset, memory_->host_range(buffer_base_, bytes),
+                                    static_cast<std::size_t>(bytes));
+        complete(bytes, moved);
+        return;
+    }
+
+    // The worker's transfer goes through the staging buffer, which a write fills now, at the
+    // command, and a read empties at the pickup. Either reading of when the bytes leave the
+    // buffer is one the contract allows, since the guest may not count on a buffer it has handed
+    // to a transfer in flight.
+    if (reading) {
+        staging_.resize(static_cast<std::size_t>(bytes));
+    } else {
+        const std::uint8_t* from = memory_->host_range(buffer_base_, bytes);
+        staging_.assign(from, from + bytes);
+    }
+    in_flight_ = true;
+    flight_command_ = command;
+    flight_base_ = buffer_base_;
+    flight_bytes_ = bytes;
+    if (worker_ == nullptr) {
+        worker_ = std::make_unique<BlockWorkerV2>();
+    }
+    worker_->submit(image_, reading, offset, staging_);
+}
+
+void BlockStorageDeviceV2::host_poll_transfer() {
+    if (!in_flight_ || worker_ == nullptr || !worker_->done()) {
+        return;
+    }
+    std::size_t moved = worker_->collect(staging_);
+    // "The contents of the buffer are the bytes the device did transfer with the remainder
+    // unmodified", so a short read lands what it got and no more. A load that no longer fits
+    // is a host resize between the command and the pickup, and lands nothing.
+    if (flight_command_ == block_storage_offset::kCommandRead &&
+        !memory_->load_image(flight_base_, staging_.data(), moved)) {
+        moved = 0;
+    }
+    complete(flight_bytes_, moved);
+}
+
+void BlockStorageDeviceV2::host_wait_for_transfer(std::uint64_t nanoseconds) {
+    if (in_flight_ && worker_ != nullptr) {
+        worker_->wait(nanoseconds);
+    }
+}
+
+void BlockStorageDeviceV2::host_finish_transfer() {
+    host_wait_for_transfer(UINT64_MAX);
+    host_poll_transfer();
+}
+
+void BlockStorageDeviceV2::complete(std::uint64_t requested, std::uint64_t moved) {
+    in_flight_ = false;
+    acknowledgeable_status_ |= status_mask(block_storage_status_bit::kTransferComplete);
+    if (moved < requested) {
+        acknowledgeable_status_ |= status_mask(block_storage_status_bit::kTransferError);
+    }
+    publish_line();
+}
+
+void BlockStorageDeviceV2::load_class_state(StateReaderV2& in) {
+    if (in_flight_) {
+        worker_->wait(UINT64_MAX);
+        worker_->collect(staging_);
+        in_flight_ = false;
+    }
+    block_number_ = in.get_u64();
+    buffer_base_ = in.get_u64();
+    length_ = in.get_u64();
+    buffer_registered_ = in.get_bool();
+}
+
+FileBlockImageV2::~FileBlockImageV2() { close(); }
+
+bool FileBlockImageV2::open(const std::string& path) {
+    close();
+#ifdef _WIN32
+    const int descriptor = _open(path.c_str(), _O_RDWR | _O_BINARY);
+    struct _stat64 info;
+    const bool sized = descriptor >= 0 && _fstat64(descriptor, &info) == 0;
+#else
+    const int descriptor = ::open(path.c_str(), O_RDWR);
+    struct stat info;
+    const bool sized = descriptor >= 0 && fstat(descriptor, &info) == 0;
+#endif
+    if (!sized) {
+        if (descriptor >= 0) {
+#ifdef _WIN32
+            _close(descriptor);
+#else
+            ::close(descriptor);
+#endif
+        }
+        return false;
+    }
+    descriptor_ = descriptor;
+    size_ = static_cast<std::uint64_t>(info.st_size);
+    return true;
+}
+
+void FileBlockImageV2::close() {
+    if (descriptor_ < 0) {
+        return;
+    }
+#ifdef _WIN32
+    _close(descriptor_);
+#else
+    ::close(descriptor_);
+#endif
+    descriptor_ = -1;
+    size_ = 0;
+}
+
+// Both loop, because a read or a write at an offset may move fewer bytes than asked without
+// anything being wrong, and stop at the first call that moves none.
+std::size_t FileBlockImageV2::read(std::uint64_t offset, std::uint8_t* into, std::size_t length) {
+    std::size_t moved = 0;
+    while (moved < length) {
+#ifdef _WIN32
+        // The CRT has no read at an offset. Nothing else uses this descriptor while a transfer
+        // is on it, since the device runs one at a time, so a seek and a read stand in for one.
+        const std::size_t chunk = std::min<std::size_t>(length - moved, std::size_t{1} << 30);
+        const int got = _lseeki64(descriptor_, static_cast<__int64>(offset + moved), SEEK_SET) < 0
+                            ? -1
+                            : _read(descriptor_, into + moved, static_cast<unsigned>(chunk));
+#else
+        const ssize_t got =
+            pread(descriptor_, into + moved, length - moved, static_cast<off_t>(offset + moved));
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+#endif
+        if (got <= 0) {
+            break;
+        }
+        moved += static_cast<std::size_t>(got);
+    }
+    return moved;
+}
+
+std::size_t FileBlockImageV2::write(std::uint64_t offset, const std::uint8_t* from,
+                                    std::size_t length) {
+    std::size_t moved = 0;
+    while (moved < length) {
+#ifdef _WIN32
+        const std::size_t chunk = std::min<std::size_t>(length - moved, std::size_t{1} << 30);
+        const int put = _lseeki64(descriptor_, static_cast<__int64>(offset + moved), SEEK_SET) < 0
+                            ? -1
+                            : _write(descriptor_, from + moved, static_cast<unsigned>(chunk));
+#else
+        const ssize_t put =
+            pwrite(descriptor_, from + moved, length - moved, static_cast<off_t>(offset + moved));
+        if (put < 0 && errno == EINTR) {
+            continue;
+        }
+#endif
+        if (put <= 0) {
+            break;
+        }
+        moved += static_cast<std::size_t>(put);
+    }
+    return moved;
+}
+
+}  // namespace maize::v2
@@ -0,0 +1,55 @@
+// block_storage_v2.h (user-018): the host file a block storage device keeps its blocks in.
+//
+// device_v2.h declares the device and the BlockImageV2 it stores through; this is the image mzvm
+// attaches, and block_storage_v2.cpp holds both it and the parts of the device that need a
+// thread.
+//
+// THE FILE IS READ AND WRITTEN AT AN OFFSET, NOT MAPPED. pread and pwrite put the bytes straight
+// into the guest's buffer and take them straight out of it, so a transfer is one host call and
+// one copy, which is all a mapping of the file would have saved too; and a mapped file that
+// another process truncates kills the host with a bus error at the next touch, where a read at an
+// offset comes up short and the guest is told so with transfer-error. The offset is passed in
+// every call rather than kept in the descriptor, so the machine's thread and the device's worker
+// never share a file position.
+//
+// THE IMAGE IS WHOLE BLOCKS. The device reports the whole blocks in the file as its capacity and
+// never transfers past them, so a file that is not a multiple of the block size has a tail the
+// guest cannot reach, and the file never grows.
+
+#ifndef MAIZE_V2_BLOCK_STORAGE_V2_H
+#define MAIZE_V2_BLOCK_STORAGE_V2_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "device_v2.h"
+
+namespace maize::v2 {
+
+class FileBlockImageV2 final : public BlockImageV2 {
+  public:
+    FileBlockImageV2() = default;
+    ~FileBlockImageV2() override;
+
+    FileBlockImageV2(const FileBlockImageV2&) = delete;
+    FileBlockImageV2& operator=(const FileBlockImageV2&) = delete;
+
+    // Open `path` for reading and writing. False, with nothing open, when the file cannot be
+    // opened that way or its size cannot be read. An image already open is closed first.
+    bool open(const std::string& path);
+    void close();
+    bool is_open() const { return descriptor_ >= 0; }
+
+    std::uint64_t size() const override { return size_; }
+    std::size_t read(std::uint64_t offset, std::uint8_t* into, std::size_t length) override;
+    std::size_t write(std::uint64_t offset, const std::uint8_t* from, std::size_t length) override;
+
+  private:
+    int descriptor_ = -1;
+    std::uint64_t size_ = 0;
+};
+
+}  // namespace maize::v2
+
+#endif  // MAIZE_V2_BLOCK_STORAGE_V2_H
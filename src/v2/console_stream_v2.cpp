@@ -0,0 +1,213 @@
+// console_stream_v2.cpp (user-016): the writer thread behind StreamingConsoleSinkV2.
+
+#include "console_stream_v2.h"
+
+#include <algorithm>
+#include <cerrno>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace maize::v2 {
+
+StreamingConsoleSinkV2::StreamingConsoleSinkV2(std::FILE* out, const ConsoleStreamOptionsV2& options)
+    : out_(out), options_(options) {
+    // A threshold past the capacity would never be reached, and put() would wait on a writer
+    // that is waiting for its tick.
+    if (options_.capacity == 0) {
+        options_.capacity = 1;
+    }
+    if (options_.threshold == 0 || options_.threshold > options_.capacity) {
+        options_.threshold = options_.capacity;
+    }
+    held_.reserve(options_.capacity);
+#ifdef _WIN32
+    // The same reason write_console_bytes gives in mzvm_main.cpp: a text-mode stream turns one
+    // line feed the guest wrote into two bytes, and the console's contract is the bytes it wrote.
+    std::fflush(out_);
+    previous_mode_ = _setmode(_fileno(out_), _O_BINARY);
+#endif
+    writer_ = std::thread(&StreamingConsoleSinkV2::write_loop, this);
+}
+
+StreamingConsoleSinkV2::~StreamingConsoleSinkV2() { close(); }
+
+void StreamingConsoleSinkV2::put(std::uint8_t byte) {
+    std::unique_lock<std::mutex> guard(lock_);
+    while (held_.size() >= options_.capacity && !failed_ && !closing_) {
+        space_.wait(guard);
+    }
+    if (failed_ || closing_) {
+        return;
+    }
+    held_.push_back(byte);
+    // Woken once per batch of held bytes rather than once per line feed in it: a writer already
+    // told to come takes every byte held when it does.
+    if (!urgent_ &&
+        (held_.size() >= options_.threshold || (options_.line_flush && byte == '\n'))) {
+        urgent_ = true;
+        wake_writer_.notify_one();
+    }
+}
+
+void StreamingConsoleSinkV2::close() {
+    {
+        std::lock_guard<std::mutex> guard(lock_);
+        if (closed_) {
+            return;
+        }
+        closed_ = true;
+        closing_ = true;
+    }
+    wake_writer_.notify_one();
+    space_.notify_all();
+    writer_.join();
+#ifdef _WIN32
+    if (previous_mode_ != -1) {
+        _setmode(_fileno(out_), previous_mode_);
+    }
+#endif
+}
+
+bool StreamingConsoleSinkV2::failed() const {
+    std::lock_guard<std::mutex> guard(lock_);
+    return failed_;
+}
+
+void StreamingConsoleSinkV2::write_loop() {
+    // Two buffers that trade places, so the writer writes one while the guest fills the other and
+    // neither is reallocated after the first swap.
+    std::vector<std::uint8_t> writing;
+    writing.reserve(options_.capacity);
+    std::unique_lock<std::mutex> guard(lock_);
+    for (;;) {
+        wake_writer_.wait_for(guard, options_.tick, [this] { return urgent_ || closing_; });
+        if (held_.empty()) {
+            if (closing_) {
+                return;
+            }
+            continue;
+        }
+        writing.swap(held_);
+        urgent_ = false;
+        space_.notify_all();
+
+        guard.unlock();
+        const bool written =
+            std::fwrite(writing.data(), 1, writing.size(), out_) == writing.size() &&
+            std::fflush(out_) == 0;
+        writing.clear();
+        guard.lock();
+
+        if (!written) {
+            failed_ = true;
+            held_.clear();
+            urgent_ = false;
+            space_.notify_all();
+        }
+    }
+}
+
+StreamingConsoleSourceV2::StreamingConsoleSourceV2(int descriptor, std::size_t capacity)
+    : shared_(std::make_shared<Shared>()), descriptor_(descriptor),
+      capacity_(capacity == 0 ? 1 : capacity) {}
+
+StreamingConsoleSourceV2::~StreamingConsoleSourceV2() {
+    {
+        std::lock_guard<std::mutex> guard(shared_->lock);
+        shared_->abandoned = true;
+    }
+    shared_->space.notify_all();
+}
+
+void StreamingConsoleSourceV2::start() {
+    started_ = true;
+    std::thread(read_loop, shared_, descriptor_, capacity_).detach();
+}
+
+bool StreamingConsoleSourceV2::take(std::vector<std::uint8_t>& into, std::size_t limit) {
+    if (!started_) {
+        start();
+    }
+    // The machine asks at every settle while its guest waits for input, so the answer to "has
+    // anything come" is one load, and the lock is taken only when something has.
+    if (!shared_->ready.load(std::memory_order_acquire)) {
+        return false;
+    }
+    std::lock_guard<std::mutex> guard(shared_->lock);
+    std::vector<std::uint8_t>& held = shared_->held;
+    const std::size_t count = std::min(limit, held.size());
+    into.insert(into.end(), held.begin(), held.begin() + static_cast<std::ptrdiff_t>(count));
+    held.erase(held.begin(), held.begin() + static_cast<std::ptrdiff_t>(count));
+    shared_->ready.store(!held.empty() || shared_->ended, std::memory_order_release);
+    if (count != 0) {
+        shared_->space.notify_one();
+    }
+    return shared_->ended && held.empty();
+}
+
+void StreamingConsoleSourceV2::wait(std::uint64_t nanoseconds) {
+    if (!started_) {
+        start();
+    }
+    std::unique_lock<std::mutex> guard(shared_->lock);
+    const auto ready = [this] { return !shared_->held.empty() || shared_->ended; };
+    if (nanoseconds == UINT64_MAX) {
+        shared_->arrived.wait(guard, ready);
+        return;
+    }
+    shared_->arrived.wait_for(guard, std::chrono::nanoseconds(nanoseconds), ready);
+}
+
+void StreamingConsoleSourceV2::read_loop(std::shared_ptr<Shared> shared, int descriptor,
+                                         std::size_t capacity) {
+#ifdef _WIN32
+    // Bytes in, as the console's contract says, with no carriage return taken out of a line end.
+    _setmode(descriptor, _O_BINARY);
+#endif
+    std::uint8_t buffer[4096];
+    for (;;) {
+        std::size_t room = 0;
+        {
+            std::unique_lock<std::mutex> guard(shared->lock);
+            shared->space.wait(guard, [&shared, capacity] {
+                return shared->abandoned || shared->held.size() < capacity;
+            });
+            if (shared->abandoned) {
+                return;
+            }
+            room = std::min(sizeof(buffer), capacity - shared->held.size());
+        }
+
+        // The one call here that can block for as long as the host likes, so nothing is held
+        // across it.
+#ifdef _WIN32
+        const int got = _read(descriptor, buffer, static_cast<unsigned>(room));
+#else
+        const ssize_t got = read(descriptor, buffer, room);
+#endif
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+
+        std::lock_guard<std::mutex> guard(shared->lock);
+        if (got <= 0) {
+            // The end of the stream and a stream that cannot be read are one thing to a guest:
+            // no byte is ever coming, which is what end-of-input says.
+            shared->ended = true;
+        } else {
+            shared->held.insert(shared->held.end(), buffer, buffer + got);
+        }
+        shared->ready.store(true, std::memory_order_release);
+        shared->arrived.notify_all();
+        if (shared->ended) {
+            return;
+        }
+    }
+}
+
+}  // namespace maize::v2
@@ -0,0 +1,149 @@
+// console_stream_v2.h (user-016): the console sink mzvm streams a guest's output through, and
+// (user-017) the source it streams the guest's input from.
+//
+// Before this, mzvm held every byte the guest wrote until the machine stopped and wrote them all
+// out at the end. A guest that logs for hours showed nothing for hours, and held every byte of
+// the log in host memory while it did. StreamingConsoleSinkV2 is the replacement: the console
+// hands it each byte as the guest writes it, and it passes them on to a host stream while the
+// machine is still running.
+//
+// THE STREAM IS WRITTEN ON A THREAD OF ITS OWN. put() runs on the machine's thread, inside an
+// OUT instruction, and does nothing there but append to a buffer under a lock nobody else holds
+// for longer than a swap. A writer thread takes the buffer and does the fwrite and the fflush, so
+// a terminal that is slow to scroll, or a pipe whose reader is busy, costs the guest nothing
+// until the guest has got a whole buffer ahead of it. At that point put() waits for the writer,
+// because the alternatives are holding without bound, which is the memory growth this exists to
+// end, or losing bytes the console's contract says were delivered.
+//
+// WHEN THE BYTES GO OUT. The writer is woken, rather than left to its tick, by a full threshold's
+// worth of bytes and, when the stream is a terminal, by a line feed: a person watching a terminal
+// expects each line as it is finished, the way line-buffered stdio gives it to them, while a
+// pipe or a file is better served by fewer, larger writes. Anything short of either goes out at
+// the next tick, so a prompt with no line feed after it still appears, and close() writes
+// whatever is left, which is what mzvm does when the machine stops for any reason.
+//
+// THE INPUT SIDE READS ON A THREAD OF ITS OWN TOO, for the opposite reason. A read of a terminal
+// or a pipe blocks until a byte comes, and the machine cannot block on it: it has a guest to run.
+// StreamingConsoleSourceV2's reader thread does the blocking read into a bounded buffer, and the
+// console takes from that buffer on the machine's thread without ever waiting. The reader stops
+// reading while the buffer is full, so a guest that never reads holds a buffer's worth of its
+// input at most and the rest stays in the host stream where it was.
+//
+// NOTHING STARTS UNTIL THE GUEST ASKS. The reader thread is started by the console's first
+// request, and device_v2.h says when the console makes one: a guest that reads its console's
+// input or enables its line. A guest that does neither never has its stdin read, so a program
+// piped into something else's input, or run from a shell it should not steal keystrokes from,
+// behaves exactly as it did before there was a source at all.
+//
+// A WAITING GUEST SLEEPS. wait() is a condition variable the reader signals, so a guest parked in
+// wait_for_interrupt on console input parks the host thread running it, and no thread polls: the
+// reader sleeps in the read and the machine sleeps in the wait until a byte wakes them both.
+
+#ifndef MAIZE_V2_CONSOLE_STREAM_V2_H
+#define MAIZE_V2_CONSOLE_STREAM_V2_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "device_v2.h"
+
+namespace maize::v2 {
+
+struct ConsoleStreamOptionsV2 {
+    // The most bytes held for the writer at once; put() waits for the writer beyond it.
+    std::size_t capacity = std::size_t{1} << 20;
+    // Bytes held at which the writer is woken rather than left to its tick.
+    std::size_t threshold = std::size_t{64} << 10;
+    // The longest a byte waits for the writer when nothing else wakes it.
+    std::chrono::milliseconds tick{50};
+    // Wake the writer at every line feed. mzvm sets it when its stdout is a terminal.
+    bool line_flush = false;
+};
+
+class StreamingConsoleSinkV2 final : public ConsoleSinkV2 {
+  public:
+    // `out` stays the caller's; it is written only by the writer thread until close().
+    explicit StreamingConsoleSinkV2(std::FILE* out, const ConsoleStreamOptionsV2& options = {});
+    ~StreamingConsoleSinkV2() override;
+
+    StreamingConsoleSinkV2(const StreamingConsoleSinkV2&) = delete;
+    StreamingConsoleSinkV2& operator=(const StreamingConsoleSinkV2&) = delete;
+
+    void put(std::uint8_t byte) override;
+
+    // Write everything held, flush the stream and stop the writer. Bytes put after it are
+    // dropped. Safe to call more than once, and the destructor calls it.
+    void close();
+
+    // Whether a write to the stream has failed. Everything from the failed write on is dropped
+    // rather than held, so a guest whose reader went away runs on instead of waiting forever.
+    bool failed() const;
+
+  private:
+    void write_loop();
+
+    std::FILE* out_;
+    ConsoleStreamOptionsV2 options_;
+    mutable std::mutex lock_;
+    std::condition_variable wake_writer_;
+    std::condition_variable space_;
+    std::vector<std::uint8_t> held_;
+    bool urgent_ = false;   // the writer has been woken for the bytes now held
+    bool closing_ = false;
+    bool failed_ = false;
+    bool closed_ = false;
+    int previous_mode_ = -1;  // the stream's translation mode before this sink, on Windows
+    std::thread writer_;
+};
+
+class StreamingConsoleSourceV2 final : public ConsoleSourceV2 {
+  public:
+    // The host stream is `descriptor`, a file descriptor the source reads and never closes.
+    explicit StreamingConsoleSourceV2(int descriptor, std::size_t capacity = std::size_t{64} << 10);
+    // Does not wait for the reader. A reader blocked in a read of a stream with nothing more to
+    // say would hold the host up for as long as that stream stays open, so it is left to end
+    // with the stream or the process, and it touches nothing of this object's once it does.
+    ~StreamingConsoleSourceV2() override;
+
+    StreamingConsoleSourceV2(const StreamingConsoleSourceV2&) = delete;
+    StreamingConsoleSourceV2& operator=(const StreamingConsoleSourceV2&) = delete;
+
+    bool take(std::vector<std::uint8_t>& into, std::size_t limit) override;
+    void wait(std::uint64_t nanoseconds) override;
+
+    // Whether the reader has been started, which is whether any guest has asked for input yet.
+    bool started() const { return started_; }
+
+  private:
+    // Everything the reader thread touches, owned jointly by it and by this source so that either
+    // may go first.
+    struct Shared {
+        std::mutex lock;
+        std::condition_variable arrived;  // the reader signals a byte or the end
+        std::condition_variable space;    // the machine signals that it took some
+        std::vector<std::uint8_t> held;
+        std::atomic<bool> ready{false};   // held is not empty, or ended is set
+        bool ended = false;
+        bool abandoned = false;           // the source is gone and the reader should be too
+    };
+
+    void start();
+    static void read_loop(std::shared_ptr<Shared> shared, int descriptor, std::size_t capacity);
+
+    std::shared_ptr<Shared> shared_;
+    int descriptor_;
+    std::size_t capacity_;
+    bool started_ = false;
+};
+
+}  // namespace maize::v2
+
+#endif  // MAIZE_V2_CONSOLE_STREAM_V2_H
@@ -0,0 +1,95 @@
+// cost_v2.h (user-022): the cycle costs a metered v2 machine charges.
+//
+// ROADMAP.md leaves the cost model open and docs/spec/cycle-cost.md keeps it out of the
+// behavioural contract, and this does not close either: it is the HOST's model, which no
+// instruction can read and no guest result depends on, and the architectural counter the `meter`
+// extension reserves is still to be specified. What it gives a host is a count of work that is
+// exact and reproducible, the same on every host and with or without the JIT, so a run can be
+// bounded by it (mzvm --cycle-budget) and two builds of a program compared by it (mzvm --meter).
+//
+// THE COST IS THE OPCODE'S, AND NOTHING ELSE. An instruction is charged the same whatever its
+// operands, whether it trapped, and whether the machine ran it from the predecode cache, a fused
+// pair or a compiled block, which is what lets the count ride on the retirement the machine
+// counts already: cycle() adds the table entry where it counts the step, and JitV2 where it
+// counts its own. Two things cost by the amount of work rather than by the opcode, because one
+// instruction can do an unbounded amount of it, and each is charged where that work is counted:
+// a block-memory instruction pays kBlockByte for every byte it moves, run by run, and every walk
+// of the page tables pays kTranslationWalk, read off the translator's own walk count when the
+// total is asked for rather than added on the walk's path.
+//
+// The numbers are a first cut in units of the simplest instruction, and belong to this file
+// alone: a change to one moves every count a host has recorded, and is a change to this file and
+// to the fixture that pins them, not to anything a guest does.
+
+#ifndef MAIZE_V2_COST_V2_H
+#define MAIZE_V2_COST_V2_H
+
+#include <array>
+#include <cstdint>
+
+#include "opcode_v2.h"
+
+namespace maize::v2 {
+
+namespace cycle_cost {
+
+// A register-to-register operation, a constant, a compare, a branch, a jump, and every byte this
+// table does not name otherwise.
+inline constexpr std::uint8_t kSimple = 1;
+inline constexpr std::uint8_t kMultiply = 3;
+inline constexpr std::uint8_t kDivide = 20;
+inline constexpr std::uint8_t kMemory = 2;
+// A call or a return, which reads or writes the link as well as the program counter.
+inline constexpr std::uint8_t kCall = 2;
+inline constexpr std::uint8_t kCsr = 4;
+inline constexpr std::uint8_t kTlbInvalidate = 8;
+// A block-memory instruction's own cost, before the bytes it moves.
+inline constexpr std::uint8_t kBlock = 4;
+inline constexpr std::uint8_t kPort = 20;
+// sys, breakpoint and trap_return, each of which crosses a privilege boundary.
+inline constexpr std::uint8_t kPrivilegeChange = 20;
+
+inline constexpr std::uint64_t kBlockByte = 1;
+// Four page-table reads, one a level.
+inline constexpr std::uint64_t kTranslationWalk = 8;
+
+}  // namespace cycle_cost
+
+namespace detail {
+
+constexpr void assign_cost(std::array<std::uint8_t, 256>& t, std::uint8_t first,
+                           std::uint8_t last, std::uint8_t cost) {
+    for (unsigned byte = first; byte <= last; ++byte) {
+        t[byte] = cost;
+    }
+}
+
+constexpr std::array<std::uint8_t, 256> build_cycle_costs() {
+    std::array<std::uint8_t, 256> t{};
+    assign_cost(t, 0x00, 0xFF, cycle_cost::kSimple);
+    assign_cost(t, op::kMultiply, op::kMultiplyHighUnsigned, cycle_cost::kMultiply);
+    assign_cost(t, op::kDivideSigned, op::kRemainderUnsignedH, cycle_cost::kDivide);
+    assign_cost(t, op::kCallDisp, op::kReturn, cycle_cost::kCall);
+    assign_cost(t, op::kLoad, op::kStoreDisp + 3, cycle_cost::kMemory);
+    assign_cost(t, op::kBlockCopy, op::kBlockSet, cycle_cost::kBlock);
+    assign_cost(t, op::kCsrRead, op::kCsrWrite, cycle_cost::kCsr);
+    assign_cost(t, op::kCsrSwap, op::kCsrSwap, cycle_cost::kCsr);
+    assign_cost(t, op::kSysImm, op::kTrapReturn, cycle_cost::kPrivilegeChange);
+    assign_cost(t, op::kBreakpoint, op::kBreakpoint, cycle_cost::kPrivilegeChange);
+    assign_cost(t, op::kTlbInvalidateAll, op::kTlbInvalidateAddress, cycle_cost::kTlbInvalidate);
+    assign_cost(t, op::kPortIn, op::kPortOut, cycle_cost::kPort);
+    return t;
+}
+
+}  // namespace detail
+
+inline constexpr std::array<std::uint8_t, 256> kCycleCosts = detail::build_cycle_costs();
+
+static_assert(kCycleCosts[op::kAdd] == cycle_cost::kSimple &&
+                  kCycleCosts[op::kStoreDisp + 3] == cycle_cost::kMemory &&
+                  kCycleCosts[op::kRemainderUnsignedH] == cycle_cost::kDivide,
+              "each band's first and last byte carry its cost");
+
+}  // namespace maize::v2
+
+#endif  // MAIZE_V2_COST_V2_H
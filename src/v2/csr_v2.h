@@ -27,7 +27,9 @@
 
 #include <array>
 #include <cstdint>
+#include <initializer_list>
 
+#include "state_stream_v2.h"
 #include "trap_v2.h"
 
 namespace maize::v2 {
@@ -290,6 +292,7 @@ class CsrFileV2 {
     // `64n + 63`, with the cause's number modulo 64 selecting the bit."
     static constexpr unsigned kCauseCount = 256;
     static constexpr unsigned kNoCause = kCauseCount;  // "no cause", outside the 0..255 range
+    static constexpr std::uint64_t kDeviceLineMask = 0xFF;  // lines 0 through 7
 
     // A device raises its cause. This is the machine acting on the world's behalf, not an
     // instruction, which is why it does not go through access(): the pending registers are
@@ -309,6 +312,18 @@ class CsrFileV2 {
         return (interrupt_pending_[cause_number / 64] & cause_bit(cause_number)) != 0u;
     }
 
+    // The pending bits of the eight device causes, 32 through 39, as a word indexed by line,
+    // which is the shape the device surface publishes its lines in (user-010). The sample at an
+    // instruction boundary compares the two and writes only when they differ, so the boundary
+    // costs one compare on every instruction no line moved on.
+    std::uint64_t device_pending_lines() const {
+        return (interrupt_pending_[0] >> cause::kFirstExternalInterrupt) & kDeviceLineMask;
+    }
+    void machine_set_device_pending_lines(std::uint64_t lines) {
+        interrupt_pending_[0] = (interrupt_pending_[0] & ~(kDeviceLineMask << cause::kFirstExternalInterrupt)) |
+                                ((lines & kDeviceLineMask) << cause::kFirstExternalInterrupt);
+    }
+
     // The enable bit as SOFTWARE READS IT, which for causes 0 through 31 is zero whatever the
     // stored word holds. Going through read_raw rather than the array is the whole point: those
     // bits read as zero by an independent rule, so a cause that got into the array by some route
@@ -399,6 +414,33 @@ class CsrFileV2 {
     // Reads a register without applying any access rule, for a host inspecting a machine.
     std::uint64_t host_read(std::uint16_t number) const { return read_raw(number); }
 
+    // Every register, the translation-flush counter included, to and from a snapshot
+    // (user-007). Whole values and no access rule, because a restore puts back a state the
+    // machine was already in rather than asking for a change to it.
+    void save_state(StateWriterV2& out) const {
+        for (const std::uint64_t value :
+             {fcsr_, feature_bitmap_, status_, trap_stack_, trap_vector_base_, paging_root_,
+              syscall_provider_, scratch_, halt_cause_, boot_info_, translation_flushes_}) {
+            out.put_u64(value);
+        }
+        for (unsigned array = 0; array < 4; ++array) {
+            out.put_u64(interrupt_enable_[array]);
+            out.put_u64(interrupt_pending_[array]);
+        }
+    }
+
+    void load_state(StateReaderV2& in) {
+        for (std::uint64_t* value :
+             {&fcsr_, &feature_bitmap_, &status_, &trap_stack_, &trap_vector_base_, &paging_root_,
+              &syscall_provider_, &scratch_, &halt_cause_, &boot_info_, &translation_flushes_}) {
+            *value = in.get_u64();
+        }
+        for (unsigned array = 0; array < 4; ++array) {
+            interrupt_enable_[array] = in.get_u64();
+            interrupt_pending_[array] = in.get_u64();
+        }
+    }
+
   private:
     // "with the cause's number modulo 64 selecting the bit".
     static constexpr std::uint64_t cause_bit(unsigned cause_number) {
@@ -43,6 +43,16 @@ namespace maize::v2 {
 // This is a source rather than a flag because the decoder is also a disassembler front end and a
 // tracer front end, and those walk a byte stream with no machine behind it. The bare constructor
 // keeps that use working unchanged.
+//
+// THE SOURCE KEEPS A WINDOW ON ONE CODE PAGE (user-005). The first byte fetched from a page is
+// translated and judged as above, and the populated part of that page then becomes a window of
+// host bytes, so the rest of the instruction reads straight out of it. Every byte of a page
+// translates alike, so a byte inside the window would have translated to exactly where the
+// window says. A byte outside it, which is a byte across the page boundary or past the end of
+// populated memory, takes the translated road and reports its own fault. A source lives for one
+// decode, so nothing the decode could not see (a paging-root write, a privilege change, a TLB
+// invalidation, a store) can happen while its window is open, and a store made before the next
+// decode is read through the window anyway because the window is memory itself.
 class FetchSourceV2 {
   public:
     explicit FetchSourceV2(const MemoryV2& memory) : memory_(&memory) {}
@@ -58,6 +68,10 @@ class FetchSourceV2 {
     // word, and leaves the captured program counter to the decoder, which is the only party
     // that knows the address of the instruction this byte belongs to.
     bool byte(std::uint64_t address, std::uint8_t& value, TrapV2& trap) const {
+        if (address - window_base_ < window_length_) {
+            value = window_[address - window_base_];
+            return true;
+        }
         std::uint64_t physical = address;
         if (translator_ != nullptr) {
             const TranslationResult translated = translator_->translate(
@@ -75,16 +89,33 @@ class FetchSourceV2 {
             return false;
         }
         value = memory_->read_byte(physical);
+        open_window(address, physical);
         return true;
     }
 
   private:
+    // Open the window on the page holding `address`, which has just fetched from `physical`,
+    // over as much of the page as is populated.
+    void open_window(std::uint64_t address, std::uint64_t physical) const {
+        constexpr std::uint64_t kOffsetMask = MemoryV2::kPageBytes - 1;
+        const std::uint64_t physical_page = physical & ~kOffsetMask;
+        const std::uint64_t populated = static_cast<std::uint64_t>(memory_->size()) - physical_page;
+        window_ = memory_->host_bytes(physical_page);
+        window_base_ = address & ~kOffsetMask;
+        window_length_ = populated < MemoryV2::kPageBytes ? populated : MemoryV2::kPageBytes;
+    }
+
     const MemoryV2* memory_;
     // Null means bare fetch straight out of physical memory, which is what a disassembler wants
     // and what this build did everywhere before Sv48 existed.
     TranslatorV2* translator_ = nullptr;
     std::uint64_t paging_root_value_ = 0;
     Privilege level_ = Privilege::Supervisor;
+    // The open window, empty until the first byte. Mutable because opening it is a cache of
+    // what byte() already decided, not a change to what the source reads.
+    mutable const std::uint8_t* window_ = nullptr;
+    mutable std::uint64_t window_base_ = 0;
+    mutable std::uint64_t window_length_ = 0;
 };
 
 struct DecodedV2 {
@@ -46,16 +46,29 @@
 // The spec's own word for end-of-input is "latches", which is why `latched` is not the name of
 // the other category here: borrowing it would put the one bit the spec calls latched in the
 // field named after it, and the miscategorisation would read as correct forever.
+//
+// A LINE IS PUBLISHED WHEN IT MOVES, NOT POLLED (user-010). The machine samples the interrupt
+// lines at every instruction boundary, and asking every class in turn, through a virtual call
+// each, would put a cost on every instruction that grows with every class this file gains. So
+// each class writes its own line into one word the surface owns, at the moments its level can
+// move: a port access, a host-side delivery such as pushed input, and the timer's expiry. The
+// boundary then reads one word. The rule for a class is short and has no exceptions: anything
+// that can change interrupt_condition() or the enable ends by calling publish_line().
 
 #ifndef MAIZE_V2_DEVICE_V2_H
 #define MAIZE_V2_DEVICE_V2_H
 
 #include <cstddef>
 #include <cstdint>
+#include <memory>
 #include <vector>
 
+#include "state_stream_v2.h"
+
 namespace maize::v2 {
 
+class MemoryV2;
+
 // A port identifier is 16 bits, and the low nibble is the offset within a class block.
 inline constexpr unsigned kPortsPerBlock = 16;
 
@@ -141,6 +154,93 @@ inline constexpr std::uint64_t kModeDefinedMask = 0x3;
 
 }  // namespace timer_offset
 
+namespace block_storage_status_bit {
+
+// device-surface.md's Block storage section names bit 0, transfer-complete, which is the
+// interrupt condition, and bit 6, transfer-error, which is set alongside it when a transfer came
+// up short. Busy and invalid-request are the skeleton's, and this is the one class in this build
+// that ever holds busy.
+inline constexpr unsigned kTransferComplete = skeleton_status_bit::kPrimaryCondition;
+inline constexpr unsigned kBusy = skeleton_status_bit::kBusy;
+inline constexpr unsigned kInvalidRequest = skeleton_status_bit::kInvalidRequest;
+inline constexpr unsigned kTransferError = 6;
+
+}  // namespace block_storage_status_bit
+
+namespace block_storage_offset {
+
+inline constexpr std::uint16_t kBlockSize = 3;    // read only, bytes
+inline constexpr std::uint16_t kCapacity = 4;     // read only, blocks
+inline constexpr std::uint16_t kBlockNumber = 5;  // read and write
+inline constexpr std::uint16_t kBufferBase = 6;   // read and write, a physical address
+inline constexpr std::uint16_t kLength = 7;       // read and write, blocks
+inline constexpr std::uint16_t kCommand = 8;      // write only
+
+// The command port's two defined values: device into buffer, and buffer onto device.
+inline constexpr std::uint64_t kCommandRead = 1;
+inline constexpr std::uint64_t kCommandWrite = 2;
+
+}  // namespace block_storage_offset
+
+namespace framebuffer_status_bit {
+
+// device-surface.md's Framebuffer section names bit 0, frame-pending, and it is the interrupt
+// condition. Invalid-request is the skeleton's, and a claim or a present the device cannot honor
+// sets it.
+inline constexpr unsigned kFramePending = skeleton_status_bit::kPrimaryCondition;
+inline constexpr unsigned kInvalidRequest = skeleton_status_bit::kInvalidRequest;
+
+}  // namespace framebuffer_status_bit
+
+namespace framebuffer_offset {
+
+inline constexpr std::uint16_t kWidth = 3;          // read only, pixels
+inline constexpr std::uint16_t kHeight = 4;         // read only, pixels
+inline constexpr std::uint16_t kFormat = 5;         // read only
+inline constexpr std::uint16_t kSurfaceCount = 6;   // read only
+inline constexpr std::uint16_t kSurfaceSelect = 7;  // read and write
+inline constexpr std::uint16_t kSurfaceBase = 8;    // read and write, a physical address
+inline constexpr std::uint16_t kPresent = 9;        // write only
+inline constexpr std::uint16_t kScanout = 10;       // read and write
+
+// The one pixel format the base defines: XRGB8888, four bytes a pixel.
+inline constexpr std::uint64_t kFormatXrgb8888 = 1;
+
+}  // namespace framebuffer_offset
+
+namespace network_status_bit {
+
+// device-surface.md's Network section names bit 0, receive-available, as the interrupt condition
+// and bit 5 as overrun. Invalid-request is the skeleton's.
+inline constexpr unsigned kReceiveAvailable = skeleton_status_bit::kPrimaryCondition;
+inline constexpr unsigned kInvalidRequest = skeleton_status_bit::kInvalidRequest;
+inline constexpr unsigned kOverrun = 5;
+
+}  // namespace network_status_bit
+
+namespace network_offset {
+
+inline constexpr std::uint16_t kMaxFrame = 3;         // read only, bytes
+inline constexpr std::uint16_t kTransmitBuffer = 4;   // read and write, a physical address
+inline constexpr std::uint16_t kReceiveBuffer = 5;    // read and write, a physical address
+inline constexpr std::uint16_t kTransmit = 6;         // write only, the frame's length
+inline constexpr std::uint16_t kReceiveLength = 7;    // read only, and reading consumes
+
+}  // namespace network_offset
+
+namespace entropy_status_bit {
+
+// device-surface.md's Entropy section names bit 0, data-available, as the interrupt condition.
+inline constexpr unsigned kDataAvailable = skeleton_status_bit::kPrimaryCondition;
+
+}  // namespace entropy_status_bit
+
+namespace entropy_offset {
+
+inline constexpr std::uint16_t kData = 3;  // read only, and reading consumes
+
+}  // namespace entropy_offset
+
 constexpr std::uint64_t status_mask(unsigned bit) { return std::uint64_t{1} << bit; }
 
 // Every class identification word carries a "class contract version" in its second
@@ -226,7 +326,13 @@ class DeviceClassV2 {
             case skeleton_offset::kIdentification: return identification();
             case skeleton_offset::kStatus: return status();
             case skeleton_offset::kInterruptControl: return interrupt_enabled_ ? 1u : 0u;
-            default: return read_class_port(offset);
+            default: {
+                // A class read can consume, and consuming the console's last byte drops its
+                // line, so the read publishes like a write.
+                const std::uint64_t value = read_class_port(offset);
+                publish_line();
+                return value;
+            }
         }
     }
 
@@ -247,24 +353,64 @@ class DeviceClassV2 {
                 // acknowledge rather than a redefinition of what an acknowledge means, so the
                 // three skeleton offsets stay sealed and the hook runs beneath them.
                 on_acknowledge(value);
-                return;
+                break;
             case skeleton_offset::kInterruptControl:
                 // Bit 0 enables the class's interrupt line. Bits 1 through 63 are reserved, and
                 // writing a reserved bit is discarded rather than trapped.
                 interrupt_enabled_ = (value & 1u) != 0;
-                return;
+                break;
             default:
                 write_class_port(offset, value);
-                return;
+                break;
         }
+        publish_line();
+    }
+
+    // Where this class publishes its line (user-010), which is the surface's word, attached
+    // once by the surface that owns the class. A class standing alone, as a fixture builds one,
+    // publishes nowhere and is polled through interrupt_asserted() instead.
+    void attach_line(std::uint64_t* lines) {
+        lines_ = lines;
+        publish_line();
     }
 
     // Host-side, reachable from no instruction. A fixture uses this to stand up an acknowledgeable
     // condition whose real source this build does not wire, so the acknowledge contract can be
     // tested on a bit that genuinely clears.
-    void host_raise_acknowledgeable_bit(unsigned bit) { acknowledgeable_status_ |= status_mask(bit); }
+    void host_raise_acknowledgeable_bit(unsigned bit) {
+        acknowledgeable_status_ |= status_mask(bit);
+        publish_line();
+    }
+
+    // The class's state to and from a snapshot (user-007). Sealed the way the skeleton ports
+    // are: the skeleton's own two fields are saved here, once, and a class adds what it holds
+    // through the hooks below. The identification is not state, since it is fixed at
+    // construction, and a snapshot restored into a machine is restored into one carrying the
+    // same classes.
+    void save_state(StateWriterV2& out) const {
+        out.put_u64(acknowledgeable_status_);
+        out.put_bool(interrupt_enabled_);
+        save_class_state(out);
+    }
+
+    void load_state(StateReaderV2& in) {
+        acknowledgeable_status_ = in.get_u64();
+        interrupt_enabled_ = in.get_bool();
+        load_class_state(in);
+        publish_line();
+    }
 
   protected:
+    // Write this class's line into the surface's word. Cheap enough to call on every path that
+    // might move the level, which is what lets no path have to work out whether it did.
+    void publish_line() {
+        if (lines_ == nullptr) {
+            return;
+        }
+        const std::uint64_t bit = std::uint64_t{1} << class_code_;
+        *lines_ = interrupt_asserted() ? (*lines_ | bit) : (*lines_ & ~bit);
+    }
+
     // The bits this class holds true right now, recomputed on every read.
     virtual std::uint64_t held_status_bits() const { return 0; }
 
@@ -289,6 +435,11 @@ class DeviceClassV2 {
         (void)value;
     }
 
+    // Whatever the class holds beyond the skeleton. A class with registers of its own must
+    // override both, in the same order, or a restored machine silently resets it.
+    virtual void save_class_state(StateWriterV2& out) const { (void)out; }
+    virtual void load_class_state(StateReaderV2& in) { (void)in; }
+
     // Bits an acknowledge clears for good. A bit the device would still consider true afterwards
     // does not belong here; it belongs in held_status_bits().
     std::uint64_t acknowledgeable_status_ = 0;
@@ -297,27 +448,27 @@ class DeviceClassV2 {
     unsigned class_code_;
     std::uint64_t contract_version_;
     bool interrupt_enabled_ = false;
+    std::uint64_t* lines_ = nullptr;
 };
 
 // The console: a byte-at-a-time input stream and a byte-at-a-time output stream at offset 3.
 //
-// NO HOST INPUT SOURCE IS WIRED IN THIS BUILD, and a queue a fixture fills is not one. maize-451
-// filed that as D-2 when a console with no way at all to receive a byte was the whole story;
-// maize-466 needs the interrupt condition the console owns, so the queue below exists and
-// host_push_input is the only thing that fills it. Nothing reachable from a guest instruction
-// puts a byte in it, so a program run under mzvm still sees input-available permanently clear,
-// which is the contract's own defined behaviour for an input stream that has nothing waiting
-// rather than a gap in it. A later card wires real stdin into host_push_input and changes
-// nothing else here.
+// INPUT COMES FROM A HOST SOURCE WHEN ONE IS ATTACHED (user-017), and otherwise from nothing.
+// maize-451 filed a console with no way at all to receive a byte as D-2; maize-466 added the queue
+// below and host_push_input, which is how fixtures deliver a byte; and a ConsoleSourceV2 is how
+// a host delivers a stream, which mzvm does with its own stdin. The console PULLS from the source,
+// on the machine's thread, at three moments and no others: when the guest reads the status or
+// data port, at the settle points of a machine whose console interrupt is enabled, and in a
+// wait_for_interrupt that input could end. A guest that never reads the console and never asks to
+// be interrupted by it never asks the source for anything, which is what lets a source start its
+// host-side machinery on the first request and cost nothing until then.
 //
-// WHERE THE BIT GOES WHEN STDIN ARRIVES, since that card will read this paragraph rather than
-// re-derive it. End-of-input is HELD, not acknowledgeable, so it belongs in held_status_bits()
-// behind `input_exhausted_` and NOT in acknowledgeable_status_. The spec's word for it is
-// "latches", and it "stays set thereafter" precisely so a guest can tell a byte that is not
-// there yet from a byte that will never come, which an acknowledge must not be able to undo.
-// The stdin card sets `input_exhausted_` when the host stream ends and never clears it. That
-// path is already exercised: host_set_input_exhausted stands the condition up today and
-// device_console_acknowledge_clears_transient_bits_only proves an acknowledge cannot clear it.
+// END-OF-INPUT IS HELD, not acknowledgeable, so it lives in held_status_bits() behind
+// `input_exhausted_` and NOT in acknowledgeable_status_. The spec's word for it is "latches", and
+// it "stays set thereafter" precisely so a guest can tell a byte that is not there yet from a
+// byte that will never come, which an acknowledge must not be able to undo. A source sets it once
+// its stream has ended and every byte of it has been queued, and nothing clears it;
+// device_console_acknowledge_clears_transient_bits_only proves an acknowledge cannot.
 //
 // INPUT-AVAILABLE IS HELD TOO, and for a different reason: it is true exactly while a byte is
 // waiting, so consuming the last byte makes it false again. device-surface.md's Console section
@@ -328,8 +479,37 @@ class DeviceClassV2 {
 // double delivery.
 //
 // Output goes into a buffer rather than to a real stream, so the interpreter and its in-process
-// fixtures carry no I/O dependency. mzvm_main.cpp reads the buffer after run() and is the only
-// thing in the tree that touches a real stdout.
+// fixtures carry no I/O dependency. A host that wants the bytes as they are written rather than
+// after the machine stops attaches a ConsoleSinkV2 instead (user-016), and then the buffer is not
+// filled at all; mzvm_main.cpp does, through console_stream_v2.h, and is still the only thing in
+// the tree that touches a real stdout.
+class ConsoleSinkV2 {
+  public:
+    virtual ~ConsoleSinkV2() = default;
+
+    // One byte the guest wrote to the data port, in the order it wrote them. Called on the
+    // machine's own thread, in the middle of an instruction, so an implementation that can wait
+    // on anything slower than memory belongs behind a queue of its own.
+    virtual void put(std::uint8_t byte) = 0;
+};
+
+// Where a console's input comes from (user-017). The host's side of it, which owns whatever
+// thread or handle the bytes really arrive on; the console only ever calls it from the machine's
+// thread.
+class ConsoleSourceV2 {
+  public:
+    virtual ~ConsoleSourceV2() = default;
+
+    // Move up to `limit` of the bytes that have arrived and not yet been taken onto the end of
+    // `into`, and say whether the stream has ended with nothing left to take. Never waits: a
+    // source with nothing to give returns at once, and cheaply, because the machine asks often.
+    virtual bool take(std::vector<std::uint8_t>& into, std::size_t limit) = 0;
+
+    // Wait until take() would give a byte or report the end, or until `nanoseconds` have passed;
+    // UINT64_MAX waits for as long as that takes. Called by a machine with nothing to run.
+    virtual void wait(std::uint64_t nanoseconds) = 0;
+};
+
 class ConsoleDeviceV2 : public DeviceClassV2 {
   public:
     ConsoleDeviceV2() : DeviceClassV2(device_class::kConsole) {}
@@ -338,28 +518,86 @@ class ConsoleDeviceV2 : public DeviceClassV2 {
 
     const std::vector<std::uint8_t>& output() const { return output_; }
 
+    // Host-side, reachable from no instruction (user-016). While a sink is attached every byte
+    // written goes to it and none goes into output(), so a guest that prints for hours holds no
+    // more host memory than the sink does. Null detaches it and the buffer takes over again. The
+    // sink is the host's, and must outlive the attachment.
+    void host_attach_sink(ConsoleSinkV2* sink) { sink_ = sink; }
+
     // Host-side, reachable from no instruction. A console whose output can always accept a byte
     // holds output-ready permanently set, which is conforming and is what this build's in-memory
     // buffer is. A fixture clears it to reach the overrun path, which no guest program can reach
     // here but a real terminal with backpressure will reach for real.
     void host_set_output_ready(bool ready) { output_ready_ = ready; }
 
-    // Host-side, reachable from no instruction. The stdin card sets this when the host stream
-    // ends; today it exists so a fixture can prove that end-of-input, once true, survives an
-    // acknowledge. Without it the categorisation above would be an untested claim, and it is a
+    // Host-side, reachable from no instruction. A source latches this itself when its stream
+    // ends (user-017); this exists so a fixture can prove that end-of-input, once true, survives
+    // an acknowledge. Without it the categorisation above would be an untested claim, and it is a
     // claim that got itself wrong once already.
-    void host_set_input_exhausted(bool exhausted) { input_exhausted_ = exhausted; }
+    void host_set_input_exhausted(bool exhausted) {
+        input_exhausted_ = exhausted;
+        publish_line();
+    }
 
     // Host-side, reachable from no instruction (maize-466). Deliver one byte to the input stream,
     // which is what a real console does when a key reaches it. This is the ordinary console-input
     // injection the interrupt fixtures use, and it is the only thing in the tree that makes
     // input-available true.
-    void host_push_input(std::uint8_t byte) { input_.push_back(byte); }
+    void host_push_input(std::uint8_t byte) {
+        input_.push_back(byte);
+        publish_line();
+    }
 
     // How many delivered bytes the guest has not consumed yet. Host-side and for assertions; a
     // guest sees this only as the input-available status bit.
     std::size_t host_pending_input() const { return input_.size() - input_read_; }
 
+    // The bytes the guest has read from the data port and written to it and had accepted, since
+    // the console was made (user-025). Host-side and for reporting, and not in a snapshot: they
+    // count this host's traffic, which a restored machine has not had yet.
+    std::uint64_t host_bytes_in() const { return bytes_in_; }
+    std::uint64_t host_bytes_out() const { return bytes_out_; }
+
+    // Host-side, reachable from no instruction (user-017). The source this console pulls input
+    // from, or null for none. The source is the host's, and must outlive the attachment.
+    void host_attach_source(ConsoleSourceV2* source) { source_ = source; }
+
+    // The most undelivered bytes the console holds at once. The rest wait in the source, so a
+    // guest that polls the status port and never reads pulls no unbounded stream into the machine.
+    static constexpr std::size_t kInputWindow = 4096;
+
+    // Pull whatever the source has into the queue, and latch end-of-input once it has nothing
+    // more to give. A console with no source, or one whose stream already ended, does nothing.
+    void host_poll_source() {
+        if (source_ == nullptr || input_exhausted_) {
+            return;
+        }
+        // Consumed bytes are dropped here rather than kept for a fixture to look back at: a stream
+        // is not small by construction the way a fixture's pushes are.
+        if (input_read_ != 0) {
+            input_.erase(input_.begin(), input_.begin() + static_cast<std::ptrdiff_t>(input_read_));
+            input_read_ = 0;
+        }
+        if (input_.size() < kInputWindow && source_->take(input_, kInputWindow - input_.size())) {
+            input_exhausted_ = true;
+        }
+        publish_line();
+    }
+
+    // Whether input from the source could raise the line right now: a stream is still open, the
+    // guest has enabled the line, and the line is not already up. A byte more behind one already
+    // waiting changes nothing a wait could wake on.
+    bool host_watches_source() const {
+        return source_ != nullptr && !input_exhausted_ && interrupt_enabled() &&
+               !input_available();
+    }
+
+    void host_wait_for_source(std::uint64_t nanoseconds) {
+        if (source_ != nullptr) {
+            source_->wait(nanoseconds);
+        }
+    }
+
   protected:
     std::uint64_t held_status_bits() const override {
         std::uint64_t held = 0;
@@ -389,6 +627,7 @@ class ConsoleDeviceV2 : public DeviceClassV2 {
             }
             // Zero-extended, and consumed. Consuming the last byte clears input-available, which
             // drops the interrupt line with it.
+            ++bytes_in_;
             return input_[input_read_++];
         }
         return 0;  // reserved within a populated block
@@ -406,9 +645,39 @@ class ConsoleDeviceV2 : public DeviceClassV2 {
             acknowledgeable_status_ |= status_mask(console_status_bit::kOverrun);
             return;
         }
+        ++bytes_out_;
+        if (sink_ != nullptr) {
+            sink_->put(static_cast<std::uint8_t>(value & 0xFF));
+            return;
+        }
         output_.push_back(static_cast<std::uint8_t>(value & 0xFF));
     }
 
+    // The output buffer travels with the snapshot, so a restored machine's console holds what
+    // the original's did and a host writing out "what the guest printed" writes the same bytes.
+    // Bytes that went to a sink are not in it: they have already left the machine, which is the
+    // same position a restored run's host is in for the buffer, and the sink itself is host
+    // wiring that a snapshot neither records nor replaces.
+    void save_class_state(StateWriterV2& out) const override {
+        out.put_bytes(output_);
+        out.put_bytes(input_);
+        out.put_u64(input_read_);
+        out.put_bool(output_ready_);
+        out.put_bool(input_exhausted_);
+    }
+
+    void load_class_state(StateReaderV2& in) override {
+        in.get_bytes(output_);
+        in.get_bytes(input_);
+        input_read_ = static_cast<std::size_t>(in.get_u64());
+        output_ready_ = in.get_bool();
+        input_exhausted_ = in.get_bool();
+        // A read index past the queue would read past the vector on the next data-port read.
+        if (input_read_ > input_.size()) {
+            input_read_ = input_.size();
+        }
+    }
+
   private:
     bool input_available() const { return input_read_ < input_.size(); }
 
@@ -418,7 +687,11 @@ class ConsoleDeviceV2 : public DeviceClassV2 {
     std::vector<std::uint8_t> input_;
     std::size_t input_read_ = 0;
     bool output_ready_ = true;
-    bool input_exhausted_ = false;  // nothing in this build ever sets it
+    bool input_exhausted_ = false;
+    ConsoleSinkV2* sink_ = nullptr;
+    ConsoleSourceV2* source_ = nullptr;
+    std::uint64_t bytes_in_ = 0;
+    std::uint64_t bytes_out_ = 0;
 };
 
 // The timer, class 3 (maize-466). device-surface.md says outright that it "is the device the
@@ -448,6 +721,10 @@ class TimerDeviceV2 : public DeviceClassV2 {
 
     std::uint64_t monotonic_nanoseconds() const { return monotonic_ns_; }
 
+    // How many times an interval has run out since the timer was made (user-025). Host-side and
+    // for reporting, and not in a snapshot, like the console's byte counts.
+    std::uint64_t host_expiries() const { return expiries_; }
+
     // Advance the machine's own sense of time and expire the timer if the interval elapsed. The
     // interpreter calls this once per retired instruction; nothing a guest executes calls it.
     void advance_time(std::uint64_t nanoseconds) {
@@ -463,6 +740,8 @@ class TimerDeviceV2 : public DeviceClassV2 {
             // expiry, which is what keeps a periodic timer from queueing expiries behind a
             // handler that has not run yet.
             armed_ = false;
+            ++expiries_;
+            publish_line();
         }
     }
 
@@ -567,6 +846,24 @@ class TimerDeviceV2 : public DeviceClassV2 {
         }
     }
 
+    // The interval in flight is saved as its absolute expiry, so a restored timer fires at the
+    // same instruction the original would have.
+    void save_class_state(StateWriterV2& out) const override {
+        out.put_u64(period_);
+        out.put_u64(mode_);
+        out.put_u64(monotonic_ns_);
+        out.put_u64(next_expiry_ns_);
+        out.put_bool(armed_);
+    }
+
+    void load_class_state(StateReaderV2& in) override {
+        period_ = in.get_u64();
+        mode_ = in.get_u64();
+        monotonic_ns_ = in.get_u64();
+        next_expiry_ns_ = in.get_u64();
+        armed_ = in.get_bool();
+    }
+
   private:
     bool counting_enabled() const {
         return (mode_ & timer_offset::kModeCountingEnabled) != 0;
@@ -595,18 +892,593 @@ class TimerDeviceV2 : public DeviceClassV2 {
     std::uint64_t monotonic_ns_ = 0;
     std::uint64_t next_expiry_ns_ = 0;
     bool armed_ = false;
+    std::uint64_t expiries_ = 0;
+};
+
+// What a block storage device keeps its blocks in (user-018). The host's side, like a console's
+// sink and source: mzvm backs it with a file through block_storage_v2.h, and a fixture can back
+// it with anything. The device calls it from the machine's thread for a synchronous transfer and
+// from its worker thread for an asynchronous one, and never from both at once, because the device
+// accepts one command at a time.
+class BlockImageV2 {
+  public:
+    virtual ~BlockImageV2() = default;
+
+    // The image's length in bytes. The device's capacity is the whole blocks in it.
+    virtual std::uint64_t size() const = 0;
+
+    // Copy `length` bytes from the image at byte `offset` into `into`, or from `from` into the
+    // image, and say how many moved. Fewer than asked only when the host failed partway, which
+    // the device reports to the guest as transfer-error.
+    virtual std::size_t read(std::uint64_t offset, std::uint8_t* into, std::size_t length) = 0;
+    virtual std::size_t write(std::uint64_t offset, const std::uint8_t* from,
+                              std::size_t length) = 0;
+};
+
+class BlockWorkerV2;
+
+// Block storage, class 4 (user-018): fixed-size blocks whose payload moves through a buffer in
+// guest memory rather than through a port, which device-surface.md's "Bulk transfer through guest
+// memory" section bounds and its Block storage section lays out.
+//
+// THE CLASS IS PRESENT ONLY WHILE THE HOST HAS ATTACHED AN IMAGE. A block device with nothing
+// behind it has no capacity to report and nothing to transfer, and an optional class a machine
+// does not carry is exactly what the presence bitmap is for, so a machine with no image reads the
+// class absent, as every machine did before this class existed.
+//
+// A TRANSFER GOES STRAIGHT BETWEEN THE IMAGE AND GUEST MEMORY. The buffer is checked whole before
+// a byte moves, as the bulk-transfer rule requires, and then the image is read into, or written
+// from, the buffer's own host bytes in one call, with no copy in between and no per-block or
+// per-page loop on the machine's side. memory_v2.h's host_range_for_write is what keeps that
+// honest: every page of the buffer is told it is being written first, so a decoded instruction,
+// a dirty page or a shared page in the buffer is handled exactly as a guest store would handle it.
+//
+// COMPLETION IS SYNCHRONOUS UNLESS THE HOST ASKS OTHERWISE. By default the transfer is done by the
+// time the port_out that issued it retires, which the contract allows ("a command may complete
+// asynchronously") and which keeps every run a function of its program and its image. A host
+// that attaches the image as asynchronous gets the other reading: the device sets busy, hands the
+// transfer to a worker thread of its own, and the guest runs on while the host does the I/O. The
+// worker never touches guest memory, which has no locking and no business acquiring any: it moves
+// the bytes through a staging buffer, and the device picks up the finished transfer on the
+// machine's thread, at the same points user-017 polls console input, and only there copies it
+// into the guest's buffer, clears busy and raises transfer-complete.
+class BlockStorageDeviceV2 : public DeviceClassV2 {
+  public:
+    // block_storage_v2.cpp, where the worker is complete.
+    BlockStorageDeviceV2();
+    ~BlockStorageDeviceV2() override;
+
+    // 512 bytes, the smallest block the contract allows and the sector every host disk image is
+    // already cut into, so any image a host has is a whole number of blocks or very nearly.
+    static constexpr std::uint64_t kBlockBytes = 512;
+
+    // The memory a transfer's buffer lives in, attached once by the machine that owns both.
+    void attach_memory(MemoryV2* memory) { memory_ = memory; }
+
+    // Host-side, reachable from no instruction. The image this device stores its blocks in, or
+    // null to detach it, and whether its transfers complete on a worker thread. A transfer in
+    // flight finishes first. The image is the host's and must outlive the attachment; like a
+    // console's sink it is host wiring, so a snapshot does not carry it and a clone does not
+    // inherit it.
+    void host_attach_image(BlockImageV2* image, bool asynchronous = false);
+    bool host_attached() const { return image_ != nullptr; }
+
+    // The asynchronous side, all of it called on the machine's thread. Whether a transfer has
+    // been accepted and not yet picked up; whether one could raise the line when it is; pick one
+    // up if the worker has finished it; wait up to `nanoseconds` for the worker to finish it,
+    // with UINT64_MAX waiting as long as that takes; and wait for it and pick it up.
+    bool host_transfer_in_flight() const { return in_flight_; }
+    bool host_watches_transfer() const { return in_flight_ && interrupt_enabled(); }
+    void host_poll_transfer();
+    void host_wait_for_transfer(std::uint64_t nanoseconds);
+    void host_finish_transfer();
+
+  protected:
+    // Busy is held: it is true exactly while a transfer is in flight, and no acknowledge can make
+    // a transfer finish sooner.
+    std::uint64_t held_status_bits() const override {
+        return in_flight_ ? status_mask(block_storage_status_bit::kBusy) : 0;
+    }
+
+    // device-surface.md, Block storage: "status bit 0, transfer-complete, is the interrupt
+    // condition." Acknowledgeable, as the timer's expiry-pending is: it records that a transfer
+    // finished, and once the guest has been told, the device has nothing left to report.
+    bool interrupt_condition() const override {
+        return (acknowledgeable_status_ &
+                status_mask(block_storage_status_bit::kTransferComplete)) != 0;
+    }
+
+    std::uint64_t read_class_port(std::uint16_t offset) override {
+        switch (offset) {
+            case block_storage_offset::kBlockSize: return kBlockBytes;
+            case block_storage_offset::kCapacity: return capacity_;
+            case block_storage_offset::kBlockNumber: return block_number_;
+            case block_storage_offset::kBufferBase: return buffer_base_;
+            case block_storage_offset::kLength: return length_;
+            default: return 0;  // the command port is write only, and the rest is reserved
+        }
+    }
+
+    void write_class_port(std::uint16_t offset, std::uint64_t value) override {
+        switch (offset) {
+            case block_storage_offset::kBlockNumber: block_number_ = value; return;
+            case block_storage_offset::kBufferBase:
+                buffer_base_ = value;
+                buffer_registered_ = true;
+                return;
+            case block_storage_offset::kLength: length_ = value; return;
+            case block_storage_offset::kCommand: issue(value); return;
+            default: return;  // block size and capacity are read only, and the rest is reserved
+        }
+    }
+
+    // The registers and nothing in flight: InterpreterV2 finishes a transfer before it saves the
+    // machine, so there is never one to save, and a load abandons whatever this device still had
+    // going, since the machine it was going for has just been replaced.
+    void save_class_state(StateWriterV2& out) const override {
+        out.put_u64(block_number_);
+        out.put_u64(buffer_base_);
+        out.put_u64(length_);
+        out.put_bool(buffer_registered_);
+    }
+
+    void load_class_state(StateReaderV2& in) override;
+
+  private:
+    // A command written to offset 8. block_storage_v2.cpp.
+    void issue(std::uint64_t command);
+    // Retire the transfer in flight, `moved` bytes of the `requested`.
+    void complete(std::uint64_t requested, std::uint64_t moved);
+
+    MemoryV2* memory_ = nullptr;
+    BlockImageV2* image_ = nullptr;
+    bool asynchronous_ = false;
+    std::uint64_t capacity_ = 0;
+    std::uint64_t block_number_ = 0;
+    std::uint64_t buffer_base_ = 0;
+    std::uint64_t length_ = 0;
+    // "Unregistered" is a buffer the guest has never written a base for since reset, which is
+    // not the same as one at address zero: physical zero is populated memory like any other.
+    bool buffer_registered_ = false;
+    // The transfer the worker has, as it was accepted: the registers may move under it, and the
+    // contract says the transfer in flight is unaffected by anything issued after it.
+    bool in_flight_ = false;
+    std::uint64_t flight_command_ = 0;
+    std::uint64_t flight_base_ = 0;
+    std::uint64_t flight_bytes_ = 0;
+    std::vector<std::uint8_t> staging_;
+    std::unique_ptr<BlockWorkerV2> worker_;
+};
+
+// Where a framebuffer's presented frames go (user-019). The host's side, like a console's sink:
+// framebuffer_v2.h has a shared-memory one a presenter process maps and a headless one that only
+// counts, and a fixture can supply anything. Both calls come on the machine's thread, inside the
+// port_out that caused them.
+class FramebufferSinkV2 {
+  public:
+    virtual ~FramebufferSinkV2() = default;
+
+    // One presented frame of `surface`: `bytes` bytes of XRGB8888, row after row with no padding.
+    // `pixels` is a view of the guest's own buffer, valid for this call only, so a sink that
+    // keeps the frame copies it, once, and a sink that does not copies nothing.
+    virtual void present(unsigned surface, const std::uint8_t* pixels, std::size_t bytes) = 0;
+
+    // The guest chose `surface` as the one scanned out.
+    virtual void scan_out(unsigned surface) = 0;
+};
+
+// A framebuffer's shape, fixed by the host for the run: device-surface.md says width, height and
+// format "are properties of the machine for the duration of a run".
+struct FramebufferGeometryV2 {
+    std::uint32_t width = 640;
+    std::uint32_t height = 480;
+    unsigned surfaces = 1;
+};
+
+// The framebuffer, class 5 (user-019). A guest registers a buffer in ordinary memory for a
+// surface, draws into it with ordinary stores, and writes the present port, and "on present the
+// device reads the whole buffer once and displays it".
+//
+// THE CLASS IS PRESENT ONLY WHILE THE HOST HAS ATTACHED A DISPLAY, which is block storage's rule
+// for its image and for the same reason: a machine with nothing to show frames on would refuse
+// every claim, and an absent class says that more plainly than a present one that always says no.
+//
+// PRESENT IS ONE READ OF GUEST MEMORY AND NO COPY OF ITS OWN. The device checks the buffer is
+// still wholly populated, hands the sink a view of the guest's bytes where they already are, and
+// is done; the sink copies them into wherever its display reads from, so a present costs one
+// memcpy of the frame at most, and nothing at all for a sink that only counts. No frame is
+// allocated or staged anywhere on the way.
+//
+// A frame is scanned out the moment its present hands it over, so frame-pending is set by the
+// present of the scanned-out surface. A present of any other surface reaches the sink too, which
+// keeps it ready for the moment the guest switches to it, but nothing was scanned out, so nothing
+// is pending.
+class FramebufferDeviceV2 : public DeviceClassV2 {
+  public:
+    FramebufferDeviceV2() : DeviceClassV2(device_class::kFramebuffer) {}
+
+    static constexpr std::uint64_t kBytesPerPixel = 4;
+    // More surfaces than any run needs, and few enough that the per-surface registers stay small.
+    static constexpr unsigned kMaxSurfaces = 16;
+
+    // The memory the surfaces' buffers live in, attached once by the machine that owns both.
+    void attach_memory(MemoryV2* memory) { memory_ = memory; }
+
+    // Host-side, reachable from no instruction. The display frames go to, or null to detach it,
+    // and the shape the guest sees, whose surface count is clamped to 1 through kMaxSurfaces.
+    // Attaching resets the surfaces to unclaimed. The sink is the host's and must outlive the
+    // attachment; like block storage's image it is host wiring that a snapshot does not carry.
+    void host_attach_display(FramebufferSinkV2* sink, const FramebufferGeometryV2& geometry = {}) {
+        sink_ = sink;
+        geometry_ = geometry;
+        if (geometry_.surfaces == 0) {
+            geometry_.surfaces = 1;
+        } else if (geometry_.surfaces > kMaxSurfaces) {
+            geometry_.surfaces = kMaxSurfaces;
+        }
+        bases_.assign(geometry_.surfaces, 0);
+        selected_ = 0;
+        scanout_ = 0;
+    }
+    bool host_attached() const { return sink_ != nullptr; }
+    const FramebufferGeometryV2& geometry() const { return geometry_; }
+
+    // How many presents reached the display, of any surface. Host-side and for reporting.
+    std::uint64_t host_presents() const { return presents_; }
+
+    std::uint64_t frame_bytes() const {
+        return std::uint64_t{geometry_.width} * geometry_.height * kBytesPerPixel;
+    }
+
+  protected:
+    // device-surface.md, Framebuffer: "Status bit 0 is frame-pending ... and it is the interrupt
+    // condition." Acknowledgeable: it records a frame that went out.
+    bool interrupt_condition() const override {
+        return (acknowledgeable_status_ & status_mask(framebuffer_status_bit::kFramePending)) != 0;
+    }
+
+    std::uint64_t read_class_port(std::uint16_t offset) override {
+        switch (offset) {
+            case framebuffer_offset::kWidth: return geometry_.width;
+            case framebuffer_offset::kHeight: return geometry_.height;
+            case framebuffer_offset::kFormat: return framebuffer_offset::kFormatXrgb8888;
+            case framebuffer_offset::kSurfaceCount: return geometry_.surfaces;
+            case framebuffer_offset::kSurfaceSelect: return selected_;
+            case framebuffer_offset::kSurfaceBase: return bases_[selected_];
+            case framebuffer_offset::kScanout: return scanout_;
+            default: return 0;  // the present port is write only, and the rest is reserved
+        }
+    }
+
+    // framebuffer_v2.cpp, where a claim and a present reach memory.
+    void write_class_port(std::uint16_t offset, std::uint64_t value) override;
+
+    // The surfaces as the guest set them up. A restored machine's display has not seen its
+    // frames, and shows the next one presented.
+    void save_class_state(StateWriterV2& out) const override {
+        out.put_u64(selected_);
+        out.put_u64(scanout_);
+        out.put_u64(bases_.size());
+        for (const std::uint64_t base : bases_) {
+            out.put_u64(base);
+        }
+    }
+
+    void load_class_state(StateReaderV2& in) override;
+
+  private:
+    void present();
+    void refuse() {
+        acknowledgeable_status_ |= status_mask(framebuffer_status_bit::kInvalidRequest);
+    }
+
+    MemoryV2* memory_ = nullptr;
+    FramebufferSinkV2* sink_ = nullptr;
+    FramebufferGeometryV2 geometry_{};
+    // One base per surface, zero for unclaimed. Never empty, so the selected surface always has
+    // one to read back.
+    std::vector<std::uint64_t> bases_ = std::vector<std::uint64_t>(1, 0);
+    std::uint64_t selected_ = 0;
+    std::uint64_t scanout_ = 0;
+    std::uint64_t presents_ = 0;
+};
+
+// The network a network device's frames go out on and come in from (user-020). The host's side:
+// network_v2.h has a virtual switch whose ports are links, and a fixture can supply anything.
+// Every call but wait() comes on the machine's thread. A link is one end of something, and its
+// other ends may be on other threads, so what a link holds for this end it holds safely against
+// them.
+class NetworkLinkV2 {
+  public:
+    virtual ~NetworkLinkV2() = default;
+
+    // The longest frame the link carries, which is what the device reports as its maximum.
+    virtual std::size_t max_frame() const = 0;
+
+    // Send one frame of `length` bytes, at most max_frame(). The link has its own copy when this
+    // returns, so the bytes may be reused at once.
+    virtual void send(const std::uint8_t* frame, std::size_t length) = 0;
+
+    // The length of the oldest frame waiting for this end, or zero when none is.
+    virtual std::size_t peek() = 0;
+    // Copy the oldest frame into `into`, which has room for what peek() said, and let it go.
+    virtual void receive(std::uint8_t* into) = 0;
+    // Let the oldest frame go uncopied.
+    virtual void discard() = 0;
+
+    // How many frames for this end the link itself dropped, having no room to hold them, since
+    // the last time this was asked.
+    virtual std::uint64_t take_dropped() = 0;
+
+    // Block until a frame is waiting for this end, nothing is left connected to send one, or
+    // `nanoseconds` pass, UINT64_MAX for no limit.
+    virtual void wait(std::uint64_t nanoseconds) = 0;
+
+    // Whether anything is still at the far end that could send this end a frame. A link every
+    // far end of which has hung up has nothing more coming, however long this end waits.
+    virtual bool connected() const = 0;
+    // This end is done: nothing reads from it or sends through it again, and a far end that is
+    // left with nobody to hear from stops waiting.
+    virtual void hang_up() = 0;
+};
+
+// The network device, class 6 (user-020). Whole link-layer frames move between a link the host
+// attaches and buffers in guest memory, under the bulk-transfer rule.
+//
+// THE CLASS IS PRESENT ONLY WHILE THE HOST HAS ATTACHED A LINK, which is block storage's rule and
+// the framebuffer's: a network device with no network has nothing to send frames to.
+//
+// A FRAME IS COPIED ONCE EACH WAY BY THE MACHINE. A transmit hands the link the guest's transmit
+// buffer where it is, and the link copies it into wherever the far end receives from before the
+// port_out returns, as the contract requires. A receive copies the link's oldest frame straight
+// into the guest's receive buffer. Nothing is staged in between on the machine's side.
+//
+// ONE FRAME WAITS IN THE RECEIVE BUFFER AND THE REST WAIT IN THE LINK. The contract drops a frame
+// that arrives while one is waiting; here a frame has arrived when it reaches the device, and
+// the link in front of the device is the wire's buffer, so a guest that consumes its frames
+// promptly loses none of a burst the link had room for. A frame the link had no room for is the
+// contract's dropped frame, and so is one that reaches the device with no receive buffer
+// registered to take it; both set overrun.
+//
+// Frames reach the device when the guest looks for them, by reading the status or the receive
+// length, and, while the guest has the line enabled and nothing waiting, at the machine's host
+// polls and in a wait_for_interrupt, as console input does (user-017).
+class NetworkDeviceV2 : public DeviceClassV2 {
+  public:
+    NetworkDeviceV2() : DeviceClassV2(device_class::kNetwork) {}
+
+    // The memory the buffers live in, attached once by the machine that owns both.
+    void attach_memory(MemoryV2* memory) { memory_ = memory; }
+
+    // Host-side, reachable from no instruction. The link, or null to detach it; the link is the
+    // host's and must outlive the attachment. Like block storage's image it is host wiring, and a
+    // snapshot does not carry it or anything still in it.
+    void host_attach_link(NetworkLinkV2* link) {
+        link_ = link;
+        publish_line();
+    }
+    bool host_attached() const { return link_ != nullptr; }
+
+    // Bring the link's next frame into the receive buffer if none is waiting there, and report
+    // whatever the link dropped. network_v2.cpp.
+    void host_poll_link();
+
+    // Whether a frame from the link could raise the line right now: one is in the link already,
+    // or something is still connected that could send one. A guest waiting on a link its peers
+    // have all hung up is waiting on nothing, and is suspended as one waiting on no device is.
+    bool host_watches_link() const {
+        return link_ != nullptr && interrupt_enabled() && waiting_ == 0 &&
+               (link_->connected() || link_->peek() != 0);
+    }
+
+    void host_wait_for_link(std::uint64_t nanoseconds) {
+        if (link_ != nullptr) {
+            link_->wait(nanoseconds);
+        }
+    }
+
+  protected:
+    // Receive-available is held: it says a frame is waiting, and only consuming the frame
+    // changes that.
+    std::uint64_t held_status_bits() const override {
+        return waiting_ != 0 ? status_mask(network_status_bit::kReceiveAvailable) : 0;
+    }
+
+    bool interrupt_condition() const override { return waiting_ != 0; }
+
+    std::uint64_t read_class_port(std::uint16_t offset) override {
+        switch (offset) {
+            case network_offset::kMaxFrame: return link_->max_frame();
+            case network_offset::kTransmitBuffer: return transmit_base_;
+            case network_offset::kReceiveBuffer: return receive_base_;
+            case network_offset::kReceiveLength: {
+                // "Reading offset 7 consumes the frame and clears the condition when no further
+                // frame is waiting", so the next one is brought in behind it straight away.
+                const std::uint64_t length = waiting_;
+                waiting_ = 0;
+                host_poll_link();
+                return length;
+            }
+            default: return 0;  // the transmit port is write only, and the rest is reserved
+        }
+    }
+
+    void write_class_port(std::uint16_t offset, std::uint64_t value) override {
+        switch (offset) {
+            case network_offset::kTransmitBuffer:
+                transmit_base_ = value;
+                transmit_registered_ = true;
+                return;
+            case network_offset::kReceiveBuffer:
+                receive_base_ = value;
+                receive_registered_ = true;
+                return;
+            case network_offset::kTransmit:
+                transmit(value);
+                return;
+            default:
+                return;  // the rest is read only or reserved
+        }
+    }
+
+    // The buffers as the guest registered them, and the length of the frame waiting in the
+    // receive buffer, whose bytes are in guest memory and go with it.
+    void save_class_state(StateWriterV2& out) const override {
+        out.put_u64(transmit_base_);
+        out.put_u64(receive_base_);
+        out.put_bool(transmit_registered_);
+        out.put_bool(receive_registered_);
+        out.put_u64(waiting_);
+    }
+
+    void load_class_state(StateReaderV2& in) override {
+        transmit_base_ = in.get_u64();
+        receive_base_ = in.get_u64();
+        transmit_registered_ = in.get_bool();
+        receive_registered_ = in.get_bool();
+        waiting_ = in.get_u64();
+    }
+
+  private:
+    // network_v2.cpp, where a frame leaves guest memory.
+    void transmit(std::uint64_t length);
+
+    MemoryV2* memory_ = nullptr;
+    NetworkLinkV2* link_ = nullptr;
+    // A buffer counts as registered once its base port has been written, as block storage's does.
+    std::uint64_t transmit_base_ = 0;
+    std::uint64_t receive_base_ = 0;
+    bool transmit_registered_ = false;
+    bool receive_registered_ = false;
+    // The length of the frame in the receive buffer, zero for none.
+    std::uint64_t waiting_ = 0;
+};
+
+// Where an entropy device's words come from (user-021). The host's side: entropy_v2.h has the
+// generator mzvm attaches, and a fixture can supply anything. Called on the machine's thread.
+class EntropySourceV2 {
+  public:
+    virtual ~EntropySourceV2() = default;
+
+    // Fill `words` with `count` words of entropy. Never fails and never blocks for long, since
+    // the device has promised the guest a word before it asks.
+    virtual void fill(std::uint64_t* words, std::size_t count) = 0;
+};
+
+// The entropy device, class 7 (user-021). One port, and each read of it consumes a word.
+//
+// THE CLASS IS PRESENT ONLY WHILE THE HOST HAS ATTACHED A SOURCE, which is block storage's rule
+// and the network's: the contract requires successive reads not to be reproducible from the
+// machine's other state, and a machine with nothing outside itself to draw on cannot keep that.
+//
+// DATA-AVAILABLE IS HELD PERMANENTLY SET, which the contract calls conforming for "a machine
+// whose entropy source is always ready". The device keeps a buffer of words and asks the source
+// for a whole buffer's worth when it runs dry, so a guest reading in a loop costs one port read
+// a word and the source is asked once every kBufferWords of them. It is also the interrupt
+// condition, so a guest that enables the line has it asserted for as long as it stays enabled.
+class EntropyDeviceV2 : public DeviceClassV2 {
+  public:
+    static constexpr std::size_t kBufferWords = 256;
+
+    EntropyDeviceV2() : DeviceClassV2(device_class::kEntropy) {}
+
+    // Host-side, reachable from no instruction. The source, or null to detach it; the source is
+    // the host's and must outlive the attachment. A snapshot does not carry it, and the words
+    // still buffered from the last one are dropped with it.
+    void host_attach_source(EntropySourceV2* source) {
+        source_ = source;
+        next_ = kBufferWords;
+        publish_line();
+    }
+    bool host_attached() const { return source_ != nullptr; }
+
+    // How many times the source has been asked for a buffer's worth.
+    std::uint64_t host_refills() const { return refills_; }
+
+  protected:
+    std::uint64_t held_status_bits() const override {
+        return source_ != nullptr ? status_mask(entropy_status_bit::kDataAvailable) : 0;
+    }
+
+    bool interrupt_condition() const override { return source_ != nullptr; }
+
+    std::uint64_t read_class_port(std::uint16_t offset) override {
+        if (offset != entropy_offset::kData) {
+            return 0;  // reserved within a populated block
+        }
+        if (next_ == kBufferWords) {
+            source_->fill(words_, kBufferWords);
+            next_ = 0;
+            ++refills_;
+        }
+        return words_[next_++];
+    }
+
+    // Nothing: the device has no registers a guest sets, and the buffered words are the source's
+    // rather than the machine's. A restored machine draws fresh ones, which is what the contract
+    // asks of a read after any other state whatever.
+    void load_class_state(StateReaderV2& in) override {
+        (void)in;
+        next_ = kBufferWords;
+    }
+
+  private:
+    EntropySourceV2* source_ = nullptr;
+    std::uint64_t words_[kBufferWords] = {};
+    std::size_t next_ = kBufferWords;
+    std::uint64_t refills_ = 0;
 };
 
 // The whole port space of one machine: the machine block, the populated classes, and the
 // read-zero-discard-writes fallback that covers everything else.
 class DeviceSurfaceV2 {
   public:
+    DeviceSurfaceV2() {
+        console_.attach_line(&asserted_lines_);
+        timer_.attach_line(&asserted_lines_);
+        block_storage_.attach_line(&asserted_lines_);
+        framebuffer_.attach_line(&asserted_lines_);
+        network_.attach_line(&asserted_lines_);
+        entropy_.attach_line(&asserted_lines_);
+    }
+
+    // The memory the bulk-transfer classes move their buffers through (user-018), attached once
+    // by the machine that owns both.
+    void attach_memory(MemoryV2* memory) {
+        block_storage_.attach_memory(memory);
+        framebuffer_.attach_memory(memory);
+        network_.attach_memory(memory);
+    }
+
+    // The classes publish into this surface's own word, so it stays where it was built.
+    DeviceSurfaceV2(const DeviceSurfaceV2&) = delete;
+    DeviceSurfaceV2& operator=(const DeviceSurfaceV2&) = delete;
+
     std::uint64_t port_in(std::uint16_t port) {
         const unsigned class_code = port_class_code(port);
         const std::uint16_t offset = port_offset(port);
         if (class_code == device_class::kMachineBlock) {
             return machine_block_read(offset);
         }
+        // A guest reading the console's status or data is a guest reading its input, so that is
+        // when a host source is asked for more (user-017).
+        if (class_code == device_class::kConsole &&
+            (offset == skeleton_offset::kStatus || offset == ConsoleDeviceV2::kDataOffset)) {
+            console_.host_poll_source();
+        }
+        // And a guest reading block storage's status is a guest looking for its transfer's end,
+        // so that is when one finished on the worker is picked up (user-018).
+        if (class_code == device_class::kBlockStorage && offset == skeleton_offset::kStatus) {
+            block_storage_.host_poll_transfer();
+        }
+        // A guest reading the network's status or receive length is looking for a frame
+        // (user-020), and the length port brings the next one in itself once it has consumed the
+        // last.
+        if (class_code == device_class::kNetwork &&
+            (offset == skeleton_offset::kStatus || offset == network_offset::kReceiveLength) &&
+            network_.host_attached()) {
+            network_.host_poll_link();
+        }
         DeviceClassV2* device = device_for(class_code);
         return device == nullptr ? 0 : device->port_read(offset);
     }
@@ -645,6 +1517,14 @@ class DeviceSurfaceV2 {
     const ConsoleDeviceV2& console() const { return console_; }
     TimerDeviceV2& timer() { return timer_; }
     const TimerDeviceV2& timer() const { return timer_; }
+    BlockStorageDeviceV2& block_storage() { return block_storage_; }
+    const BlockStorageDeviceV2& block_storage() const { return block_storage_; }
+    FramebufferDeviceV2& framebuffer() { return framebuffer_; }
+    const FramebufferDeviceV2& framebuffer() const { return framebuffer_; }
+    NetworkDeviceV2& network() { return network_; }
+    const NetworkDeviceV2& network() const { return network_; }
+    EntropyDeviceV2& entropy() { return entropy_; }
+    const EntropyDeviceV2& entropy() const { return entropy_; }
 
     const std::vector<std::uint8_t>& console_output() const { return console_.output(); }
 
@@ -653,16 +1533,10 @@ class DeviceSurfaceV2 {
     // line, and the line index equals the class code in the class table." The machine turns a
     // line index into a cause number; this function knows nothing about cause numbers, which is
     // what keeps that mapping in the one place trap-model.md assigns it to.
-    std::uint64_t asserted_interrupt_lines() const {
-        std::uint64_t lines = 0;
-        for (unsigned code = 1; code <= device_class::kHighestClassCode; ++code) {
-            const DeviceClassV2* device = device_for(code);
-            if (device != nullptr && device->interrupt_asserted()) {
-                lines |= std::uint64_t{1} << code;
-            }
-        }
-        return lines;
-    }
+    //
+    // The word the classes publish into (user-010), so reading it asks no class anything. Every
+    // class keeps it equal to what asking each one's interrupt_asserted() would give.
+    std::uint64_t asserted_interrupt_lines() const { return asserted_lines_; }
 
     // Move every device's sense of time forward. Only the timer has one today.
     void advance_time(std::uint64_t nanoseconds) { timer_.advance_time(nanoseconds); }
@@ -675,6 +1549,79 @@ class DeviceSurfaceV2 {
         return timer_.nanoseconds_until_expiry(out);
     }
 
+    // Host events: input from a host source (user-017), a block transfer finished on its worker
+    // (user-018) and a frame from the network (user-020). None is a device event: nothing in the
+    // machine's clock says when one is due, so they are polled for instead, every
+    // kHostPollInstructions while a guest could be interrupted by one, and waited for on the host
+    // in a wait_for_interrupt. A guest that could not be is never polled on its behalf.
+    //
+    // A wait watching more than one waits on the transfer if there is one, which ends on its own
+    // and soon, and the machine comes back to wait on the rest afterwards. A wait watching both
+    // the network and the console, which can each stay quiet for as long as they like, waits on
+    // the network a slice at a time, so a byte typed meanwhile waits a slice at most.
+    static constexpr std::uint64_t kHostPollInstructions = std::uint64_t{1} << 16;
+    static constexpr std::uint64_t kHostWaitSliceNanoseconds = 1'000'000;
+    bool host_events_watched() const {
+        return console_.host_watches_source() || block_storage_.host_watches_transfer() ||
+               network_.host_watches_link();
+    }
+    void poll_host_events() {
+        if (console_.host_watches_source()) {
+            console_.host_poll_source();
+        }
+        if (block_storage_.host_transfer_in_flight()) {
+            block_storage_.host_poll_transfer();
+        }
+        if (network_.host_watches_link()) {
+            network_.host_poll_link();
+        }
+    }
+    void wait_for_host_events(std::uint64_t nanoseconds) {
+        if (block_storage_.host_watches_transfer()) {
+            block_storage_.host_wait_for_transfer(nanoseconds);
+            return;
+        }
+        if (network_.host_watches_link()) {
+            network_.host_wait_for_link(console_.host_watches_source() &&
+                                                nanoseconds > kHostWaitSliceNanoseconds
+                                            ? kHostWaitSliceNanoseconds
+                                            : nanoseconds);
+            return;
+        }
+        console_.host_wait_for_source(nanoseconds);
+    }
+
+    // Finish whatever is in flight on the host's side, so the machine's state is all in the
+    // machine. A snapshot and a clone come here first.
+    void host_finish_transfers() { block_storage_.host_finish_transfer(); }
+
+    // Every populated class's state, in class-code order, each behind its code (user-007). A
+    // load that meets a code this surface does not carry, or a class out of order, fails the
+    // stream rather than loading one class's registers into another.
+    void save_state(StateWriterV2& out) const {
+        for (unsigned code = 1; code <= device_class::kHighestClassCode; ++code) {
+            const DeviceClassV2* device = device_for(code);
+            if (device != nullptr) {
+                out.put_u64(code);
+                device->save_state(out);
+            }
+        }
+    }
+
+    bool load_state(StateReaderV2& in) {
+        for (unsigned code = 1; code <= device_class::kHighestClassCode; ++code) {
+            DeviceClassV2* device = device_for(code);
+            if (device == nullptr) {
+                continue;
+            }
+            if (in.get_u64() != code || !in.ok()) {
+                return false;
+            }
+            device->load_state(in);
+        }
+        return in.ok();
+    }
+
   private:
     // The one place that says which classes this machine carries. A class code the base assigns
     // but this build does not populate, and a class code the base never assigns at all, both
@@ -684,6 +1631,14 @@ class DeviceSurfaceV2 {
         switch (class_code) {
             case device_class::kConsole: return &console_;
             case device_class::kTimer: return &timer_;
+            case device_class::kBlockStorage:
+                return block_storage_.host_attached() ? &block_storage_ : nullptr;
+            case device_class::kFramebuffer:
+                return framebuffer_.host_attached() ? &framebuffer_ : nullptr;
+            case device_class::kNetwork:
+                return network_.host_attached() ? &network_ : nullptr;
+            case device_class::kEntropy:
+                return entropy_.host_attached() ? &entropy_ : nullptr;
             default: return nullptr;
         }
     }
@@ -692,6 +1647,14 @@ class DeviceSurfaceV2 {
         switch (class_code) {
             case device_class::kConsole: return &console_;
             case device_class::kTimer: return &timer_;
+            case device_class::kBlockStorage:
+                return block_storage_.host_attached() ? &block_storage_ : nullptr;
+            case device_class::kFramebuffer:
+                return framebuffer_.host_attached() ? &framebuffer_ : nullptr;
+            case device_class::kNetwork:
+                return network_.host_attached() ? &network_ : nullptr;
+            case device_class::kEntropy:
+                return entropy_.host_attached() ? &entropy_ : nullptr;
             default: return nullptr;
         }
     }
@@ -706,6 +1669,11 @@ class DeviceSurfaceV2 {
 
     ConsoleDeviceV2 console_;
     TimerDeviceV2 timer_;
+    BlockStorageDeviceV2 block_storage_;
+    FramebufferDeviceV2 framebuffer_;
+    NetworkDeviceV2 network_;
+    EntropyDeviceV2 entropy_;
+    std::uint64_t asserted_lines_ = 0;
 };
 
 }  // namespace maize::v2
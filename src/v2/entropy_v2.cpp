@@ -0,0 +1,170 @@
+// entropy_v2.cpp (user-021): ChaCha20, the host's generator, and the source built from both.
+
+#include "entropy_v2.h"
+
+#include <cerrno>
+#include <cstring>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <bcrypt.h>
+#elif defined(__linux__)
+#include <sys/random.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace maize::v2 {
+
+namespace {
+
+constexpr std::uint32_t rotate_left(std::uint32_t value, unsigned bits) {
+    return (value << bits) | (value >> (32 - bits));
+}
+
+inline void quarter_round(std::uint32_t& a, std::uint32_t& b, std::uint32_t& c,
+                          std::uint32_t& d) {
+    a += b;
+    d = rotate_left(d ^ a, 16);
+    c += d;
+    b = rotate_left(b ^ c, 12);
+    a += b;
+    d = rotate_left(d ^ a, 8);
+    c += d;
+    b = rotate_left(b ^ c, 7);
+}
+
+// splitmix64, which spreads a seed of any shape, zero included, across a whole key.
+std::uint64_t next_seed_word(std::uint64_t& state) {
+    std::uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+}  // namespace
+
+void chacha20_block(const std::uint32_t key[8], std::uint64_t counter, std::uint64_t nonce,
+                    std::uint32_t out[16]) {
+    // "expand 32-byte k", the constant the first row always holds.
+    const std::uint32_t input[16] = {
+        0x61707865u, 0x3320646Eu, 0x79622D32u, 0x6B206574u,
+        key[0], key[1], key[2], key[3], key[4], key[5], key[6], key[7],
+        static_cast<std::uint32_t>(counter), static_cast<std::uint32_t>(counter >> 32),
+        static_cast<std::uint32_t>(nonce), static_cast<std::uint32_t>(nonce >> 32)};
+    std::uint32_t x[16];
+    std::memcpy(x, input, sizeof(x));
+    for (int round = 0; round < 10; ++round) {
+        quarter_round(x[0], x[4], x[8], x[12]);
+        quarter_round(x[1], x[5], x[9], x[13]);
+        quarter_round(x[2], x[6], x[10], x[14]);
+        quarter_round(x[3], x[7], x[11], x[15]);
+        quarter_round(x[0], x[5], x[10], x[15]);
+        quarter_round(x[1], x[6], x[11], x[12]);
+        quarter_round(x[2], x[7], x[8], x[13]);
+        quarter_round(x[3], x[4], x[9], x[14]);
+    }
+    for (int i = 0; i < 16; ++i) {
+        out[i] = x[i] + input[i];
+    }
+}
+
+bool host_random_bytes(void* into, std::size_t length) {
+    auto* bytes = static_cast<unsigned char*>(into);
+#ifdef _WIN32
+    return BCryptGenRandom(nullptr, bytes, static_cast<ULONG>(length),
+                           BCRYPT_USE_SYSTEM_PREFERRED_RNG) >= 0;
+#elif defined(__linux__)
+    while (length != 0) {
+        const ssize_t got = getrandom(bytes, length, 0);
+        if (got < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        bytes += got;
+        length -= static_cast<std::size_t>(got);
+    }
+    return true;
+#else
+    // getentropy gives 256 bytes a call at most.
+    while (length != 0) {
+        const std::size_t chunk = length < 256 ? length : 256;
+        if (getentropy(bytes, chunk) != 0) {
+            return false;
+        }
+        bytes += chunk;
+        length -= chunk;
+    }
+    return true;
+#endif
+}
+
+bool ChaChaEntropyV2::seed_from_host() {
+    std::uint32_t key[8];
+    std::uint64_t nonce = 0;
+    if (!host_random_bytes(key, sizeof(key)) || !host_random_bytes(&nonce, sizeof(nonce))) {
+        return false;
+    }
+    std::memcpy(key_, key, sizeof(key_));
+    nonce_ = nonce;
+    counter_ = 0;
+    blocks_since_key_ = 0;
+    seeded_ = true;
+    from_host_ = true;
+    return true;
+}
+
+void ChaChaEntropyV2::seed(std::uint64_t value) {
+    std::uint64_t state = value;
+    for (int i = 0; i < 8; i += 2) {
+        const std::uint64_t word = next_seed_word(state);
+        key_[i] = static_cast<std::uint32_t>(word);
+        key_[i + 1] = static_cast<std::uint32_t>(word >> 32);
+    }
+    nonce_ = 0;
+    counter_ = 0;
+    blocks_since_key_ = 0;
+    seeded_ = true;
+    from_host_ = false;
+}
+
+void ChaChaEntropyV2::fill(std::uint64_t* words, std::size_t count) {
+    std::uint32_t block[16];
+    std::size_t filled = 0;
+    while (filled < count) {
+        if (from_host_ && blocks_since_key_ == kReseedBlocks) {
+            rekey();
+        }
+        chacha20_block(key_, counter_++, nonce_, block);
+        ++blocks_since_key_;
+        for (std::size_t i = 0; i < 16 && filled < count; i += 2) {
+            words[filled++] = static_cast<std::uint64_t>(block[i]) |
+                              (static_cast<std::uint64_t>(block[i + 1]) << 32);
+        }
+    }
+}
+
+void ChaChaEntropyV2::rekey() {
+    // A host that had a key to give at the start and has none now is one whose generator broke
+    // underneath a running machine. The device has promised the guest its words regardless, so
+    // the next key comes from the keystream instead, and the key that made it is gone either
+    // way.
+    std::uint32_t block[16];
+    if (!host_random_bytes(key_, sizeof(key_))) {
+        chacha20_block(key_, counter_++, nonce_, block);
+        std::memcpy(key_, block, sizeof(key_));
+    }
+    counter_ = 0;
+    ++nonce_;
+    blocks_since_key_ = 0;
+}
+
+}  // namespace maize::v2
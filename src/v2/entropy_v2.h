@@ -0,0 +1,75 @@
+// entropy_v2.h (user-021): the generator mzvm attaches to a machine's entropy device.
+//
+// device_v2.h declares the device and the EntropySourceV2 it draws through; this is the source,
+// and entropy_v2.cpp holds it and the host call it seeds from.
+//
+// THE HOST IS ASKED FOR A KEY, NOT FOR EVERY WORD. A guest seeding its hash tables or running its
+// own cryptography reads entropy constantly, and one getrandom a word would make each read a
+// system call. So the host's generator supplies a 256-bit key and ChaCha20 expands it: one block
+// of the cipher is 64 bytes of output for twenty rounds of additions, rotations and exclusive
+// ors on sixteen words, with no table and no branch on the data, and a key is good for far more
+// output than any guest reads. The key is drawn from the host again every kReseedBlocks blocks,
+// so output the guest has not yet read cannot be worked out from a key that has leaked, or not
+// for long.
+//
+// SEEDED IS REPRODUCIBLE, AND SAYS SO. seed() keys the generator from a number instead, so two
+// runs given the same seed read the same words in the same order and a failure that depends on
+// them can be replayed. It keeps the contract's letter, since nothing else in the machine's state
+// predicts the words, and not its spirit, since the command line does; a seeded source is for
+// tests and investigations and is never suitable for cryptographic use.
+
+#ifndef MAIZE_V2_ENTROPY_V2_H
+#define MAIZE_V2_ENTROPY_V2_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "device_v2.h"
+
+namespace maize::v2 {
+
+// One ChaCha20 block: the sixteen words of keystream for `key` at block `counter` under `nonce`.
+// The counter takes state words 12 and 13 and the nonce words 14 and 15, which is Bernstein's
+// original layout rather than RFC 8439's, whose 32-bit counter a long-running generator would
+// outrun; a 64-bit counter given RFC 8439's nonce in its upper half reproduces its blocks.
+void chacha20_block(const std::uint32_t key[8], std::uint64_t counter, std::uint64_t nonce,
+                    std::uint32_t out[16]);
+
+// Fill `into` with `length` bytes from the host's own generator: getrandom on Linux, getentropy
+// on the other POSIX hosts, and BCryptGenRandom on Windows. False when the host cannot supply
+// them.
+bool host_random_bytes(void* into, std::size_t length);
+
+class ChaChaEntropyV2 final : public EntropySourceV2 {
+  public:
+    // Blocks of keystream between two keys drawn from the host: 4 MiB of output.
+    static constexpr std::uint64_t kReseedBlocks = std::uint64_t{1} << 16;
+
+    // Unkeyed until one of the two below is called, and attached only after one is.
+    ChaChaEntropyV2() = default;
+
+    // Key from the host. False, with the generator unkeyed, when the host has nothing to give.
+    bool seed_from_host();
+
+    // Key from `value`, reproducibly, and never again from the host.
+    void seed(std::uint64_t value);
+
+    bool seeded() const { return seeded_; }
+    bool from_host() const { return from_host_; }
+
+    void fill(std::uint64_t* words, std::size_t count) override;
+
+  private:
+    void rekey();
+
+    std::uint32_t key_[8] = {};
+    std::uint64_t counter_ = 0;
+    std::uint64_t nonce_ = 0;
+    std::uint64_t blocks_since_key_ = 0;
+    bool seeded_ = false;
+    bool from_host_ = false;
+};
+
+}  // namespace maize::v2
+
+#endif  // MAIZE_V2_ENTROPY_V2_H
@@ -0,0 +1,273 @@
+// framebuffer_v2.cpp (user-019): the framebuffer's claims and presents, and the shared-memory
+// display mzvm presents into.
+
+#include "framebuffer_v2.h"
+
+#include <cstring>
+#include <new>
+
+#include "memory_v2.h"
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace maize::v2 {
+
+void FramebufferDeviceV2::write_class_port(std::uint16_t offset, std::uint64_t value) {
+    switch (offset) {
+        case framebuffer_offset::kSurfaceSelect:
+            // A surface the device does not provide is a request it cannot honor, and the
+            // selection stays where it was rather than pointing offsets 8 and 9 at nothing.
+            if (value >= bases_.size()) {
+                refuse();
+                return;
+            }
+            selected_ = value;
+            return;
+        case framebuffer_offset::kSurfaceBase: {
+            // "A claim the machine cannot honor ... leaves the surface unclaimed", and a buffer
+            // that is not a whole frame of populated memory is one it cannot: a present would
+            // read past the end of memory. A refused claim releases whatever the surface held,
+            // since what the guest asked for was a different buffer.
+            std::uint64_t unused = 0;
+            if (value != 0 &&
+                (memory_ == nullptr || !memory_->check_range(value, frame_bytes(), unused))) {
+                bases_[selected_] = 0;
+                refuse();
+                return;
+            }
+            bases_[selected_] = value;
+            return;
+        }
+        case framebuffer_offset::kPresent:
+            present();
+            return;
+        case framebuffer_offset::kScanout:
+            if (value >= bases_.size()) {
+                refuse();
+                return;
+            }
+            scanout_ = value;
+            sink_->scan_out(static_cast<unsigned>(value));
+            return;
+        default:
+            return;  // the geometry is read only, and the rest is reserved
+    }
+}
+
+void FramebufferDeviceV2::present() {
+    // Memory can shrink under a claim (host_set_size), so the buffer is checked again here rather
+    // than trusted from the claim; a surface whose buffer is no longer all there presents nothing.
+    const std::uint64_t base = bases_[selected_];
+    const std::uint64_t bytes = frame_bytes();
+    std::uint64_t unused = 0;
+    if (base == 0 || !memory_->check_range(base, bytes, unused)) {
+        refuse();
+        return;
+    }
+    sink_->present(static_cast<unsigned>(selected_), memory_->host_range(base, bytes),
+                   static_cast<std::size_t>(bytes));
+    ++presents_;
+    if (selected_ == scanout_) {
+        acknowledgeable_status_ |= status_mask(framebuffer_status_bit::kFramePending);
+        publish_line();
+    }
+}
+
+void FramebufferDeviceV2::load_class_state(StateReaderV2& in) {
+    selected_ = in.get_u64();
+    scanout_ = in.get_u64();
+    const std::uint64_t count = in.get_u64();
+    // Restored onto the display the host attached this run, which may have fewer surfaces than
+    // the one the snapshot was taken with: the surfaces it does not have are dropped, and the
+    // selection and the scanout fall back to surface 0 when theirs went with them.
+    std::vector<std::uint64_t> bases(bases_.size(), 0);
+    for (std::uint64_t surface = 0; surface < count; ++surface) {
+        const std::uint64_t base = in.get_u64();
+        if (surface < bases.size()) {
+            bases[surface] = base;
+        }
+    }
+    bases_.swap(bases);
+    if (selected_ >= bases_.size()) {
+        selected_ = 0;
+    }
+    if (scanout_ >= bases_.size()) {
+        scanout_ = 0;
+    }
+}
+
+namespace {
+
+#ifndef _WIN32
+// POSIX shared-memory names are one path component with a leading slash.
+std::string host_name(const std::string& name) {
+    return !name.empty() && name.front() == '/' ? name : "/" + name;
+}
+#else
+// Local to the session, which needs no privilege to create and is where a presenter the same
+// user starts looks.
+std::string host_name(const std::string& name) { return "Local\\" + name; }
+#endif
+
+}  // namespace
+
+SharedFramebufferV2::~SharedFramebufferV2() { close(); }
+
+bool SharedFramebufferV2::create(const std::string& name, const FramebufferGeometryV2& geometry) {
+    close();
+    const std::size_t frame_bytes = static_cast<std::size_t>(geometry.width) * geometry.height *
+                                    FramebufferDeviceV2::kBytesPerPixel;
+    const unsigned surfaces = geometry.surfaces == 0 ? 1 : geometry.surfaces;
+    if (!map(name, shared_framebuffer::kFramesOffset + frame_bytes * surfaces, true)) {
+        return false;
+    }
+    // A fresh segment is zero-filled by the host, and a replaced one is truncated to nothing and
+    // regrown, so every frame starts black and the sequence starts at zero either way. The magic
+    // goes last, so a presenter that maps the segment early sees no segment until it is whole.
+    control_ = new (control_) shared_framebuffer::Control{};
+    control_->version = shared_framebuffer::kVersion;
+    control_->width = geometry.width;
+    control_->height = geometry.height;
+    control_->format = static_cast<std::uint32_t>(framebuffer_offset::kFormatXrgb8888);
+    control_->surfaces = surfaces;
+    std::atomic_thread_fence(std::memory_order_release);
+    control_->magic = shared_framebuffer::kMagic;
+    frame_bytes_ = frame_bytes;
+    return true;
+}
+
+bool SharedFramebufferV2::open(const std::string& name) {
+    close();
+    if (!map(name, 0, false)) {
+        return false;
+    }
+    const std::size_t frame_bytes = static_cast<std::size_t>(control_->width) * control_->height *
+                                    FramebufferDeviceV2::kBytesPerPixel;
+    if (control_->magic != shared_framebuffer::kMagic ||
+        control_->version != shared_framebuffer::kVersion ||
+        mapped_bytes_ < shared_framebuffer::kFramesOffset + frame_bytes * control_->surfaces) {
+        close();
+        return false;
+    }
+    frame_bytes_ = frame_bytes;
+    return true;
+}
+
+void SharedFramebufferV2::present(unsigned surface, const std::uint8_t* pixels, std::size_t bytes) {
+    // The single copy a present costs, straight from the guest's buffer into the slot the
+    // presenter reads, and then the doorbell.
+    std::memcpy(frames_ + static_cast<std::size_t>(surface) * frame_bytes_, pixels,
+                bytes < frame_bytes_ ? bytes : frame_bytes_);
+    control_->last_presented.store(surface, std::memory_order_relaxed);
+    control_->present_sequence.fetch_add(1, std::memory_order_release);
+}
+
+void SharedFramebufferV2::scan_out(unsigned surface) {
+    control_->scanout.store(surface, std::memory_order_release);
+}
+
+const std::uint8_t* SharedFramebufferV2::frame(unsigned surface) const {
+    if (control_ == nullptr || surface >= control_->surfaces) {
+        return nullptr;
+    }
+    return frames_ + static_cast<std::size_t>(surface) * frame_bytes_;
+}
+
+bool SharedFramebufferV2::map(const std::string& name, std::size_t bytes, bool creating) {
+    const std::string host = host_name(name);
+#ifdef _WIN32
+    HANDLE mapping = nullptr;
+    if (creating) {
+        const unsigned long long size = bytes;
+        mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+                                     static_cast<DWORD>(size >> 32), static_cast<DWORD>(size),
+                                     host.c_str());
+    } else {
+        mapping = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, host.c_str());
+    }
+    if (mapping == nullptr) {
+        return false;
+    }
+    void* view = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+    MEMORY_BASIC_INFORMATION info{};
+    if (view == nullptr || VirtualQuery(view, &info, sizeof(info)) == 0) {
+        if (view != nullptr) {
+            UnmapViewOfFile(view);
+        }
+        CloseHandle(mapping);
+        return false;
+    }
+    mapping_ = mapping;
+    mapped_bytes_ = creating ? bytes : info.RegionSize;
+#else
+    const int descriptor = creating ? shm_open(host.c_str(), O_CREAT | O_RDWR, 0600)
+                                    : shm_open(host.c_str(), O_RDWR, 0);
+    if (descriptor < 0) {
+        return false;
+    }
+    struct stat info;
+    bool sized = true;
+    if (creating) {
+        // Truncating to nothing first is what zeroes a segment a previous run left behind.
+        sized = ftruncate(descriptor, 0) == 0 &&
+                ftruncate(descriptor, static_cast<off_t>(bytes)) == 0;
+    } else {
+        sized = fstat(descriptor, &info) == 0 &&
+                static_cast<std::size_t>(info.st_size) >= shared_framebuffer::kFramesOffset;
+        bytes = sized ? static_cast<std::size_t>(info.st_size) : 0;
+    }
+    void* view = sized ? mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, descriptor, 0)
+                       : MAP_FAILED;
+    // The mapping holds the segment open; the descriptor is not needed past it.
+    ::close(descriptor);
+    if (view == MAP_FAILED) {
+        if (creating) {
+            shm_unlink(host.c_str());
+        }
+        return false;
+    }
+    mapped_bytes_ = bytes;
+#endif
+    control_ = static_cast<shared_framebuffer::Control*>(view);
+    frames_ = static_cast<std::uint8_t*>(view) + shared_framebuffer::kFramesOffset;
+    name_ = host;
+    owner_ = creating;
+    return true;
+}
+
+void SharedFramebufferV2::close() {
+    if (control_ == nullptr) {
+        return;
+    }
+#ifdef _WIN32
+    UnmapViewOfFile(control_);
+    CloseHandle(static_cast<HANDLE>(mapping_));
+    mapping_ = nullptr;
+#else
+    munmap(control_, mapped_bytes_);
+    if (owner_) {
+        shm_unlink(name_.c_str());
+    }
+#endif
+    control_ = nullptr;
+    frames_ = nullptr;
+    frame_bytes_ = 0;
+    mapped_bytes_ = 0;
+    name_.clear();
+    owner_ = false;
+}
+
+}  // namespace maize::v2
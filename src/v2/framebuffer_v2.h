@@ -0,0 +1,126 @@
+// framebuffer_v2.h (user-019): the displays a framebuffer device presents its frames to.
+//
+// device_v2.h declares the device and the FramebufferSinkV2 it presents through; these are the
+// two sinks mzvm attaches, and framebuffer_v2.cpp holds them and the parts of the device that
+// reach guest memory.
+//
+// HEADLESS COUNTS AND COPIES NOTHING. A guest that draws with nobody watching, a benchmark or a
+// fixture or a CI run of a game, still needs a framebuffer that accepts its claims and its
+// presents, and a frame nobody will look at is not worth a memcpy. HeadlessFramebufferV2 keeps a
+// count and nothing else.
+//
+// THE SHARED SEGMENT IS WHERE A PRESENTER PROCESS READS FRAMES. SharedFramebufferV2 creates one
+// named shared-memory segment: a control block in its first page, and one frame slot per surface
+// after it, each exactly a frame's bytes. A present is one memcpy from the guest's buffer into its
+// surface's slot followed by a release increment of the control block's present sequence, which is
+// the doorbell a presenter polls. A presenter that finds the sequence moved reads the scanned-out
+// slot and shows it; one that falls behind skips straight to the latest frame, since a frame it
+// never showed is one nobody needs any more. The layout follows the one v1's presenter transport
+// uses (a fixed page for the control block, slots after it), but it is v2's own segment with v2's
+// own magic, because the v1 transport belongs to the archived tree and its session, input ring and
+// ownership protocol have no v2 counterpart yet.
+//
+// The memcpy races a presenter reading the same slot, and a presenter may show a frame that is
+// part one present and part the next. That is tearing, the same thing a real scanout shows when
+// software draws into the buffer being scanned, and the guest's cure is the real one too: present
+// into a second surface and switch the scanout to it.
+
+#ifndef MAIZE_V2_FRAMEBUFFER_V2_H
+#define MAIZE_V2_FRAMEBUFFER_V2_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "device_v2.h"
+
+namespace maize::v2 {
+
+class HeadlessFramebufferV2 final : public FramebufferSinkV2 {
+  public:
+    void present(unsigned surface, const std::uint8_t*, std::size_t) override {
+        ++presents_;
+        last_presented_ = surface;
+    }
+    void scan_out(unsigned surface) override { scanned_out_ = surface; }
+
+    std::uint64_t presents() const { return presents_; }
+    unsigned last_presented() const { return last_presented_; }
+    unsigned scanned_out() const { return scanned_out_; }
+
+  private:
+    std::uint64_t presents_ = 0;
+    unsigned last_presented_ = 0;
+    unsigned scanned_out_ = 0;
+};
+
+namespace shared_framebuffer {
+
+inline constexpr std::uint32_t kMagic = 0x4d5a4642;  // 'MZFB'
+inline constexpr std::uint32_t kVersion = 1;
+// The first frame slot's offset from the segment's base: the control block's page.
+inline constexpr std::size_t kFramesOffset = 4096;
+
+// The first page of the segment. Both processes are built from the same tree by the same
+// compiler, so the atomics have the same layout on both sides.
+struct Control {
+    std::uint32_t magic;
+    std::uint32_t version;
+    std::uint32_t width;
+    std::uint32_t height;
+    std::uint32_t format;    // framebuffer_offset::kFormatXrgb8888
+    std::uint32_t surfaces;
+    std::atomic<std::uint32_t> scanout;          // the surface the guest scans out
+    std::atomic<std::uint32_t> last_presented;   // the surface of the latest present
+    std::atomic<std::uint64_t> present_sequence; // one per present, released after the copy
+};
+
+static_assert(sizeof(Control) <= kFramesOffset, "the control block must fit before the frames");
+
+}  // namespace shared_framebuffer
+
+class SharedFramebufferV2 final : public FramebufferSinkV2 {
+  public:
+    SharedFramebufferV2() = default;
+    ~SharedFramebufferV2() override;
+
+    SharedFramebufferV2(const SharedFramebufferV2&) = delete;
+    SharedFramebufferV2& operator=(const SharedFramebufferV2&) = delete;
+
+    // The machine's side. Create the segment `name` sized for `geometry`, replacing any segment a
+    // run that did not end cleanly left under that name, and own it: close() removes the name.
+    // False, with nothing mapped, when the host will not create or map it.
+    bool create(const std::string& name, const FramebufferGeometryV2& geometry);
+
+    // A presenter's side, and a fixture's. Map the existing segment `name` without owning it.
+    // False when there is no such segment or it is not a version this tree writes.
+    bool open(const std::string& name);
+
+    void close();
+    bool is_open() const { return control_ != nullptr; }
+
+    void present(unsigned surface, const std::uint8_t* pixels, std::size_t bytes) override;
+    void scan_out(unsigned surface) override;
+
+    const shared_framebuffer::Control* control() const { return control_; }
+    // The first byte of `surface`'s slot, or null for a surface the segment does not have.
+    const std::uint8_t* frame(unsigned surface) const;
+
+  private:
+    bool map(const std::string& name, std::size_t bytes, bool creating);
+
+    shared_framebuffer::Control* control_ = nullptr;
+    std::uint8_t* frames_ = nullptr;
+    std::size_t frame_bytes_ = 0;
+    std::size_t mapped_bytes_ = 0;
+    std::string name_;     // the host's name for the segment, kept to remove it
+    bool owner_ = false;
+#ifdef _WIN32
+    void* mapping_ = nullptr;
+#endif
+};
+
+}  // namespace maize::v2
+
+#endif  // MAIZE_V2_FRAMEBUFFER_V2_H
@@ -2,6 +2,12 @@
 
 #include "interpreter_v2.h"
 
+#include <chrono>
+#include <utility>
+
+#include "jit_v2.h"
+#include "profile_v2.h"
+
 namespace maize::v2 {
 namespace {
 
@@ -40,6 +46,28 @@ constexpr std::uint32_t reverse_bytes_half(std::uint32_t value) {
 
 }  // namespace
 
+InterpreterV2::InterpreterV2(MemoryV2& memory, std::uint64_t reset_pc)
+    : memory_(memory), pc_(reset_pc) {
+    devices_.attach_memory(&memory_);
+}
+
+InterpreterV2::InterpreterV2(std::unique_ptr<MemoryV2> owned, std::uint64_t reset_pc)
+    : owned_memory_(std::move(owned)), memory_(*owned_memory_), pc_(reset_pc) {
+    devices_.attach_memory(&memory_);
+}
+
+// Out of line because JitV2 is only declared in the header.
+InterpreterV2::~InterpreterV2() = default;
+
+bool InterpreterV2::enable_jit(const JitOptionsV2& options) {
+    auto jit = std::make_unique<JitV2>(*this, options);
+    if (!jit->active()) {
+        return false;
+    }
+    jit_ = std::move(jit);
+    return true;
+}
+
 bool evaluate_predicate(unsigned predicate, std::uint64_t left, std::uint64_t right) {
     const std::int64_t signed_left = static_cast<std::int64_t>(left);
     const std::int64_t signed_right = static_cast<std::int64_t>(right);
@@ -105,34 +133,47 @@ std::uint64_t multiply_high_signed_value(std::uint64_t a, std::uint64_t b) {
 // function of the access alone and not of the order in which an implementation touches bytes."
 // That chapter lists it as a directly testable conformance property at lines 907 through 909.
 //
-// This build complies. The loop below scans the access in ascending virtual order and returns
-// at the first byte whose translation failed, which is the lowest inaccessible address the
-// access covers. Do not change the scan order or report the instruction's base address here:
-// both would break a stated conformance property, and the fixture
+// This build complies. The loop below translates the access a page at a time in ascending
+// virtual order, at the first byte of each page, and returns at the first page whose translation
+// failed. Every byte of a page translates alike, so the first byte of that page is the lowest
+// inaccessible address the access covers, exactly as when maize-465 translated every byte. Do not
+// change the scan order or report the instruction's base address here: both would break a stated
+// conformance property, and the fixture
 // tests/v2/fixtures_paging.cpp:sv48_translation_carries_a_program_and_its_data pins the reported
 // address in plain digits so either change goes red.
 bool InterpreterV2::plan_access(std::uint64_t address, unsigned length, AccessKind kind,
                                 Privilege level, AccessPlanV2& plan, TrapV2& trap) {
     const std::uint64_t root = csr_.host_read(csr::kPagingRoot);
     plan.count = length;
-    for (unsigned i = 0; i < length; ++i) {
+    plan.run_count = 0;
+    for (unsigned offset = 0; offset < length;) {
+        const std::uint64_t virtual_address = address + offset;
         const TranslationResult translated =
-            translator_.translate(memory_, root, level, kind, address + i);
+            translator_.translate(memory_, root, level, kind, virtual_address);
         if (!translated.ok) {
             trap = translated.trap;
             return false;
         }
-        plan.physical[i] = translated.physical;
+        const std::uint64_t to_page_end =
+            MemoryV2::kPageBytes - (virtual_address & (MemoryV2::kPageBytes - 1));
+        AccessPlanV2::Run& run = plan.runs[plan.run_count++];
+        run.physical = translated.physical;
+        run.offset = offset;
+        run.length = static_cast<unsigned>(
+            to_page_end < length - offset ? to_page_end : std::uint64_t{length - offset});
+        offset += run.length;
     }
 
     // Physical reachability, judged over the whole access and reporting the LOWEST inaccessible
-    // physical address, which is the property MemoryV2::check_range already fixes for the
-    // untranslated case and which this keeps once the addresses are no longer contiguous.
+    // physical address, which is the property MemoryV2::check_range already fixes for one
+    // contiguous run and which this keeps across the runs once they are no longer contiguous.
     bool found = false;
     std::uint64_t lowest = 0;
-    for (unsigned i = 0; i < length; ++i) {
-        if (!memory_.accessible(plan.physical[i]) && (!found || plan.physical[i] < lowest)) {
-            lowest = plan.physical[i];
+    for (unsigned i = 0; i < plan.run_count; ++i) {
+        std::uint64_t inaccessible = 0;
+        if (!memory_.check_range(plan.runs[i].physical, plan.runs[i].length, inaccessible) &&
+            (!found || inaccessible < lowest)) {
+            lowest = inaccessible;
             found = true;
         }
     }
@@ -151,18 +192,23 @@ bool InterpreterV2::plan_byte(std::uint64_t address, AccessKind kind, std::uint6
     if (!plan_access(address, 1, kind, privilege(), plan, trap)) {
         return false;
     }
-    physical = plan.physical[0];
+    physical = plan.runs[0].physical;
     return true;
 }
 
 // Little-endian at every width, over a plan whose bytes may live in two different physical
 // pages, so the lowest VIRTUAL address of the access holds the least significant byte whatever
-// the translation did with it.
+// the translation did with it. The common case, a word that lies inside one run, is one
+// host-width access; only a word split across the page boundary is assembled a byte at a time.
 std::uint64_t InterpreterV2::read_planned(const AccessPlanV2& plan, unsigned offset,
                                           unsigned width) const {
+    const AccessPlanV2::Run& run = plan.run_at(offset);
+    if (offset + width <= run.offset + run.length) {
+        return memory_.read_within_page(run.physical + (offset - run.offset), width);
+    }
     std::uint64_t value = 0;
     for (unsigned i = 0; i < width; ++i) {
-        value |= static_cast<std::uint64_t>(memory_.read_byte(plan.physical[offset + i]))
+        value |= static_cast<std::uint64_t>(memory_.read_byte(plan.physical(offset + i)))
                  << (i * 8);
     }
     return value;
@@ -170,31 +216,35 @@ std::uint64_t InterpreterV2::read_planned(const AccessPlanV2& plan, unsigned off
 
 void InterpreterV2::write_planned(const AccessPlanV2& plan, unsigned offset, unsigned width,
                                   std::uint64_t value) {
+    if (store_journal_ != nullptr) {
+        for (unsigned i = 0; i < width; ++i) {
+            const std::uint64_t physical = plan.physical(offset + i);
+            store_journal_->push_back({physical, memory_.read_byte(physical)});
+        }
+    }
+    const AccessPlanV2::Run& run = plan.run_at(offset);
+    if (offset + width <= run.offset + run.length) {
+        memory_.write_within_page(run.physical + (offset - run.offset), width, value);
+        return;
+    }
     for (unsigned i = 0; i < width; ++i) {
-        memory_.write_byte(plan.physical[offset + i], static_cast<std::uint8_t>(value >> (i * 8)));
+        memory_.write_byte(plan.physical(offset + i), static_cast<std::uint8_t>(value >> (i * 8)));
     }
 }
 
-StepResult InterpreterV2::advance(const DecodedV2& decoded) {
+CycleV2 InterpreterV2::advance(const DecodedV2& decoded) {
     pc_ = decoded.next_pc;
-    StepResult result;
-    result.status = StepStatus::Advanced;
-    result.opcode = decoded.opcode;
-    result.pc = decoded.pc;
-    return result;
+    return CycleV2::Advanced;
 }
 
-StepResult InterpreterV2::branch_to(const DecodedV2& decoded, std::uint64_t target) {
+CycleV2 InterpreterV2::branch_to(const DecodedV2& decoded, std::uint64_t target) {
+    (void)decoded;
     pc_ = target;
-    StepResult result;
-    result.status = StepStatus::Advanced;
-    result.opcode = decoded.opcode;
-    result.pc = decoded.pc;
-    return result;
+    return CycleV2::Advanced;
 }
 
-StepResult InterpreterV2::raise(const DecodedV2& decoded, std::uint8_t cause_number,
-                                std::uint8_t subcode_number, std::uint64_t aux) {
+CycleV2 InterpreterV2::raise(const DecodedV2& decoded, std::uint8_t cause_number,
+                             std::uint8_t subcode_number, std::uint64_t aux) {
     // A FAULT captures the faulting instruction's own address, so a handler that fixes the
     // condition and returns gets a clean re-execution of the same bytes.
     TrapV2 trap;
@@ -205,8 +255,10 @@ StepResult InterpreterV2::raise(const DecodedV2& decoded, std::uint8_t cause_num
     return deliver(trap, decoded.opcode, decoded.pc);
 }
 
-StepResult InterpreterV2::raise_trap_class(const DecodedV2& decoded, std::uint8_t cause_number,
-                                           std::uint8_t subcode_number, std::uint64_t aux) {
+CycleV2 InterpreterV2::raise_trap_class(const DecodedV2& decoded,
+                                        std::uint8_t cause_number,
+                                        std::uint8_t subcode_number,
+                                        std::uint64_t aux) {
     // A TRAP in the narrow sense captures the address of the FOLLOWING instruction, because the
     // instruction asked for the entry and there is nothing to retry. next_pc was fixed at decode
     // time, before any operand was read, so it is the encoded length past the opcode byte
@@ -219,10 +271,11 @@ StepResult InterpreterV2::raise_trap_class(const DecodedV2& decoded, std::uint8_
     return deliver(trap, decoded.opcode, decoded.pc);
 }
 
-StepResult InterpreterV2::halt_without_delivering(const TrapV2& trap, std::uint8_t opcode,
-                                                  std::uint64_t instruction_pc,
-                                                  TrapDisposition disposition,
-                                                  unsigned halt_kind) {
+CycleV2 InterpreterV2::halt_without_delivering(const TrapV2& trap,
+                                               std::uint8_t opcode,
+                                               std::uint64_t instruction_pc,
+                                               TrapDisposition disposition,
+                                               unsigned halt_kind) {
     // Both halts record the ORIGINAL cause and subcode, which for a double fault means the cause
     // that was being delivered rather than the page or physical-memory fault the frame push then
     // met. A handler debugging a machine that stopped this way wants to know what it was trying
@@ -236,7 +289,7 @@ StepResult InterpreterV2::halt_without_delivering(const TrapV2& trap, std::uint8
     result.pc = instruction_pc;
     result.trap = trap;
     result.disposition = disposition;
-    return result;
+    return stop(result);
 }
 
 // trap-model.md, "Vectored dispatch". Delivery proceeds in a fixed order and every step is
@@ -254,8 +307,8 @@ StepResult InterpreterV2::halt_without_delivering(const TrapV2& trap, std::uint8
 // vector read and the four frame stores reach physical memory directly and only cause 11 can
 // fail them; maize-465 brings the translation that can also raise causes 8, 9 and 10 here, and
 // the double-fault rule below already covers both.
-StepResult InterpreterV2::deliver(const TrapV2& trap, std::uint8_t opcode,
-                                  std::uint64_t instruction_pc) {
+CycleV2 InterpreterV2::deliver(const TrapV2& trap, std::uint8_t opcode,
+                               std::uint64_t instruction_pc) {
     // Step 1, the cause number, the subcode and the auxiliary value, is the caller's: the trap
     // record arrives determined.
 
@@ -321,7 +374,7 @@ StepResult InterpreterV2::deliver(const TrapV2& trap, std::uint8_t opcode,
     result.trap = trap;
     result.disposition = TrapDisposition::Delivered;
     result.handler = handler;
-    return result;
+    return stop(result);
 }
 
 // trap_return, $BC (trap-model.md, "Returning from a trap"). The instruction reads the four
@@ -336,7 +389,7 @@ StepResult InterpreterV2::deliver(const TrapV2& trap, std::uint8_t opcode,
 // Neither of the two faults this instruction can raise is a double fault, because both occur at
 // trap_return rather than at trap entry. That distinction is why the frame read below does not
 // go anywhere near deliver()'s double-fault path.
-StepResult InterpreterV2::execute_trap_return(const DecodedV2& decoded) {
+CycleV2 InterpreterV2::execute_trap_return(const DecodedV2& decoded) {
     const std::uint64_t frame = csr_.host_read(csr::kTrapStack);
 
     // A fault while popping abandons the pop and leaves the trap-stack register unchanged, so
@@ -400,18 +453,20 @@ StepResult InterpreterV2::execute_trap_return(const DecodedV2& decoded) {
 // the delivered cause read zero at the handler's first instruction for any source that has
 // stopped asserting, and it is the only writer of the pending bits of causes no device in this
 // machine owns.
+//
+// The lines are the word the device classes publish as their levels move (user-010), and the
+// comparison is against the pending bits rather than against whether any line moved since the
+// last sample. That is the same thing on every boundary but the one after a delivery: delivery
+// clears a pending bit under a line that stays high, no line has moved, and this must still
+// raise the bit again. Comparing against what it writes makes that fall out with no bookkeeping.
 void InterpreterV2::sample_device_interrupts() {
     const std::uint64_t lines = devices_.asserted_interrupt_lines();
-    for (unsigned line = 0; line <= device_class::kHighestClassCode; ++line) {
-        // "The cause number of a device interrupt is 32 plus the device's interrupt line index."
-        // This is the only place in the machine that turns a line into a cause.
-        const unsigned cause_number = cause::kFirstExternalInterrupt + line;
-        if ((lines & (std::uint64_t{1} << line)) != 0u) {
-            csr_.machine_raise_pending(cause_number);
-        } else {
-            csr_.machine_clear_pending(cause_number);
-        }
+    if (lines == csr_.device_pending_lines()) {
+        return;
     }
+    // "The cause number of a device interrupt is 32 plus the device's interrupt line index."
+    // This is the only place in the machine that turns a line into a cause.
+    csr_.machine_set_device_pending_lines(lines);
 }
 
 unsigned InterpreterV2::deliverable_interrupt() const {
@@ -424,7 +479,8 @@ unsigned InterpreterV2::deliverable_interrupt() const {
     return csr_.lowest_pending_and_enabled();
 }
 
-StepResult InterpreterV2::deliver_interrupt(unsigned cause_number, std::uint64_t resume_pc) {
+CycleV2 InterpreterV2::deliver_interrupt(unsigned cause_number,
+                                         std::uint64_t resume_pc) {
     // "On delivery the machine clears that cause's pending bit FIRST, so the same interrupt is not
     // delivered twice for one assertion, then follows the ordinary delivery sequence." The order
     // is observable: a handler reading its own cause's pending bit at its first instruction reads
@@ -465,7 +521,8 @@ StepResult InterpreterV2::deliver_interrupt(unsigned cause_number, std::uint64_t
 // program counter is the address of the instruction after the wait and trap_return resumes there.
 // A machine that folded delivery into the wait would capture the wait's own address instead and
 // re-execute it on return, which is a different and observably wrong machine.
-StepResult InterpreterV2::execute_wait_for_interrupt(const DecodedV2& decoded) {
+CycleV2 InterpreterV2::execute_wait_for_interrupt(const DecodedV2& decoded) {
+    settle_time();
     for (;;) {
         sample_device_interrupts();
         if (csr_.lowest_pending_and_enabled() != CsrFileV2::kNoCause) {
@@ -481,23 +538,166 @@ StepResult InterpreterV2::execute_wait_for_interrupt(const DecodedV2& decoded) {
         // both deterministic and the reason a fixture can tell a machine that genuinely suspends
         // from one that spins: the spinning machine reaches the instructions after the wait first.
         std::uint64_t delay = 0;
-        if (!devices_.nanoseconds_until_next_device_event(delay)) {
+        const bool scheduled = devices_.nanoseconds_until_next_device_event(delay);
+        if (devices_.host_events_watched()) {
+            // Input from the host could end this wait too, and it arrives on the host's clock
+            // rather than the machine's (user-017), so the wait is a real one: the machine sleeps
+            // on the source until a byte comes, or until the device event the clock would have
+            // jumped to is that far away in real time, and the clock moves by what was slept.
+            // Only a guest waiting on a console line it enabled, with a stream still open, ever
+            // takes this road, as does one waiting on a block transfer the host is finishing
+            // asynchronously (user-018) or on a network line it enabled (user-020), so every
+            // other wait stays a function of the program alone.
+            const auto slept_from = std::chrono::steady_clock::now();
+            devices_.wait_for_host_events(scheduled ? delay : UINT64_MAX);
+            const std::uint64_t slept = static_cast<std::uint64_t>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - slept_from)
+                    .count());
+            devices_.advance_time(scheduled && slept > delay ? delay : slept);
+            devices_.poll_host_events();
+            schedule_settle();
+            continue;
+        }
+        if (!scheduled) {
             StepResult result;
             result.status = StepStatus::Suspended;
             result.opcode = decoded.opcode;
             result.pc = decoded.pc;
-            return result;
+            return stop(result);
         }
         devices_.advance_time(delay);
+        schedule_settle();
+    }
+}
+
+// user-001. The opcode byte's translation is done here, every time, whether or not the decode
+// is cached: it is what makes a fetch from a non-executable page fault, and the cache is keyed
+// by the physical address it yields. Only a fetch that translated and landed in populated memory
+// consults the cache at all, so every trapping fetch reaches decode_v2 and traps exactly as it
+// always did.
+//
+// A successful decode is cached when all of its bytes lie in the opcode byte's page. Contiguity
+// within one virtual page is contiguity within one physical page, so checking the virtual
+// offset is enough, and an instruction that straddles a page is simply decoded every time.
+//
+// A hit is handed back in place when the record was decoded at the program counter it is being
+// run at (user-013), so the common case copies nothing: the record already holds the right pc
+// and next_pc. Only a record reached through a second mapping of its page is copied out and
+// given the live ones.
+const PredecodedV2* InterpreterV2::fetch_and_decode() {
+    const std::uint64_t root = csr_.host_read(csr::kPagingRoot);
+    const Privilege level = privilege();
+    const TranslationResult fetch = translate_fetch(root, level, true);
+    // accessible() is asked again on a window hit, because a host resize can take the page out
+    // of populated memory without any translation changing.
+    const bool cacheable = fetch.ok && memory_.accessible(fetch.physical);
+    if (cacheable) {
+        if (const PredecodedV2* cached = predecode_.find(memory_, fetch.physical)) {
+            if (cached->instruction.pc == pc_) {
+                return cached;
+            }
+            fetched_ = *cached;
+            fetched_.instruction.pc = pc_;
+            fetched_.instruction.next_pc = pc_ + cached->instruction.length;
+            // The link is to a record on the page's own list, so the copy runs unpaired.
+            fetched_.handler = handler_for(cached->instruction.opcode);
+            fetched_.pair = 0;
+            return &fetched_;
+        }
+    }
+
+    // The fetch is translated under the current paging root at the current privilege level
+    // (maize-465), so an instruction on an unmapped or non-executable page raises cause 8 before
+    // the opcode byte means anything. In bare mode the source translates nothing and the decode
+    // sequence sees physical memory directly, exactly as it did before Sv48 existed.
+    const FetchSourceV2 source(memory_, translator_, root, level);
+    const DecodeResult decoded = decode_v2(source, pc_);
+    if (decoded.status == DecodeStatus::Trap) {
+        fetch_trap_ = decoded.trap;
+        return nullptr;
+    }
+    fetched_ = PredecodedV2{decoded.instruction, handler_for(decoded.instruction.opcode)};
+    if (cacheable &&
+        (pc_ & (MemoryV2::kPageBytes - 1)) + decoded.instruction.length <= MemoryV2::kPageBytes) {
+        predecode_.insert(memory_, fetch.physical, fetched_.instruction, fetched_.handler);
+        if (opens_pair(decoded.instruction.opcode)) {
+            predecode_pair(fetch.physical, decoded.instruction);
+        }
     }
+    return &fetched_;
+}
+
+TranslationResult InterpreterV2::translate_fetch(std::uint64_t root, Privilege level, bool walk) {
+    constexpr std::uint64_t kOffsetMask = MemoryV2::kPageBytes - 1;
+    FetchWindowV2& window = fetch_window_;
+    TranslationResult fetch;
+    if (window.valid && (pc_ & ~kOffsetMask) == window.virtual_page &&
+        window.paging_root == root && window.level == level &&
+        window.epoch == translator_.epoch()) {
+        fetch.ok = true;
+        fetch.physical = window.physical_page | (pc_ & kOffsetMask);
+        return fetch;
+    }
+    fetch = walk ? translator_.translate(memory_, root, level, AccessKind::Fetch, pc_)
+                 : translator_.translate_cached(root, level, AccessKind::Fetch, pc_);
+    window.valid = false;
+    if (fetch.ok && memory_.accessible(fetch.physical)) {
+        window.valid = true;
+        window.virtual_page = pc_ & ~kOffsetMask;
+        window.physical_page = fetch.physical & ~kOffsetMask;
+        window.paging_root = root;
+        window.epoch = translator_.epoch();
+        window.level = level;
+    }
+    return fetch;
+}
+
+// user-014. The instruction after one that can open a fused pair is decoded now rather than when
+// the machine reaches it, so the pair is linked from the first time the opening half is found
+// in the cache. Its bytes are on the opening half's page, which has just been translated for a
+// fetch, so reading them physically is reading them exactly as their own fetch would. A
+// following instruction that does not decode, does not fuse or runs off the page is left for
+// its own fetch to find, and traps there if it traps at all.
+void InterpreterV2::predecode_pair(std::uint64_t physical, const DecodedV2& first) {
+    constexpr std::uint64_t kOffsetMask = MemoryV2::kPageBytes - 1;
+    const std::uint64_t second = physical + first.length;
+    if ((second & ~kOffsetMask) != (physical & ~kOffsetMask)) {
+        return;
+    }
+    if (!predecode_.holds(memory_, second)) {
+        DecodeResult following = decode_v2(memory_, second);
+        if (following.status != DecodeStatus::Ok ||
+            !fuses(first.opcode, following.instruction.opcode) ||
+            (second & kOffsetMask) + following.instruction.length > MemoryV2::kPageBytes) {
+            return;
+        }
+        following.instruction.pc = first.next_pc;
+        following.instruction.next_pc = first.next_pc + following.instruction.length;
+        predecode_.insert(memory_, second, following.instruction,
+                          handler_for(following.instruction.opcode));
+    }
+    predecode_.fuse(physical, second, pair_handler_for(first.opcode));
 }
 
 StepResult InterpreterV2::step() {
+    if (profile_ != nullptr) {
+        return run(1);
+    }
+    schedule_settle();
+    const std::uint64_t pc = pc_;
+    std::uint8_t opcode = 0;
+    const CycleV2 ended = cycle(opcode);
+    settle_time();
+    return ended == CycleV2::Advanced ? advanced_result(opcode, pc) : stopped_;
+}
+
+CycleV2 InterpreterV2::cycle(std::uint8_t& opcode) {
     if (halted_) {
         StepResult result;
         result.status = StepStatus::Halted;
         result.pc = pc_;
-        return result;
+        return stop(result);
     }
 
     // THE BOUNDARY. "The machine completes the instruction it is executing, commits its effects,
@@ -507,14 +707,8 @@ StepResult InterpreterV2::step() {
     // through when it runs.
     sample_device_interrupts();
 
-    // The fetch is translated under the current paging root at the current privilege level
-    // (maize-465), so an instruction on an unmapped or non-executable page raises cause 8 before
-    // the opcode byte means anything. In bare mode the source translates nothing and the decode
-    // sequence sees physical memory directly, exactly as it did before Sv48 existed.
-    const FetchSourceV2 source(memory_, translator_, csr_.host_read(csr::kPagingRoot),
-                               privilege());
-    const DecodeResult decoded = decode_v2(source, pc_);
-    if (decoded.status == DecodeStatus::Trap) {
+    const PredecodedV2* const fetched = fetch_and_decode();
+    if (fetched == nullptr) {
         // An illegal instruction, an illegal operand, or a page fault on the fetch itself is a
         // fault like any other and is delivered through the same sequence. The decoder already
         // captured the instruction's own first byte as the faulting address, and no opcode is
@@ -530,7 +724,7 @@ StepResult InterpreterV2::step() {
         // decode itself commits nothing, so running it ahead of the interrupt test is free:
         // an interrupt taken below is taken at exactly the state a machine that had not yet
         // fetched would have.
-        return deliver(decoded.trap, 0, decoded.trap.pc);
+        return deliver(fetch_trap_, 0, fetch_trap_.pc);
     }
 
     const unsigned interrupt = deliverable_interrupt();
@@ -543,33 +737,312 @@ StepResult InterpreterV2::step() {
     }
 
     ++steps_taken_;
-    const StepResult result = execute(decoded.instruction);
+    opcode = fetched->instruction.opcode;
+    // Charged where it is counted (user-022), so a step and its cycles never disagree.
+    cycles_ += kCycleCosts[opcode];
+#if MAIZE_V2_THREADED_DISPATCH
+    const CycleV2 ended = fetched->handler(*this, *fetched);
+#else
+    const CycleV2 ended = execute(fetched->instruction);
+#endif
     // The machine's own sense of time moves with the instruction it just retired (maize-466), so
     // the timer's monotonic count is a function of architectural state rather than of the host's
     // clock. device_v2.h's kNanosecondsPerInstruction says why that is the conforming choice.
     // This runs after execute() and before the next boundary's sample, so an expiry that this
     // instruction's own time made due is delivered at the boundary after it and never inside it.
-    devices_.advance_time(kNanosecondsPerInstruction);
-    return result;
+    //
+    // The time is counted here and handed over at the deadline (user-011). Nothing between two
+    // settles can tell the difference: no line can move before the deadline, which is the first
+    // instruction after which the next device event is due, and everything that reads or
+    // changes a device's time settles first.
+    if (++unsettled_instructions_ >= settle_deadline_) {
+        settle_time();
+    }
+    return ended;
+}
+
+// Hand the devices the time of every instruction retired since the last settle, in one call.
+// That is the same as one call per instruction because an expiry disarms the timer, so a span
+// that passes an expiry expires it once however it is cut up; JitV2::settle relies on the same.
+//
+// A settle is also where host input is polled for (user-017), where a block transfer finished
+// on its worker is picked up (user-018), and where a frame from the network is (user-020), which
+// costs the run loop nothing it was not already paying: the deadline below is what brings the
+// loop here.
+void InterpreterV2::settle_time() {
+    if (unsettled_instructions_ != 0) {
+        devices_.advance_time(unsettled_instructions_ * kNanosecondsPerInstruction);
+        unsettled_instructions_ = 0;
+    }
+    devices_.poll_host_events();
+    schedule_settle();
+}
+
+// The next device event `delay` nanoseconds away is due after ceil(delay /
+// kNanosecondsPerInstruction) instructions, and after at least one, since an event due now is
+// the next instruction's to settle; with nothing scheduled, nothing ever needs the clock. A guest
+// waiting on a host event is settled at least every kHostPollInstructions, so a byte or a finished
+// transfer reaches it that long after arriving at the latest.
+void InterpreterV2::schedule_settle() {
+    std::uint64_t delay = 0;
+    settle_deadline_ = UINT64_MAX;
+    if (devices_.nanoseconds_until_next_device_event(delay)) {
+        const std::uint64_t span =
+            (delay + kNanosecondsPerInstruction - 1) / kNanosecondsPerInstruction;
+        settle_deadline_ = span == 0 ? 1 : span;
+    }
+    if (devices_.host_events_watched() &&
+        settle_deadline_ > DeviceSurfaceV2::kHostPollInstructions) {
+        settle_deadline_ = DeviceSurfaceV2::kHostPollInstructions;
+    }
 }
 
 StepResult InterpreterV2::run(std::uint64_t max_steps) {
-    StepResult result;
+    schedule_settle();
+    const StepResult result = run_deferred(max_steps);
+    fuse_limit_ = 0;
+    settle_time();
+    return result;
+}
+
+StepResult InterpreterV2::run_deferred(std::uint64_t max_steps) {
     std::uint64_t taken = 0;
+    std::uint64_t pc = pc_;
+    std::uint8_t opcode = 0;
+
+    // THE TIGHT LOOP (user-012). An instruction that advanced leaves nothing to report but
+    // pc_, so nothing is built for it; the only result this loop ever constructs is the one for
+    // the step that used up the budget, and a stop has already built its own in stopped_.
+    //
+    // A cycle retires two instructions when they are a fused pair (user-014), so the budget is
+    // counted off steps_taken_. A pair may not end on the budget's last step, which keeps the
+    // instruction that uses up the budget a cycle of its own and its result the one built here.
+    //
+    // A cycle limit (user-022) is one more test of a member against zero where no limit is set,
+    // and the sum cycles() works out only where one is. It leaves pairs fused: a pair is charged
+    // both halves' costs, and execute_pair() fuses only a pair whose sum cannot reach the limit,
+    // so the instruction that does reach it is a cycle of its own here too.
+    //
+    // A profile (user-023) is a test once a call rather than once an instruction, and takes the
+    // run to a loop of its own.
+    if (profile_ != nullptr) {
+        return run_profiled(max_steps);
+    }
+    if (jit_ == nullptr) {
+#if MAIZE_V2_COMPUTED_GOTO
+        return run_threaded(max_steps);
+#else
+        const std::uint64_t first_step = steps_taken_;
+        fuse_limit_ = max_steps == 0 ? UINT64_MAX : first_step + max_steps;
+        for (;;) {
+            pc = pc_;
+            if (cycle(opcode) != CycleV2::Advanced) {
+                return stopped_;
+            }
+            if (steps_taken_ - first_step == max_steps) {  // never, for a budget of zero
+                return advanced_result(opcode, pc);
+            }
+            if (cycle_limit_reached()) {
+                return advanced_result(opcode, pc);
+            }
+        }
+#endif
+    }
+
+    // The compiled road (user-002). It counts its own Advanced instructions and hands back the
+    // last result, so the budget and the stopping rule below are the same for both. It keeps its
+    // own clock from a settled one and settles it itself, so the deadline is worked out again
+    // after it ran.
+    //
+    // It is asked only where a block can start: where the run starts, where a block it ran left
+    // off, and after an instruction that ended a block, by its kind or by landing somewhere other
+    // than after itself. Anywhere else the next instruction is inside a block the JIT was asked
+    // about at its entry, so interpreted code pays one comparison an instruction for the JIT,
+    // runs its pairs fused and settles its clock at the deadline as it does without one, and the
+    // tier-up counters count block entries and nothing else. A pair counts as the end of a block,
+    // since its second half is not after its first, which at worst asks once too often.
+    StepResult result;
+    bool entry = true;
+    fuse_limit_ = max_steps == 0 ? UINT64_MAX : steps_taken_ + max_steps;
+    for (;;) {
+        if (entry && !halted_) {
+            std::uint64_t advanced = 0;
+            if (jit_->dispatch(max_steps == 0 ? 0 : max_steps - taken, advanced, result)) {
+                schedule_settle();
+                taken += advanced;
+                if (result.status != StepStatus::Advanced) {
+                    return result;
+                }
+                if ((max_steps != 0 && taken >= max_steps) || cycle_limit_reached()) {
+                    return result;
+                }
+                continue;
+            }
+        }
+        pc = pc_;
+        const std::uint64_t steps = steps_taken_;
+        if (cycle(opcode) != CycleV2::Advanced) {
+            return stopped_;
+        }
+        taken += steps_taken_ - steps;
+        if ((max_steps != 0 && taken >= max_steps) || cycle_limit_reached()) {
+            return advanced_result(opcode, pc);
+        }
+        entry = ends_basic_block(opcode) || pc_ != pc + instruction_length(opcode);
+    }
+}
+
+#if MAIZE_V2_COMPUTED_GOTO
+// THREADED DISPATCH (user-013). The tight loop above, with cycle() taken apart and its tail
+// copied into every opcode's label, so each instruction ends in a jump to the next one's label
+// rather than in a return to one shared loop. The jump at the end of each label is an indirect
+// branch of its own, which is what threading buys: the predictor learns which opcode tends to
+// follow which, where one shared dispatch branch sees the whole program's mix. The label is the
+// one the record names, by its opcode byte and by whether it opens a fused pair, so choosing it
+// is one load from a table; the record's handler pointer still serves step() and the other loops.
+//
+// Only the common road is copied. A halted machine, a fetch that faulted and a deliverable
+// interrupt leave the threaded code for the shared tail below, which does what cycle() does for
+// them and checks the budget as the loop above does, so every way a cycle can go is the same
+// here as there. The order within a label is cycle()'s: the clock's count, then the stop and
+// budget checks, then the next boundary's sample, fetch and interrupt test.
+StepResult InterpreterV2::run_threaded(std::uint64_t max_steps) {
+    const std::uint64_t first_step = steps_taken_;
+    fuse_limit_ = max_steps == 0 ? UINT64_MAX : first_step + max_steps;
+    std::uint64_t pc = pc_;
+    std::uint8_t opcode = 0;
+    const PredecodedV2* fetched = nullptr;
+    unsigned interrupt = CsrFileV2::kNoCause;
+    CycleV2 ended = CycleV2::Advanced;
+
+#define MAIZE_V2_THREAD_ROW(X, h)                                                               \
+    X(0x##h##0) X(0x##h##1) X(0x##h##2) X(0x##h##3) X(0x##h##4) X(0x##h##5) X(0x##h##6)        \
+    X(0x##h##7) X(0x##h##8) X(0x##h##9) X(0x##h##A) X(0x##h##B) X(0x##h##C) X(0x##h##D)        \
+    X(0x##h##E) X(0x##h##F)
+#define MAIZE_V2_THREAD_OPCODES(X)                                                              \
+    MAIZE_V2_THREAD_ROW(X, 0) MAIZE_V2_THREAD_ROW(X, 1) MAIZE_V2_THREAD_ROW(X, 2)               \
+    MAIZE_V2_THREAD_ROW(X, 3) MAIZE_V2_THREAD_ROW(X, 4) MAIZE_V2_THREAD_ROW(X, 5)               \
+    MAIZE_V2_THREAD_ROW(X, 6) MAIZE_V2_THREAD_ROW(X, 7) MAIZE_V2_THREAD_ROW(X, 8)               \
+    MAIZE_V2_THREAD_ROW(X, 9) MAIZE_V2_THREAD_ROW(X, A) MAIZE_V2_THREAD_ROW(X, B)               \
+    MAIZE_V2_THREAD_ROW(X, C) MAIZE_V2_THREAD_ROW(X, D) MAIZE_V2_THREAD_ROW(X, E)               \
+    MAIZE_V2_THREAD_ROW(X, F)
+#define MAIZE_V2_THREAD_LABEL(n) &&opcode_##n,
+#define MAIZE_V2_THREAD_FUSED(n) &&fused,
+
+    // A label per opcode byte, then, for a record that opens a fused pair (user-014), the one
+    // label that runs the pair through the record's handler.
+    static const void* const kLabels[512] = {MAIZE_V2_THREAD_OPCODES(MAIZE_V2_THREAD_LABEL)
+                                                 MAIZE_V2_THREAD_OPCODES(MAIZE_V2_THREAD_FUSED)};
+
+#define MAIZE_V2_THREAD_BOUNDARY()                                                              \
+    pc = pc_;                                                                                   \
+    if (halted_) {                                                                              \
+        goto halted;                                                                            \
+    }                                                                                           \
+    sample_device_interrupts();                                                                 \
+    fetched = fetch_and_decode();                                                               \
+    if (fetched == nullptr) {                                                                   \
+        goto fetch_fault;                                                                       \
+    }                                                                                           \
+    interrupt = deliverable_interrupt();                                                        \
+    if (interrupt != CsrFileV2::kNoCause) {                                                     \
+        goto interrupted;                                                                       \
+    }                                                                                           \
+    ++steps_taken_;                                                                             \
+    opcode = fetched->instruction.opcode;                                                       \
+    cycles_ += kCycleCosts[opcode];                                                             \
+    goto* kLabels[opcode | (fetched->pair != 0 ? 0x100u : 0u)]
+#define MAIZE_V2_THREAD_RETIRE()                                                                \
+    if (++unsettled_instructions_ >= settle_deadline_) {                                        \
+        settle_time();                                                                          \
+    }                                                                                           \
+    if (ended != CycleV2::Advanced) {                                                           \
+        return stopped_;                                                                        \
+    }                                                                                           \
+    if (steps_taken_ - first_step == max_steps || cycle_limit_reached()) {                      \
+        return advanced_result(opcode, pc);                                                     \
+    }                                                                                           \
+    MAIZE_V2_THREAD_BOUNDARY()
+#define MAIZE_V2_THREAD_HANDLER(n)                                                              \
+    opcode_##n : ended = execute_fixed<n>(*this, *fetched);                                     \
+    MAIZE_V2_THREAD_RETIRE();
+
+    MAIZE_V2_THREAD_BOUNDARY();
+    MAIZE_V2_THREAD_OPCODES(MAIZE_V2_THREAD_HANDLER)
+fused:
+    ended = fetched->handler(*this, *fetched);
+    MAIZE_V2_THREAD_RETIRE();
+
+halted:
+    ended = cycle(opcode);  // which builds the halted machine's stop
+    goto checked;
+fetch_fault:
+    ended = deliver(fetch_trap_, 0, fetch_trap_.pc);
+    goto checked;
+interrupted:
+    ended = deliver_interrupt(interrupt, pc_);
+checked:
+    if (ended != CycleV2::Advanced) {
+        return stopped_;
+    }
+    if (steps_taken_ - first_step == max_steps || cycle_limit_reached()) {
+        return advanced_result(opcode, pc);
+    }
+    MAIZE_V2_THREAD_BOUNDARY();
+
+#undef MAIZE_V2_THREAD_HANDLER
+#undef MAIZE_V2_THREAD_RETIRE
+#undef MAIZE_V2_THREAD_BOUNDARY
+#undef MAIZE_V2_THREAD_FUSED
+#undef MAIZE_V2_THREAD_LABEL
+#undef MAIZE_V2_THREAD_OPCODES
+#undef MAIZE_V2_THREAD_ROW
+}
+#endif
+
+void InterpreterV2::host_attach_profile(ProfileV2* profile) {
+    profile_ = profile;
+    if (profile != nullptr) {
+        profile->begin(*this);
+    }
+}
+
+// The interpreted loop, one instruction a cycle since fuse_limit_ is left at zero, with what
+// each cycle left behind counted after it. An instruction was retired when the step count moved,
+// which it does for one that then trapped as well, and anything it cost beyond its opcode's
+// entry in kCycleCosts is the block bytes execute_block charged, since walks are not in cycles_.
+StepResult InterpreterV2::run_profiled(std::uint64_t max_steps) {
+    const std::uint64_t first_step = steps_taken_;
+    std::uint8_t opcode = 0;
     for (;;) {
-        result = step();
-        if (result.status != StepStatus::Advanced) {
-            return result;
+        const std::uint64_t pc = pc_;
+        const std::uint64_t steps = steps_taken_;
+        const std::uint64_t cycles = cycles_;
+        const CycleV2 ended = cycle(opcode);
+        if (steps_taken_ != steps) {
+            profile_->count_instruction(pc, opcode, pc_, cycles_ - cycles - kCycleCosts[opcode]);
+            if (ended == CycleV2::Advanced && profile_->sampling()) {
+                profile_->follow_transfer(pc, opcode, pc_);
+            }
         }
-        ++taken;
-        if (max_steps != 0 && taken >= max_steps) {
-            return result;
+        if (ended != CycleV2::Advanced) {
+            if (stopped_.status == StepStatus::Trapped) {
+                profile_->count_trap(stopped_.trap.cause);
+                if (stopped_.disposition == TrapDisposition::Delivered) {
+                    profile_->enter_handler(stopped_.handler);
+                }
+            }
+            profile_->end_block();
+            return stopped_;
+        }
+        if (steps_taken_ - first_step == max_steps || cycle_limit_reached()) {
+            return advanced_result(opcode, pc);
         }
     }
 }
 
-StepResult InterpreterV2::execute_load(const DecodedV2& decoded, unsigned width_bytes,
-                                       bool sign_extended, bool displaced) {
+CycleV2 InterpreterV2::execute_load(const DecodedV2& decoded, unsigned width_bytes,
+                                    bool sign_extended, bool displaced) {
     const unsigned base_register = decoded.reg[0];
     const unsigned destination = decoded.reg[1];
     const std::uint64_t displacement =
@@ -593,8 +1066,8 @@ StepResult InterpreterV2::execute_load(const DecodedV2& decoded, unsigned width_
     return advance(decoded);
 }
 
-StepResult InterpreterV2::execute_store(const DecodedV2& decoded, unsigned width_bytes,
-                                        bool displaced) {
+CycleV2 InterpreterV2::execute_store(const DecodedV2& decoded, unsigned width_bytes,
+                                     bool displaced) {
     const unsigned source = decoded.reg[0];
     const unsigned base_register = decoded.reg[1];
     const std::uint64_t displacement =
@@ -617,29 +1090,101 @@ StepResult InterpreterV2::execute_store(const DecodedV2& decoded, unsigned width
 // The granularity at which a block-memory instruction can be interrupted (maize-466).
 // instruction-reference-memory.md, "The restartability contract": "The machine may be interrupted
 // between byte transfers, and it CHOOSES THE GRANULARITY at which that is possible." This machine
-// transfers one byte at a time and checks every 64 of them, which is a choice about when it
-// looks rather than about how it copies, so it is safe for all three instructions including
-// block_copy_forward over overlapping regions, whose ascending byte-by-byte result is
-// architectural and which a chunked TRANSFER would break.
+// checks every 64 bytes, which is a choice about when it looks rather than about how it copies,
+// so it is safe for all three instructions including block_copy_forward over overlapping
+// regions, whose ascending byte-by-byte result is architectural and which a careless chunked
+// TRANSFER would break. The runs execute_block moves between two checks (user-015) give the
+// byte-by-byte result by construction; copy_block_run says how.
 //
 // The clock advances at the same boundaries and for the same reason it advances per instruction:
 // a copy of a megabyte takes longer than a copy of a byte, and it is exactly that fact which
 // makes the family interruptible at all. "That is what keeps a long copy from delaying an
 // interrupt for an unbounded time" (execution-model.md).
 namespace {
+
 inline constexpr std::uint64_t kBlockInterruptCheckBytes = 64;
+
+// The bounds on one run of a block-memory transfer (user-015). The first keeps a run short of
+// the next mid-operation boundary, `transferred` bytes in; the second keeps an ascending run
+// inside the page `address` is on and inside populated memory from `physical` up; the third
+// keeps a descending run inside the page `address` is on, from the bottom of that page up to
+// and including `address`.
+std::uint64_t block_run_limit(std::uint64_t run, std::uint64_t transferred) {
+    const std::uint64_t to_boundary =
+        kBlockInterruptCheckBytes - transferred % kBlockInterruptCheckBytes;
+    return run < to_boundary ? run : to_boundary;
+}
+
+std::uint64_t block_run_limit(std::uint64_t run, std::uint64_t address, std::uint64_t physical,
+                              std::uint64_t populated) {
+    const std::uint64_t to_page_end =
+        MemoryV2::kPageBytes - (address & (MemoryV2::kPageBytes - 1));
+    const std::uint64_t reachable = populated - physical;
+    const std::uint64_t limit = to_page_end < reachable ? to_page_end : reachable;
+    return run < limit ? run : limit;
+}
+
+std::uint64_t block_run_limit_down(std::uint64_t run, std::uint64_t address) {
+    const std::uint64_t to_page_start = (address & (MemoryV2::kPageBytes - 1)) + 1;
+    return run < to_page_start ? run : to_page_start;
+}
+
 }  // namespace
 
 unsigned InterpreterV2::block_mid_operation_interrupt(std::uint64_t transferred) {
     if (transferred == 0 || transferred % kBlockInterruptCheckBytes != 0) {
         return CsrFileV2::kNoCause;
     }
-    devices_.advance_time(kNanosecondsPerInstruction);
+    // This boundary's instruction-time joins whatever is still unsettled, and all of it is
+    // settled here because the sample below must see every expiry it makes due.
+    ++unsettled_instructions_;
+    settle_time();
     sample_device_interrupts();
     return deliverable_interrupt();
 }
 
-StepResult InterpreterV2::execute_block(const DecodedV2& decoded) {
+// Move one run whose bytes are all proved accessible, giving the result the byte-by-byte
+// transfer in the given direction gives. `to` and `from` are the run's lowest physical
+// addresses. That result is memmove's unless the destination starts inside the source on the
+// side the transfer travels towards: then each byte reads one the same transfer already wrote
+// `distance` bytes back, which is the repeating pattern block_copy_forward is specified to
+// produce, and the run goes in pieces of `distance` bytes, none of which overlaps itself and
+// each of which reads only bytes the pieces before it finished.
+void InterpreterV2::copy_block_run(std::uint64_t to, std::uint64_t from, std::uint64_t length,
+                                   bool descending) {
+    journal_block_run(to, length);
+    if (!descending && to > from && to - from < length) {
+        const std::uint64_t distance = to - from;
+        for (std::uint64_t done = 0; done < length; done += distance) {
+            const std::uint64_t piece = length - done < distance ? length - done : distance;
+            memory_.move_within_pages(to + done, from + done, static_cast<std::size_t>(piece));
+        }
+        return;
+    }
+    if (descending && from > to && from - to < length) {
+        const std::uint64_t distance = from - to;
+        for (std::uint64_t left = length; left > 0;) {
+            const std::uint64_t piece = left < distance ? left : distance;
+            left -= piece;
+            memory_.move_within_pages(to + left, from + left, static_cast<std::size_t>(piece));
+        }
+        return;
+    }
+    memory_.move_within_pages(to, from, static_cast<std::size_t>(length));
+}
+
+// The whole destination is kept before any of it moves, so an overlapping copy that reads back
+// bytes it wrote still journals each byte's value from before the instruction touched it.
+void InterpreterV2::journal_block_run(std::uint64_t physical, std::uint64_t length) {
+    if (store_journal_ == nullptr) {
+        return;
+    }
+    for (std::uint64_t i = 0; i < length; ++i) {
+        store_journal_->push_back({physical + i, memory_.read_byte(physical + i)});
+    }
+}
+
+CycleV2 InterpreterV2::execute_block(const DecodedV2& decoded) {
     const bool is_set = decoded.opcode == op::kBlockSet;
     const unsigned slot0 = decoded.reg[0];  // source pointer, or the fill value for block_set
     const unsigned slot1 = decoded.reg[1];  // destination pointer
@@ -676,10 +1221,21 @@ StepResult InterpreterV2::execute_block(const DecodedV2& decoded) {
         return advance(decoded);
     }
 
+    // THE TRANSFER GOES A RUN AT A TIME (user-015). The loops below are still the byte-by-byte
+    // transfer the contract describes, and every byte is still judged, transferred and counted
+    // exactly where it was; what changed is how many bytes one trip round the loop covers. A
+    // trip translates the byte the transfer is on, source first, and then takes as many bytes
+    // as are certain to behave as that one does: the rest of its page on each side, no further
+    // than populated memory goes, and no further than the next mid-operation boundary. Every
+    // byte of that run would pass both of its plan_byte calls, so the run is moved with one
+    // host call and the next trip's first byte is the one that would have faulted, if any
+    // does. The restart state, the reported fault and the boundaries are therefore the ones
+    // the byte loop produced, for all three instructions.
+    const std::uint64_t populated = static_cast<std::uint64_t>(memory_.size());
     if (is_set) {
         const std::uint8_t fill = static_cast<std::uint8_t>(registers_.read(slot0));
         const std::uint64_t destination = registers_.read(slot1);
-        for (std::uint64_t i = 0; i < count; ++i) {
+        for (std::uint64_t i = 0; i < count;) {
             const std::uint64_t address = destination + i;
             std::uint64_t physical = 0;
             TrapV2 access_trap;
@@ -689,7 +1245,12 @@ StepResult InterpreterV2::execute_block(const DecodedV2& decoded) {
                 registers_.write(slot2, count - i);
                 return raise(decoded, access_trap.cause, access_trap.subcode, access_trap.aux);
             }
-            memory_.write_byte(physical, fill);
+            std::uint64_t run = block_run_limit(count - i, i);
+            run = block_run_limit(run, address, physical, populated);
+            journal_block_run(physical, run);
+            memory_.fill_within_page(physical, fill, static_cast<std::size_t>(run));
+            cycles_ += run * cycle_cost::kBlockByte;
+            i += run;
             // Translation is planned before this point and the interrupt is tested after it, and
             // that order is the chapter's rather than a convenience. "A fault or a trap raised by
             // an instruction belongs to that instruction and is delivered when the instruction
@@ -698,14 +1259,14 @@ StepResult InterpreterV2::execute_block(const DecodedV2& decoded) {
             // is deliverable." So a byte that cannot be translated reports its page fault through
             // the plan_byte arm above and the interrupt waits, rather than the interrupt
             // pre-empting a fault the machine has already decided to raise.
-            const unsigned interrupt = block_mid_operation_interrupt(i + 1);
+            const unsigned interrupt = block_mid_operation_interrupt(i);
             if (interrupt != CsrFileV2::kNoCause) {
                 // The same remaining-work description the fault path above writes, because an
                 // interrupt taken here and a fault taken here leave the machine in the same
                 // restartable state. The captured program counter is the block instruction's OWN
                 // address, so trap_return re-executes it and finishes the transfer.
-                registers_.write(slot1, address + 1);
-                registers_.write(slot2, count - (i + 1));
+                registers_.write(slot1, destination + i);
+                registers_.write(slot2, count - i);
                 return deliver_interrupt(interrupt, decoded.pc);
             }
         }
@@ -728,7 +1289,7 @@ StepResult InterpreterV2::execute_block(const DecodedV2& decoded) {
         decoded.opcode == op::kBlockCopy && offset != 0 && offset < count;
 
     if (!descending) {
-        for (std::uint64_t i = 0; i < count; ++i) {
+        for (std::uint64_t i = 0; i < count;) {
             const std::uint64_t from = source + i;
             const std::uint64_t to = destination + i;
             // The read is judged before the write, so a byte that cannot be read reports the
@@ -745,23 +1306,30 @@ StepResult InterpreterV2::execute_block(const DecodedV2& decoded) {
                 registers_.write(slot2, count - i);
                 return raise(decoded, access_trap.cause, access_trap.subcode, access_trap.aux);
             }
-            memory_.write_byte(to_physical, memory_.read_byte(from_physical));
+            std::uint64_t run = block_run_limit(count - i, i);
+            run = block_run_limit(run, from, from_physical, populated);
+            run = block_run_limit(run, to, to_physical, populated);
+            copy_block_run(to_physical, from_physical, run, false);
+            cycles_ += run * cycle_cost::kBlockByte;
+            i += run;
             // Both plan_byte calls run before this test, for the precedence reason block_set's
             // loop states at length: a fault belongs to the byte the instruction is on and is
             // raised there, and a pending interrupt waits for the next boundary at which it is
             // deliverable.
-            const unsigned interrupt = block_mid_operation_interrupt(i + 1);
+            const unsigned interrupt = block_mid_operation_interrupt(i);
             if (interrupt != CsrFileV2::kNoCause) {
-                registers_.write(slot0, from + 1);
-                registers_.write(slot1, to + 1);
-                registers_.write(slot2, count - (i + 1));
+                registers_.write(slot0, source + i);
+                registers_.write(slot1, destination + i);
+                registers_.write(slot2, count - i);
                 return deliver_interrupt(interrupt, decoded.pc);
             }
         }
     } else {
-        for (std::uint64_t i = count; i-- > 0;) {
-            const std::uint64_t from = source + i;
-            const std::uint64_t to = destination + i;
+        // `left` is the count of bytes not yet transferred, which are the low ones, so the byte
+        // this trip is on is the highest of them and a run reaches down from it.
+        for (std::uint64_t left = count; left > 0;) {
+            const std::uint64_t from = source + (left - 1);
+            const std::uint64_t to = destination + (left - 1);
             std::uint64_t from_physical = 0;
             std::uint64_t to_physical = 0;
             TrapV2 access_trap;
@@ -770,16 +1338,23 @@ StepResult InterpreterV2::execute_block(const DecodedV2& decoded) {
                 // High to low shows its progress by decrementing the count alone: the bytes not
                 // yet transferred are still the LOW ones, so both pointers already name them
                 // and neither moves.
-                registers_.write(slot2, i + 1);
+                registers_.write(slot2, left);
                 return raise(decoded, access_trap.cause, access_trap.subcode, access_trap.aux);
             }
-            memory_.write_byte(to_physical, memory_.read_byte(from_physical));
-            const unsigned interrupt = block_mid_operation_interrupt(count - i);
+            // Downward, populated memory is no limit: it is [0, size), so every byte below one
+            // that is populated is populated too.
+            std::uint64_t run = block_run_limit(left, count - left);
+            run = block_run_limit_down(run, from);
+            run = block_run_limit_down(run, to);
+            copy_block_run(to_physical - (run - 1), from_physical - (run - 1), run, true);
+            cycles_ += run * cycle_cost::kBlockByte;
+            left -= run;
+            const unsigned interrupt = block_mid_operation_interrupt(count - left);
             if (interrupt != CsrFileV2::kNoCause) {
                 // High to low shows its progress by decrementing the count alone, for the reason
                 // the fault path just above states: the bytes not yet transferred are still the
                 // LOW ones, so both pointers already name them and neither moves.
-                registers_.write(slot2, i);
+                registers_.write(slot2, left);
                 return deliver_interrupt(interrupt, decoded.pc);
             }
         }
@@ -809,7 +1384,7 @@ StepResult InterpreterV2::execute_block(const DecodedV2& decoded) {
 // rules and the target register's value validation both run before any state moves, so on a
 // trap no control and status register changed, no destination register changed, and no side
 // effect fired.
-StepResult InterpreterV2::execute_csr(const DecodedV2& decoded) {
+CycleV2 InterpreterV2::execute_csr(const DecodedV2& decoded) {
     const std::uint8_t opcode = decoded.opcode;
     const bool is_write = opcode != op::kCsrRead;
     const std::uint16_t number = static_cast<std::uint16_t>(decoded.immediate[0]);
@@ -843,8 +1418,117 @@ StepResult InterpreterV2::execute_csr(const DecodedV2& decoded) {
     return advance(decoded);
 }
 
-StepResult InterpreterV2::execute(const DecodedV2& decoded) {
-    const std::uint8_t opcode = decoded.opcode;
+StepResult InterpreterV2::execute_to_result(const DecodedV2& decoded) {
+    return execute(decoded) == CycleV2::Advanced ? advanced_result(decoded.opcode, decoded.pc)
+                                               : stopped_;
+}
+
+// The two opcode sources execute_as() is instantiated with. The cascade below is written once,
+// against whatever `source` returns; given the decoded byte it is the switch every instruction
+// used to go through, and given a constant it is one opcode's handler.
+namespace {
+
+struct DecodedOpcode {
+    std::uint8_t operator()(const DecodedV2& decoded) const { return decoded.opcode; }
+};
+
+template <std::uint8_t Opcode>
+struct FixedOpcode {
+    constexpr std::uint8_t operator()(const DecodedV2&) const { return Opcode; }
+};
+
+}  // namespace
+
+CycleV2 InterpreterV2::execute(const DecodedV2& decoded) {
+    return execute_as(decoded, DecodedOpcode{});
+}
+
+template <std::uint8_t Opcode>
+CycleV2 InterpreterV2::execute_fixed(InterpreterV2& machine, const PredecodedV2& record) {
+    return machine.execute_as(record.instruction, FixedOpcode<Opcode>{});
+}
+
+// A FUSED PAIR (user-014). The opening half runs as its own handler would, and the second half
+// follows it at once, without a fetch and without the boundary between the two, whenever that
+// boundary could have done nothing. An opener changes no control register and touches no
+// device, so the lines cycle() sampled and the deliverability it answered still stand after it;
+// if its retirement does not reach the clock's deadline, no device has an event due at the
+// boundary either. What is left of the boundary is the bookkeeping, done here for the opener as
+// the bottom of cycle() does it for the second half, so a fault in the second half is raised at
+// its own address with both halves counted, exactly as if the machine had stopped between them.
+//
+// fuse_limit_ is the step count a pair's second half has to stay below: zero outside run(), so
+// step() always runs one instruction, and the budget's last step within it. A cycle limit
+// (user-022) is kept the same way: the pair is charged the sum of its two costs, and the second
+// half runs fused only when that sum, with the two walks an access of its can add, stays below
+// the limit. Within a few cycles of the limit, pairs run a half a cycle.
+template <std::uint8_t Opcode>
+CycleV2 InterpreterV2::execute_pair(InterpreterV2& machine, const PredecodedV2& record) {
+    if (machine.execute_as(record.instruction, FixedOpcode<Opcode>{}) != CycleV2::Advanced) {
+        return CycleV2::Stopped;
+    }
+    const PredecodedV2& second = *record.fused();
+    const std::uint64_t cost = kCycleCosts[second.instruction.opcode];
+    if (machine.steps_taken_ + 1 >= machine.fuse_limit_ ||
+        machine.unsettled_instructions_ + 1 >= machine.settle_deadline_ ||
+        (machine.cycle_limit_ != 0 &&
+         machine.cycles() + cost + 2 * cycle_cost::kTranslationWalk >= machine.cycle_limit_)) {
+        return CycleV2::Advanced;
+    }
+    ++machine.unsettled_instructions_;
+    ++machine.steps_taken_;
+    machine.predecode_.count_fused_hit();
+    machine.cycles_ += cost;
+    return second.handler(machine, second);
+}
+
+template <std::size_t... Opcodes>
+constexpr std::array<ExecuteHandlerV2, sizeof...(Opcodes)> InterpreterV2::handler_table(
+    std::index_sequence<Opcodes...>) {
+    return {{&execute_fixed<static_cast<std::uint8_t>(Opcodes)>...}};
+}
+
+template <std::uint8_t Opcode>
+constexpr ExecuteHandlerV2 InterpreterV2::pair_handler() {
+    if constexpr (opens_pair(Opcode)) {
+        return &execute_pair<Opcode>;
+    } else {
+        return nullptr;
+    }
+}
+
+template <std::size_t... Opcodes>
+constexpr std::array<ExecuteHandlerV2, sizeof...(Opcodes)> InterpreterV2::pair_handler_table(
+    std::index_sequence<Opcodes...>) {
+    return {{pair_handler<static_cast<std::uint8_t>(Opcodes)>()...}};
+}
+
+// One handler per opcode byte, the unassigned ones included: the decoder never hands one of
+// those over, and if it did its handler would report it unimplemented exactly as the switch does.
+//
+// A handler returns to its caller rather than jumping into the next instruction's: C++ promises
+// no tail call, and a chain of calls the compiler did not turn into jumps would grow the stack
+// by an instruction at a time. The handlers are what step(), the JIT's loop and the profile's
+// loop call, and the tight loop as well where the compiler has no computed goto. What they save
+// is the dispatch itself: one indirect call through a pointer the record already holds, in
+// place of the cascade of range checks and the switch's own table jump. run_threaded() is the
+// road that chains, with labels.
+ExecuteHandlerV2 InterpreterV2::handler_for(std::uint8_t opcode) {
+    static constexpr std::array<ExecuteHandlerV2, 256> kHandlers =
+        handler_table(std::make_index_sequence<256>{});
+    return kHandlers[opcode];
+}
+
+// Null for an opcode fuses() never opens a pair with.
+ExecuteHandlerV2 InterpreterV2::pair_handler_for(std::uint8_t opcode) {
+    static constexpr std::array<ExecuteHandlerV2, 256> kPairHandlers =
+        pair_handler_table(std::make_index_sequence<256>{});
+    return kPairHandlers[opcode];
+}
+
+template <typename OpcodeSource>
+CycleV2 InterpreterV2::execute_as(const DecodedV2& decoded, OpcodeSource source) {
+    const std::uint8_t opcode = source(decoded);
 
     // Constants and moves, $01..$09.
     switch (opcode) {
@@ -1462,7 +2146,7 @@ StepResult InterpreterV2::execute(const DecodedV2& decoded) {
         result.status = StepStatus::Halted;
         result.opcode = opcode;
         result.pc = decoded.pc;
-        return result;
+        return stop(result);
     }
 
     // port_in and port_out, $C2 and $C3 (maize-451). The port space is disjoint from memory and
@@ -1475,6 +2159,9 @@ StepResult InterpreterV2::execute(const DecodedV2& decoded) {
         if (privilege() != Privilege::Supervisor) {
             return raise(decoded, cause::kPrivilegedOperation, 0, opcode);
         }
+        // A device sees the clock as of the instructions before this one, as it always has, and
+        // a write can arm the timer, so the deadline is worked out again after it (user-011).
+        settle_time();
         if (opcode == op::kPortIn) {
             // port_in rp rd. The port identifier is the low quarter-word of the port register
             // and the upper 48 bits are ignored rather than checked, so a computed port number
@@ -1489,6 +2176,7 @@ StepResult InterpreterV2::execute(const DecodedV2& decoded) {
                 static_cast<std::uint16_t>(registers_.read(decoded.reg[1]));
             devices_.port_out(port, value);
         }
+        schedule_settle();
         return advance(decoded);
     }
 
@@ -1505,7 +2193,7 @@ StepResult InterpreterV2::execute(const DecodedV2& decoded) {
     result.status = StepStatus::Unimplemented;
     result.opcode = opcode;
     result.pc = decoded.pc;
-    return result;
+    return stop(result);
 }
 
 }  // namespace maize::v2
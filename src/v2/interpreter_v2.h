@@ -32,7 +32,7 @@
 // completion state: count zero, each pointer at its original value plus the original count.
 //
 // EVERY GUEST ACCESS GOES THROUGH ONE TRANSLATION PATH (maize-465). The fetch, a load, a store,
-// each byte of a block-memory transfer, the vector read and the four frame stores of trap
+// each run of a block-memory transfer, the vector read and the four frame stores of trap
 // delivery all reach memory through plan_access below, which translates first and judges
 // physical reachability second. There is no second road to memory, which is the only reason a
 // fetch from a non-executable page and a store to a read-only page cannot come to disagree
@@ -42,38 +42,87 @@
 #define MAIZE_V2_INTERPRETER_V2_H
 
 #include <array>
+#include <cstddef>
 #include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
 
+#include "cost_v2.h"
 #include "csr_v2.h"
 #include "decode_v2.h"
 #include "device_v2.h"
 #include "memory_v2.h"
+#include "predecode_v2.h"
 #include "registers_v2.h"
+#include "snapshot_v2.h"
 #include "translate_v2.h"
 #include "trap_v2.h"
 
+// How the execute stage is entered (user-013). 1, the default, threads the run loop: under a
+// compiler with computed goto (GCC and Clang), each opcode has a label of its own in
+// run_threaded(), and each label runs its instruction, the boundary after it and the next fetch,
+// and jumps straight to the next instruction's label. Elsewhere, and for step() and the JIT's and
+// profile's loops everywhere, the loop calls the handler a predecoded record carries, which is
+// execute() specialized for that record's opcode. 0 enters execute()'s switch for every
+// instruction. The switch is the reference either way: the handlers and labels are generated
+// from it, the JIT's --jit-check oracle always runs it, and a build with 0 is how a suspected
+// handler bug is told from a bug in the switch. CMake's MAIZE_V2_THREADED_DISPATCH option sets it.
+#ifndef MAIZE_V2_THREADED_DISPATCH
+#define MAIZE_V2_THREADED_DISPATCH 1
+#endif
+#if MAIZE_V2_THREADED_DISPATCH && defined(__GNUC__)
+#define MAIZE_V2_COMPUTED_GOTO 1
+#else
+#define MAIZE_V2_COMPUTED_GOTO 0
+#endif
+
 namespace maize::v2 {
 
-// One access, translated byte by byte and judged whole before any of it happens (maize-465).
+// One access, translated and judged whole before any of it happens (maize-465).
 //
-// The plan holds a physical address per byte rather than one base address, because an access
-// that straddles a page boundary is contiguous in virtual addresses and need not be contiguous
-// in physical ones. Judging every byte before touching any is the same trap-writes-nothing
-// discipline this file already applied to the physical range check, extended to translation:
-// a load whose second page is unmapped writes no destination register, and a store whose second
-// page is read-only writes no byte at all.
+// The plan holds the access as runs, one per page it touches (user-004), rather than one base
+// address, because an access that straddles a page boundary is contiguous in virtual addresses
+// and need not be contiguous in physical ones. Every byte of a page translates alike, so one
+// translation per run is the same answer maize-465 reached by translating every byte. Judging
+// the whole access before touching any of it is the same trap-writes-nothing discipline this
+// file already applied to the physical range check, extended to translation: a load whose
+// second page is unmapped writes no destination register, and a store whose second page is
+// read-only writes no byte at all.
 //
-// The largest access the machine makes is the four-word trap frame, so the capacity is 32. The
-// assertions below state that in a form the compiler checks, rather than leaving it to a comment
-// that goes stale the first time one of those accesses grows.
+// The largest access the machine makes is the four-word trap frame, so the capacity is 32, and
+// 32 bytes can touch at most two pages. The assertions below state that in a form the compiler
+// checks, rather than leaving it to a comment that goes stale the first time one of those
+// accesses grows.
 struct AccessPlanV2 {
     static constexpr unsigned kMaxBytes = 32;
     // The widest single load or store the instruction set has, which is one 64-bit word.
     static constexpr unsigned kMaxDataBytes = 8;
-    std::array<std::uint64_t, kMaxBytes> physical{};
+    static constexpr unsigned kMaxRuns = 2;
+
+    // `length` bytes at `physical`, holding the access's bytes from `offset` on.
+    struct Run {
+        std::uint64_t physical = 0;
+        unsigned offset = 0;
+        unsigned length = 0;
+    };
+
+    std::array<Run, kMaxRuns> runs{};
+    unsigned run_count = 0;
     unsigned count = 0;
+
+    // The run holding the access's byte `offset`, and that byte's physical address.
+    const Run& run_at(unsigned offset) const {
+        return (run_count > 1 && offset >= runs[1].offset) ? runs[1] : runs[0];
+    }
+    std::uint64_t physical(unsigned offset) const {
+        const Run& run = run_at(offset);
+        return run.physical + (offset - run.offset);
+    }
 };
 
+static_assert(AccessPlanV2::kMaxBytes <= MemoryV2::kPageBytes,
+              "an access touches at most two pages, so a plan holds at most two runs");
 static_assert(trap_frame::kBytes <= AccessPlanV2::kMaxBytes,
               "a trap frame is planned as one access, so the plan must hold all of it");
 static_assert(vector_table::kEntryBytes <= AccessPlanV2::kMaxBytes,
@@ -123,6 +172,19 @@ enum class TrapDisposition : std::uint8_t {
     HaltedDoubleFault,   // the vector read or a frame store faulted: halt kind 2, original cause
 };
 
+// One byte a store is about to overwrite, as it was before the store (user-002). A host that has
+// to put memory back the way it found it, which is JitV2's --jit-check and nothing a guest can
+// reach, points the machine at a journal of these; every other run leaves the pointer null and
+// pays one test per store for it.
+struct StoreJournalEntryV2 {
+    std::uint64_t physical = 0;
+    std::uint8_t previous = 0;
+};
+
+class JitV2;
+struct JitOptionsV2;
+class ProfileV2;
+
 struct StepResult {
     StepStatus status = StepStatus::Advanced;
     TrapV2 trap{};                 // meaningful when status is Trapped
@@ -134,18 +196,51 @@ struct StepResult {
     std::uint64_t handler = 0;     // the handler address, when the disposition is Delivered
 };
 
+// How one cycle ended (user-012). An instruction that advanced has said everything it has to
+// say by moving the program counter, so it returns Advanced and nothing else; the run loop
+// checks that and goes round again without building a result at all. Everything else, a
+// delivered or halting trap, a halt, a suspension or an unimplemented opcode, is rare and is the
+// only place a full StepResult is built. At namespace scope rather than in the class since
+// user-013, because a predecoded record's handler returns one (predecode_v2.h).
+enum class CycleV2 : std::uint8_t { Advanced, Stopped };
+
 class InterpreterV2 {
   public:
-    explicit InterpreterV2(MemoryV2& memory, std::uint64_t reset_pc = 0)
-        : memory_(memory), pc_(reset_pc) {}
+    explicit InterpreterV2(MemoryV2& memory, std::uint64_t reset_pc = 0);
+    ~InterpreterV2();
+
+    InterpreterV2(const InterpreterV2&) = delete;
+    InterpreterV2& operator=(const InterpreterV2&) = delete;
 
     StepResult step();
 
     // Run until the machine halts, traps, hits an unimplemented opcode, or exhausts the step
     // budget. The budget exists so a fixture with a runaway loop fails instead of hanging; a
     // budget of zero runs without a bound.
+    //
+    // With the JIT enabled, run() offers each boundary where a block can start to the compiled
+    // code first and steps only where it declines, so a run with the JIT and a run without it
+    // stop at the same instruction with the same state. step() never consults the JIT: a single step is always interpreted.
+    //
+    // Both return with the machine's clock settled (user-011), so a host that reads a device
+    // between calls sees exactly the time the retired instructions account for.
     StepResult run(std::uint64_t max_steps = 0);
 
+    // Compile hot blocks to host code from here on (user-002). Returns false, and leaves the
+    // machine interpreted, on a host with no JIT backend or when the code arena could not be
+    // mapped; a caller that asked for the JIT on the command line says so and carries on.
+    bool enable_jit(const JitOptionsV2& options);
+    // Null until enable_jit() succeeds.
+    JitV2* jit() { return jit_.get(); }
+    const JitV2* jit() const { return jit_.get(); }
+
+    // Count what the machine does into `profile` from here on (user-023), or stop counting with
+    // null. The host owns the profile and keeps it alive while it is attached. A profiled
+    // machine runs interpreted and unfused, the JIT or no, and its step() is a run() of one, so
+    // every instruction either retires is counted; profile_v2.h says why that is the price.
+    void host_attach_profile(ProfileV2* profile);
+    ProfileV2* profile() { return profile_; }
+
     RegistersV2& registers() { return registers_; }
     const RegistersV2& registers() const { return registers_; }
     MemoryV2& memory() { return memory_; }
@@ -171,11 +266,31 @@ class InterpreterV2 {
     TranslatorV2& translator() { return translator_; }
     const TranslatorV2& translator() const { return translator_; }
 
+    // The decoded-instruction cache (user-001), invisible to a guest for the same reason the
+    // translation cache is and exposed for the same reason: a host that wants to know what it
+    // is saving, and a fixture that checks a patched instruction is not served stale.
+    PredecodeCacheV2& predecode() { return predecode_; }
+    const PredecodeCacheV2& predecode() const { return predecode_; }
+
     std::uint64_t pc() const { return pc_; }
     void set_pc(std::uint64_t value) { pc_ = value; }
     bool halted() const { return halted_; }
     std::uint64_t steps_taken() const { return steps_taken_; }
 
+    // The cycles consumed under cost_v2.h's model (user-022), which carry on across a snapshot
+    // and a clone the way the step count does. The walk charge is worked out here from the
+    // translator's count rather than added as each walk happens, so the walk path pays nothing.
+    std::uint64_t cycles() const {
+        return cycles_ + (translator_.walks() - walk_base_) * cycle_cost::kTranslationWalk;
+    }
+    // Stop run() at the first instruction boundary at which cycles() has reached `limit`, which
+    // is a count rather than a budget for the reason run_until's limit is (batch_v2.h); zero, the
+    // default, sets no limit. The instruction that reaches it is the last to run, whatever it
+    // cost, and run() reports it as it reports the one that uses up a step budget.
+    void set_cycle_limit(std::uint64_t limit) { cycle_limit_ = limit; }
+    std::uint64_t cycle_limit() const { return cycle_limit_; }
+    bool cycle_limit_reached() const { return cycle_limit_ != 0 && cycles() >= cycle_limit_; }
+
     // The live privilege level is the status register's privilege field (maize-463). There is
     // no separate copy of it, so a csr_write to status IS a privilege change and cannot be
     // implemented correctly in one place and forgotten in another.
@@ -206,7 +321,40 @@ class InterpreterV2 {
     // causes 8, 9 and 10 cannot be raised here at all and maize-465 brings the conditions that
     // raise them. Without this seam the page-fault causes would travel a delivery path no test
     // had ever run, and the first thing to run it would be maize-465's own new code.
-    StepResult host_deliver_trap(const TrapV2& trap) { return deliver(trap, 0, trap.pc); }
+    StepResult host_deliver_trap(const TrapV2& trap) {
+        deliver(trap, 0, trap.pc);
+        return stopped_;
+    }
+
+    // Snapshots (user-007); snapshot_v2.h says what one holds and how a chain of them works.
+    //
+    // take_full_snapshot() saves the whole machine and starts the chain, which turns on the
+    // memory's dirty tracking. take_incremental_snapshot() saves the machine state and the pages
+    // written since the previous snapshot, and returns false, leaving `out` alone, when no full
+    // snapshot has started a chain. restore_snapshot() puts a snapshot back: a full one anywhere,
+    // an incremental one only directly after the snapshot this machine last took or restored.
+    // It returns false, having changed nothing, for an incremental out of order or a snapshot
+    // whose contents do not parse. Memory is resized to the snapshot's size when they differ,
+    // through MemoryV2::host_set_size and with its std::bad_alloc.
+    //
+    // Each is host-side, reachable from no instruction, and meant between runs, which is the
+    // only time a host holds the machine anyway.
+    MachineSnapshotV2 take_full_snapshot();
+    bool take_incremental_snapshot(MachineSnapshotV2& out);
+    bool restore_snapshot(const MachineSnapshotV2& snapshot);
+
+    // A second machine in this one's exact state, for a host that runs one warm machine up to a
+    // point and then fans it out into many runs from there (user-008). The clone owns its
+    // memory, which shares this machine's pages copy-on-write (memory_v2.h), so the cost of a
+    // clone is the machine state and a pass over the watch bytes, and each machine afterwards
+    // pays a page copy only for a page it writes. The two are independent from then on and
+    // either may outlive the other. The translation cache and the fetch window are copied, since
+    // they hold no host pointers; the predecode cache starts empty, the JIT, when this machine
+    // has one, starts with no compiled blocks under the same options, and the clone has no
+    // snapshot chain until it takes a full snapshot of its own. Not const, because this
+    // machine's memory is frozen into the image the two share. Throws std::bad_alloc as
+    // MemoryV2's constructor does.
+    std::unique_ptr<InterpreterV2> clone();
 
     // Sample every device's interrupt line into the pending registers (maize-466). The machine
     // does this at each instruction boundary on its own account; a fixture calls it to observe
@@ -214,11 +362,90 @@ class InterpreterV2 {
     void host_sample_device_interrupts() { sample_device_interrupts(); }
 
   private:
-    StepResult execute(const DecodedV2& decoded);
+    // The clone's constructor, which takes ownership of the memory it runs on.
+    InterpreterV2(std::unique_ptr<MemoryV2> owned, std::uint64_t reset_pc);
+
+    // The JIT sequences this class's own execute path (jit_v2.h), so it needs that path and the
+    // boundary checks around it, and nothing else here is any of its business.
+    friend class JitV2;
+
+    CycleV2 execute(const DecodedV2& decoded);
+    // The body of execute(), with the opcode it dispatches on taken from `source` (user-013).
+    // execute() passes the decoded opcode byte; each handler passes its own opcode as a
+    // constant, so the compiler folds every range check and switch down to that opcode's case
+    // and the handler is the case alone.
+    template <typename OpcodeSource>
+    CycleV2 execute_as(const DecodedV2& decoded, OpcodeSource source);
+    template <std::uint8_t Opcode>
+    static CycleV2 execute_fixed(InterpreterV2& machine, const PredecodedV2& record);
+    template <std::size_t... Opcodes>
+    static constexpr std::array<ExecuteHandlerV2, sizeof...(Opcodes)> handler_table(
+        std::index_sequence<Opcodes...>);
+    // The handler for an opcode, which fetch_and_decode stores in the predecode record.
+    static ExecuteHandlerV2 handler_for(std::uint8_t opcode);
+    // The handler a pair's opening record is given when it is linked to its second half
+    // (user-014): the opener's own handler, followed by the second half's when the boundary
+    // between them allows.
+    template <std::uint8_t Opcode>
+    static CycleV2 execute_pair(InterpreterV2& machine, const PredecodedV2& record);
+    template <std::uint8_t Opcode>
+    static constexpr ExecuteHandlerV2 pair_handler();
+    template <std::size_t... Opcodes>
+    static constexpr std::array<ExecuteHandlerV2, sizeof...(Opcodes)> pair_handler_table(
+        std::index_sequence<Opcodes...>);
+    static ExecuteHandlerV2 pair_handler_for(std::uint8_t opcode);
+    // execute() for a caller that wants the result step() would have reported: the JIT, which
+    // hands its last instruction's result back through run(), and --jit-check's oracle.
+    StepResult execute_to_result(const DecodedV2& decoded);
+    CycleV2 stop(const StepResult& result) {
+        stopped_ = result;
+        return CycleV2::Stopped;
+    }
+    static StepResult advanced_result(std::uint8_t opcode, std::uint64_t pc) {
+        StepResult result;
+        result.opcode = opcode;
+        result.pc = pc;
+        return result;
+    }
 
-    // Translate every byte of one access and judge its physical reachability, before any of the
-    // access happens (maize-465). Returns false with `trap`'s cause, subcode and auxiliary word
-    // set and its captured program counter left to the raise site.
+    // Fetch and decode the instruction at the program counter, through the predecode cache when
+    // the bytes are cached and through decode_v2 when they are not, and return it with its
+    // handler. Null when the fetch or the decode trapped, with the trap in fetch_trap_ exactly as
+    // decode_v2 reported it, because every trapping fetch takes the uncached road. The record is
+    // the cache's own when it was decoded at this same program counter, which is the usual
+    // case, and is otherwise fetched_; either way it is good until the next fetch.
+    const PredecodedV2* fetch_and_decode();
+    // The fetch's translation at the program counter, through the fetch window below when it
+    // answers and the translator when it does not, keeping the window up to date either way.
+    // The JIT's dispatcher asks here too (user-022), so a run with it walks the page tables
+    // exactly where a run without it would; with `walk` false a translation the translator does
+    // not already hold is reported as a failure rather than walked for, and the instruction's own
+    // fetch walks for it.
+    TranslationResult translate_fetch(std::uint64_t root, Privilege level, bool walk);
+    // Cache and link the instruction after `first`, whose opcode byte is at `physical`, when the
+    // two fuse (user-014).
+    void predecode_pair(std::uint64_t physical, const DecodedV2& first);
+
+    // The translation of the code page the last instruction was fetched from (user-005), so
+    // straight-line code on one page translates its fetch once rather than once per
+    // instruction. It answers only while everything the translation depended on is unchanged:
+    // the paging root, the privilege level, and the translator's epoch, which every invalidation
+    // moves, and a tlb_invalidate_* or a paging-root write is therefore seen here without being
+    // told. A store to the page changes its bytes and not its translation, and the bytes are the
+    // predecode cache's to track. Only successful translations onto populated memory are kept,
+    // so every fault takes the translated road and reports itself as before.
+    struct FetchWindowV2 {
+        bool valid = false;
+        std::uint64_t virtual_page = 0;
+        std::uint64_t physical_page = 0;
+        std::uint64_t paging_root = 0;
+        std::uint64_t epoch = 0;
+        Privilege level = Privilege::Supervisor;
+    };
+
+    // Translate one access, once per page it touches, and judge its physical reachability,
+    // before any of the access happens (maize-465, user-004). Returns false with `trap`'s cause,
+    // subcode and auxiliary word set and its captured program counter left to the raise site.
     //
     // `level` is a parameter rather than being read off the status register, because the machine
     // makes accesses on its own account that are not the running program's: the vector read and
@@ -235,24 +462,24 @@ class InterpreterV2 {
     void write_planned(const AccessPlanV2& plan, unsigned offset, unsigned width,
                        std::uint64_t value);
 
-    // Result constructors, so no execute path assembles a StepResult by hand.
-    StepResult advance(const DecodedV2& decoded);
-    StepResult branch_to(const DecodedV2& decoded, std::uint64_t target);
+    // The two ways an instruction advances, so no execute path writes pc_ for itself.
+    CycleV2 advance(const DecodedV2& decoded);
+    CycleV2 branch_to(const DecodedV2& decoded, std::uint64_t target);
 
     // Raise a FAULT-class condition: the captured program counter is the faulting instruction's
     // own first byte, so a handler that repairs the condition returns and the instruction runs
     // again (trap-model.md, "Fault, trap, and interrupt").
-    StepResult raise(const DecodedV2& decoded, std::uint8_t cause_number,
-                     std::uint8_t subcode_number, std::uint64_t aux);
+    CycleV2 raise(const DecodedV2& decoded, std::uint8_t cause_number,
+                  std::uint8_t subcode_number, std::uint64_t aux);
 
     // Raise a TRAP-class condition, which the instruction asked for: the captured program
     // counter is the address of the FOLLOWING instruction, because there is nothing to retry.
     // `sys` and `breakpoint` are the two members of the class in the base.
-    StepResult raise_trap_class(const DecodedV2& decoded, std::uint8_t cause_number,
-                                std::uint8_t subcode_number, std::uint64_t aux);
+    CycleV2 raise_trap_class(const DecodedV2& decoded, std::uint8_t cause_number,
+                             std::uint8_t subcode_number, std::uint64_t aux);
 
     // The delivery sequence itself, in the chapter's fixed order.
-    StepResult deliver(const TrapV2& trap, std::uint8_t opcode, std::uint64_t instruction_pc);
+    CycleV2 deliver(const TrapV2& trap, std::uint8_t opcode, std::uint64_t instruction_pc);
 
     // External interrupts (maize-466).
     //
@@ -267,32 +494,87 @@ class InterpreterV2 {
     // Clear the pending bit, then run the ordinary delivery sequence. `resume_pc` is the address
     // the interrupted program resumes at, which is the following instruction's at an ordinary
     // boundary and the block instruction's own at a mid-operation one.
-    StepResult deliver_interrupt(unsigned cause_number, std::uint64_t resume_pc);
-    StepResult execute_wait_for_interrupt(const DecodedV2& decoded);
+    CycleV2 deliver_interrupt(unsigned cause_number, std::uint64_t resume_pc);
+    CycleV2 execute_wait_for_interrupt(const DecodedV2& decoded);
+    // The clock, settled lazily (user-011). Retiring an instruction only counts it; the count
+    // reaches the devices at the deadline, the instruction after which some device could next
+    // change a line, and before anything that observes or changes a device's time: a port
+    // access, a wait, a block-memory boundary, and the return from step() or run().
+    // One boundary and the instruction after it, with `opcode` set to that instruction's opcode
+    // when it advanced. A fused pair (user-014) is one instruction here, and `opcode` its first.
+    CycleV2 cycle(std::uint8_t& opcode);
+    StepResult run_deferred(std::uint64_t max_steps);
+#if MAIZE_V2_COMPUTED_GOTO
+    StepResult run_threaded(std::uint64_t max_steps);
+#endif
+    StepResult run_profiled(std::uint64_t max_steps);
+    void settle_time();
+    void schedule_settle();
     // A block-memory mid-operation boundary: advance the clock, sample, and report the cause the
     // machine would take, or CsrFileV2::kNoCause. `transferred` is the byte count completed so
     // far, which is what selects the boundaries.
     unsigned block_mid_operation_interrupt(std::uint64_t transferred);
-    StepResult halt_without_delivering(const TrapV2& trap, std::uint8_t opcode,
-                                       std::uint64_t instruction_pc, TrapDisposition disposition,
-                                       unsigned halt_kind);
-
-    StepResult execute_trap_return(const DecodedV2& decoded);
-
-    StepResult execute_load(const DecodedV2& decoded, unsigned width_bytes, bool sign_extended,
-                            bool displaced);
-    StepResult execute_store(const DecodedV2& decoded, unsigned width_bytes, bool displaced);
-    StepResult execute_block(const DecodedV2& decoded);
-    StepResult execute_csr(const DecodedV2& decoded);
-
+    CycleV2 halt_without_delivering(const TrapV2& trap, std::uint8_t opcode,
+                                    std::uint64_t instruction_pc, TrapDisposition disposition,
+                                    unsigned halt_kind);
+
+    CycleV2 execute_trap_return(const DecodedV2& decoded);
+
+    CycleV2 execute_load(const DecodedV2& decoded, unsigned width_bytes, bool sign_extended,
+                         bool displaced);
+    CycleV2 execute_store(const DecodedV2& decoded, unsigned width_bytes, bool displaced);
+    CycleV2 execute_block(const DecodedV2& decoded);
+    // One run of a block-memory transfer, every byte of it already proved accessible, moved as
+    // the byte-by-byte transfer in that direction would move it (user-015).
+    void copy_block_run(std::uint64_t to, std::uint64_t from, std::uint64_t length,
+                        bool descending);
+    // Keep what a run of block-memory stores is about to overwrite, when a journal is attached;
+    // the runs write through memory_ a page at a time rather than through write_planned().
+    void journal_block_run(std::uint64_t physical, std::uint64_t length);
+    CycleV2 execute_csr(const DecodedV2& decoded);
+
+    // snapshot_v2.cpp. The machine state a snapshot carries besides memory, and the machine
+    // half of a restore, which has already been checked to parse.
+    std::vector<std::uint8_t> save_machine_state() const;
+    bool load_machine_state(StateReaderV2& in);
+
+    // Set only on a clone, and declared ahead of memory_ so it is constructed first and
+    // destroyed last.
+    std::unique_ptr<MemoryV2> owned_memory_;
     MemoryV2& memory_;
     RegistersV2 registers_{};
     DeviceSurfaceV2 devices_{};
     CsrFileV2 csr_{};
     TranslatorV2 translator_{};
+    PredecodeCacheV2 predecode_{};
+    FetchWindowV2 fetch_window_{};
     std::uint64_t pc_ = 0;
     std::uint64_t steps_taken_ = 0;
+    // Instructions retired whose time the devices have not been given, and how many may be
+    // before they must be. The first is zero whenever step() or run() is not on the stack.
+    std::uint64_t unsettled_instructions_ = 0;
+    std::uint64_t settle_deadline_ = 0;
+    // The step count a fused pair's second half must stay below (user-014); zero when no pair
+    // may run.
+    std::uint64_t fuse_limit_ = 0;
+    // The cycles charged by opcode and by block byte, and the translator's walk count at the
+    // point its walks started counting towards cycles(): zero for a new machine, and the count
+    // at the restore or the clone that put cycles_ in place (user-022).
+    std::uint64_t cycles_ = 0;
+    std::uint64_t walk_base_ = 0;
+    std::uint64_t cycle_limit_ = 0;
+    // The result of the last cycle that did not advance.
+    StepResult stopped_{};
+    // fetch_and_decode's answer when it is not a cached record.
+    PredecodedV2 fetched_{};
+    TrapV2 fetch_trap_{};
     bool halted_ = false;
+    // The sequence number the next incremental snapshot takes, or zero while no full snapshot
+    // has started a chain.
+    std::uint64_t next_snapshot_sequence_ = 0;
+    std::vector<StoreJournalEntryV2>* store_journal_ = nullptr;
+    std::unique_ptr<JitV2> jit_;
+    ProfileV2* profile_ = nullptr;
 };
 
 // The ten predicates, in the order the compare band, the immediate compare band and the branch
@@ -0,0 +1,1151 @@
+// jit_v2.cpp (user-002): the template JIT for InterpreterV2. jit_v2.h says what it is and what
+// it is not; this file is the host backend, the block table, and the three host calls compiled
+// code makes.
+
+#include "jit_v2.h"
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <initializer_list>
+#include <unordered_map>
+#include <utility>
+
+#if MAIZE_V2_JIT_BACKEND
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+#endif
+
+namespace maize::v2 {
+namespace {
+
+// Past this many entries the tier-up counters are aged (age_hotness()). Only block entries are
+// counted, but a large program still has one for every branch target it ever reached, and
+// without a bound the map would keep every one of them.
+constexpr std::size_t kMaxHotnessEntries = std::size_t{1} << 20;
+// A counter value meaning "this entry does not start a compilable block".
+constexpr std::uint32_t kNeverCompile = 0xFFFFFFFFu;
+
+constexpr std::uint64_t kPageOffsetMask = MemoryV2::kPageBytes - 1;
+
+// What a block may contain. Every opcode here does all of its work through execute() with no
+// boundary of its own, never changes privilege, the paging root or the interrupt gate, and
+// never touches a device, so running a run of them back to back with the boundary checks hoisted
+// to the block's entry is invisible. The block-memory band has mid-operation boundaries, the
+// system band changes exactly the state hoisting depends on, and port I/O is a device access;
+// all three end a block before them and run in the interpreter.
+bool covered(std::uint8_t opcode) {
+    return (opcode >= op::kMove && opcode <= op::kPcAdd) ||
+           (opcode >= op::kAdd && opcode <= op::kShiftRightArithmeticHImm) ||
+           (opcode >= op::kCompareEq && opcode <= op::kCompareImmBase + 9) ||
+           (opcode >= op::kBranchBase && opcode <= op::kBranchBase + 9) ||
+           (opcode >= op::kJumpDisp && opcode <= op::kSelectZ) ||
+           (opcode >= op::kLoad && opcode <= op::kStoreDisp + 3) ||
+           (opcode >= op::kExtractZb && opcode <= op::kBitfieldInsert);
+}
+
+bool is_store(std::uint8_t opcode) {
+    return opcode >= op::kStore && opcode <= op::kStoreDisp + 3;
+}
+
+bool is_branch(std::uint8_t opcode) {
+    return opcode >= op::kBranchBase && opcode <= op::kBranchBase + 9;
+}
+
+// The control and status registers --jit-check compares. Every one a covered instruction can
+// move, which is only through a trap it raised and delivered, plus the pending registers, which
+// the boundary sample writes.
+constexpr std::uint16_t kCheckedCsrs[] = {
+    csr::kStatus,           csr::kTrapStack,         csr::kTrapVectorBase,
+    csr::kPagingRoot,       csr::kInterruptEnable0,  csr::kInterruptEnable1,
+    csr::kInterruptEnable2, csr::kInterruptEnable3,  csr::kScratch,
+    csr::kInterruptPending0, csr::kInterruptPending1, csr::kInterruptPending2,
+    csr::kInterruptPending3, csr::kHaltCause,
+};
+
+#if MAIZE_V2_JIT_BACKEND
+
+// Host register numbers, in ModRM and REX encoding order. Emitted code clobbers only the host
+// ABI's caller-saved registers and makes ABI-conformant calls, so a block is itself callable as a
+// plain `void (*)()`.
+enum : std::uint8_t { kRax = 0, kRcx = 1, kRdx = 2, kRsi = 6, kRdi = 7, kR8 = 8, kR9 = 9 };
+
+#ifdef _WIN32
+// Win64: arguments in rcx, rdx, r8, r9, and 32 bytes of shadow space. rsp is 8 mod 16 on entry,
+// so a 40-byte frame leaves every call site 16-aligned.
+constexpr std::uint8_t kArgumentRegister[4] = {kRcx, kRdx, kR8, kR9};
+constexpr std::uint8_t kCallFrame = 40;
+#else
+// System V: arguments in rdi, rsi, rdx, rcx. An 8-byte frame restores 16-alignment.
+constexpr std::uint8_t kArgumentRegister[4] = {kRdi, kRsi, kRdx, kRcx};
+constexpr std::uint8_t kCallFrame = 8;
+#endif
+
+// What is emitted inline rather than called (jit_v2.h): the moves, the arithmetic and logic that
+// is one host instruction, the compares and the conditional branches. None of them can trap or
+// touch anything but registers and the program counter. A literal the templates would have to
+// widen differently from the interpreter is left to the handler, though the decoder yields none:
+// the host sign-extends 32 bits, as sign_extend(literal, 32) does, and nothing wider.
+bool templated(const DecodedV2& decoded) {
+    const std::uint8_t opcode = decoded.opcode;
+    if (opcode == op::kMove || opcode == op::kMoveW || opcode == op::kAdd ||
+        opcode == op::kSubtract || (opcode >= op::kAnd && opcode <= op::kXor) ||
+        (opcode >= op::kCompareEq && opcode <= op::kCompareGeUnsigned) || is_branch(opcode)) {
+        return true;
+    }
+    const bool immediate = opcode == op::kAddImm || opcode == op::kSubtractImm ||
+                           (opcode >= op::kAndImm && opcode <= op::kXorImm) ||
+                           (opcode >= op::kCompareImmBase && opcode <= op::kCompareImmBase + 9);
+    return immediate && decoded.immediate[0] <= 0xFFFFFFFFu;
+}
+
+// x86-64 condition codes, the low nibble of jcc and setcc, for the ten predicates in the order
+// compares and branches number them: eq, ne, the four signed and the four unsigned orderings.
+constexpr std::uint8_t kPredicateCondition[10] = {0x4, 0x5, 0xC, 0xE, 0xF,
+                                                  0xD, 0x2, 0x6, 0x7, 0x3};
+constexpr std::uint8_t kAboveOrEqual = 0x3;
+
+// A host arithmetic operation in its two encodings: the opcode of `op r/m64, r64`, and the
+// ModRM digit of `op r/m64, imm32` under opcode 81.
+struct HostOperation {
+    std::uint8_t register_opcode;
+    std::uint8_t immediate_digit;
+};
+constexpr HostOperation kHostAdd{0x01, 0};
+constexpr HostOperation kHostOr{0x09, 1};
+constexpr HostOperation kHostAnd{0x21, 4};
+constexpr HostOperation kHostSubtract{0x29, 5};
+constexpr HostOperation kHostXor{0x31, 6};
+constexpr HostOperation kHostCompare{0x39, 7};
+
+// The backend's primitives, as v1 numbered them, and after them the instructions the templates
+// are written in. Every memory operand is a 32-bit displacement from rcx or rdx, which need no
+// SIB byte; the templates keep the machine's address in one and the JIT's in the other.
+class Emitter {
+  public:
+    Emitter(std::uint8_t* begin, std::uint8_t* end) : cursor_(begin), end_(end) {}
+
+    std::uint8_t* cursor() const { return cursor_; }
+    bool overflowed() const { return overflowed_; }
+
+    // Primitive 1: call `function` with up to four integer constants. Nothing stays live in a
+    // host register across the call, and the return value lands in rax.
+    void call(std::uint64_t function, std::initializer_list<std::uint64_t> arguments) {
+        // sub rsp, frame
+        byte(0x48);
+        byte(0x83);
+        byte(0xEC);
+        byte(kCallFrame);
+        unsigned index = 0;
+        for (const std::uint64_t argument : arguments) {
+            move_immediate(kArgumentRegister[index++], argument);
+        }
+        move_immediate(kRax, function);
+        // call rax
+        byte(0xFF);
+        byte(0xD0);
+        // add rsp, frame
+        byte(0x48);
+        byte(0x83);
+        byte(0xC4);
+        byte(kCallFrame);
+    }
+
+    // Primitive 2: return to the dispatcher.
+    void ret() { byte(0xC3); }
+
+    // Primitive 3: skip forward when the last call returned zero. Returns the rel32 field for
+    // patch() once the destination is known.
+    std::uint8_t* skip_if_zero() {
+        // test rax, rax
+        byte(0x48);
+        byte(0x85);
+        byte(0xC0);
+        // jz rel32
+        byte(0x0F);
+        byte(0x84);
+        std::uint8_t* site = cursor_;
+        word32(0);
+        return site;
+    }
+
+    // Primitive 4: an unconditional patchable jump, the chaining site.
+    std::uint8_t* jump() {
+        byte(0xE9);
+        std::uint8_t* site = cursor_;
+        word32(0);
+        return site;
+    }
+
+    // Primitive 5: store a constant to memory, through rax.
+    void store_constant(std::uint8_t base, std::int32_t displacement, std::uint64_t value) {
+        move_immediate(kRax, value);
+        store(base, displacement, kRax);
+    }
+
+    // movabs r64, imm64
+    void move_immediate(std::uint8_t target, std::uint64_t value) {
+        byte(static_cast<std::uint8_t>(0x48 | (target >= 8 ? 1 : 0)));
+        byte(static_cast<std::uint8_t>(0xB8 | (target & 7)));
+        for (unsigned i = 0; i < 8; ++i) {
+            byte(static_cast<std::uint8_t>(value >> (i * 8)));
+        }
+    }
+    // mov r64, [base + displacement]
+    void load(std::uint8_t target, std::uint8_t base, std::int32_t displacement) {
+        memory_operand(0x8B, target, base, displacement);
+    }
+    // mov [base + displacement], r64
+    void store(std::uint8_t base, std::int32_t displacement, std::uint8_t source) {
+        memory_operand(0x89, source, base, displacement);
+    }
+    // add [base + displacement], r64
+    void add_register_to_memory(std::uint8_t base, std::int32_t displacement,
+                                std::uint8_t source) {
+        memory_operand(0x01, source, base, displacement);
+    }
+    // add qword [base + displacement], imm8
+    void add_to_memory(std::uint8_t base, std::int32_t displacement, std::int8_t value) {
+        memory_operand(0x83, 0, base, displacement);
+        byte(static_cast<std::uint8_t>(value));
+    }
+    // cmp r64, [base + displacement]
+    void compare_with_memory(std::uint8_t target, std::uint8_t base, std::int32_t displacement) {
+        memory_operand(0x3B, target, base, displacement);
+    }
+    // xor r32, r32, which clears the whole register
+    void zero(std::uint8_t target) {
+        if (target >= 8) {
+            byte(0x45);
+        }
+        byte(0x31);
+        byte(static_cast<std::uint8_t>(0xC0 | (target & 7) << 3 | (target & 7)));
+    }
+    // op target, source
+    void operate(HostOperation operation, std::uint8_t target, std::uint8_t source) {
+        byte(static_cast<std::uint8_t>(0x48 | (source >= 8 ? 4 : 0) | (target >= 8 ? 1 : 0)));
+        byte(operation.register_opcode);
+        byte(static_cast<std::uint8_t>(0xC0 | (source & 7) << 3 | (target & 7)));
+    }
+    // op target, imm32, the literal sign-extended to 64 bits
+    void operate_immediate(HostOperation operation, std::uint8_t target, std::uint32_t value) {
+        byte(static_cast<std::uint8_t>(0x48 | (target >= 8 ? 1 : 0)));
+        byte(0x81);
+        byte(static_cast<std::uint8_t>(0xC0 | operation.immediate_digit << 3 | (target & 7)));
+        word32(value);
+    }
+    // setcc al; movzx eax, al
+    void set_if(std::uint8_t condition) {
+        byte(0x0F);
+        byte(static_cast<std::uint8_t>(0x90 | condition));
+        byte(0xC0);
+        byte(0x0F);
+        byte(0xB6);
+        byte(0xC0);
+    }
+    // jcc rel32, patched like a jump
+    std::uint8_t* jump_if(std::uint8_t condition) {
+        byte(0x0F);
+        byte(static_cast<std::uint8_t>(0x80 | condition));
+        std::uint8_t* site = cursor_;
+        word32(0);
+        return site;
+    }
+
+  private:
+    void byte(std::uint8_t value) {
+        if (cursor_ >= end_) {
+            overflowed_ = true;
+            return;
+        }
+        *cursor_++ = value;
+    }
+    void word32(std::uint32_t value) {
+        for (unsigned i = 0; i < 4; ++i) {
+            byte(static_cast<std::uint8_t>(value >> (i * 8)));
+        }
+    }
+    // REX.W, the opcode, and a ModRM naming [base + disp32].
+    void memory_operand(std::uint8_t opcode, std::uint8_t reg, std::uint8_t base,
+                        std::int32_t displacement) {
+        byte(static_cast<std::uint8_t>(0x48 | (reg >= 8 ? 4 : 0) | (base >= 8 ? 1 : 0)));
+        byte(opcode);
+        byte(static_cast<std::uint8_t>(0x80 | (reg & 7) << 3 | (base & 7)));
+        word32(static_cast<std::uint32_t>(displacement));
+    }
+
+    std::uint8_t* cursor_;
+    std::uint8_t* end_;
+    bool overflowed_ = false;
+};
+
+template <typename Function>
+std::uint64_t address_of(Function function) {
+    return reinterpret_cast<std::uint64_t>(function);
+}
+
+// Where `field` lies in `object`, as a displacement from the object's address.
+template <typename Object, typename Field>
+std::int32_t offset_in(const Object& object, const Field& field) {
+    return static_cast<std::int32_t>(reinterpret_cast<const std::uint8_t*>(&field) -
+                                     reinterpret_cast<const std::uint8_t*>(&object));
+}
+
+// Where the templates find what they touch: the machine's fields from rcx, the JIT's from rdx.
+struct TemplateFrame {
+    std::int32_t registers = 0;
+    std::int32_t pc = 0;
+    std::int32_t cycles = 0;
+    std::int32_t retired = 0;
+    std::int32_t unsettled = 0;
+    std::int32_t last_record = 0;
+    std::int32_t cycle_stop = 0;
+};
+
+HostOperation host_operation(std::uint8_t opcode) {
+    switch (opcode) {
+        case op::kSubtract:
+        case op::kSubtractImm: return kHostSubtract;
+        case op::kAnd:
+        case op::kAndImm: return kHostAnd;
+        case op::kOr:
+        case op::kOrImm: return kHostOr;
+        case op::kXor:
+        case op::kXorImm: return kHostXor;
+        default: return kHostAdd;
+    }
+}
+
+// One templated instruction, as execute_as() would run it and the bottom of run_instruction()
+// would retire it: the operation on the register file, the program counter moved past it or to
+// its target, the counts, and the cycle charge, leaving by `exits` when the charge reaches the
+// cycle stop. A source register of zero is read as a cleared host register rather than from the
+// file, and a destination of zero is never written, which is register-model.md's r0. Jumps
+// within the template go on `links`, to be patched once the block is known to fit.
+void emit_template(Emitter& emitter, const TemplateFrame& frame, const PredecodedV2& record,
+                   std::vector<std::uint8_t*>& exits,
+                   std::vector<std::pair<std::uint8_t*, std::uint8_t*>>& links) {
+    const DecodedV2& decoded = record.instruction;
+    const std::uint8_t opcode = decoded.opcode;
+    const auto read = [&](std::uint8_t target, unsigned n) {
+        if (n == 0) {
+            emitter.zero(target);
+        } else {
+            emitter.load(target, kRcx, frame.registers + static_cast<std::int32_t>(8 * n));
+        }
+    };
+    const auto write = [&](unsigned n) {
+        if (n != 0) {
+            emitter.store(kRcx, frame.registers + static_cast<std::int32_t>(8 * n), kRax);
+        }
+    };
+    const auto literal = static_cast<std::uint32_t>(decoded.immediate[0]);
+    const auto length = static_cast<std::int8_t>(decoded.length);
+
+    if (is_branch(opcode)) {
+        read(kRax, decoded.reg[0]);
+        read(kR8, decoded.reg[1]);
+        emitter.operate(kHostCompare, kRax, kR8);
+        std::uint8_t* const taken =
+            emitter.jump_if(kPredicateCondition[opcode - op::kBranchBase]);
+        emitter.add_to_memory(kRcx, frame.pc, length);
+        std::uint8_t* const joined = emitter.jump();
+        links.emplace_back(taken, emitter.cursor());
+        emitter.move_immediate(kRax, decoded.length + sign_extend(decoded.immediate[0], 32));
+        emitter.add_register_to_memory(kRcx, frame.pc, kRax);
+        links.emplace_back(joined, emitter.cursor());
+    } else {
+        if (opcode == op::kMove) {
+            read(kRax, decoded.reg[0]);
+            write(decoded.reg[1]);
+        } else if (opcode == op::kMoveW) {
+            emitter.move_immediate(kRax, decoded.immediate[0]);
+            write(decoded.reg[0]);
+        } else if (opcode >= op::kCompareEq && opcode <= op::kCompareGeUnsigned) {
+            read(kRax, decoded.reg[0]);
+            read(kR8, decoded.reg[1]);
+            emitter.operate(kHostCompare, kRax, kR8);
+            emitter.set_if(kPredicateCondition[opcode - op::kCompareEq]);
+            write(decoded.reg[2]);
+        } else if (opcode >= op::kCompareImmBase && opcode <= op::kCompareImmBase + 9) {
+            read(kRax, decoded.reg[0]);
+            emitter.operate_immediate(kHostCompare, kRax, literal);
+            emitter.set_if(kPredicateCondition[opcode - op::kCompareImmBase]);
+            write(decoded.reg[1]);
+        } else if (opcode >= op::kAddImm) {
+            read(kRax, decoded.reg[0]);
+            emitter.operate_immediate(host_operation(opcode), kRax, literal);
+            write(decoded.reg[1]);
+        } else {
+            read(kRax, decoded.reg[0]);
+            read(kR8, decoded.reg[1]);
+            emitter.operate(host_operation(opcode), kRax, kR8);
+            write(decoded.reg[2]);
+        }
+        emitter.add_to_memory(kRcx, frame.pc, length);
+    }
+
+    emitter.add_to_memory(kRdx, frame.retired, std::int8_t{1});
+    emitter.add_to_memory(kRdx, frame.unsettled, std::int8_t{1});
+    emitter.store_constant(kRdx, frame.last_record, address_of(&record));
+    emitter.load(kRax, kRcx, frame.cycles);
+    emitter.operate_immediate(kHostAdd, kRax, kCycleCosts[opcode]);
+    emitter.store(kRcx, frame.cycles, kRax);
+    emitter.compare_with_memory(kRax, kRdx, frame.cycle_stop);
+    exits.push_back(emitter.jump_if(kAboveOrEqual));
+}
+
+#endif  // MAIZE_V2_JIT_BACKEND
+
+// Primitive 6: retarget the rel32 field at `site` to `destination`. Outside the backend guard
+// because the block table calls it unconditionally; without a backend no block is ever emitted,
+// so it is never reached.
+void patch(std::uint8_t* site, const std::uint8_t* destination) {
+    const std::int64_t relative = destination - (site + 4);
+    const std::uint32_t field = static_cast<std::uint32_t>(static_cast<std::int32_t>(relative));
+    std::memcpy(site, &field, 4);
+}
+
+}  // namespace
+
+// The code arena. Never writable and executable at once: the whole arena flips between the two,
+// writable while a block is emitted or an edge is patched and executable otherwise. The
+// instruction-cache flush is a no-op on x86-64 and stays anyway, for the backend that is not.
+struct JitV2::Arena {
+    std::uint8_t* base = nullptr;
+    std::size_t size = 0;
+    std::size_t used = 0;
+    bool executable = false;
+
+    Arena() = default;
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    ~Arena() {
+#if MAIZE_V2_JIT_BACKEND
+        if (base != nullptr) {
+#ifdef _WIN32
+            VirtualFree(base, 0, MEM_RELEASE);
+#else
+            munmap(base, size);
+#endif
+        }
+#endif
+    }
+
+    bool map(std::size_t bytes) {
+#if MAIZE_V2_JIT_BACKEND
+#ifdef _WIN32
+        base = static_cast<std::uint8_t*>(
+            VirtualAlloc(nullptr, bytes, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE));
+#else
+        void* mapped =
+            mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        base = mapped == MAP_FAILED ? nullptr : static_cast<std::uint8_t*>(mapped);
+#endif
+        if (base == nullptr) {
+            return false;
+        }
+        size = bytes;
+        return true;
+#else
+        (void)bytes;
+        return false;
+#endif
+    }
+
+    void set_executable(bool value) {
+#if MAIZE_V2_JIT_BACKEND
+        if (base == nullptr || executable == value) {
+            return;
+        }
+#ifdef _WIN32
+        DWORD previous = 0;
+        VirtualProtect(base, size, value ? PAGE_EXECUTE_READ : PAGE_READWRITE, &previous);
+        if (value) {
+            FlushInstructionCache(GetCurrentProcess(), base, size);
+        }
+#else
+        mprotect(base, size, value ? (PROT_READ | PROT_EXEC) : (PROT_READ | PROT_WRITE));
+#if defined(__GNUC__) || defined(__clang__)
+        if (value) {
+            __builtin___clear_cache(reinterpret_cast<char*>(base),
+                                    reinterpret_cast<char*>(base + size));
+        }
+#endif
+#endif
+        executable = value;
+#else
+        (void)value;
+#endif
+    }
+};
+
+// A direct exit from a block. Unchained, its jump lands on the block's own return; chained, it
+// lands on the successor's first byte.
+struct JitV2::Edge {
+    std::uint8_t* site = nullptr;  // the jump's rel32 field
+    std::uint8_t* stub = nullptr;  // the owning block's return
+    std::uint64_t target_key = 0;  // the successor's physical entry address
+    Block* target = nullptr;       // non-null exactly while chained
+};
+
+struct JitV2::Block {
+    std::uint64_t key = 0;           // physical address of the first instruction
+    std::uint64_t generation = 0;    // the page's write generation when it was decoded
+    std::uint64_t virtual_page = 0;  // the page the records' addresses are on
+    std::vector<PredecodedV2> records;
+    std::vector<Edge> edges;       // at most two: the fall-through and the direct target
+    std::vector<Edge*> incoming;   // other blocks' edges chained into this one
+    std::uint8_t* code = nullptr;
+};
+
+JitV2::JitV2(InterpreterV2& machine, const JitOptionsV2& options)
+    : machine_(machine), options_(options), arena_(std::make_unique<Arena>()) {
+    active_ = kHasBackend && arena_->map(options_.cache_bytes);
+}
+
+JitV2::~JitV2() = default;
+
+// The host call for every covered instruction the templates leave alone but a store. The
+// record's handler is the one the interpreter's loop would call for it, and its addresses are
+// the live page's (rebase()).
+//
+// The instruction's cycles are charged here as cycle() charges them (user-022), and a cycle
+// limit it reaches leaves the block after it, which is the boundary run() stops at without the
+// JIT. An instruction that walked the page tables moved cycles() by more than its charge, so
+// the templates' stop is worked out again after it.
+std::uint64_t JitV2::run_instruction(JitV2* jit, const PredecodedV2* record) {
+    InterpreterV2& machine = jit->machine_;
+    ++jit->retired_;
+    ++jit->unsettled_;
+    machine.cycles_ += kCycleCosts[record->instruction.opcode];
+    jit->last_record_ = record;
+    if (record->handler(machine, *record) != CycleV2::Advanced) {
+        jit->stopped_ = true;
+        return 0;
+    }
+    if (machine.cycle_limit_ == 0) {
+        return 1;
+    }
+    jit->update_cycle_stop();
+    return machine.cycle_limit_reached() ? 0u : 1u;
+}
+
+// A store, which additionally leaves the block when it wrote the block's own page. The
+// instructions after it in this block may be the bytes it just changed.
+std::uint64_t JitV2::run_store(JitV2* jit, const PredecodedV2* record, Block* block) {
+    if (run_instruction(jit, record) == 0) {
+        return 0;
+    }
+    return jit->machine_.memory_.page_generation(block->key) == block->generation ? 1u : 0u;
+}
+
+// The chained boundary. Everything step() and dispatch() check at a boundary is checked here,
+// in the same order, before the jump to the successor is allowed: the settled clock, the device
+// sample, a deliverable interrupt, the step budget and the device deadline. A decline costs
+// nothing but a trip through the dispatcher, which asks the same questions again.
+std::uint64_t JitV2::take_edge(JitV2* jit, Block* block, std::uint64_t index) {
+    Edge& edge = block->edges[static_cast<std::size_t>(index)];
+    InterpreterV2& machine = jit->machine_;
+    if (edge.target == nullptr || jit->options_.check) {
+        return 0;
+    }
+    if ((machine.pc_ >> MemoryV2::kPageShift) != jit->entry_page_ ||
+        (machine.pc_ & kPageOffsetMask) != (edge.target_key & kPageOffsetMask)) {
+        return 0;
+    }
+    Block& target = *edge.target;
+    if (machine.memory_.page_generation(target.key) != target.generation) {
+        return 0;
+    }
+
+    jit->settle();
+    machine.sample_device_interrupts();
+    if (machine.deliverable_interrupt() != CsrFileV2::kNoCause) {
+        return 0;
+    }
+    if (jit->budget_ != 0 && jit->retired_ >= jit->budget_) {
+        return 0;
+    }
+    const std::uint64_t remaining = jit->budget_ == 0 ? 0 : jit->budget_ - jit->retired_;
+    if (!jit->admissible(static_cast<unsigned>(target.records.size()), remaining)) {
+        return 0;
+    }
+    jit->rebase(target);
+    ++jit->stats_.chained_entries;
+    return 1;
+}
+
+// May a block of `count` instructions run from this boundary? Within the budget, and short
+// enough that no boundary inside it could have seen a device line change: the next device event
+// `delay` nanoseconds away is sampled at the first boundary at or after it, which is after
+// ceil(delay / kNanosecondsPerInstruction) instructions, and the first instruction always runs
+// because the boundary before it has just been sampled.
+bool JitV2::admissible(unsigned count, std::uint64_t budget) const {
+    if (budget != 0 && count > budget) {
+        return false;
+    }
+    std::uint64_t delay = 0;
+    if (machine_.devices_.nanoseconds_until_next_device_event(delay)) {
+        std::uint64_t span = (delay + kNanosecondsPerInstruction - 1) / kNanosecondsPerInstruction;
+        if (span == 0) {
+            span = 1;
+        }
+        if (count > span) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Move a block's records to the page the run entered on, when it last ran on another. Only the
+// handlers read a record's addresses, to advance or to capture a trap's program counter; the
+// templates add to the live program counter, and are the same code on any page.
+void JitV2::rebase(Block& block) {
+    if (block.virtual_page == entry_page_) {
+        return;
+    }
+    for (PredecodedV2& record : block.records) {
+        DecodedV2& decoded = record.instruction;
+        decoded.pc = (entry_page_ << MemoryV2::kPageShift) | (decoded.pc & kPageOffsetMask);
+        decoded.next_pc = decoded.pc + decoded.length;
+    }
+    block.virtual_page = entry_page_;
+}
+
+// The charged cycles at which the machine's cycles() reaches its limit, given the walks made so
+// far, which the templates never add to.
+void JitV2::update_cycle_stop() {
+    if (machine_.cycle_limit_ == 0) {
+        cycle_stop_ = ~std::uint64_t{0};
+        return;
+    }
+    const std::uint64_t walked = machine_.cycles() - machine_.cycles_;
+    cycle_stop_ = machine_.cycle_limit_ > walked ? machine_.cycle_limit_ - walked : 0;
+}
+
+// The result step() would have reported for the instruction retired last.
+StepResult JitV2::last_result() const {
+    if (stopped_) {
+        return machine_.stopped_;
+    }
+    return InterpreterV2::advanced_result(last_record_->instruction.opcode,
+                                          last_record_->instruction.pc);
+}
+
+// Hand the machine the step count and the clock time of everything retired since the last
+// settle. step() does both per instruction; admissible() is what makes doing them per block
+// indistinguishable.
+//
+// Host events are polled here as the interpreter's settle polls them (user-017), so a chain of
+// blocks that never returns to the dispatcher still sees a byte arrive at its next edge.
+void JitV2::settle() {
+    if (unsettled_ == 0) {
+        return;
+    }
+    machine_.steps_taken_ += unsettled_;
+    machine_.devices_.advance_time(unsettled_ * kNanosecondsPerInstruction);
+    machine_.devices_.poll_host_events();
+    unsettled_ = 0;
+}
+
+bool JitV2::dispatch(std::uint64_t budget, std::uint64_t& advanced, StepResult& result) {
+    if (!active_) {
+        return false;
+    }
+    InterpreterV2& machine = machine_;
+
+    // The fetch is translated through the interpreter's own fetch window and never walked for
+    // (user-022): a page the translator does not hold is walked for by the step() this declines
+    // to, once, so the walks a run makes, and the cycles they cost, are the same with the JIT as
+    // without it. A fetch that fails is declined before anything else is asked, so a fetch fault
+    // still beats an interrupt because it is step() that reaches both.
+    const std::uint64_t root = machine.csr_.host_read(csr::kPagingRoot);
+    const TranslationResult fetch = machine.translate_fetch(root, machine.privilege(), false);
+    if (!fetch.ok || !machine.memory_.accessible(fetch.physical)) {
+        return false;
+    }
+
+    const std::uint64_t key = fetch.physical;
+    Block* block = nullptr;
+    if (const auto found = table_.find(key); found != table_.end()) {
+        block = found->second.get();
+        if (machine.memory_.page_generation(key) != block->generation) {
+            invalidate_page(key >> MemoryV2::kPageShift);
+            block = nullptr;
+        }
+    }
+    if (block == nullptr) {
+        if (hotness_.size() >= kMaxHotnessEntries) {
+            age_hotness();
+        }
+        std::uint32_t& count = hotness_[key];
+        if (count == kNeverCompile || ++count < options_.hotness) {
+            return false;
+        }
+        block = compile(key);
+        if (block == nullptr) {
+            count = kNeverCompile;
+            return false;
+        }
+        hotness_.erase(key);
+    }
+
+    // A block is about to run, so the boundary is opened as step() opens it, from a settled
+    // clock, since the block keeps a clock of its own from here. Only here: the interpreted
+    // instructions before it settle at their deadline, as cycle() settles them. Sampling twice
+    // at one boundary, once here and once in the step() that runs when this declines, writes the
+    // same pending bits twice, and settling early hands the devices the same time in two pieces.
+    machine.settle_time();
+    machine.sample_device_interrupts();
+    if (machine.deliverable_interrupt() != CsrFileV2::kNoCause) {
+        return false;
+    }
+    if (!admissible(static_cast<unsigned>(block->records.size()), budget)) {
+        return false;
+    }
+
+    retired_ = 0;
+    unsettled_ = 0;
+    budget_ = budget;
+    entry_page_ = machine.pc_ >> MemoryV2::kPageShift;
+    last_record_ = nullptr;
+    stopped_ = false;
+    update_cycle_stop();
+    rebase(*block);
+    if (options_.check) {
+        if (!run_checked(*block)) {
+            return false;
+        }
+    } else {
+        reinterpret_cast<void (*)()>(block->code)();
+        last_ = last_result();
+    }
+    settle();
+
+    ++stats_.block_runs;
+    stats_.instructions += retired_;
+    result = last_;
+    advanced = retired_ - (last_.status == StepStatus::Advanced ? 0u : 1u);
+    return true;
+}
+
+// Decode a block from physical memory, starting at `key`, and emit it. Null when the entry does
+// not start a block worth compiling, which the caller remembers.
+JitV2::Block* JitV2::compile(std::uint64_t key) {
+    MemoryV2& memory = machine_.memory_;
+    auto block = std::make_unique<Block>();
+    block->key = key;
+    // Read the generation before watching, as the predecode cache does, so the first write from
+    // here on moves the page past the generation recorded.
+    block->generation = memory.page_generation(key);
+    block->virtual_page = key >> MemoryV2::kPageShift;
+
+    std::uint64_t physical = key;
+    while (block->records.size() < kMaxBlockInstructions) {
+        const DecodeResult decoded = decode_v2(memory, physical);
+        if (decoded.status != DecodeStatus::Ok || !covered(decoded.instruction.opcode)) {
+            break;
+        }
+        // Every byte on the entry's page, so the entry's fetch translation answers for it.
+        if ((physical & kPageOffsetMask) + decoded.instruction.length > MemoryV2::kPageBytes) {
+            break;
+        }
+        block->records.push_back(PredecodedV2{
+            decoded.instruction, InterpreterV2::handler_for(decoded.instruction.opcode)});
+        physical += decoded.instruction.length;
+        if (ends_basic_block(decoded.instruction.opcode) || (physical & kPageOffsetMask) == 0) {
+            break;
+        }
+    }
+    if (block->records.empty()) {
+        return nullptr;
+    }
+
+    if (options_.inject_miscompile) {
+        for (PredecodedV2& record : block->records) {
+            if (record.instruction.opcode == op::kAddImm) {
+                record.instruction.immediate[0] += 1;
+                break;
+            }
+        }
+    }
+
+    // The direct exits, as physical entry keys. A target is chained only when it is on this
+    // page: virtual and physical offsets agree within a page, so "the same physical page" and
+    // "the same virtual page" are one test here.
+    const DecodedV2& last = block->records.back().instruction;
+    const std::uint64_t page = key >> MemoryV2::kPageShift;
+    std::vector<std::uint64_t> targets;
+    const bool branch = is_branch(last.opcode);
+    if (!ends_basic_block(last.opcode) || branch) {
+        targets.push_back(physical);
+    }
+    if (branch || last.opcode == op::kJumpDisp || last.opcode == op::kCallDisp) {
+        const std::uint64_t target = physical + sign_extend(last.immediate[0], 32);
+        if (targets.empty() || targets.front() != target) {
+            targets.push_back(target);
+        }
+    }
+    for (const std::uint64_t target : targets) {
+        if ((target >> MemoryV2::kPageShift) == page) {
+            Edge edge;
+            edge.target_key = target;
+            block->edges.push_back(edge);
+        }
+    }
+
+    arena_->set_executable(false);
+    if (!emit(*block)) {
+        flush();
+        if (!emit(*block)) {
+            arena_->set_executable(true);
+            return nullptr;
+        }
+    }
+    memory.watch_page(key);
+
+    Block* compiled = block.get();
+    table_[key] = std::move(block);
+    code_pages_[page].push_back(key);
+    ++stats_.blocks_compiled;
+
+    // Chain both ways: edges that were waiting for this entry, and this block's own edges to
+    // whatever is already compiled. --jit-check never chains, so every block is checked.
+    if (!options_.check) {
+        const auto waiting = pending_.find(key);
+        if (waiting != pending_.end()) {
+            for (Edge* edge : waiting->second) {
+                patch(edge->site, compiled->code);
+                edge->target = compiled;
+                compiled->incoming.push_back(edge);
+            }
+            pending_.erase(waiting);
+        }
+        for (Edge& edge : compiled->edges) {
+            const auto found = table_.find(edge.target_key);
+            if (found != table_.end() &&
+                memory.page_generation(edge.target_key) == found->second->generation) {
+                patch(edge.site, found->second->code);
+                edge.target = found->second.get();
+                found->second->incoming.push_back(&edge);
+            } else {
+                pending_[edge.target_key].push_back(&edge);
+            }
+        }
+    }
+    arena_->set_executable(true);
+    return compiled;
+}
+
+// Lay a block out in the arena:
+//
+//     for each instruction:  its template, leaving for the return at the cycle stop; or
+//                            call run_instruction or run_store; skip to the return on zero
+//     for each edge:         call take_edge; skip to the next edge on zero; jmp (patchable)
+//     return:                ret
+//
+// A run of templates loads the machine's address into rcx and the JIT's into rdx once, and a
+// call, which may clobber both, makes the next template load them again. The arena is writable
+// when this runs. False, with nothing consumed, when the block does not fit.
+bool JitV2::emit(Block& block) {
+#if MAIZE_V2_JIT_BACKEND
+    Emitter emitter(arena_->base + arena_->used, arena_->base + arena_->size);
+    std::uint8_t* const entry = emitter.cursor();
+
+    TemplateFrame frame;
+    frame.registers = offset_in(machine_, *machine_.registers_.host_file());
+    frame.pc = offset_in(machine_, machine_.pc_);
+    frame.cycles = offset_in(machine_, machine_.cycles_);
+    frame.retired = offset_in(*this, retired_);
+    frame.unsettled = offset_in(*this, unsettled_);
+    frame.last_record = offset_in(*this, last_record_);
+    frame.cycle_stop = offset_in(*this, cycle_stop_);
+
+    std::vector<std::uint8_t*> exits;
+    std::vector<std::pair<std::uint8_t*, std::uint8_t*>> links;
+    bool frame_loaded = false;
+    for (const PredecodedV2& record : block.records) {
+        if (templated(record.instruction)) {
+            if (!frame_loaded) {
+                emitter.move_immediate(kRcx, address_of(&machine_));
+                emitter.move_immediate(kRdx, address_of(this));
+                frame_loaded = true;
+            }
+            emit_template(emitter, frame, record, exits, links);
+            continue;
+        }
+        if (is_store(record.instruction.opcode)) {
+            emitter.call(address_of(&JitV2::run_store),
+                         {address_of(this), address_of(&record), address_of(&block)});
+        } else {
+            emitter.call(address_of(&JitV2::run_instruction),
+                         {address_of(this), address_of(&record)});
+        }
+        exits.push_back(emitter.skip_if_zero());
+        frame_loaded = false;
+    }
+
+    std::vector<std::uint8_t*> declines;
+    std::vector<std::uint8_t*> edge_starts;
+    for (std::size_t i = 0; i < block.edges.size(); ++i) {
+        edge_starts.push_back(emitter.cursor());
+        emitter.call(address_of(&JitV2::take_edge),
+                     {address_of(this), address_of(&block), static_cast<std::uint64_t>(i)});
+        declines.push_back(emitter.skip_if_zero());
+        block.edges[i].site = emitter.jump();
+    }
+    std::uint8_t* const stub = emitter.cursor();
+    emitter.ret();
+    if (emitter.overflowed()) {
+        return false;
+    }
+
+    for (std::uint8_t* site : exits) {
+        patch(site, stub);
+    }
+    for (const auto& [site, destination] : links) {
+        patch(site, destination);
+    }
+    for (std::size_t i = 0; i < block.edges.size(); ++i) {
+        patch(declines[i], i + 1 < block.edges.size() ? edge_starts[i + 1] : stub);
+        patch(block.edges[i].site, stub);
+        block.edges[i].stub = stub;
+    }
+    block.code = entry;
+    arena_->used += static_cast<std::size_t>(emitter.cursor() - entry);
+    return true;
+#else
+    (void)block;
+    return false;
+#endif
+}
+
+// Drop every block, as v1 did on overflow. Nothing is running: this is only reached from
+// compile(), which only the dispatcher calls.
+void JitV2::flush() {
+    table_.clear();
+    pending_.clear();
+    code_pages_.clear();
+    arena_->used = 0;
+    ++stats_.flushes;
+}
+
+// Make room among the tier-up counters without forgetting what is warming up. An entry seen once
+// since the last pass is dropped and every other count is halved, so a flood of entries that are
+// never seen again empties the map while a loop head keeps most of its count, and one that stops
+// being reached is gone after a few passes. An entry that does not start a compilable block is
+// kept as it is, since forgetting it would only have the dispatcher try again.
+void JitV2::age_hotness() {
+    for (auto entry = hotness_.begin(); entry != hotness_.end();) {
+        std::uint32_t& count = entry->second;
+        if (count == kNeverCompile) {
+            ++entry;
+        } else if (count <= 1) {
+            entry = hotness_.erase(entry);
+        } else {
+            count /= 2;
+            ++entry;
+        }
+    }
+}
+
+// Drop every block on a physical page whose generation has moved. Their code stays in the arena
+// until the next flush, unreachable once every edge into it is pointed back at its own return.
+void JitV2::invalidate_page(std::uint64_t page) {
+    const auto found = code_pages_.find(page);
+    if (found == code_pages_.end()) {
+        return;
+    }
+    const std::vector<std::uint64_t> keys = std::move(found->second);
+    code_pages_.erase(found);
+
+    arena_->set_executable(false);
+    for (const std::uint64_t key : keys) {
+        const auto block = table_.find(key);
+        if (block == table_.end()) {
+            continue;
+        }
+        forget(*block->second);
+        table_.erase(block);
+        ++stats_.invalidations;
+    }
+    arena_->set_executable(true);
+}
+
+// Unlink a block both ways. Incoming edges go back to their own returns and wait in pending_ for
+// the entry to be compiled again; outgoing edges leave whichever list they were on. Incoming goes
+// first so a block's edge into itself is parked and then removed again, rather than left behind.
+void JitV2::forget(Block& block) {
+    for (Edge* edge : block.incoming) {
+        patch(edge->site, edge->stub);
+        edge->target = nullptr;
+        pending_[block.key].push_back(edge);
+    }
+    block.incoming.clear();
+    for (Edge& edge : block.edges) {
+        if (edge.target != nullptr) {
+            std::vector<Edge*>& incoming = edge.target->incoming;
+            std::erase(incoming, &edge);
+            continue;
+        }
+        const auto waiting = pending_.find(edge.target_key);
+        if (waiting != pending_.end()) {
+            std::erase(waiting->second, &edge);
+            if (waiting->second.empty()) {
+                pending_.erase(waiting);
+            }
+        }
+    }
+}
+
+// --jit-check. Run the compiled block with every store journaled, take the state it produced,
+// put the machine back, run the same number of instructions through decode_v2 and execute(), and
+// compare the two. The interpreter's run is the one that stands, whatever the comparison says,
+// so a miscompile reported here never reaches the guest.
+//
+// The clock and the step count are not compared because neither has moved: both are settled by
+// the dispatcher after this returns, from the interpreter's count. The cycles the compiled run
+// charged are put back with the rest, and the interpreter's run charges its own (user-022).
+bool JitV2::run_checked(Block& block) {
+    InterpreterV2& machine = machine_;
+    MemoryV2& memory = machine.memory_;
+
+    const RegistersV2 registers_before = machine.registers_;
+    const CsrFileV2 csr_before = machine.csr_;
+    const TranslatorV2 translator_before = machine.translator_;
+    const std::uint64_t pc_before = machine.pc_;
+    const bool halted_before = machine.halted_;
+    const std::uint64_t cycles_before = machine.cycles_;
+
+    std::vector<StoreJournalEntryV2> journal;
+    machine.store_journal_ = &journal;
+    reinterpret_cast<void (*)()>(block.code)();
+    machine.store_journal_ = nullptr;
+
+    const std::uint64_t compiled_retired = retired_;
+    const StepResult compiled_last = last_result();
+    const RegistersV2 compiled_registers = machine.registers_;
+    const CsrFileV2 compiled_csr = machine.csr_;
+    const std::uint64_t compiled_pc = machine.pc_;
+    const bool compiled_halted = machine.halted_;
+    std::unordered_map<std::uint64_t, std::uint8_t> compiled_bytes;
+    for (const StoreJournalEntryV2& entry : journal) {
+        compiled_bytes[entry.physical] = memory.read_byte(entry.physical);
+    }
+
+    for (auto entry = journal.rbegin(); entry != journal.rend(); ++entry) {
+        memory.write_byte(entry->physical, entry->previous);
+    }
+    machine.registers_ = registers_before;
+    machine.csr_ = csr_before;
+    machine.translator_ = translator_before;
+    machine.pc_ = pc_before;
+    machine.halted_ = halted_before;
+    machine.cycles_ = cycles_before;
+
+    std::vector<StoreJournalEntryV2> oracle_journal;
+    machine.store_journal_ = &oracle_journal;
+    std::uint64_t oracle_retired = 0;
+    StepResult oracle_last;
+    bool decoded_all = true;
+    const std::uint64_t root = machine.csr_.host_read(csr::kPagingRoot);
+    while (oracle_retired < compiled_retired) {
+        const FetchSourceV2 source(memory, machine.translator_, root, machine.privilege());
+        const DecodeResult decoded = decode_v2(source, machine.pc_);
+        if (decoded.status != DecodeStatus::Ok) {
+            decoded_all = false;
+            break;
+        }
+        ++oracle_retired;
+        machine.cycles_ += kCycleCosts[decoded.instruction.opcode];
+        oracle_last = machine.execute_to_result(decoded.instruction);
+        if (oracle_last.status != StepStatus::Advanced) {
+            break;
+        }
+    }
+    machine.store_journal_ = nullptr;
+    ++stats_.checked_blocks;
+
+    char detail[160] = {};
+    if (!decoded_all) {
+        std::snprintf(detail, sizeof(detail),
+                      "the interpreter could not decode the instruction at $%016" PRIX64,
+                      machine.pc_);
+    } else if (oracle_retired != compiled_retired || oracle_last.status != compiled_last.status) {
+        std::snprintf(detail, sizeof(detail),
+                      "the compiled block stopped after %" PRIu64
+                      " instructions and the interpreter after %" PRIu64,
+                      compiled_retired, oracle_retired);
+    } else if (machine.pc_ != compiled_pc || machine.halted_ != compiled_halted) {
+        std::snprintf(detail, sizeof(detail),
+                      "pc is $%016" PRIX64 " compiled and $%016" PRIX64 " interpreted",
+                      compiled_pc, machine.pc_);
+    }
+    for (unsigned n = 1; detail[0] == '\0' && n < kRegisterCount; ++n) {
+        if (compiled_registers.raw(n) != machine.registers_.raw(n)) {
+            std::snprintf(detail, sizeof(detail),
+                          "r%u is $%016" PRIX64 " compiled and $%016" PRIX64 " interpreted", n,
+                          compiled_registers.raw(n), machine.registers_.raw(n));
+        }
+    }
+    for (const std::uint16_t number : kCheckedCsrs) {
+        if (detail[0] != '\0') {
+            break;
+        }
+        if (compiled_csr.host_read(number) != machine.csr_.host_read(number)) {
+            std::snprintf(detail, sizeof(detail),
+                          "csr $%04X is $%016" PRIX64 " compiled and $%016" PRIX64 " interpreted",
+                          number, compiled_csr.host_read(number), machine.csr_.host_read(number));
+        }
+    }
+    // A byte only one of the two runs wrote still has to agree: the run that did not write it
+    // left the byte as it found it, which is the oldest journaled value of the run that did.
+    std::unordered_map<std::uint64_t, std::uint8_t> original;
+    for (auto entry = oracle_journal.rbegin(); entry != oracle_journal.rend(); ++entry) {
+        original[entry->physical] = entry->previous;
+    }
+    for (const StoreJournalEntryV2& entry : oracle_journal) {
+        if (detail[0] != '\0') {
+            break;
+        }
+        const auto compiled = compiled_bytes.find(entry.physical);
+        const std::uint8_t expected =
+            compiled != compiled_bytes.end() ? compiled->second : original[entry.physical];
+        if (memory.read_byte(entry.physical) != expected) {
+            std::snprintf(detail, sizeof(detail),
+                          "byte $%016" PRIX64 " is $%02X compiled and $%02X interpreted",
+                          entry.physical, expected, memory.read_byte(entry.physical));
+        }
+    }
+    for (const auto& [physical, value] : compiled_bytes) {
+        if (detail[0] != '\0') {
+            break;
+        }
+        if (original.find(physical) == original.end() && memory.read_byte(physical) != value) {
+            std::snprintf(detail, sizeof(detail),
+                          "byte $%016" PRIX64 " is $%02X compiled and $%02X interpreted",
+                          physical, value, memory.read_byte(physical));
+        }
+    }
+
+    if (detail[0] != '\0') {
+        char report[256];
+        std::snprintf(report, sizeof(report),
+                      "compiled block at $%016" PRIX64 " (physical $%016" PRIX64 "): %s",
+                      pc_before, block.key, detail);
+        check_failure_ = report;
+        active_ = false;
+    }
+
+    retired_ = oracle_retired;
+    unsettled_ = oracle_retired;
+    last_ = oracle_last;
+    return oracle_retired != 0;
+}
+
+}  // namespace maize::v2
@@ -0,0 +1,191 @@
+// jit_v2.h (user-002): the tier-1 template JIT, ported from v1's src/jit.inl to InterpreterV2.
+//
+// A hot basic block is compiled to a straight run of host code, one template per guest
+// instruction. The moves, the register and immediate arithmetic and logic that cannot trap, the
+// compares and the conditional branches are emitted inline: a handful of host instructions that
+// read and write the register file in place, move the program counter by the instruction's
+// length, and retire it. Everything else in a block, the loads and stores above all, is a host
+// call straight into the interpreter's predecoded handler for that opcode (predecode_v2.h), the
+// same handler the interpreter's own loop calls, so the one copy of the memory, translation and
+// trap semantics there is stays the interpreter's. What the JIT removes is the per-instruction
+// boundary work, which is the device sample, the fetch translation, the decode or predecode
+// lookup, and the clock, and for a templated instruction the dispatch too; it removes the
+// boundary work only where the machine can prove nothing would have been noticed at those
+// boundaries anyway. A template is checked against the interpreter the way the rest is, by
+// --jit-check and by fixtures_jit.cpp, which run both and compare.
+//
+// THE HOST BACKEND IS v1's SIX PRIMITIVES AND THE TEMPLATES' INSTRUCTIONS: call a function with
+// up to four constant arguments, return to the dispatcher, skip forward when the last call
+// returned zero, a patchable jump, a store of a constant, and patching a jump, plus the loads,
+// stores, arithmetic, compares and conditional jumps on x86-64's general registers that the
+// templates are written in. Everything else (block discovery, the block table, chaining and
+// unlinking, store-driven invalidation, the differential check, the W^X arena) is host-neutral
+// C++ in jit_v2.cpp. A host without a backend builds and runs; enable_jit() on it leaves the
+// machine interpreted and says so.
+//
+// WHAT IS DIFFERENT FROM V1, because v2 is a different machine:
+//
+//   - KEYED BY PHYSICAL ENTRY ADDRESS, for the reason predecode_v2.h gives. The fetch
+//     translation of a block's entry is still made at every dispatch under the live paging root
+//     and privilege, so a non-executable page faults through step() exactly as before, and a
+//     block never spans a page, so the entry's translation answers for every byte in it. A
+//     block's records carry the virtual addresses of the page it last ran on, and are moved to
+//     another page's when it is entered under a different mapping; the templates only ever add
+//     to the program counter, so they need no moving.
+//   - NO FLAGS. v2 is flagless, so there is no lazy-flag materialization at block exits and the
+//     templates need nothing v1's did to keep condition codes coherent.
+//   - TIME IS SETTLED IN BULK, and a block is admitted only when that is invisible. A block of N
+//     instructions runs when the next device event is at least N-1 instruction-times away, which
+//     is exactly the condition under which no boundary inside the block could have sampled a
+//     newly asserted line; the clock then advances by N instruction-times in one call, which
+//     device_v2.h's timer treats identically to N calls because at most one expiry fits.
+//   - CHAINING STAYS ON ONE PAGE. A direct successor on the block's own page is chained with a
+//     patched jump; anything else returns to the dispatcher, which translates the fetch again.
+//     Every chained entry re-runs the boundary checks (device sample, deliverable interrupt, step
+//     budget, device deadline) in a host call before the jump is taken.
+//   - STORES INVALIDATE THROUGH MemoryV2's PAGE GENERATIONS, the same watch user-001 introduced
+//     for the predecode cache. A compiled store re-reads its own block's page generation and
+//     returns to the dispatcher if the store moved it, so a block that patches the instruction
+//     after itself never runs the stale compile of it.
+//
+// --jit-check runs every compiled block, rolls the machine back, runs the same instructions
+// through the interpreter, and compares. A divergence is reported with the first register or
+// byte that differs, the JIT turns itself off, and the interpreter's state stands.
+
+#ifndef MAIZE_V2_JIT_V2_H
+#define MAIZE_V2_JIT_V2_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "decode_v2.h"
+#include "interpreter_v2.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define MAIZE_V2_JIT_BACKEND 1
+#define MAIZE_V2_JIT_BACKEND_NAME "x86-64"
+#else
+#define MAIZE_V2_JIT_BACKEND 0
+#define MAIZE_V2_JIT_BACKEND_NAME "none"
+#endif
+
+namespace maize::v2 {
+
+struct JitOptionsV2 {
+    // --jit-cache-mb. Overflow flushes the whole cache, as v1 did; a working set that does not
+    // fit recompiles, which costs time and nothing else.
+    std::size_t cache_bytes = std::size_t{16} << 20;
+    // Times a block entry is reached before it is compiled. v1's docs/design/jit.md section 2 number.
+    std::uint32_t hotness = 50;
+    // --jit-check: verify every compiled block against the interpreter, and disable chaining
+    // so every block comes back through the check.
+    bool check = false;
+    // Deliberately corrupt the first add-immediate of every block, so a fixture can prove the
+    // differential check catches a miscompile. Never set by mzvm.
+    bool inject_miscompile = false;
+};
+
+// Host-visible only, like the translation cache's counters.
+struct JitStatsV2 {
+    std::uint64_t blocks_compiled = 0;
+    std::uint64_t block_runs = 0;       // dispatcher entries that ran compiled code
+    std::uint64_t chained_entries = 0;  // block-to-block transfers that skipped the dispatcher
+    std::uint64_t instructions = 0;     // instructions retired by compiled code
+    std::uint64_t invalidations = 0;    // blocks dropped because their page was written
+    std::uint64_t flushes = 0;          // whole-cache flushes on arena overflow
+    std::uint64_t checked_blocks = 0;   // --jit-check comparisons made
+};
+
+class JitV2 {
+  public:
+    static constexpr bool kHasBackend = MAIZE_V2_JIT_BACKEND != 0;
+    // A block ends after this many instructions even when the next one is covered, so one
+    // block's worst case stays small next to a timer deadline.
+    static constexpr unsigned kMaxBlockInstructions = 64;
+
+    JitV2(InterpreterV2& machine, const JitOptionsV2& options);
+    ~JitV2();
+
+    JitV2(const JitV2&) = delete;
+    JitV2& operator=(const JitV2&) = delete;
+
+    // False when this host has no backend, when the code arena could not be mapped, or after
+    // --jit-check found a divergence. An inactive JIT declines every dispatch.
+    bool active() const { return active_; }
+
+    // Run compiled code at the machine's program counter, if the block there is compiled and
+    // may run now. Returns false, having changed nothing a guest could observe, when the
+    // interpreter should take the next step instead. Returns true having retired at least one
+    // instruction: `advanced` counts those that completed as StepStatus::Advanced, and `result`
+    // is the last instruction's result, which is the stopping one when it is not Advanced.
+    // `budget` is the caller's remaining step budget, zero for none.
+    bool dispatch(std::uint64_t budget, std::uint64_t& advanced, StepResult& result);
+
+    // Empty unless --jit-check found a divergence, in which case it says where and what.
+    const std::string& check_failure() const { return check_failure_; }
+    const JitStatsV2& stats() const { return stats_; }
+    const JitOptionsV2& options() const { return options_; }
+
+  private:
+    struct Arena;
+    struct Edge;
+    struct Block;
+
+    // The host-call targets the emitted code makes. Static so their addresses are plain
+    // function pointers, and members so they reach the interpreter's private execute path
+    // through the friendship InterpreterV2 grants this class.
+    static std::uint64_t run_instruction(JitV2* jit, const PredecodedV2* record);
+    static std::uint64_t run_store(JitV2* jit, const PredecodedV2* record, Block* block);
+    static std::uint64_t take_edge(JitV2* jit, Block* block, std::uint64_t index);
+
+    Block* compile(std::uint64_t key);
+    bool emit(Block& block);
+    void flush();
+    void age_hotness();
+    void invalidate_page(std::uint64_t page);
+    void forget(Block& block);
+    bool admissible(unsigned count, std::uint64_t budget) const;
+    void rebase(Block& block);
+    void update_cycle_stop();
+    StepResult last_result() const;
+    void settle();
+    bool run_checked(Block& block);
+
+    InterpreterV2& machine_;
+    JitOptionsV2 options_;
+    bool active_ = false;
+    std::unique_ptr<Arena> arena_;
+    std::unordered_map<std::uint64_t, std::unique_ptr<Block>> table_;
+    std::unordered_map<std::uint64_t, std::uint32_t> hotness_;
+    std::unordered_map<std::uint64_t, std::vector<Edge*>> pending_;  // unchained, by target key
+    std::unordered_map<std::uint64_t, std::vector<std::uint64_t>> code_pages_;
+
+    // The run in progress. `unsettled_` is retired instructions whose step count and clock time
+    // have not reached the machine yet; `retired_` is the whole dispatch's count, which the
+    // budget is judged against; `entry_page_` is the virtual page the run entered on, which
+    // every chained block shares. The templates count into the first two in place, and into
+    // `last_record_`, the instruction retired last, whose result is only built when the run
+    // ends; `stopped_` says the last one stopped the run, with its result in the interpreter's
+    // stopped_. `cycle_stop_` is the count of charged cycles a template may not reach: the cycle
+    // limit less the walks' share of cycles(), so the templates compare one word against it, and
+    // the all-ones word with no limit set.
+    std::uint64_t unsettled_ = 0;
+    std::uint64_t retired_ = 0;
+    std::uint64_t budget_ = 0;
+    std::uint64_t entry_page_ = 0;
+    std::uint64_t cycle_stop_ = 0;
+    const PredecodedV2* last_record_ = nullptr;
+    bool stopped_ = false;
+    StepResult last_{};
+
+    std::string check_failure_;
+    JitStatsV2 stats_{};
+};
+
+}  // namespace maize::v2
+
+#endif  // MAIZE_V2_JIT_V2_H
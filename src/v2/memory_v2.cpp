@@ -0,0 +1,443 @@
+// memory_v2.cpp (user-006): the host mapping behind MemoryV2.
+//
+// Everything host-specific about physical memory is here, so memory_v2.h stays the portable
+// description of what memory is. The region is anonymous memory the host zero-fills on first
+// touch: mmap on POSIX hosts, and on Windows address space VirtualAlloc reserves without
+// committing, each page of which commit() below commits when memory_v2.h's watch byte says the
+// page is about to be written, or handed to a host call, for the first time. Committing the
+// whole region up front would charge the host's commit limit for the guest's full size at
+// construction, which is the cost this file exists to avoid. Nothing here zero-fills the region
+// by hand, which is the whole point; the only bytes this file ever clears are the tail of a
+// partial host page a shrink leaves behind.
+
+#include "memory_v2.h"
+
+#include <cstring>
+#include <new>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace maize::v2 {
+namespace {
+
+std::size_t host_page_bytes() {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return static_cast<std::size_t>(info.dwPageSize);
+#else
+    const long page = sysconf(_SC_PAGESIZE);
+    return page > 0 ? static_cast<std::size_t>(page) : std::size_t{4096};
+#endif
+}
+
+// The mapped extent for a populated size: whole host pages, and at least one, so an empty
+// memory still has a base address and every path below can treat the region as mapped.
+std::size_t mapped_extent(std::size_t size) {
+    const std::size_t page = host_page_bytes();
+    if (size == 0) {
+        return page;
+    }
+    if (size > SIZE_MAX - (page - 1)) {
+        throw std::bad_alloc();
+    }
+    return (size + page - 1) / page * page;
+}
+
+#ifdef _WIN32
+// The committed pages among the first `bytes` of a reservation, as [from, to) runs, so a copy
+// of the region need not touch, and so commit, the pages nothing has touched yet.
+template <typename Visit>
+void for_each_committed(const std::uint8_t* base, std::size_t bytes, Visit visit) {
+    for (std::size_t at = 0; at < bytes;) {
+        MEMORY_BASIC_INFORMATION info;
+        if (VirtualQuery(base + at, &info, sizeof(info)) == 0) {
+            return;
+        }
+        const std::size_t region_end =
+            static_cast<std::size_t>(static_cast<const std::uint8_t*>(info.BaseAddress) -
+                                     base) +
+            info.RegionSize;
+        const std::size_t end = region_end < bytes ? region_end : bytes;
+        if (info.State == MEM_COMMIT) {
+            visit(at, end);
+        }
+        at = end;
+    }
+}
+#endif
+
+// A mapping that reads zero throughout. On Windows a `committed` one is committed whole and
+// any other is only reserved, and commit() makes its pages usable as they are needed.
+std::uint8_t* map_zeroed(std::size_t bytes, [[maybe_unused]] bool committed) {
+#ifdef _WIN32
+    const DWORD kind = committed ? MEM_RESERVE | MEM_COMMIT : MEM_RESERVE;
+    void* mapped =
+        VirtualAlloc(nullptr, bytes, kind, committed ? PAGE_READWRITE : PAGE_NOACCESS);
+    if (mapped == nullptr) {
+        throw std::bad_alloc();
+    }
+#else
+    // MAP_NORESERVE where the host has it, so a large memory is not refused up front by a
+    // commit-charge policy for pages the guest may never touch.
+#ifdef MAP_NORESERVE
+    constexpr int kFlags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE;
+#else
+    constexpr int kFlags = MAP_PRIVATE | MAP_ANONYMOUS;
+#endif
+    void* mapped = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, kFlags, -1, 0);
+    if (mapped == MAP_FAILED) {
+        throw std::bad_alloc();
+    }
+#endif
+    return static_cast<std::uint8_t*>(mapped);
+}
+
+// Make [at, at + bytes) of a mapping readable and writable. Only a Windows reservation needs
+// it; every other host commits a page on first touch by itself. Committing a page that already
+// is changes nothing, and a commit the host refuses is out of memory, as a refused map is.
+void commit([[maybe_unused]] std::uint8_t* at, [[maybe_unused]] std::size_t bytes) {
+#ifdef _WIN32
+    if (bytes != 0 && VirtualAlloc(at, bytes, MEM_COMMIT, PAGE_READWRITE) == nullptr) {
+        throw std::bad_alloc();
+    }
+#endif
+}
+
+void unmap(std::uint8_t* base, [[maybe_unused]] std::size_t bytes) {
+    if (base == nullptr) {
+        return;
+    }
+#ifdef _WIN32
+    VirtualFree(base, 0, MEM_RELEASE);
+#else
+    munmap(base, bytes);
+#endif
+}
+
+// Return [from, to) of a mapping to the host, so it reads zero and holds no memory. `from` and
+// `to` are host-page aligned.
+void discard_pages(std::uint8_t* base, std::size_t from, std::size_t to) {
+    if (from >= to) {
+        return;
+    }
+#ifdef _WIN32
+    // Decommitted and left so: the pages come back untouched, and the next write commits a
+    // fresh zero page, as the first did.
+    VirtualFree(base + from, to - from, MEM_DECOMMIT);
+#elif defined(__linux__)
+    // Linux defines a discarded private anonymous page to read zero on its next touch, and
+    // madvise leaves the mapping one piece, which mremap in grow() needs.
+    madvise(base + from, to - from, MADV_DONTNEED);
+#else
+    // Elsewhere madvise's answer for what a discarded page reads back as varies, and a fixed
+    // anonymous mapping over the range replaces its pages with fresh zero pages everywhere.
+    mmap(base + from, to - from, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED,
+         -1, 0);
+#endif
+}
+
+}  // namespace
+
+// One frozen mapping (user-008): the mapping a memory held when it was frozen, read-only by
+// convention from then on and unmapped with the last image that still has a page in it.
+struct MemoryV2::SharedLayer {
+    Mapping bytes{};
+
+    SharedLayer() = default;
+    SharedLayer(const SharedLayer&) = delete;
+    SharedLayer& operator=(const SharedLayer&) = delete;
+    ~SharedLayer() { release(bytes); }
+};
+
+// The pages a clone shares, one level deep whatever the history. Each populated page has a
+// pointer straight at its bytes, in whichever layer holds it, and the index of that layer in
+// `layers`, which keeps every layer a page points into alive and no other. Freezing a memory
+// that already shares an image builds the next image from this one's pointers rather than over
+// it, so a read never walks a chain and a long line of clones of clones holds only the layers
+// its pages are still in.
+struct MemoryV2::SharedImage {
+    std::vector<std::shared_ptr<const SharedLayer>> layers;
+    std::vector<const std::uint8_t*> page_bytes;
+    std::vector<std::uint32_t> page_layer;
+};
+
+MemoryV2::MemoryV2(std::size_t size) {
+    resize_region(size);
+}
+
+MemoryV2::~MemoryV2() {
+    release(bytes_);
+    release(watched_);
+    release(generations_);
+}
+
+void MemoryV2::host_set_size(std::size_t size) {
+    // A shared page a shrink cuts through is copied first, so the part of it below the new size
+    // keeps its bytes when resize_region clears the rest. A shared page wholly above the new
+    // size stops being shared, which is what makes it read zero if it returns.
+    const std::size_t populated = page_count(size);
+    if (size < size_ && (size & (kPageBytes - 1)) != 0 &&
+        (watched_.base[populated - 1] & kWatchShared) != 0u) {
+        copy_shared_page(populated - 1);
+    }
+    resize_region(size);
+    resized_since_freeze_ = image_ != nullptr;
+    std::uint64_t* const generation = generations();
+    for (std::size_t page = 0; page < pages_; ++page) {
+        watched_.base[page] = page < populated
+                                  ? (watched_.base[page] & (kWatchShared | kWatchUntouched))
+                                  : kWatchUntouched;
+        ++generation[page];
+    }
+    // Every populated page is recorded dirty and every dirty flag is now clear, which is the
+    // list's invariant restated for a memory in which nothing can be assumed unchanged.
+    if (dirty_tracking_) {
+        dirty_pages_.clear();
+        for (std::size_t page = 0; page < populated; ++page) {
+            dirty_pages_.push_back(page);
+        }
+    }
+}
+
+void MemoryV2::start_dirty_tracking() {
+    dirty_tracking_ = true;
+    dirty_pages_.clear();
+    const std::size_t populated = page_count(size_);
+    for (std::size_t page = 0; page < populated; ++page) {
+        watched_.base[page] |= kWatchDirty;
+    }
+}
+
+void MemoryV2::clear_dirty_pages() {
+    for (const std::uint64_t page : dirty_pages_) {
+        watched_.base[static_cast<std::size_t>(page)] |= kWatchDirty;
+    }
+    dirty_pages_.clear();
+}
+
+bool MemoryV2::page_is_zero(std::uint64_t page) const {
+    const std::uint64_t start = page << kPageShift;
+    const std::uint64_t end =
+        start + kPageBytes < static_cast<std::uint64_t>(size_) ? start + kPageBytes : size_;
+    const std::uint8_t* bytes = read_base(static_cast<std::size_t>(page));
+    for (std::uint64_t i = 0; i < end - start; ++i) {
+        if (bytes[i] != 0u) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::unique_ptr<MemoryV2> MemoryV2::clone() {
+    // A memory that has written nothing since it was last frozen is already exactly its image,
+    // so a fan-out of clones from one warm parent freezes it once and shares that image with
+    // every child.
+    if (image_ == nullptr || copied_pages_ != 0 || resized_since_freeze_ ||
+        touched_since_freeze_) {
+        freeze();
+    }
+    std::unique_ptr<MemoryV2> child = std::make_unique<MemoryV2>(size_);
+    child->image_ = image_;
+    child->shared_pages_ = image_->page_bytes.data();
+    const std::size_t populated = page_count(size_);
+    for (std::size_t page = 0; page < populated; ++page) {
+        child->watched_.base[page] |= watched_.base[page] & kWatchShared;
+    }
+    return child;
+}
+
+void MemoryV2::freeze() {
+    constexpr std::uint32_t kUnkept = UINT32_MAX;
+    auto layer = std::make_shared<SharedLayer>();
+    layer->bytes = bytes_;
+    bytes_ = Mapping{};
+    grow(bytes_, size_, 0, false);
+
+    // The pages this memory wrote are the new layer's, and every page it still shares keeps
+    // the pointer it had, so nothing is copied; a layer is carried over only when some page
+    // still points into it. A page it neither wrote nor shares reads zero, and is left out of
+    // the image altogether, since its bytes in the layer may not even be committed.
+    auto image = std::make_shared<SharedImage>();
+    const std::size_t populated = page_count(size_);
+    image->page_bytes.resize(populated);
+    image->page_layer.resize(populated);
+    image->layers.push_back(layer);
+    std::vector<std::uint32_t> kept(image_ != nullptr ? image_->layers.size() : 0, kUnkept);
+    for (std::size_t page = 0; page < populated; ++page) {
+        const std::uint8_t flags = watched_.base[page];
+        if ((flags & (kWatchShared | kWatchUntouched)) == kWatchUntouched) {
+            image->page_bytes[page] = kZeroPage;
+            image->page_layer[page] = 0;
+            continue;
+        }
+        if ((flags & kWatchShared) == 0u) {
+            image->page_bytes[page] = layer->bytes.base + (page << kPageShift);
+            image->page_layer[page] = 0;
+        } else {
+            const std::uint32_t from = image_->page_layer[page];
+            if (kept[from] == kUnkept) {
+                kept[from] = static_cast<std::uint32_t>(image->layers.size());
+                image->layers.push_back(image_->layers[from]);
+            }
+            image->page_bytes[page] = image_->page_bytes[page];
+            image->page_layer[page] = kept[from];
+        }
+        watched_.base[page] |= kWatchShared;
+    }
+    // Every page of the fresh mapping is untouched, the ones just shared included.
+    for (std::size_t page = 0; page < pages_; ++page) {
+        watched_.base[page] |= kWatchUntouched;
+    }
+    image_ = std::move(image);
+    shared_pages_ = image_->page_bytes.data();
+    copied_pages_ = 0;
+    resized_since_freeze_ = false;
+    touched_since_freeze_ = false;
+}
+
+std::size_t MemoryV2::shared_layers() const {
+    return image_ != nullptr ? image_->layers.size() : 0;
+}
+
+const std::uint8_t* MemoryV2::shared_range(std::uint64_t address, std::uint64_t length) const {
+    // One place when every page of the run is this memory's own, or every page is in one layer
+    // of the image; a layer is one mapping, so its pages lie in order as they do here.
+    const std::size_t first = static_cast<std::size_t>(address >> kPageShift);
+    const std::size_t last = static_cast<std::size_t>((address + length - 1) >> kPageShift);
+    const bool shared = (watched_.base[first] & kWatchShared) != 0u;
+    bool together = true;
+    for (std::size_t page = first + 1; together && page <= last; ++page) {
+        const bool also_shared = (watched_.base[page] & kWatchShared) != 0u;
+        together = also_shared == shared &&
+                   (!shared || image_->page_layer[page] == image_->page_layer[first]);
+    }
+    if (together) {
+        return host_bytes(address);
+    }
+    gathered_.resize(static_cast<std::size_t>(length));
+    std::uint64_t done = 0;
+    while (done < length) {
+        const std::uint64_t at = address + done;
+        const std::uint64_t room = kPageBytes - (at & kOffsetMask);
+        const std::uint64_t chunk = room < length - done ? room : length - done;
+        std::memcpy(gathered_.data() + done, host_bytes(at), static_cast<std::size_t>(chunk));
+        done += chunk;
+    }
+    return gathered_.data();
+}
+
+void MemoryV2::commit_page(std::size_t page) const {
+    const std::size_t offset = page << kPageShift;
+    const std::size_t room = bytes_.bytes - offset;
+    commit(bytes_.base + offset, room < kPageBytes ? room : static_cast<std::size_t>(kPageBytes));
+}
+
+void MemoryV2::commit_untouched(std::uint64_t address, std::uint64_t length) const {
+    // A shared page is read from the image and copied before it is written, so only the pages
+    // this memory's own mapping answers for are committed.
+    const std::size_t first = static_cast<std::size_t>(address >> kPageShift);
+    const std::size_t last = static_cast<std::size_t>((address + length - 1) >> kPageShift);
+    for (std::size_t page = first; page <= last; ++page) {
+        if ((watched_.base[page] & (kWatchShared | kWatchUntouched)) == kWatchUntouched) {
+            commit_page(page);
+            watched_.base[page] &= static_cast<std::uint8_t>(~kWatchUntouched);
+        }
+    }
+}
+
+void MemoryV2::copy_shared_page(std::size_t page) {
+    // The whole page, or as much of it as the layer's mapping holds, which is all of it unless
+    // the page is the partial last one; whatever lies past that reads zero here already.
+    const Mapping& layer = image_->layers[image_->page_layer[page]]->bytes;
+    const std::size_t offset = page << kPageShift;
+    const std::size_t available = layer.bytes > offset ? layer.bytes - offset : 0;
+    commit_page(page);
+    std::memcpy(bytes_.base + offset, shared_pages_[page],
+                available < kPageBytes ? available : static_cast<std::size_t>(kPageBytes));
+    watched_.base[page] &= static_cast<std::uint8_t>(~(kWatchShared | kWatchUntouched));
+    ++copied_pages_;
+}
+
+void MemoryV2::grow(Mapping& mapping, std::size_t bytes, [[maybe_unused]] std::size_t used,
+                    bool committed) {
+    const std::size_t extent = mapped_extent(bytes);
+    if (mapping.base == nullptr) {
+        mapping.base = map_zeroed(extent, committed);
+        mapping.bytes = extent;
+        return;
+    }
+    if (extent <= mapping.bytes) {
+        return;
+    }
+#if defined(__linux__)
+    // Linux moves the mapping without copying a byte.
+    void* moved = mremap(mapping.base, mapping.bytes, extent, MREMAP_MAYMOVE);
+    if (moved == MAP_FAILED) {
+        throw std::bad_alloc();
+    }
+    mapping.base = static_cast<std::uint8_t*>(moved);
+#else
+    // Elsewhere the contents move by hand, and only the `used` prefix has any: everything past
+    // it reads zero in the new mapping already, and copying it would touch, and so commit, every
+    // page of the old one. On Windows the prefix is narrowed again to the pages a write has
+    // committed, since the rest read zero too, and the same pages are committed in the new one.
+    std::uint8_t* grown = map_zeroed(extent, committed);
+    const std::size_t keep = used < mapping.bytes ? used : mapping.bytes;
+#ifdef _WIN32
+    for_each_committed(mapping.base, keep, [&](std::size_t from, std::size_t to) {
+        commit(grown + from, to - from);
+        std::memcpy(grown + from, mapping.base + from, to - from);
+    });
+#else
+    std::memcpy(grown, mapping.base, keep);
+#endif
+    unmap(mapping.base, mapping.bytes);
+    mapping.base = grown;
+#endif
+    mapping.bytes = extent;
+}
+
+void MemoryV2::release(Mapping& mapping) {
+    unmap(mapping.base, mapping.bytes);
+    mapping = Mapping{};
+}
+
+void MemoryV2::resize_region(std::size_t size) {
+    const std::size_t zero_from = page_count(size < size_ ? size : size_);
+    if (bytes_.base != nullptr && size < size_) {
+        // Everything from the new size up must read zero if it is ever populated again. The
+        // partial host page at the new end is cleared by hand, committed first because nothing
+        // says it was written; every whole page above it goes back to the host. The mapping
+        // keeps its length, so growing back is free.
+        const std::size_t extent = mapped_extent(size);
+        const std::size_t partial_end = extent < size_ ? extent : size_;
+        commit(bytes_.base + size, partial_end - size);
+        std::memset(bytes_.base + size, 0, partial_end - size);
+        discard_pages(bytes_.base, extent, mapped_extent(size_));
+    } else {
+        // Growing within the mapping needs nothing, because its bytes above the old size
+        // already read zero; growing past it moves the mapping.
+        grow(bytes_, size, size_, false);
+    }
+    size_ = size;
+
+    const std::size_t pages = page_count(size);
+    if (pages > pages_ || watched_.base == nullptr) {
+        grow(watched_, pages, pages_, true);
+        grow(generations_, pages * sizeof(std::uint64_t), pages_ * sizeof(std::uint64_t), true);
+        pages_ = pages > pages_ ? pages : pages_;
+    }
+    // Every page wholly above the smaller of the two sizes reads zero now, whether it was
+    // never written, was given back by the shrink, or is new.
+    for (std::size_t page = zero_from; page < pages_; ++page) {
+        watched_.base[page] |= kWatchUntouched;
+    }
+}
+
+}  // namespace maize::v2
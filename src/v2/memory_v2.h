@@ -15,28 +15,103 @@
 // the real address map is maize-421; until it lands, whoever constructs the machine says how
 // much memory it has.
 //
+// THE REGION IS ONE HOST MAPPING, COMMITTED LAZILY (user-006), which is the representation
+// memory-model.md's implementation notes describe. The host maps anonymous zero pages and
+// commits each one the first time the guest, or a loader, writes it, so constructing a machine
+// with gigabytes of memory costs the same as constructing one with a megabyte, and resident
+// memory follows what the guest writes. Memory commits a page itself rather than leaving it to a
+// fault, because Windows only reserves the region and a fault is not raised for every access
+// (a file read into a reserved page fails in the kernel instead): a page nothing has written yet
+// is flagged untouched in its watch byte, a read of it is served from a page of zeros without
+// going near the mapping, and the first write commits it, which is the same one-shot slow road
+// every other watch flag takes. memory_v2.cpp holds the mapping calls, which are the only
+// host-specific code here.
+//
 // Addresses wrap modulo 2^64, and wrapping is an ordinary defined outcome rather than a fault:
 // an access beginning at $FFFFFFFFFFFFFFFF and covering eight bytes touches seven bytes at the
 // top of the address space and the byte at address zero. Every byte of an access is judged on
-// its own, which is why the range check walks bytes rather than comparing endpoints.
+// its own, and the range check below compares endpoints only because, with populated memory one
+// region starting at zero, that gives the same answer as walking the bytes (user-004).
+//
+// CODE PAGES CARRY A WRITE GENERATION. Decoded instructions are cached per physical page (see
+// predecode_v2.h), and memory-model.md makes an instruction fetch coherent with every earlier
+// store, self-modifying code included. So a page that something has decoded from is WATCHED, and
+// the first write to a watched page bumps that page's generation and stops watching it. A cache
+// compares the generation it recorded with the current one and drops what it held when they
+// differ. Memory knows nothing about what is cached, only that somebody asked to hear about a
+// page, which keeps the write path to one test of one byte for a page nobody decoded from.
+//
+// THE SAME BYTE TRACKS DIRTY PAGES (user-007). A snapshot that copies only what changed needs to
+// know which pages were written since the last one, and every store the machine makes, whether
+// an instruction's, a block-memory transfer's or a trap frame's, reaches memory through
+// write_byte, write_within_page or one of the block-memory runs below. So a page under dirty
+// tracking carries a second flag in its watch byte, and the first write to it clears the flag
+// and records the page. The write path is unchanged: a page that is neither decoded from nor
+// clean under tracking still costs one test, and a page already recorded as dirty costs the
+// same, since its flag is gone. Arming the flags is the snapshot's cost, once per page for a
+// full snapshot and once per dirtied page for an incremental one, and never the store's.
+//
+// AND A CLONE'S PAGES ARE SHARED UNTIL THEY ARE WRITTEN (user-008). clone() freezes this
+// memory's mapping into an image the parent and the child then both read through, and gives each
+// of them a fresh, lazily committed mapping with every populated page flagged shared in its watch
+// byte. A read of a shared page is served from the image where it lies, and the first write to
+// one copies that one page out of the image into the memory's own mapping and clears the flag;
+// every access after that is the ordinary one. So a clone costs a mapping and a pass over the
+// watch bytes, and each machine pays a page copy for the pages it goes on to dirty and nothing
+// for the ones it only reads. A read has to test the flag as a write does, which is one test of
+// a byte the write path already reads, and the image keeps a pointer per page so the shared
+// read is one more load, however the image came to be. A parent cloned again after it has
+// written pages of its own is frozen again, its own pages becoming a new layer and the rest
+// pointing where they pointed before, so no page is ever copied at clone time and a layer every
+// page has moved off is let go.
 
 #ifndef MAIZE_V2_MEMORY_V2_H
 #define MAIZE_V2_MEMORY_V2_H
 
+#include <bit>
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
+#include <memory>
 #include <vector>
 
 namespace maize::v2 {
 
 class MemoryV2 {
   public:
-    explicit MemoryV2(std::size_t size) : bytes_(size, 0) {}
+    // The granule a generation is kept at, which is also the Sv48 base page size. A cached
+    // decode never spans two of these, so one generation answers for all of it.
+    static constexpr unsigned kPageShift = 12;
+    static constexpr std::uint64_t kPageBytes = std::uint64_t{1} << kPageShift;
+
+    // Throws std::bad_alloc when the host will not map the region, as the std::vector this
+    // replaced did.
+    explicit MemoryV2(std::size_t size);
+    ~MemoryV2();
 
-    std::size_t size() const { return bytes_.size(); }
+    // The region is owned, and an InterpreterV2 holds a reference to it, so memory neither
+    // copies nor moves.
+    MemoryV2(const MemoryV2&) = delete;
+    MemoryV2& operator=(const MemoryV2&) = delete;
+
+    std::size_t size() const { return size_; }
+
+    // A memory with this one's size and contents whose pages are shared with it copy-on-write
+    // (user-008). Not const, because the parent's pages are what gets frozen and shared. Throws
+    // std::bad_alloc as the constructor does. The two memories are independent from here on, in
+    // either direction, and either may outlive the other.
+    std::unique_ptr<MemoryV2> clone();
+
+    // How many pages this memory has copied out of the image it shares since it was last
+    // frozen, which a write does and a read does not, so it is the memory a clone has actually
+    // cost. Host-visible only.
+    std::uint64_t copied_pages() const { return copied_pages_; }
+    // How many frozen mappings the pages this memory shares are spread across, which is what
+    // its image keeps alive. Host-visible only.
+    std::size_t shared_layers() const;
 
     bool accessible(std::uint64_t address) const {
-        return address < static_cast<std::uint64_t>(bytes_.size());
+        return address < static_cast<std::uint64_t>(size_);
     }
 
     // Judge a whole access before any of it happens. Returns true when every byte is
@@ -50,33 +125,162 @@ class MemoryV2 {
     // address is still the reported one, which is what "lowest" says.
     bool check_range(std::uint64_t address, std::uint64_t length,
                      std::uint64_t& lowest_inaccessible) const {
-        bool found = false;
-        std::uint64_t lowest = 0;
-        for (std::uint64_t i = 0; i < length; ++i) {
-            const std::uint64_t byte_address = address + i;  // wraps modulo 2^64 by construction
-            if (!accessible(byte_address)) {
-                if (!found || byte_address < lowest) {
-                    lowest = byte_address;
-                    found = true;
-                }
-            }
+        // Populated memory is [0, size), so within any run of ascending addresses that does not
+        // wrap, the inaccessible bytes are exactly those at or above `size`, and the lowest of
+        // them is the larger of the run's start and `size`. An access that wraps is two such
+        // runs, the one at zero numerically lower than the one at the top, and the top one is
+        // never wholly populated because `size` is below 2^64.
+        if (length == 0) {
+            return true;
         }
-        if (found) {
-            lowest_inaccessible = lowest;
+        const std::uint64_t size = static_cast<std::uint64_t>(size_);
+        const std::uint64_t last = address + (length - 1);  // wraps modulo 2^64 by construction
+        if (last >= address) {
+            if (last < size) {
+                return true;
+            }
+            lowest_inaccessible = address > size ? address : size;
             return false;
         }
-        return true;
+        lowest_inaccessible = last >= size ? size : (address > size ? address : size);
+        return false;
     }
 
     // Unchecked byte access. Every caller checks first, either over the whole access (a load or
     // a store, which must write nothing when any byte of the access faults) or per byte (a
     // block-memory instruction, whose restart contract expects a partial transfer to stand).
     std::uint8_t read_byte(std::uint64_t address) const {
-        return bytes_[static_cast<std::size_t>(address)];
+        return read_base(static_cast<std::size_t>(address >> kPageShift))[address & kOffsetMask];
     }
 
     void write_byte(std::uint64_t address, std::uint8_t value) {
-        bytes_[static_cast<std::size_t>(address)] = value;
+        const std::size_t page = static_cast<std::size_t>(address >> kPageShift);
+        if (watched_.base[page] != 0u) {
+            note_write(page);
+        }
+        bytes_.base[static_cast<std::size_t>(address)] = value;
+    }
+
+    // The write generation of the page holding `address`, and the request to have it bumped by
+    // the next write. Both take an accessible address; a caller holding anything else has
+    // nothing to cache.
+    std::uint64_t page_generation(std::uint64_t address) const {
+        return generations()[static_cast<std::size_t>(address >> kPageShift)];
+    }
+
+    void watch_page(std::uint64_t address) {
+        watched_.base[static_cast<std::size_t>(address >> kPageShift)] |= kWatchGeneration;
+    }
+
+    // Dirty-page tracking (user-007). start_dirty_tracking() arms every populated page as clean
+    // and forgets what was recorded; from then on the first write to a page appends its number
+    // to dirty_pages(), once, until clear_dirty_pages() arms the recorded pages as clean again.
+    // The list is in first-write order and is not sorted. A host resize records every populated
+    // page, since any of them may now read differently.
+    void start_dirty_tracking();
+    void clear_dirty_pages();
+    bool dirty_tracking() const { return dirty_tracking_; }
+    const std::vector<std::uint64_t>& dirty_pages() const { return dirty_pages_; }
+
+    // The number of pages populated memory spans, the last of which may be partial, and
+    // whether one of them reads zero throughout. Reading an untouched page does not commit it,
+    // and judging a shared page does not copy it.
+    std::uint64_t populated_pages() const { return page_count(size_); }
+    bool page_is_zero(std::uint64_t page) const;
+
+    // The host address of a populated byte, for a reader that has proved a run of bytes
+    // accessible and wants to read it without a call per byte (the fetch window, user-005). It
+    // stays valid until host_set_size or a write to the page, so no holder may keep it past the
+    // access it was taken for. It is good for the rest of the page and no further.
+    const std::uint8_t* host_bytes(std::uint64_t address) const {
+        return read_base(static_cast<std::size_t>(address >> kPageShift)) +
+               (address & kOffsetMask);
+    }
+
+    // The host address of a whole run of populated bytes, for a device that moves a bulk
+    // transfer straight between guest memory and the host in one call (user-018). The caller
+    // has proved every byte of the run accessible. The region is one contiguous mapping, so
+    // the run is contiguous however many pages it spans; what a page at a time is needed for
+    // is the watch bytes, which is why the writer's form tells every page of the run it is
+    // about to be written before handing the run out, exactly as load_image does. Valid until
+    // host_set_size, as host_bytes is. Either form commits the run's untouched pages first, so
+    // a host call that reads or writes the run in the kernel finds every page of it there.
+    //
+    // The reader's form copies nothing out of a shared image: a run that lies wholly in this
+    // memory's own mapping, or wholly in one layer of the image, is handed out where it lies,
+    // and one that straddles the two is gathered into a buffer the memory keeps, which is valid
+    // until the next call.
+    const std::uint8_t* host_range(std::uint64_t address, std::uint64_t length) const {
+        if (length == 0) {
+            return bytes_.base + static_cast<std::size_t>(address);
+        }
+        commit_untouched(address, length);
+        if (image_ == nullptr) {
+            return bytes_.base + static_cast<std::size_t>(address);
+        }
+        return shared_range(address, length);
+    }
+
+    std::uint8_t* host_range_for_write(std::uint64_t address, std::uint64_t length) {
+        if (length != 0) {
+            const std::uint64_t last = (address + length - 1) >> kPageShift;
+            for (std::uint64_t page = address >> kPageShift; page <= last; ++page) {
+                if (watched_.base[page] != 0u) {
+                    note_write(static_cast<std::size_t>(page));
+                }
+            }
+        }
+        return bytes_.base + static_cast<std::size_t>(address);
+    }
+
+    // One checked run of at most eight bytes that lies inside a single page, read or written
+    // as one host-width access (user-004). The caller has already proved every byte
+    // accessible; keeping the run inside one page is what lets a single generation test stand
+    // for all of it. On a little-endian host the copy is the guest's byte order already, and a
+    // big-endian host assembles the value a byte at a time as read_little_endian does.
+    std::uint64_t read_within_page(std::uint64_t address, unsigned width_bytes) const {
+        if constexpr (std::endian::native == std::endian::little) {
+            std::uint64_t value = 0;
+            std::memcpy(&value, host_bytes(address), width_bytes);
+            return value;
+        } else {
+            return read_little_endian(address, width_bytes);
+        }
+    }
+
+    void write_within_page(std::uint64_t address, unsigned width_bytes, std::uint64_t value) {
+        if constexpr (std::endian::native == std::endian::little) {
+            const std::size_t page = static_cast<std::size_t>(address >> kPageShift);
+            if (watched_.base[page] != 0u) {
+                note_write(page);
+            }
+            std::memcpy(bytes_.base + static_cast<std::size_t>(address), &value, width_bytes);
+        } else {
+            write_little_endian(address, width_bytes, value);
+        }
+    }
+
+    // A run of bytes moved or filled as one host call (user-015), for a block-memory transfer
+    // that has already proved every byte of the run accessible. `to`'s run lies inside one page
+    // and `from`'s inside one page, which is what lets one watch-byte test stand for the run the
+    // way it does for write_within_page. The two runs may overlap; the result is memmove's, and
+    // a caller whose architectural result is something else cuts the run up so it is not.
+    void move_within_pages(std::uint64_t to, std::uint64_t from, std::size_t length) {
+        // The destination first, so a source on the same page is read from the copy its write
+        // has just made rather than from the image.
+        const std::size_t page = static_cast<std::size_t>(to >> kPageShift);
+        if (watched_.base[page] != 0u) {
+            note_write(page);
+        }
+        std::memmove(bytes_.base + static_cast<std::size_t>(to), host_bytes(from), length);
+    }
+
+    void fill_within_page(std::uint64_t to, std::uint8_t value, std::size_t length) {
+        const std::size_t page = static_cast<std::size_t>(to >> kPageShift);
+        if (watched_.base[page] != 0u) {
+            note_write(page);
+        }
+        std::memset(bytes_.base + static_cast<std::size_t>(to), value, length);
     }
 
     // Little-endian at every width, register to memory and memory to register alike, so the
@@ -100,23 +304,155 @@ class MemoryV2 {
     // kernel that services a fault by making a region populated, which is what lets a fixture
     // arm a physical-memory fault partway through a block-memory transfer, inspect the restart
     // state, service the fault, and re-execute. Bytes below the new size keep their values.
-    void host_set_size(std::size_t size) { bytes_.resize(size, 0); }
+    //
+    // Every page's generation moves, because a byte that stops being populated and comes back
+    // reads zero, and a cached decode taken before the resize must not outlive it. The side
+    // tables only ever grow, so a page that leaves and returns keeps counting from where it was
+    // rather than starting again at a generation some cache may still hold.
+    //
+    // Growing past the mapped extent moves the mapping, by remapping where the host can and by
+    // copying where it cannot, and shrinking gives the pages above the new size back to the
+    // host so that they read zero when they return. Throws std::bad_alloc as the constructor
+    // does.
+    void host_set_size(std::size_t size);
 
     // Host-side loading. Fixtures and the mzvm entry point place program bytes directly, since
-    // the loader and the boot-information block are maize-421.
+    // the loader and the boot-information block are maize-421. A snapshot restore puts pages
+    // back through here too, so it copies a page at a time and tells each page's watch byte
+    // once, exactly as the same bytes stored one at a time would have.
     bool load_image(std::uint64_t address, const std::uint8_t* data, std::size_t length) {
         std::uint64_t unused = 0;
         if (!check_range(address, length, unused)) {
             return false;
         }
-        for (std::size_t i = 0; i < length; ++i) {
-            write_byte(address + i, data[i]);
+        while (length != 0) {
+            const std::size_t page = static_cast<std::size_t>(address >> kPageShift);
+            const std::uint64_t room = kPageBytes - (address & (kPageBytes - 1));
+            const std::size_t chunk = room < length ? static_cast<std::size_t>(room) : length;
+            if (watched_.base[page] != 0u) {
+                note_write(page);
+            }
+            std::memcpy(bytes_.base + static_cast<std::size_t>(address), data, chunk);
+            address += chunk;
+            data += chunk;
+            length -= chunk;
         }
         return true;
     }
 
   private:
-    std::vector<std::uint8_t> bytes_;
+    // One lazily committed host mapping, whole host pages long. Bytes past whatever was last
+    // written read zero.
+    struct Mapping {
+        std::uint8_t* base = nullptr;
+        std::size_t bytes = 0;
+    };
+
+    // memory_v2.cpp. grow() extends a mapping to at least `bytes`, keeping its first `used`
+    // bytes, the only ones that can be other than zero; resize_region() makes the first `size`
+    // bytes of the region populated, and grows the side tables, which never shrink, to cover
+    // them.
+    // A `committed` mapping is committed whole up front, which the side tables are: the code
+    // that reads them is the code that tests for untouched pages, and they cost a ninth of a
+    // byte per byte of the region.
+    static void grow(Mapping& mapping, std::size_t bytes, std::size_t used, bool committed);
+    static void release(Mapping& mapping);
+    void resize_region(std::size_t size);
+
+    // The two flags a page's watch byte carries: somebody decoded from it and wants its
+    // generation moved, and dirty tracking holds it clean and wants to hear it was written.
+    static constexpr std::uint8_t kWatchGeneration = 1;
+    static constexpr std::uint8_t kWatchDirty = 2;
+    // The page's bytes are still in image_ and not yet in this memory's own mapping.
+    static constexpr std::uint8_t kWatchShared = 4;
+    // Nothing has written the page in this memory's own mapping since the mapping was made or
+    // the page was given back, so it reads zero there and the host may not have committed it.
+    // A page can be committed and still carry the flag, but never written and without it.
+    static constexpr std::uint8_t kWatchUntouched = 8;
+
+    // The first write to a page with any flag set. Every flag is one-shot, so the next write
+    // to the page takes the one-test road again.
+    void note_write(std::size_t page) {
+        const std::uint8_t flags = watched_.base[page];
+        if ((flags & kWatchShared) != 0u) {
+            copy_shared_page(page);
+        } else if ((flags & kWatchUntouched) != 0u) {
+            commit_page(page);
+            touched_since_freeze_ = true;
+        }
+        watched_.base[page] = 0;
+        if ((flags & kWatchGeneration) != 0u) {
+            ++generations()[page];
+        }
+        if ((flags & kWatchDirty) != 0u) {
+            dirty_pages_.push_back(page);
+        }
+    }
+
+    static constexpr std::uint64_t kOffsetMask = kPageBytes - 1;
+
+    // Where a read of `page` finds its bytes: the image's while the page is shared, a page of
+    // zeros while it is untouched, and this memory's own mapping once it is neither.
+    const std::uint8_t* read_base(std::size_t page) const {
+        const std::uint8_t flags = watched_.base[page];
+        if ((flags & (kWatchShared | kWatchUntouched)) == 0u) {
+            return bytes_.base + (page << kPageShift);
+        }
+        return (flags & kWatchShared) != 0u ? shared_pages_[page] : kZeroPage;
+    }
+
+    static constexpr std::uint8_t kZeroPage[kPageBytes] = {};
+
+    // memory_v2.cpp. Commit one page of this memory's own mapping, and every untouched page of
+    // a run a host call is about to reach, clearing their flags, which changes what backs the
+    // pages and not what they read, so a reader may do it; copy one shared page out of the
+    // image into this memory's own mapping, and clear its flag, which only a write does; freeze
+    // this memory's mapping into a new image and share every page of it that is not untouched;
+    // and host_range()'s answer for a memory with an image.
+    void commit_page(std::size_t page) const;
+    void commit_untouched(std::uint64_t address, std::uint64_t length) const;
+    void copy_shared_page(std::size_t page);
+    void freeze();
+    const std::uint8_t* shared_range(std::uint64_t address, std::uint64_t length) const;
+
+    std::uint64_t* generations() const {
+        return reinterpret_cast<std::uint64_t*>(generations_.base);
+    }
+
+    static std::size_t page_count(std::size_t size) {
+        return static_cast<std::size_t>((static_cast<std::uint64_t>(size) + kPageBytes - 1) >>
+                                        kPageShift);
+    }
+
+    // The region, of which the first size_ bytes are populated, and the two per-page side
+    // tables, which are mapped the same way so that neither costs anything at construction
+    // either: one watch byte and one generation for each of pages_ pages.
+    Mapping bytes_{};
+    std::size_t size_ = 0;
+    Mapping watched_{};
+    Mapping generations_{};
+    std::size_t pages_ = 0;
+
+    // Pages written since dirty tracking last armed them. A page is in the list exactly when
+    // tracking is on and its kWatchDirty flag is clear, which is what keeps it in the list once.
+    bool dirty_tracking_ = false;
+    std::vector<std::uint64_t> dirty_pages_;
+
+    // The frozen pages a clone shares (memory_v2.cpp), null until this memory is cloned or is
+    // a clone; the image's per-page pointers, for read_base(); and the count of pages copied out
+    // of it since it was last frozen.
+    struct SharedLayer;
+    struct SharedImage;
+    std::shared_ptr<const SharedImage> image_;
+    const std::uint8_t* const* shared_pages_ = nullptr;
+    std::uint64_t copied_pages_ = 0;
+    // A resize, or a write to a page the image left untouched, can leave pages in the mapping
+    // the image never had, so the next clone freezes again rather than sharing the image as it
+    // stands.
+    bool resized_since_freeze_ = false;
+    bool touched_since_freeze_ = false;
+    // host_range()'s run that straddles pages held in different places.
+    mutable std::vector<std::uint8_t> gathered_;
 };
 
 }  // namespace maize::v2
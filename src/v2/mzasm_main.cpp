@@ -15,6 +15,11 @@
 // before loading it, so the naming is the only place a reader catches the mistake. A suffix is a
 // convention rather than a check, and this buys a naming-level mistake in place of a
 // content-level one, which is all it claims.
+//
+// --symbols (user-024) writes the flat image's labels beside it as <input>.sym (symbols_v2.h),
+// for mzvm to name the addresses a profile reports. It is an output like the image and follows
+// the image's rules: removed before assembly when stale, written only on success, and neither
+// removed nor written under --check.
 
 #include <filesystem>
 #include <fstream>
@@ -24,6 +29,7 @@
 #include <vector>
 
 #include "mzasm.h"
+#include "symbols_v2.h"
 
 namespace {
 
@@ -37,6 +43,8 @@ void print_usage(std::ostream& out) {
            "\n"
            "options:\n"
            "  -c, --emit-object     emit a relocatable .mzo object instead of a flat .mzi\n"
+           "  --symbols             also write the image's labels, one per line with its\n"
+           "                        address, to <input>.sym (flat output only)\n"
            "  --check               validate only: run the full assembly pipeline with\n"
            "                        no filesystem effects (nothing written or removed)\n"
            "  --stdin               read source from standard input instead of a file;\n"
@@ -74,6 +82,7 @@ int main(int argc, char* argv[]) {
     bool check_only = false;
     bool emit_object = false;
     bool stdin_mode = false;
+    bool write_symbols = false;
     std::string input_file;
     std::string base_path_arg;
     std::string source_name = "<stdin>";
@@ -87,6 +96,8 @@ int main(int argc, char* argv[]) {
             check_only = true;
         } else if (arg == "-c" || arg == "--emit-object") {
             emit_object = true;
+        } else if (arg == "--symbols") {
+            write_symbols = true;
         } else if (arg == "--stdin") {
             stdin_mode = true;
         } else if (arg == "--base-path" && i + 1 < argc) {
@@ -100,7 +111,14 @@ int main(int argc, char* argv[]) {
         }
     }
 
+    if (write_symbols && emit_object) {
+        std::cerr << "mzasm: error: --symbols names the addresses of a flat image, and -c "
+                     "emits an object whose sections are not placed yet\n";
+        return 1;
+    }
+
     std::filesystem::path output_path;
+    std::filesystem::path symbols_path;
     Assembler assembler;
     bool ok = false;
 
@@ -137,6 +155,11 @@ int main(int argc, char* argv[]) {
             output_path.replace_extension(emit_object ? "mzo" : "mzi");
             std::error_code ec;
             std::filesystem::remove(output_path, ec);
+            if (write_symbols) {
+                symbols_path = std::filesystem::path(input_file);
+                symbols_path.replace_extension("sym");
+                std::filesystem::remove(symbols_path, ec);
+            }
         }
         ok = assembler.assemble_file(input_file);
     }
@@ -170,6 +193,19 @@ int main(int argc, char* argv[]) {
             std::cerr << "mzasm: error: cannot write '" << output_path.string() << "'\n";
             return 1;
         }
+        // Labels only: a constant is a number the program uses, not a place in it.
+        if (write_symbols) {
+            maize::v2::SymbolTableV2 table;
+            for (const auto& [name, symbol] : assembler.symbols()) {
+                if (symbol.defined && !symbol.is_constant && !symbol.external) {
+                    table.add(symbol.value, name);
+                }
+            }
+            if (!table.write(symbols_path.string())) {
+                std::cerr << "mzasm: error: cannot write '" << symbols_path.string() << "'\n";
+                return 1;
+            }
+        }
     }
 
     std::cout << "Output to " << output_path.string() << std::endl;
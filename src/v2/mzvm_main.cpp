@@ -14,6 +14,7 @@
 // inside a status line, and a shell pipeline gets the program's output and nothing else.
 // `--registers` is the one exception and is opt-in.
 
+#include <cctype>
 #include <cinttypes>
 #include <cstdint>
 #include <cstdio>
@@ -23,16 +24,29 @@
 #include <new>
 #include <stdexcept>
 #include <string>
+#include <utility>
 #include <vector>
 
 #ifdef _WIN32
 #include <fcntl.h>
 #include <io.h>
+#else
+#include <unistd.h>
 #endif
 
+#include "batch_v2.h"
+#include "block_storage_v2.h"
+#include "console_stream_v2.h"
+#include "entropy_v2.h"
+#include "framebuffer_v2.h"
 #include "interpreter_v2.h"
+#include "jit_v2.h"
 #include "memory_v2.h"
 #include "mzvm_options.h"
+#include "perf_v2.h"
+#include "profile_v2.h"
+#include "snapshot_v2.h"
+#include "symbols_v2.h"
 
 namespace {
 
@@ -44,6 +58,10 @@ namespace {
 // that silently doubles a byte is not delivering the stream the guest wrote. _setmode with
 // _O_BINARY is the documented CRT call that turns the translation off, and the mode is restored
 // afterwards so the `--registers` dump keeps the host's line-ending convention.
+//
+// A batch's report is what writes this way now. A single run streams its console through
+// StreamingConsoleSinkV2 instead (user-016), which makes the same change to the same stream for
+// as long as it is attached.
 void write_console_bytes(const std::vector<std::uint8_t>& bytes) {
     if (bytes.empty()) {
         return;
@@ -61,6 +79,16 @@ void write_console_bytes(const std::vector<std::uint8_t>& bytes) {
 #endif
 }
 
+// Whether stdout is a terminal, which is when the streamed console is written a line at a time
+// rather than a buffer at a time (user-016).
+bool stdout_is_terminal() {
+#ifdef _WIN32
+    return _isatty(_fileno(stdout)) != 0;
+#else
+    return isatty(fileno(stdout)) != 0;
+#endif
+}
+
 // Which of the two machines this build is (maize-456). CMakeLists.txt compiles this one file
 // into both `mzvm` and `mzvmg` and defines the name per target, so the binary an operator ran is
 // the binary every sentence below names. There is no runtime fallback and there should not be:
@@ -87,12 +115,51 @@ constexpr std::uint64_t kDefaultLoadAddress = 0x1000;
 constexpr std::uint64_t kMaxAddress = UINT64_MAX;
 constexpr std::uint64_t kMaxSteps = UINT64_MAX;
 constexpr std::uint64_t kMaxMemoryBytes = static_cast<std::uint64_t>(SIZE_MAX);
+// The code cache is mapped whole when the JIT starts, so its ceiling is a sanity bound on one
+// mapping rather than a truncation guard: a gibibyte of compiled blocks is far past any guest
+// this machine runs, and v1 never needed a tenth of it.
+constexpr std::uint64_t kMaxJitCacheMegabytes = 1024;
+
+// --jit-check found a compiled block that disagreed with the interpreter. A distinct status,
+// because a miscompile has to fail any harness running under the check, whatever the guest did.
+constexpr int kExitJitMiscompile = 4;
+
+// --snapshot-every counts instructions, and a snapshot every instruction is already the most a
+// chain can hold, so the ceiling is the step count's own.
+constexpr std::uint64_t kMaxSnapshotInterval = UINT64_MAX;
+
+// --sample-every counts instructions too, from one, which samples every instruction there is.
+// --folded-out alone samples at the default, which is fine enough to find a hot path in a run of
+// a second and coarse enough that sampling is not most of what the run does.
+constexpr std::uint64_t kMaxSampleInterval = UINT64_MAX;
+constexpr std::uint64_t kDefaultSampleInterval = 10000;
+
+// --perf-every is in milliseconds of wall-clock time, and a day between lines is already more
+// than any run wants. The clock is read between slices of the run, each this many instructions,
+// which is a small fraction of a millisecond interpreted: short enough that a line is seldom late
+// by more than that, and long enough that reading the clock is no part of what the run costs. A
+// slice changes nothing the guest can see, since a run carries on from a budget exactly as it
+// does from a snapshot interval. A guest suspended in wait_for_interrupt is in one slice for as
+// long as it waits, and the line that falls due meanwhile comes when it wakes.
+constexpr std::uint64_t kMaxPerfIntervalMilliseconds = 86400000;
+constexpr std::uint64_t kPerfSliceInstructions = std::uint64_t{1} << 16;
+
+// --threads is a count of host threads, and a few thousand is already far past any host's core
+// count; the ceiling keeps a typo from asking for a million stacks.
+constexpr std::uint64_t kMaxThreads = 4096;
+
+// --display's sides. A frame is width times height times four bytes in guest memory and in every
+// slot of the shared segment, so each side is bounded at a size past any real display, which
+// keeps the product of the two far from overflowing anything that holds it.
+constexpr std::uint64_t kMaxDisplaySide = 16384;
 
 void print_usage(std::FILE* stream, const char* program_name) {
     std::fprintf(stream,
                  "usage: %s [options] <image>\n"
+                 "       %s [options] --restore <file>\n"
+                 "       %s [options] --batch <manifest>\n"
                  "\n",
-                 program_name);
+                 program_name, program_name, program_name);
     std::fprintf(stream,
                  "Run a Maize v2 program. The image is a flat file of instruction bytes; it is\n"
                  "loaded into memory at the load address and execution starts there.\n"
@@ -102,28 +169,95 @@ void print_usage(std::FILE* stream, const char* program_name) {
                  "  --load-at <addr>   address to load the image at (default 0x1000)\n"
                  "  --start <addr>     address to start executing at (default the load address)\n"
                  "  --max-steps <n>    stop after n instructions (default 100000000, 0 for no limit)\n"
+                 "  --cycle-budget <n> stop once the machine has consumed n cycles of its cost\n"
+                 "                     model (default 0, no limit); carries on like --max-steps\n"
+                 "  --meter            print the cycles consumed when the machine stops\n"
+                 "  --profile          count retired opcodes, hot blocks, traps, block bytes and\n"
+                 "                     translation, and print the counts when the machine stops;\n"
+                 "                     the machine runs interpreted\n"
+                 "  --profile-json <file>\n"
+                 "                     profile as --profile does, and write the counts to file\n"
+                 "                     as JSON\n"
+                 "  --folded-out <file> sample the guest's call stack and write the samples to\n"
+                 "                     file as folded stacks, for flame-graph tools; the machine\n"
+                 "                     runs interpreted\n"
+                 "  --sample-every <n> take a sample every n instructions (default 10000)\n"
+                 "  --symbols <file>   name the addresses --folded-out and --profile report from\n"
+                 "                     a symbol file, as mzasm --symbols writes\n"
+                 "  --show-perf        print the performance counters of the cpu, translator,\n"
+                 "                     console, timer and display when the machine stops\n"
+                 "  --perf-every <ms>  print their rates to stderr every ms milliseconds of the\n"
+                 "                     run, and the peaks with the counters at the end\n"
                  "  --registers        print the register file when the machine stops\n"
+                 "  --jit              compile hot code to native code (x86-64 hosts only)\n"
+                 "  --jit-cache-mb <n> size of the JIT code cache in MiB (default 16)\n"
+                 "  --jit-check        run the JIT with every compiled block checked against\n"
+                 "                     the interpreter; a disagreement exits with status 4\n"
+                 "  --snapshot-out <file>\n"
+                 "                     write a full machine snapshot to file before the first\n"
+                 "                     instruction, and append incremental ones after it\n"
+                 "  --snapshot-every <n>\n"
+                 "                     take an incremental snapshot every n instructions\n"
+                 "                     (default 0, which takes only the full one)\n"
+                 "  --restore <file>   resume from the last snapshot in file instead of loading\n"
+                 "                     an image; the step count, and --max-steps, carry on\n"
+                 "  --batch <manifest> run every machine the manifest lists, across the host's\n"
+                 "                     cores, and report on each in manifest order\n"
+                 "  --threads <n>      worker threads for --batch (default one per host core)\n"
+                 "  --disk <file>      attach file as the machine's block storage device; the\n"
+                 "                     guest reads and writes it in place\n"
+                 "  --disk-async       complete block transfers on a host thread while the\n"
+                 "                     guest runs on, rather than within the command\n"
+                 "  --display <w>x<h>  attach a framebuffer of that many pixels; its frames are\n"
+                 "                     counted and shown nowhere unless --display-shm is given\n"
+                 "  --display-surfaces <n>\n"
+                 "                     the surfaces the framebuffer provides (default 1)\n"
+                 "  --display-shm <name>\n"
+                 "                     present each frame into the shared-memory segment <name>,\n"
+                 "                     for a presenter process to show\n"
+                 "  --entropy          attach an entropy device keyed from the host's generator\n"
+                 "  --entropy-seed <n> attach an entropy device keyed from n instead, so every\n"
+                 "                     run reads the same words; never for cryptographic use\n"
                  "  -h, --help         print this message\n"
                  "\n"
+                 "A batch manifest names one image per line, optionally followed by any of\n"
+                 "memory=<bytes>, load-at=<addr>, start=<addr>, max-steps=<n> and output=<file>,\n"
+                 "which override the options above for that machine alone. Blank lines and lines\n"
+                 "beginning with # are skipped. Standard output is then the report: for each\n"
+                 "machine in order, a line '== <n> <image>: <outcome>; <k> console bytes',\n"
+                 "then exactly those k bytes of its console output and a line feed. A machine\n"
+                 "given output=<file> writes its console output there instead, and reports 0.\n"
+                 "Machines given the same network=<name> each carry a network device at ports\n"
+                 "$0060 through $006F, plugged into one virtual switch, and run at once, each on\n"
+                 "a thread of its own, so their guests can exchange frames. Those threads count\n"
+                 "against --threads, and a batch with more networked machines than threads runs\n"
+                 "none of them.\n"
+                 "\n"
                  "The machine runs with paging off. It carries the machine block at port $0000\n"
-                 "and the console class at ports $0010 through $001F, and no other device class,\n"
-                 "so what the guest writes to the console port reaches standard output. Loading a\n"
-                 "boot image, floating point and system instructions are not supported yet.\n");
+                 "and the console class at ports $0010 through $001F, and block storage, the\n"
+                 "framebuffer and the entropy device only when --disk, --display and --entropy\n"
+                 "or --entropy-seed attach them. What the guest writes to the console port\n"
+                 "reaches standard output, as it is written rather than when the machine stops,\n"
+                 "and what arrives on standard input is what the guest reads from it. Standard\n"
+                 "input is not read until the guest reads the console or enables its interrupt.\n"
+                 "Loading a boot image, floating point and system instructions are not supported\n"
+                 "yet.\n");
 
     // The graphical twin says what it is not (maize-456). `mzvmg` is installed as the graphical
     // machine and SDL2.dll is installed beside it, so everything an operator can see from outside
-    // says a window is coming, and nothing they can see says the machine carries no framebuffer
-    // and no keyboard class to put in one.
+    // says a window is coming, and nothing they can see says the machine has none of its own.
     //
     // The condition is the printed name rather than a second compile definition, so the sentence
-    // and the banner above it cannot disagree about which binary this is. Every clause here is
-    // false the day the display device lands, which is the point: the paragraph is deleted then,
-    // and the fixture pinning its text fails until somebody does.
+    // and the banner above it cannot disagree about which binary this is. The framebuffer landed
+    // (user-019) and made the paragraph's first version false; this one is false the day mzvmg
+    // opens a window, and is deleted then, and the fixture pinning its text fails until somebody
+    // does.
     if (std::strcmp(program_name, "mzvmg") == 0) {
         std::fprintf(stream,
                      "\n"
-                     "%s has no display device yet (maize-456). It carries no framebuffer and no\n"
-                     "keyboard class, opens no window, and loads no SDL2 library. Today it runs\n"
+                     "%s has no window yet (maize-456). It carries the framebuffer --display\n"
+                     "attaches and no keyboard class, opens no window of its own, and loads no SDL2\n"
+                     "library: its frames reach a screen only through --display-shm. Today it runs\n"
                      "exactly what mzvm runs, and this paragraph goes away when that changes.\n",
                      program_name);
     }
@@ -149,12 +283,13 @@ bool read_file(const char* path, std::vector<std::uint8_t>& bytes) {
 // Allocate the machine's physical memory, or say why it could not be (maize-467, D-1).
 //
 // A size that passes every range check can still be one this host cannot give us, and the
-// allocation is the only thing that knows. Left to itself the vector throws, nothing catches it,
-// and the program dies on an abort with a C++ runtime message about a vector and no mention of
-// the option the user typed, which is the same nothing-was-said failure this card exists to
-// remove. std::length_error is what a request past the vector's max_size raises and
-// std::bad_alloc is what a request the allocator cannot satisfy raises; both mean the memory
-// asked for is not available, so both get the sentence.
+// allocation is the only thing that knows. Left to itself the allocation throws, nothing catches
+// it, and the program dies on an abort with a C++ runtime message and no mention of the option
+// the user typed, which is the same nothing-was-said failure this card exists to remove. Since
+// user-006 memory is a host mapping, and std::bad_alloc is what a mapping the host refuses
+// raises. std::length_error was the std::vector's way of saying the same thing and stays caught,
+// so whatever backs memory next, both mean the memory asked for is not available and both get
+// the sentence.
 //
 // The memory is owned through a pointer only because the construction has to sit inside a try
 // block while the machine below outlives it.
@@ -169,6 +304,59 @@ std::unique_ptr<maize::v2::MemoryV2> allocate_memory(std::uint64_t bytes) {
     return nullptr;
 }
 
+// Put back the machine a --snapshot-out file describes (user-007): its full snapshot, then each
+// incremental one in order, which leaves the machine as it was at the last of them. A file that
+// stops partway through a record ends the chain at the record before, which is what a run
+// killed mid-write leaves behind, and is said so; a file whose records do not chain is refused.
+bool restore_machine(maize::v2::InterpreterV2& machine, const char* path) {
+    std::FILE* file = std::fopen(path, "rb");
+    if (file == nullptr) {
+        std::fprintf(stderr, "%s: cannot read '%s'\n", kProgramName, path);
+        return false;
+    }
+    std::uint64_t restored = 0;
+    bool ok = true;
+    maize::v2::MachineSnapshotV2 snapshot;
+    for (;;) {
+        const maize::v2::SnapshotReadV2 read = maize::v2::read_snapshot(file, snapshot);
+        if (read == maize::v2::SnapshotReadV2::End) {
+            break;
+        }
+        if (read == maize::v2::SnapshotReadV2::Malformed) {
+            if (restored == 0) {
+                std::fprintf(stderr, "%s: '%s' does not begin with a machine snapshot\n",
+                             kProgramName, path);
+                ok = false;
+            } else {
+                std::fprintf(stderr,
+                             "%s: '%s' ends in an incomplete snapshot; resuming from the one "
+                             "before it\n",
+                             kProgramName, path);
+            }
+            break;
+        }
+        bool applied = false;
+        try {
+            applied = machine.restore_snapshot(snapshot);
+        } catch (const std::bad_alloc&) {
+            std::fprintf(stderr,
+                         "%s: cannot allocate %" PRIu64 " bytes of memory for the machine\n",
+                         kProgramName, snapshot.memory_size);
+            ok = false;
+            break;
+        }
+        if (!applied) {
+            std::fprintf(stderr, "%s: snapshot %" PRIu64 " in '%s' does not follow the one before it\n",
+                         kProgramName, restored, path);
+            ok = false;
+            break;
+        }
+        ++restored;
+    }
+    std::fclose(file);
+    return ok;
+}
+
 const char* cause_name(std::uint8_t cause_number) {
     switch (cause_number) {
         case maize::v2::cause::kIllegalInstruction: return "illegal instruction";
@@ -182,6 +370,187 @@ const char* cause_name(std::uint8_t cause_number) {
     }
 }
 
+// What stopped a batch machine, in the words the single-run report below uses, on one line.
+std::string describe_outcome(const maize::v2::BatchResultV2& outcome) {
+    if (!outcome.ran) {
+        return outcome.error;
+    }
+    char text[256];
+    const maize::v2::StepResult& result = outcome.result;
+    switch (result.status) {
+        case maize::v2::StepStatus::Halted:
+            std::snprintf(text, sizeof(text), "halted at $%016" PRIX64 " after %" PRIu64
+                          " instructions", result.pc, outcome.steps);
+            break;
+        case maize::v2::StepStatus::Trapped:
+            std::snprintf(text, sizeof(text),
+                          "trap %u (%s) subcode %u, aux $%016" PRIX64 ", at $%016" PRIX64 "; %s",
+                          result.trap.cause, cause_name(result.trap.cause), result.trap.subcode,
+                          result.trap.aux, result.trap.pc,
+                          result.disposition == maize::v2::TrapDisposition::HaltedDoubleFault
+                              ? "double fault"
+                              : "no handler installed");
+            break;
+        case maize::v2::StepStatus::Unimplemented:
+            std::snprintf(text, sizeof(text),
+                          "opcode $%02X at $%016" PRIX64 " is not implemented in this build",
+                          result.opcode, result.pc);
+            break;
+        case maize::v2::StepStatus::Suspended:
+            std::snprintf(text, sizeof(text),
+                          "wait_for_interrupt at $%016" PRIX64 " can never complete", result.pc);
+            break;
+        case maize::v2::StepStatus::Advanced:
+            std::snprintf(text, sizeof(text), "step limit reached at $%016" PRIX64, outcome.pc);
+            break;
+    }
+    std::string described = text;
+    // A machine that ran and then lost its output file says both.
+    if (!outcome.error.empty()) {
+        described += "; " + outcome.error;
+    }
+    if (!outcome.jit_check_failure.empty()) {
+        described += "; --jit-check: " + outcome.jit_check_failure;
+    }
+    return described;
+}
+
+// Read a --batch manifest (user-009) into one job per machine, each starting from `defaults`.
+// Every value goes through parse_number under the name "<manifest>:<line>: <key>", so a bad one
+// is refused the way the same value on the command line would be, and says where it was.
+bool read_manifest(const char* path, const maize::v2::BatchJobV2& defaults, bool start_given,
+                   std::vector<maize::v2::BatchJobV2>& jobs) {
+    std::vector<std::uint8_t> bytes;
+    if (!read_file(path, bytes)) {
+        std::fprintf(stderr, "%s: cannot read '%s'\n", kProgramName, path);
+        return false;
+    }
+    const std::string text(bytes.begin(), bytes.end());
+    std::size_t line_start = 0;
+    for (unsigned line = 1; line_start < text.size(); ++line) {
+        std::size_t line_end = text.find('\n', line_start);
+        if (line_end == std::string::npos) {
+            line_end = text.size();
+        }
+        std::vector<std::string> words;
+        std::size_t at = line_start;
+        while (at < line_end) {
+            while (at < line_end && std::isspace(static_cast<unsigned char>(text[at])) != 0) {
+                ++at;
+            }
+            const std::size_t word_start = at;
+            while (at < line_end && std::isspace(static_cast<unsigned char>(text[at])) == 0) {
+                ++at;
+            }
+            if (at > word_start) {
+                words.push_back(text.substr(word_start, at - word_start));
+            }
+        }
+        line_start = line_end + 1;
+        if (words.empty() || words.front()[0] == '#') {
+            continue;
+        }
+
+        maize::v2::BatchJobV2 job = defaults;
+        job.image_path = words.front();
+        bool start_set = false;
+        for (std::size_t w = 1; w < words.size(); ++w) {
+            const std::string& word = words[w];
+            const std::size_t equals = word.find('=');
+            const std::string key = word.substr(0, equals);
+            const std::string value = equals == std::string::npos ? "" : word.substr(equals + 1);
+            const std::string where =
+                std::string(path) + ":" + std::to_string(line) + ": " + key;
+            std::uint64_t number = 0;
+            if (equals == std::string::npos) {
+                std::fprintf(stderr, "%s: %s:%u: '%s' is not a key=value setting\n",
+                             kProgramName, path, line, word.c_str());
+                return false;
+            } else if (key == "output") {
+                job.output_path = value;
+            } else if (key == "network") {
+                if (value.empty()) {
+                    std::fprintf(stderr, "%s: %s needs a network name\n", kProgramName,
+                                 where.c_str());
+                    return false;
+                }
+                job.network = value;
+            } else if (key == "memory") {
+                if (!parse_number(kProgramName, where.c_str(), "a size", value.c_str(), 1,
+                                  kMaxMemoryBytes, number)) {
+                    return false;
+                }
+                job.memory_bytes = static_cast<std::size_t>(number);
+            } else if (key == "load-at") {
+                if (!parse_number(kProgramName, where.c_str(), "an address", value.c_str(), 0,
+                                  kMaxAddress, job.load_address)) {
+                    return false;
+                }
+            } else if (key == "start") {
+                if (!parse_number(kProgramName, where.c_str(), "an address", value.c_str(), 0,
+                                  kMaxAddress, job.start_address)) {
+                    return false;
+                }
+                start_set = true;
+            } else if (key == "max-steps") {
+                if (!parse_number(kProgramName, where.c_str(), "a count", value.c_str(), 0,
+                                  kMaxSteps, job.max_steps)) {
+                    return false;
+                }
+            } else {
+                std::fprintf(stderr, "%s: %s:%u: unrecognized setting '%s'\n", kProgramName,
+                             path, line, key.c_str());
+                return false;
+            }
+        }
+        // A machine starts at its own load address unless something said otherwise, as a
+        // single run does.
+        if (!start_set && !start_given) {
+            job.start_address = job.load_address;
+        }
+        jobs.push_back(std::move(job));
+    }
+    return true;
+}
+
+// Run a --batch manifest and write the report (user-009). The report is standard output's
+// whole content, in manifest order, and is framed by byte counts rather than by anything in
+// the guests' output, so a guest that prints a line beginning "==" cannot forge a record.
+int run_batch_manifest(const char* path, const maize::v2::BatchJobV2& defaults, bool start_given,
+                       const maize::v2::BatchOptionsV2& options) {
+    std::vector<maize::v2::BatchJobV2> jobs;
+    if (!read_manifest(path, defaults, start_given, jobs)) {
+        return 2;
+    }
+    maize::v2::BatchStatsV2 stats;
+    const std::vector<maize::v2::BatchResultV2> results =
+        maize::v2::run_batch(jobs, options, &stats);
+
+    int exit_code = 0;
+    std::uint64_t halted = 0;
+    for (std::size_t i = 0; i < results.size(); ++i) {
+        const maize::v2::BatchResultV2& outcome = results[i];
+        std::printf("== %zu %s: %s; %zu console bytes\n", i + 1, jobs[i].image_path.c_str(),
+                    describe_outcome(outcome).c_str(), outcome.console.size());
+        write_console_bytes(outcome.console);
+        std::printf("\n");
+        if (!outcome.jit_check_failure.empty()) {
+            exit_code = kExitJitMiscompile;
+        } else if (outcome.error.empty() &&
+                   outcome.result.status == maize::v2::StepStatus::Halted) {
+            ++halted;
+        } else if (exit_code == 0) {
+            exit_code = 1;
+        }
+    }
+    std::fflush(stdout);
+    std::fprintf(stderr, "%s: %zu machines on %u threads: %" PRIu64 " halted, %" PRIu64
+                 " did not\n",
+                 kProgramName, results.size(), stats.threads, halted,
+                 static_cast<std::uint64_t>(results.size()) - halted);
+    return exit_code;
+}
+
 }  // namespace
 
 int main(int argc, char** argv) {
@@ -189,9 +558,34 @@ int main(int argc, char** argv) {
     std::uint64_t load_address = kDefaultLoadAddress;
     std::uint64_t start_address = 0;
     bool start_given = false;
+    bool load_given = false;
     std::uint64_t max_steps = 100000000u;
     bool dump_registers = false;
+    bool jit_requested = false;
+    maize::v2::JitOptionsV2 jit_options;
     const char* image_path = nullptr;
+    const char* snapshot_path = nullptr;
+    std::uint64_t snapshot_every = 0;
+    const char* restore_path = nullptr;
+    const char* batch_path = nullptr;
+    std::uint64_t batch_threads = 0;
+    const char* disk_path = nullptr;
+    bool disk_async = false;
+    bool display_requested = false;
+    maize::v2::FramebufferGeometryV2 display_geometry;
+    const char* display_shm = nullptr;
+    bool entropy_requested = false;
+    bool entropy_seeded = false;
+    std::uint64_t entropy_seed = 0;
+    std::uint64_t cycle_budget = 0;
+    bool meter = false;
+    bool profile_text = false;
+    const char* profile_json_path = nullptr;
+    const char* folded_path = nullptr;
+    std::uint64_t sample_every = 0;
+    const char* symbols_path = nullptr;
+    bool show_perf = false;
+    std::uint64_t perf_every_ms = 0;
 
     for (int i = 1; i < argc; ++i) {
         const std::string argument = argv[i];
@@ -201,6 +595,99 @@ int main(int argc, char** argv) {
             return 0;
         } else if (argument == "--registers") {
             dump_registers = true;
+        } else if (argument == "--meter") {
+            meter = true;
+        } else if (argument == "--profile") {
+            profile_text = true;
+        } else if (argument == "--profile-json" && has_value) {
+            profile_json_path = argv[++i];
+        } else if (argument == "--folded-out" && has_value) {
+            folded_path = argv[++i];
+        } else if (argument == "--sample-every" && has_value) {
+            if (!parse_number(kProgramName, "--sample-every", "a count", argv[++i], 1,
+                              kMaxSampleInterval, sample_every)) {
+                return 2;
+            }
+        } else if (argument == "--symbols" && has_value) {
+            symbols_path = argv[++i];
+        } else if (argument == "--show-perf") {
+            show_perf = true;
+        } else if (argument == "--perf-every" && has_value) {
+            if (!parse_number(kProgramName, "--perf-every", "a count of milliseconds", argv[++i],
+                              1, kMaxPerfIntervalMilliseconds, perf_every_ms)) {
+                return 2;
+            }
+        } else if (argument == "--jit") {
+            jit_requested = true;
+        } else if (argument == "--jit-check") {
+            // The check is a way of running the JIT, so asking for it asks for the JIT too.
+            jit_requested = true;
+            jit_options.check = true;
+        } else if (argument == "--jit-cache-mb" && has_value) {
+            std::uint64_t megabytes = 0;
+            if (!parse_number(kProgramName, "--jit-cache-mb", "a size in MiB", argv[++i], 1,
+                              kMaxJitCacheMegabytes, megabytes)) {
+                return 2;
+            }
+            jit_options.cache_bytes = static_cast<std::size_t>(megabytes) << 20;
+        } else if (argument == "--snapshot-out" && has_value) {
+            snapshot_path = argv[++i];
+        } else if (argument == "--snapshot-every" && has_value) {
+            if (!parse_number(kProgramName, "--snapshot-every", "a count", argv[++i], 0,
+                              kMaxSnapshotInterval, snapshot_every)) {
+                return 2;
+            }
+        } else if (argument == "--restore" && has_value) {
+            restore_path = argv[++i];
+        } else if (argument == "--batch" && has_value) {
+            batch_path = argv[++i];
+        } else if (argument == "--disk" && has_value) {
+            disk_path = argv[++i];
+        } else if (argument == "--disk-async") {
+            disk_async = true;
+        } else if (argument == "--display" && has_value) {
+            // <w>x<h>, each side a number in the usual forms. The split is at the first x that is
+            // not the width's own 0x prefix, so $280x$1E0 and 0x280x0x1E0 mean what 640x480 does.
+            const std::string text = argv[++i];
+            const bool hex_width = text.size() > 1 && text[0] == '0' && (text[1] | 0x20) == 'x';
+            const std::size_t split = text.find_first_of("xX", hex_width ? 2 : 0);
+            const std::string width_text = split == std::string::npos ? "" : text.substr(0, split);
+            const std::string height_text =
+                split == std::string::npos ? "" : text.substr(split + 1);
+            std::uint64_t width = 0;
+            std::uint64_t height = 0;
+            if (!parse_number(kProgramName, "--display", "a width in pixels",
+                              width_text.c_str(), 1, kMaxDisplaySide, width) ||
+                !parse_number(kProgramName, "--display", "a height in pixels",
+                              height_text.c_str(), 1, kMaxDisplaySide, height)) {
+                return 2;
+            }
+            display_requested = true;
+            display_geometry.width = static_cast<std::uint32_t>(width);
+            display_geometry.height = static_cast<std::uint32_t>(height);
+        } else if (argument == "--display-surfaces" && has_value) {
+            std::uint64_t surfaces = 0;
+            if (!parse_number(kProgramName, "--display-surfaces", "a count", argv[++i], 1,
+                              maize::v2::FramebufferDeviceV2::kMaxSurfaces, surfaces)) {
+                return 2;
+            }
+            display_geometry.surfaces = static_cast<unsigned>(surfaces);
+        } else if (argument == "--display-shm" && has_value) {
+            display_shm = argv[++i];
+        } else if (argument == "--entropy") {
+            entropy_requested = true;
+        } else if (argument == "--entropy-seed" && has_value) {
+            if (!parse_number(kProgramName, "--entropy-seed", "a seed", argv[++i], 0, UINT64_MAX,
+                              entropy_seed)) {
+                return 2;
+            }
+            entropy_requested = true;
+            entropy_seeded = true;
+        } else if (argument == "--threads" && has_value) {
+            if (!parse_number(kProgramName, "--threads", "a count", argv[++i], 1, kMaxThreads,
+                              batch_threads)) {
+                return 2;
+            }
         } else if (argument == "--memory" && has_value) {
             // The lower bound is the option's own rule rather than a separate test after the
             // fact: a memory of zero bytes is as unusable as one of 2^70, and both are refused
@@ -214,6 +701,7 @@ int main(int argc, char** argv) {
                               load_address)) {
                 return 2;
             }
+            load_given = true;
         } else if (argument == "--start" && has_value) {
             if (!parse_number(kProgramName, "--start", "an address", argv[++i], 0, kMaxAddress,
                               start_address)) {
@@ -226,6 +714,11 @@ int main(int argc, char** argv) {
                               max_steps)) {
                 return 2;
             }
+        } else if (argument == "--cycle-budget" && has_value) {
+            if (!parse_number(kProgramName, "--cycle-budget", "a count", argv[++i], 0, UINT64_MAX,
+                              cycle_budget)) {
+                return 2;
+            }
         } else if (!argument.empty() && argument[0] == '-') {
             std::fprintf(stderr, "%s: unrecognized option '%s'\n", kProgramName, argument.c_str());
             print_usage(stderr, kProgramName);
@@ -238,13 +731,93 @@ int main(int argc, char** argv) {
         }
     }
 
-    if (image_path == nullptr) {
+    // A batch names its machines in the manifest, and each one's console output has a place in
+    // the report, so nothing that shapes a single run applies to it.
+    if (batch_path != nullptr) {
+        if (image_path != nullptr || restore_path != nullptr || snapshot_path != nullptr ||
+            dump_registers || disk_path != nullptr || display_requested || entropy_requested ||
+            cycle_budget != 0 || meter || profile_text || profile_json_path != nullptr ||
+            folded_path != nullptr || sample_every != 0 || symbols_path != nullptr ||
+            show_perf || perf_every_ms != 0) {
+            std::fprintf(stderr,
+                         "%s: --batch runs the machines its manifest names; an image, --restore, "
+                         "--snapshot-out, --registers, --disk, --display, --entropy, "
+                         "--cycle-budget, --meter, --profile, --folded-out and --show-perf do not "
+                         "apply to it\n",
+                         kProgramName);
+            return 2;
+        }
+        maize::v2::BatchJobV2 defaults;
+        defaults.memory_bytes = static_cast<std::size_t>(memory_bytes);
+        defaults.load_address = load_address;
+        defaults.start_address = start_address;
+        defaults.max_steps = max_steps;
+        maize::v2::BatchOptionsV2 options;
+        options.threads = static_cast<unsigned>(batch_threads);
+        options.jit = jit_requested;
+        options.jit_options = jit_options;
+        if (jit_requested && !maize::v2::JitV2::kHasBackend) {
+            std::fprintf(stderr, "%s: --jit: this host has no JIT backend; running interpreted\n",
+                         kProgramName);
+        }
+        return run_batch_manifest(batch_path, defaults, start_given, options);
+    }
+    if (batch_threads != 0) {
+        std::fprintf(stderr, "%s: --threads applies only to --batch\n", kProgramName);
+        return 2;
+    }
+
+    if (image_path == nullptr && restore_path == nullptr) {
         print_usage(stderr, kProgramName);
         return 2;
     }
+    // A restored machine's memory and program counter are the snapshot's, so an image, a load
+    // address or a start address would be refused rather than quietly lost.
+    if (restore_path != nullptr && (image_path != nullptr || start_given || load_given)) {
+        std::fprintf(stderr,
+                     "%s: --restore resumes a saved machine; an image, --load-at and --start do "
+                     "not apply to it\n",
+                     kProgramName);
+        return 2;
+    }
+    if (disk_async && disk_path == nullptr) {
+        std::fprintf(stderr, "%s: --disk-async needs --disk to attach\n", kProgramName);
+        return 2;
+    }
+    if ((display_shm != nullptr || display_geometry.surfaces != 1) && !display_requested) {
+        std::fprintf(stderr, "%s: --display-surfaces and --display-shm need --display to attach\n",
+                     kProgramName);
+        return 2;
+    }
+    // A profile counts the interpreter's own work, one instruction at a time (profile_v2.h), so
+    // it and the JIT are two different runs and the command line has to choose.
+    // Sampling (user-024) is a profile's too, and goes round the same loop.
+    const bool profiling = profile_text || profile_json_path != nullptr || folded_path != nullptr;
+    if (profiling && jit_requested) {
+        std::fprintf(stderr,
+                     "%s: --profile and --folded-out run the machine interpreted; --jit does not "
+                     "apply\n",
+                     kProgramName);
+        return 2;
+    }
+    if (sample_every != 0 && folded_path == nullptr) {
+        std::fprintf(stderr, "%s: --sample-every needs --folded-out to write to\n",
+                     kProgramName);
+        return 2;
+    }
+    if (symbols_path != nullptr && !profiling) {
+        std::fprintf(stderr, "%s: --symbols names what --profile and --folded-out report\n",
+                     kProgramName);
+        return 2;
+    }
+    if (snapshot_every != 0 && snapshot_path == nullptr) {
+        std::fprintf(stderr, "%s: --snapshot-every needs --snapshot-out to write to\n",
+                     kProgramName);
+        return 2;
+    }
 
     std::vector<std::uint8_t> image;
-    if (!read_file(image_path, image)) {
+    if (image_path != nullptr && !read_file(image_path, image)) {
         std::fprintf(stderr, "%s: cannot read '%s'\n", kProgramName, image_path);
         return 2;
     }
@@ -254,32 +827,215 @@ int main(int argc, char** argv) {
         return 2;
     }
     maize::v2::MemoryV2& memory = *memory_owner;
-    if (!memory.load_image(load_address, image.data(), image.size())) {
+    if (image_path != nullptr && !memory.load_image(load_address, image.data(), image.size())) {
         std::fprintf(stderr, "%s: the image does not fit in memory at the load address\n",
                      kProgramName);
         return 2;
     }
 
     maize::v2::InterpreterV2 machine(memory, start_given ? start_address : load_address);
-    maize::v2::StepResult result = machine.run(max_steps);
-
-    // A DELIVERED trap is a stopping point for this host and not for the machine (maize-464):
-    // run() hands control back at the delivery so a caller can see it, and the machine's program
-    // counter is already on the handler. Keep going until something actually stops it, which is
-    // a halt, the step budget, or a trap that could not be delivered.
-    while (result.status == maize::v2::StepStatus::Trapped &&
-           result.disposition == maize::v2::TrapDisposition::Delivered) {
-        if (max_steps != 0 && machine.steps_taken() >= max_steps) {
+    // Block storage (user-018), attached before a restore so the restored machine carries the
+    // class its snapshot was taken with. The file is the disk itself, not a copy of it: what the
+    // guest writes is in the file when mzvm exits, and a snapshot does not hold it.
+    maize::v2::FileBlockImageV2 disk;
+    if (disk_path != nullptr) {
+        if (!disk.open(disk_path)) {
+            std::fprintf(stderr, "%s: cannot open '%s' for reading and writing\n", kProgramName,
+                         disk_path);
+            return 2;
+        }
+        machine.device_surface().block_storage().host_attach_image(&disk, disk_async);
+    }
+    // The framebuffer (user-019), attached before a restore for the same reason. With no segment
+    // named, its frames are counted and go nowhere, which is a display for a guest nobody is
+    // watching; with one, each present is copied once into the segment for a presenter to show.
+    maize::v2::HeadlessFramebufferV2 headless;
+    maize::v2::SharedFramebufferV2 shared_display;
+    if (display_requested) {
+        maize::v2::FramebufferSinkV2* display = &headless;
+        if (display_shm != nullptr) {
+            if (!shared_display.create(display_shm, display_geometry)) {
+                std::fprintf(stderr, "%s: cannot create the shared-memory segment '%s'\n",
+                             kProgramName, display_shm);
+                return 2;
+            }
+            display = &shared_display;
+        }
+        machine.device_surface().framebuffer().host_attach_display(display, display_geometry);
+    }
+    // The entropy device (user-021), attached before a restore for the same reason. Keyed from
+    // the host, its words are the host generator's expanded a buffer at a time; keyed from a
+    // seed, they are the same on every run given it.
+    maize::v2::ChaChaEntropyV2 entropy;
+    if (entropy_requested) {
+        if (entropy_seeded) {
+            entropy.seed(entropy_seed);
+        } else if (!entropy.seed_from_host()) {
+            std::fprintf(stderr, "%s: --entropy: the host's generator gave nothing to key from\n",
+                         kProgramName);
+            return 2;
+        }
+        machine.device_surface().entropy().host_attach_source(&entropy);
+    }
+    if (restore_path != nullptr && !restore_machine(machine, restore_path)) {
+        return 2;
+    }
+    // A restored machine's cycles carry on from the snapshot's, so the budget is judged against
+    // the whole run, as --max-steps is (user-022).
+    machine.set_cycle_limit(cycle_budget);
+    // A host with no JIT backend runs the program anyway. The JIT changes how fast the machine
+    // runs and never what it does, so refusing to run would be the larger surprise.
+    if (jit_requested && !machine.enable_jit(jit_options)) {
+        std::fprintf(stderr, "%s: --jit: %s; running interpreted\n", kProgramName,
+                     maize::v2::JitV2::kHasBackend
+                         ? "the code cache could not be mapped"
+                         : "this host has no JIT backend");
+    }
+    // The profile (user-023) counts from the machine as it stands here, so a restored machine's
+    // report is of the run from the restore on. Its file is opened now, before a long run, so a
+    // path it cannot write to is found out before the run rather than after it.
+    maize::v2::ProfileV2 profile;
+    std::FILE* profile_json = nullptr;
+    if (profile_json_path != nullptr) {
+        profile_json = std::fopen(profile_json_path, "w");
+        if (profile_json == nullptr) {
+            std::fprintf(stderr, "%s: cannot write '%s'\n", kProgramName, profile_json_path);
+            return 2;
+        }
+    }
+    maize::v2::SymbolTableV2 symbols;
+    if (symbols_path != nullptr) {
+        std::string error;
+        if (!symbols.read(symbols_path, error)) {
+            std::fprintf(stderr, "%s: --symbols: %s\n", kProgramName, error.c_str());
+            return 2;
+        }
+    }
+    std::FILE* folded = nullptr;
+    if (folded_path != nullptr) {
+        folded = std::fopen(folded_path, "w");
+        if (folded == nullptr) {
+            std::fprintf(stderr, "%s: cannot write '%s'\n", kProgramName, folded_path);
+            return 2;
+        }
+        profile.set_sample_interval(sample_every != 0 ? sample_every : kDefaultSampleInterval);
+    }
+    if (profiling) {
+        machine.host_attach_profile(&profile);
+    }
+    // Snapshots (user-007). The full one is taken before the first instruction, so the file is
+    // restorable from the moment it exists, and each incremental one carries only the pages the
+    // guest wrote in the interval before it.
+    std::FILE* snapshots = nullptr;
+    if (snapshot_path != nullptr) {
+        snapshots = std::fopen(snapshot_path, "wb");
+        if (snapshots == nullptr || !maize::v2::write_snapshot(snapshots, machine.take_full_snapshot())) {
+            std::fprintf(stderr, "%s: cannot write '%s'\n", kProgramName, snapshot_path);
+            if (snapshots != nullptr) {
+                std::fclose(snapshots);
+            }
+            return 2;
+        }
+    }
+
+    // The guest's console output goes to stdout as the guest writes it (user-016), whatever the
+    // machine's stopping reason turns out to be. A console restored from a snapshot keeps the
+    // bytes the original run buffered, and they are not written again: the run that took the
+    // snapshot already wrote them, and a resumed guest's output is what it emits from here on.
+    maize::v2::ConsoleStreamOptionsV2 stream_options;
+    stream_options.line_flush = stdout_is_terminal();
+    maize::v2::StreamingConsoleSinkV2 console(stdout, stream_options);
+    machine.device_surface().console().host_attach_sink(&console);
+    // And its input comes from stdin, descriptor 0 (user-017), which is read only once the guest
+    // asks for it.
+    maize::v2::StreamingConsoleSourceV2 input(0);
+    machine.device_surface().console().host_attach_source(&input);
+
+    // The performance counters (user-025), begun here so they count the run and nothing before
+    // it. The display's source is registered only when there is a display, as v1's was.
+    maize::v2::PerfRegistryV2 perf;
+    maize::v2::CpuPerfSourceV2 cpu_perf(machine);
+    maize::v2::TranslatorPerfSourceV2 translator_perf(machine);
+    maize::v2::ConsolePerfSourceV2 console_perf(machine.device_surface().console());
+    maize::v2::TimerPerfSourceV2 timer_perf(machine.device_surface().timer());
+    maize::v2::DisplayPerfSourceV2 display_perf(machine.device_surface().framebuffer());
+    const bool perf_wanted = show_perf || perf_every_ms != 0;
+    if (perf_wanted) {
+        perf.add(&cpu_perf);
+        perf.add(&translator_perf);
+        perf.add(&console_perf);
+        perf.add(&timer_perf);
+        if (display_requested) {
+            perf.add(&display_perf);
+        }
+        perf.start();
+    }
+
+    maize::v2::StepResult result;
+    bool snapshot_failed = false;
+    for (;;) {
+        std::uint64_t limit = max_steps;
+        std::uint64_t next_snapshot = 0;
+        if (snapshot_every != 0 && snapshot_every <= UINT64_MAX - machine.steps_taken()) {
+            next_snapshot = machine.steps_taken() + snapshot_every;
+            if (limit == 0 || next_snapshot < limit) {
+                limit = next_snapshot;
+            }
+        }
+        if (perf_every_ms != 0 && kPerfSliceInstructions <= UINT64_MAX - machine.steps_taken()) {
+            const std::uint64_t slice_end = machine.steps_taken() + kPerfSliceInstructions;
+            if (limit == 0 || slice_end < limit) {
+                limit = slice_end;
+            }
+        }
+        result = maize::v2::run_until(machine, limit);
+        const bool can_continue =
+            result.status == maize::v2::StepStatus::Advanced ||
+            (result.status == maize::v2::StepStatus::Trapped &&
+             result.disposition == maize::v2::TrapDisposition::Delivered);
+        if (!can_continue) {
             break;
         }
-        result = machine.run(max_steps == 0 ? 0 : max_steps - machine.steps_taken());
+        if (perf_every_ms != 0 &&
+            perf.elapsed_us() - perf.last_sample_us() >= perf_every_ms * 1000) {
+            perf.sample(stderr);
+        }
+        if (next_snapshot != 0 && machine.steps_taken() == next_snapshot) {
+            maize::v2::MachineSnapshotV2 snapshot;
+            if (!machine.take_incremental_snapshot(snapshot) ||
+                !maize::v2::write_snapshot(snapshots, snapshot)) {
+                snapshot_failed = true;
+                break;
+            }
+        }
+        // A run that can continue stopped at a limit: its own, which ends it, or a snapshot's or
+        // a slice's, which does not.
+        if ((max_steps != 0 && machine.steps_taken() >= max_steps) ||
+            machine.cycle_limit_reached()) {
+            break;
+        }
+    }
+    if (snapshots != nullptr) {
+        std::fclose(snapshots);
     }
 
-    // The guest's console output, whatever the machine's stopping reason: bytes the guest emitted
-    // before a trap or a step limit genuinely left the console, and swallowing them would hide
-    // the output of exactly the run a person most wants to see. Written as raw bytes rather than
-    // through printf, so an embedded zero byte or a non-UTF-8 byte reaches stdout unreinterpreted.
-    write_console_bytes(machine.device_surface().console_output());
+    // Everything the guest wrote is out before a status line says why it stopped: bytes the guest
+    // emitted before a trap or a step limit genuinely left the console, and a report that
+    // overtook them would hide the output of exactly the run a person most wants to see.
+    console.close();
+    machine.device_surface().console().host_attach_sink(nullptr);
+    machine.device_surface().console().host_attach_source(nullptr);
+    machine.device_surface().block_storage().host_attach_image(nullptr);
+    const std::uint64_t frames_presented = machine.device_surface().framebuffer().host_presents();
+    machine.device_surface().framebuffer().host_attach_display(nullptr);
+    shared_display.close();
+
+    if (snapshot_failed) {
+        std::fprintf(stderr, "%s: cannot write '%s'; stopped at $%016" PRIX64 " after %" PRIu64
+                     " instructions\n",
+                     kProgramName, snapshot_path, machine.pc(), machine.steps_taken());
+        return 2;
+    }
 
     int exit_code = 0;
     switch (result.status) {
@@ -329,12 +1085,54 @@ int main(int argc, char** argv) {
             exit_code = 1;
             break;
         case maize::v2::StepStatus::Advanced:
-            std::fprintf(stderr, "%s: step limit reached at $%016" PRIX64 "\n", kProgramName,
+            std::fprintf(stderr, "%s: %s reached at $%016" PRIX64 "\n", kProgramName,
+                         machine.cycle_limit_reached() ? "cycle budget" : "step limit",
                          machine.pc());
             exit_code = 1;
             break;
     }
 
+    // A miscompile outranks whatever the guest did, because the guest's outcome is only worth
+    // reporting from a machine that ran it correctly. The interpreter's state stands when the
+    // check fires, so the run above did finish correctly; the status says it needed saving.
+    if (machine.jit() != nullptr && !machine.jit()->check_failure().empty()) {
+        std::fprintf(stderr, "%s: --jit-check: %s\n", kProgramName,
+                     machine.jit()->check_failure().c_str());
+        exit_code = kExitJitMiscompile;
+    }
+    // The cycles the run consumed (user-022), after why it stopped.
+    if (meter) {
+        std::fprintf(stderr, "%" PRIu64 " cycles\n", machine.cycles());
+    }
+    // How many frames the guest presented, after why it stopped, for a run with nothing showing
+    // them to be judged by.
+    if (display_requested) {
+        std::fprintf(stderr, "%" PRIu64 " frames presented\n", frames_presented);
+    }
+    // The performance report and the profile, after the one-line counts, since they run to
+    // many lines.
+    if (show_perf) {
+        perf.emit(stderr);
+    }
+    if (profile_text) {
+        profile.write_text(stderr, machine, &symbols);
+    }
+    if (profile_json != nullptr) {
+        const bool written = profile.write_json(profile_json, machine);
+        if (std::fclose(profile_json) != 0 || !written) {
+            std::fprintf(stderr, "%s: cannot write '%s'\n", kProgramName, profile_json_path);
+            exit_code = 2;
+        }
+    }
+    if (folded != nullptr) {
+        const bool written = profile.write_folded(folded, symbols);
+        if (std::fclose(folded) != 0 || !written) {
+            std::fprintf(stderr, "%s: cannot write '%s'\n", kProgramName, folded_path);
+            exit_code = 2;
+        }
+    }
+    machine.host_attach_profile(nullptr);
+
     if (dump_registers) {
         for (unsigned n = 0; n < maize::v2::kRegisterCount; ++n) {
             std::printf("r%-2u $%016" PRIX64 "%s", n, machine.registers().raw(n),
@@ -0,0 +1,266 @@
+// network_v2.cpp (user-020): the network device's transmit and receive, the lock-free frame ring,
+// and the virtual switch built from them.
+
+#include "network_v2.h"
+
+#include <chrono>
+#include <cstring>
+
+#include "memory_v2.h"
+
+namespace maize::v2 {
+
+void NetworkDeviceV2::transmit(std::uint64_t length) {
+    // device-surface.md: "A transmit whose length is zero or exceeds the maximum frame length is a
+    // defined, non-transmitting failure that sets the invalid-request status bit." A transmit
+    // buffer never registered, or not wholly populated memory, is the bulk-transfer rule's
+    // version of the same failure.
+    std::uint64_t unused = 0;
+    if (length == 0 || length > link_->max_frame() || !transmit_registered_ ||
+        memory_ == nullptr || !memory_->check_range(transmit_base_, length, unused)) {
+        acknowledgeable_status_ |= status_mask(network_status_bit::kInvalidRequest);
+        return;
+    }
+    link_->send(memory_->host_range(transmit_base_, length), static_cast<std::size_t>(length));
+}
+
+void NetworkDeviceV2::host_poll_link() {
+    if (link_->take_dropped() != 0) {
+        acknowledgeable_status_ |= status_mask(network_status_bit::kOverrun);
+    }
+    // A frame that reaches the device with nowhere to go is dropped, every one of them, since a
+    // frame left in the link for a buffer the guest might register later would be one delivered
+    // out of its time.
+    std::size_t length = 0;
+    std::uint64_t unused = 0;
+    while (waiting_ == 0 && (length = link_->peek()) != 0) {
+        if (!receive_registered_ || memory_ == nullptr ||
+            !memory_->check_range(receive_base_, length, unused)) {
+            link_->discard();
+            acknowledgeable_status_ |= status_mask(network_status_bit::kOverrun);
+            continue;
+        }
+        link_->receive(memory_->host_range_for_write(receive_base_, length));
+        waiting_ = length;
+    }
+    publish_line();
+}
+
+FrameQueueV2::FrameQueueV2(std::size_t frames, std::size_t max_frame) : max_frame_(max_frame) {
+    std::size_t capacity = 1;
+    while (capacity < frames) {
+        capacity <<= 1;
+    }
+    mask_ = capacity - 1;
+    slots_ = std::make_unique<Slot[]>(capacity);
+    for (std::size_t i = 0; i < capacity; ++i) {
+        slots_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    bytes_.resize(capacity * max_frame);
+}
+
+// A slot whose sequence equals a position is free for the producer claiming that position, and
+// one whose sequence is the position plus one holds that position's frame. The consumer frees a
+// slot by moving its sequence a whole lap on, to the position the next producer to land there
+// will claim.
+bool FrameQueueV2::push(const std::uint8_t* frame, std::size_t length) {
+    std::uint64_t position = tail_.load(std::memory_order_relaxed);
+    Slot* slot = nullptr;
+    for (;;) {
+        slot = &slots_[position & mask_];
+        const std::uint64_t sequence = slot->sequence.load(std::memory_order_acquire);
+        const std::int64_t lead =
+            static_cast<std::int64_t>(sequence) - static_cast<std::int64_t>(position);
+        if (lead == 0) {
+            if (tail_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (lead < 0) {
+            return false;  // the slot still holds the frame from a lap ago: the ring is full
+        } else {
+            position = tail_.load(std::memory_order_relaxed);
+        }
+    }
+    std::memcpy(bytes_.data() + (position & mask_) * max_frame_, frame, length);
+    slot->length = length;
+    slot->sequence.store(position + 1, std::memory_order_release);
+    return true;
+}
+
+std::size_t FrameQueueV2::peek() const {
+    const Slot& slot = slots_[head_ & mask_];
+    return slot.sequence.load(std::memory_order_acquire) == head_ + 1 ? slot.length : 0;
+}
+
+void FrameQueueV2::pop(std::uint8_t* into) {
+    Slot& slot = slots_[head_ & mask_];
+    if (into != nullptr) {
+        std::memcpy(into, bytes_.data() + (head_ & mask_) * max_frame_, slot.length);
+    }
+    slot.sequence.store(head_ + mask_ + 1, std::memory_order_release);
+    ++head_;
+}
+
+namespace {
+
+// A MAC address in the low 48 bits, with bit 48 set so that no learned address is zero.
+constexpr std::uint64_t kLearned = std::uint64_t{1} << 48;
+constexpr std::size_t kAddressBytes = 6;
+
+std::uint64_t address_at(const std::uint8_t* bytes) {
+    std::uint64_t address = 0;
+    for (std::size_t i = 0; i < kAddressBytes; ++i) {
+        address = (address << 8) | bytes[i];
+    }
+    return address | kLearned;
+}
+
+}  // namespace
+
+class VirtualSwitchV2::Port final : public NetworkLinkV2 {
+  public:
+    Port(VirtualSwitchV2& owner, const VirtualSwitchOptionsV2& options)
+        : owner_(owner), max_frame_(options.max_frame),
+          queue_(options.queue_frames, options.max_frame) {}
+
+    std::size_t max_frame() const override { return max_frame_; }
+
+    void send(const std::uint8_t* frame, std::size_t length) override {
+        owner_.forward(*this, frame, length);
+    }
+
+    std::size_t peek() override { return queue_.peek(); }
+    void receive(std::uint8_t* into) override { queue_.pop(into); }
+    void discard() override { queue_.pop(nullptr); }
+
+    std::uint64_t take_dropped() override {
+        // One load in the usual case, where nothing was dropped, rather than an exchange.
+        return dropped_.load(std::memory_order_relaxed) == 0
+                   ? 0
+                   : dropped_.exchange(0, std::memory_order_relaxed);
+    }
+
+    void wait(std::uint64_t nanoseconds) override {
+        std::unique_lock<std::mutex> guard(lock_);
+        // Asleep is announced before the ring is looked at, and a producer looks at asleep after
+        // it publishes, so between them at least one sees the other: a frame published as the
+        // owner goes to sleep either stops it sleeping or wakes it.
+        sleeping_.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        const auto arrived = [this] { return queue_.peek() != 0 || !connected(); };
+        if (nanoseconds == UINT64_MAX) {
+            ready_.wait(guard, arrived);
+        } else {
+            ready_.wait_for(guard, std::chrono::nanoseconds(nanoseconds), arrived);
+        }
+        sleeping_.store(false, std::memory_order_relaxed);
+    }
+
+    // Some other port is live: this one's own place in the count is taken off while it is.
+    bool connected() const override {
+        return owner_.live_ports() > (hung_up_.load(std::memory_order_acquire) ? 0u : 1u);
+    }
+
+    void hang_up() override {
+        if (!hung_up_.exchange(true, std::memory_order_acq_rel)) {
+            owner_.hang_up(*this);
+        }
+    }
+
+    // Any thread. Wake the owner if it is waiting, to look again at what it waits for.
+    void wake() {
+        std::lock_guard<std::mutex> guard(lock_);
+        ready_.notify_all();
+    }
+
+    // Any thread but the owner's.
+    bool offer(const std::uint8_t* frame, std::size_t length) {
+        if (!queue_.push(frame, length)) {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (sleeping_.load(std::memory_order_relaxed)) {
+            std::lock_guard<std::mutex> guard(lock_);
+            ready_.notify_all();
+        }
+        return true;
+    }
+
+    std::atomic<std::uint64_t> address{0};
+
+  private:
+    VirtualSwitchV2& owner_;
+    std::size_t max_frame_;
+    FrameQueueV2 queue_;
+    std::atomic<std::uint64_t> dropped_{0};
+    std::atomic<bool> sleeping_{false};
+    std::atomic<bool> hung_up_{false};
+    std::mutex lock_;
+    std::condition_variable ready_;
+};
+
+VirtualSwitchV2::VirtualSwitchV2(const VirtualSwitchOptionsV2& options) : options_(options) {
+    if (options_.max_frame == 0) {
+        options_.max_frame = 1;
+    }
+    if (options_.queue_frames == 0) {
+        options_.queue_frames = 1;
+    }
+}
+
+VirtualSwitchV2::~VirtualSwitchV2() = default;
+
+NetworkLinkV2* VirtualSwitchV2::connect() {
+    ports_.push_back(std::make_unique<Port>(*this, options_));
+    live_.fetch_add(1, std::memory_order_acq_rel);
+    return ports_.back().get();
+}
+
+// A waiter tests connected() under its port's lock and wake() notifies under it, so a waiter
+// that saw the count before it fell is asleep by the time it is woken, and one that sees it
+// after does not sleep. Every port is woken, not only the last: hanging up is rare, and a port
+// that still has company just looks again and goes back to sleep.
+void VirtualSwitchV2::hang_up(Port& port) {
+    live_.fetch_sub(1, std::memory_order_acq_rel);
+    for (const std::unique_ptr<Port>& other : ports_) {
+        if (other.get() != &port) {
+            other->wake();
+        }
+    }
+}
+
+void VirtualSwitchV2::forward(Port& from, const std::uint8_t* frame, std::size_t length) {
+    if (length >= 2 * kAddressBytes) {
+        const std::uint64_t source = address_at(frame + kAddressBytes);
+        if (from.address.load(std::memory_order_relaxed) != source) {
+            from.address.store(source, std::memory_order_relaxed);
+        }
+        // The group bit, the low bit of the first byte, marks broadcast and multicast.
+        if ((frame[0] & 1u) == 0) {
+            const std::uint64_t destination = address_at(frame);
+            for (const std::unique_ptr<Port>& port : ports_) {
+                if (port.get() != &from &&
+                    port->address.load(std::memory_order_relaxed) == destination) {
+                    deliver(*port, frame, length);
+                    return;
+                }
+            }
+        }
+    }
+    for (const std::unique_ptr<Port>& port : ports_) {
+        if (port.get() != &from) {
+            deliver(*port, frame, length);
+        }
+    }
+}
+
+void VirtualSwitchV2::deliver(Port& to, const std::uint8_t* frame, std::size_t length) {
+    if (to.offer(frame, length)) {
+        delivered_.fetch_add(1, std::memory_order_relaxed);
+    } else {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+}  // namespace maize::v2
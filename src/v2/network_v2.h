@@ -0,0 +1,129 @@
+// network_v2.h (user-020): a virtual switch the network devices of several machines in one host
+// process plug into, so guests exchange frames with no real network under them.
+//
+// device_v2.h declares the device and the NetworkLinkV2 it sends and receives through; each port
+// of a VirtualSwitchV2 is one such link, and network_v2.cpp holds the switch and the parts of the
+// device that move frames.
+//
+// FRAMES MOVE MEMORY TO MEMORY. A port's inbound frames wait in a FrameQueueV2, a fixed ring of
+// frame-sized slots allocated once when the switch is built. A transmit copies the frame from the
+// sender's guest memory into a slot of the receiving port's ring, and a receive copies it from the
+// slot into the receiver's guest memory: two copies end to end, no allocation, and no system
+// call, lock or socket on the way.
+//
+// THE RINGS ARE LOCK-FREE. Every machine runs on a thread of its own, and any of them may send to
+// any port, so a ring has many producers and one consumer, the machine the port belongs to. A
+// producer claims a slot by advancing the ring's tail with one compare-and-swap, fills it, and
+// publishes it through the slot's own sequence number, which is the bounded queue Dmitry Vyukov
+// described; a consumer reads the slot at the head when its sequence says it is published. A
+// producer that finds the ring full drops the frame and counts it against the port, which is a
+// frame the guest is told it lost, by the overrun bit. Nothing waits on a lock except a machine
+// with nothing to do: a port's owner parked in wait_for_interrupt sleeps on a condition variable,
+// and a producer takes that lock only when it sees the owner asleep.
+//
+// THE SWITCH LEARNS. device-surface.md leaves addressing to the guest, and the switch reads
+// nothing of a frame but what an Ethernet switch reads: a frame of at least the twelve bytes of
+// two MAC addresses teaches the switch that its source address is behind the port that sent it,
+// and one whose destination the switch has learned goes to that port alone. Everything else, a
+// broadcast or multicast destination, an unlearned one, or a frame too short to carry addresses,
+// goes to every port but the sender's. Each port remembers one address, the last it sent from,
+// which is a machine with one network device; a lookup is one atomic load per port.
+//
+// EVERY PORT IS CONNECTED BEFORE ANY MACHINE RUNS. connect() is not safe against traffic. A
+// machine that stops hangs its port up, and stays in the switch: frames for it are dropped when
+// its ring fills, as before. What hanging up changes is the ports left behind. When the last
+// port but one hangs up, the one left has nobody to hear from, so its machine's waiter is woken
+// and the device stops waiting on it; a guest parked on that link alone is then suspended, as a
+// guest waiting on no device is, rather than sleeping forever on a frame nothing can send.
+
+#ifndef MAIZE_V2_NETWORK_V2_H
+#define MAIZE_V2_NETWORK_V2_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "device_v2.h"
+
+namespace maize::v2 {
+
+class FrameQueueV2 {
+  public:
+    // `frames` is rounded up to a power of two, so a slot is an index and a mask.
+    FrameQueueV2(std::size_t frames, std::size_t max_frame);
+
+    FrameQueueV2(const FrameQueueV2&) = delete;
+    FrameQueueV2& operator=(const FrameQueueV2&) = delete;
+
+    // Any thread. False, with nothing queued, when the ring is full.
+    bool push(const std::uint8_t* frame, std::size_t length);
+
+    // The consumer's thread only. The length of the frame at the head, or zero when none is.
+    std::size_t peek() const;
+    // Copy the head frame into `into` when it is not null, and free its slot. Only after a
+    // nonzero peek().
+    void pop(std::uint8_t* into);
+
+    std::size_t capacity() const { return mask_ + 1; }
+
+  private:
+    struct Slot {
+        std::atomic<std::uint64_t> sequence{0};
+        std::size_t length = 0;
+    };
+
+    std::size_t mask_;
+    std::size_t max_frame_;
+    std::unique_ptr<Slot[]> slots_;
+    std::vector<std::uint8_t> bytes_;  // slot i's frame at i * max_frame_
+    // Apart, so the producers' compare-and-swap and the consumer's stores do not share a line.
+    alignas(64) std::atomic<std::uint64_t> tail_{0};
+    alignas(64) std::uint64_t head_ = 0;
+};
+
+struct VirtualSwitchOptionsV2 {
+    // The largest frame the switch carries: an Ethernet frame without its check sequence.
+    std::size_t max_frame = 1514;
+    // The frames each port holds for its machine before it drops what comes next.
+    std::size_t queue_frames = 256;
+};
+
+class VirtualSwitchV2 {
+  public:
+    explicit VirtualSwitchV2(const VirtualSwitchOptionsV2& options = {});
+    ~VirtualSwitchV2();
+
+    VirtualSwitchV2(const VirtualSwitchV2&) = delete;
+    VirtualSwitchV2& operator=(const VirtualSwitchV2&) = delete;
+
+    // A new port, owned by the switch and valid for as long as it is. Before any traffic.
+    NetworkLinkV2* connect();
+
+    std::size_t ports() const { return ports_.size(); }
+    // Ports connected and not yet hung up.
+    std::size_t live_ports() const { return live_.load(std::memory_order_acquire); }
+    // Frames delivered to some port's ring, and frames a full ring dropped, over every port.
+    std::uint64_t delivered() const { return delivered_.load(std::memory_order_relaxed); }
+    std::uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+  private:
+    class Port;
+
+    void forward(Port& from, const std::uint8_t* frame, std::size_t length);
+    void deliver(Port& to, const std::uint8_t* frame, std::size_t length);
+    void hang_up(Port& port);
+
+    VirtualSwitchOptionsV2 options_;
+    std::vector<std::unique_ptr<Port>> ports_;
+    std::atomic<std::uint64_t> delivered_{0};
+    std::atomic<std::uint64_t> dropped_{0};
+    std::atomic<std::size_t> live_{0};
+};
+
+}  // namespace maize::v2
+
+#endif  // MAIZE_V2_NETWORK_V2_H
@@ -412,6 +412,16 @@ constexpr std::int8_t instruction_length(std::uint8_t opcode_byte) {
     return kLengthTable[opcode_byte];
 }
 
+// The instructions that end a basic block wherever they go, taken or not: the ten conditional
+// branches, and the jumps, calls and returns. A block also ends wherever control lands other
+// than after the instruction before it, which a trap or a trap_return makes happen, so a caller
+// that follows the machine checks the next address as well (the profile, user-023, and the JIT's
+// entry points, user-002).
+constexpr bool ends_basic_block(std::uint8_t opcode) {
+    return (opcode >= op::kBranchBase && opcode <= op::kBranchBase + 9) ||
+           (opcode >= op::kJumpDisp && opcode <= op::kReturn);
+}
+
 }  // namespace maize::v2
 
 #endif  // MAIZE_V2_OPCODE_V2_H
@@ -0,0 +1,212 @@
+// perf_v2.cpp (user-025): the performance-counter registry and its sources (see perf_v2.h).
+
+#include "perf_v2.h"
+
+#include <cinttypes>
+
+#include "device_v2.h"
+#include "interpreter_v2.h"
+
+namespace maize::v2 {
+namespace {
+
+void emit_elapsed(std::FILE* out, std::uint64_t us) {
+    if (us < 10000) {
+        std::fprintf(out, "    elapsed      : %" PRIu64 " us\n", us);
+    } else {
+        std::fprintf(out, "    elapsed      : %" PRIu64 " ms\n", us / 1000);
+    }
+}
+
+// A count over a time, per second.
+double per_second(std::uint64_t count, std::uint64_t us) {
+    return us == 0 ? 0.0 : static_cast<double>(count) * 1e6 / static_cast<double>(us);
+}
+
+// A rate in as few digits as say it: 12, 4.5k, 512.3M.
+void print_rate(std::FILE* out, double rate, const char* unit) {
+    static const char* const kPrefixes[] = {"", "k", "M", "G", "T"};
+    unsigned prefix = 0;
+    while (rate >= 1000.0 && prefix + 1 < sizeof(kPrefixes) / sizeof(kPrefixes[0])) {
+        rate /= 1000.0;
+        ++prefix;
+    }
+    if (prefix == 0) {
+        std::fprintf(out, "%.0f %s/s", rate, unit);
+    } else {
+        std::fprintf(out, "%.1f%s %s/s", rate, kPrefixes[prefix], unit);
+    }
+}
+
+std::uint64_t since(std::uint64_t now, std::uint64_t base) { return now > base ? now - base : 0; }
+
+}  // namespace
+
+void PerfRegistryV2::start() {
+    start_ = std::chrono::steady_clock::now();
+    last_sample_us_ = 0;
+    sampled_ = false;
+    last_.assign(sources_.size(), {});
+    peaks_.assign(sources_.size(), {});
+    for (std::size_t i = 0; i < sources_.size(); ++i) {
+        sources_[i]->begin();
+        sources_[i]->counters(last_[i]);
+        peaks_[i].assign(last_[i].size(), 0.0);
+    }
+}
+
+std::uint64_t PerfRegistryV2::elapsed_us() const {
+    return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+                                          std::chrono::steady_clock::now() - start_)
+                                          .count());
+}
+
+void PerfRegistryV2::sample(std::FILE* out, std::uint64_t now_us) {
+    const std::uint64_t interval = since(now_us, last_sample_us_);
+    std::fprintf(out, "perf %" PRIu64 ".%03" PRIu64 " s:", now_us / 1000000,
+                 (now_us / 1000) % 1000);
+    std::vector<PerfCounterV2> now;
+    const char* separator = "";
+    for (std::size_t i = 0; i < sources_.size(); ++i) {
+        now.clear();
+        sources_[i]->counters(now);
+        if (now.empty()) {
+            continue;
+        }
+        std::fprintf(out, "%s %s", separator, sources_[i]->section());
+        separator = ";";
+        for (std::size_t c = 0; c < now.size() && c < last_[i].size(); ++c) {
+            const double rate = per_second(since(now[c].count, last_[i][c].count), interval);
+            if (rate > peaks_[i][c]) {
+                peaks_[i][c] = rate;
+            }
+            std::fprintf(out, "%s ", c == 0 ? "" : ",");
+            print_rate(out, rate, now[c].unit);
+        }
+        last_[i] = now;
+    }
+    std::fprintf(out, "\n");
+    std::fflush(out);
+    last_sample_us_ = now_us;
+    sampled_ = true;
+}
+
+void PerfRegistryV2::emit(std::FILE* out, std::uint64_t elapsed_us) const {
+    std::fprintf(out, "performance report\n");
+    std::vector<PerfCounterV2> units;
+    for (std::size_t i = 0; i < sources_.size(); ++i) {
+        std::fprintf(out, "  [%s]\n", sources_[i]->section());
+        sources_[i]->report(out, elapsed_us);
+        if (!sampled_ || i >= peaks_.size()) {
+            continue;
+        }
+        units.clear();
+        sources_[i]->counters(units);
+        std::fprintf(out, "    peak         :");
+        for (std::size_t c = 0; c < units.size() && c < peaks_[i].size(); ++c) {
+            std::fprintf(out, "%s ", c == 0 ? "" : ",");
+            print_rate(out, peaks_[i][c], units[c].unit);
+        }
+        std::fprintf(out, "\n");
+    }
+}
+
+void CpuPerfSourceV2::begin() {
+    steps_ = machine_.steps_taken();
+    cycles_ = machine_.cycles();
+}
+
+void CpuPerfSourceV2::report(std::FILE* out, std::uint64_t elapsed_us) const {
+    const std::uint64_t steps = since(machine_.steps_taken(), steps_);
+    std::fprintf(out, "    instructions : %" PRIu64 "\n", steps);
+    std::fprintf(out, "    cycles       : %" PRIu64 "\n", since(machine_.cycles(), cycles_));
+    emit_elapsed(out, elapsed_us);
+    // Instructions per microsecond are millions of instructions per second.
+    std::fprintf(out, "    MIPS         : %.1f avg\n",
+                 elapsed_us == 0 ? 0.0
+                                 : static_cast<double>(steps) / static_cast<double>(elapsed_us));
+}
+
+void CpuPerfSourceV2::counters(std::vector<PerfCounterV2>& out) const {
+    out.push_back({"instructions", since(machine_.steps_taken(), steps_)});
+}
+
+void TranslatorPerfSourceV2::begin() {
+    hits_ = machine_.translator().hits();
+    walks_ = machine_.translator().walks();
+    flushes_ = machine_.csr().translation_flushes();
+    invalidations_ = machine_.translator().epoch();
+}
+
+void TranslatorPerfSourceV2::report(std::FILE* out, std::uint64_t /*elapsed_us*/) const {
+    const std::uint64_t hits = since(machine_.translator().hits(), hits_);
+    const std::uint64_t walks = since(machine_.translator().walks(), walks_);
+    std::fprintf(out, "    hits         : %" PRIu64 "\n", hits);
+    std::fprintf(out, "    walks        : %" PRIu64 "\n", walks);
+    // A machine with paging off translates nothing, and a rate of nothing is not a rate.
+    if (hits + walks == 0) {
+        std::fprintf(out, "    hit rate     : none translated\n");
+    } else {
+        std::fprintf(out, "    hit rate     : %.2f%%\n",
+                     100.0 * static_cast<double>(hits) / static_cast<double>(hits + walks));
+    }
+    std::fprintf(out, "    flushes      : %" PRIu64 "\n",
+                 since(machine_.csr().translation_flushes(), flushes_));
+    std::fprintf(out, "    invalidations: %" PRIu64 "\n",
+                 since(machine_.translator().epoch(), invalidations_));
+}
+
+void TranslatorPerfSourceV2::counters(std::vector<PerfCounterV2>& out) const {
+    out.push_back({"hits", since(machine_.translator().hits(), hits_)});
+    out.push_back({"walks", since(machine_.translator().walks(), walks_)});
+    out.push_back({"flushes", since(machine_.csr().translation_flushes(), flushes_)});
+}
+
+void ConsolePerfSourceV2::begin() {
+    in_ = console_.host_bytes_in();
+    out_ = console_.host_bytes_out();
+}
+
+void ConsolePerfSourceV2::report(std::FILE* out, std::uint64_t /*elapsed_us*/) const {
+    std::fprintf(out, "    bytes in     : %" PRIu64 "\n", since(console_.host_bytes_in(), in_));
+    std::fprintf(out, "    bytes out    : %" PRIu64 "\n", since(console_.host_bytes_out(), out_));
+}
+
+void ConsolePerfSourceV2::counters(std::vector<PerfCounterV2>& out) const {
+    out.push_back({"bytes in", since(console_.host_bytes_in(), in_)});
+    out.push_back({"bytes out", since(console_.host_bytes_out(), out_)});
+}
+
+void TimerPerfSourceV2::begin() {
+    expiries_ = timer_.host_expiries();
+    nanoseconds_ = timer_.monotonic_nanoseconds();
+}
+
+void TimerPerfSourceV2::report(std::FILE* out, std::uint64_t elapsed_us) const {
+    const std::uint64_t virtual_us = since(timer_.monotonic_nanoseconds(), nanoseconds_) / 1000;
+    std::fprintf(out, "    expiries     : %" PRIu64 "\n", since(timer_.host_expiries(), expiries_));
+    std::fprintf(out, "    virtual time : %" PRIu64 " us\n", virtual_us);
+    std::fprintf(out, "    wall time    : %" PRIu64 " us\n", elapsed_us);
+    std::fprintf(out, "    virtual/wall : %.3f\n",
+                 elapsed_us == 0
+                     ? 0.0
+                     : static_cast<double>(virtual_us) / static_cast<double>(elapsed_us));
+}
+
+void TimerPerfSourceV2::counters(std::vector<PerfCounterV2>& out) const {
+    out.push_back({"expiries", since(timer_.host_expiries(), expiries_)});
+}
+
+void DisplayPerfSourceV2::begin() { frames_ = framebuffer_.host_presents(); }
+
+void DisplayPerfSourceV2::report(std::FILE* out, std::uint64_t elapsed_us) const {
+    const std::uint64_t frames = since(framebuffer_.host_presents(), frames_);
+    std::fprintf(out, "    frames       : %" PRIu64 "\n", frames);
+    std::fprintf(out, "    FPS          : %.1f avg\n", per_second(frames, elapsed_us));
+}
+
+void DisplayPerfSourceV2::counters(std::vector<PerfCounterV2>& out) const {
+    out.push_back({"frames", since(framebuffer_.host_presents(), frames_)});
+}
+
+}  // namespace maize::v2
@@ -0,0 +1,173 @@
+// perf_v2.h (user-025): the per-device performance-counter registry behind mzvm --show-perf.
+//
+// v1's src/perf.h (maize-222) is the model, and the shape carries over: each part of the machine
+// that has performance counters registers a source, and at exit the registry walks its sources
+// and prints one section each. A run with no display registers no display source, so it prints
+// no frames section. What changes is the plumbing, not the idea. v1 kept one registry in a
+// global, which a v2 host running a batch of machines on a pool of threads cannot share, so here
+// it is an object the host owns, and its sources read one machine through references rather than
+// through free functions. And the report goes to a host stream, not into the guest's text
+// console, so its lines end in a bare line feed where v1's carried the CR that console needed.
+//
+// EVERY COUNT IS THE MACHINE'S OWN, READ WHEN ASKED. Nothing here is on an instruction's path:
+// the interpreter counts steps and cycles already, the translator its hits and walks, the CSR
+// file its paging-root flushes, and the console and the timer keep host-side counts of their own
+// traffic. A source takes them as they stand at start() and reports the difference, so a machine
+// restored from a snapshot reports the run from the restore on, as --profile does.
+//
+// THE SAMPLER IS THE HOST'S, AND OPTIONAL. v1 took peaks from its display loop's half-second
+// sampler and a headless run reported averages only. v2 has no display loop, so the host calls
+// sample() itself, between slices of a run, and each call prints one line of the rates over the
+// time since the last (mzvm --perf-every). The highest rate each counter reached is kept, and the
+// report names it beside the average; a run nobody sampled reports averages alone, as v1's did.
+// Rates are over wall-clock time and so differ from run to run by design. The counts do not.
+
+#ifndef MAIZE_V2_PERF_V2_H
+#define MAIZE_V2_PERF_V2_H
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+namespace maize::v2 {
+
+class ConsoleDeviceV2;
+class FramebufferDeviceV2;
+class InterpreterV2;
+class TimerDeviceV2;
+
+// One count the sampler turns into a rate: what it counts, as the rate's unit names it, and how
+// many since the source began.
+struct PerfCounterV2 {
+    const char* unit = "";
+    std::uint64_t count = 0;
+};
+
+// A part of the machine with counters to report. A source is the host's, and must outlive the
+// registry's last emit().
+class PerfSourceV2 {
+  public:
+    virtual ~PerfSourceV2() = default;
+    virtual const char* section() const = 0;
+    // Take the counts as they stand, so what follows counts from here.
+    virtual void begin() = 0;
+    // The section's lines, given the wall-clock microseconds since begin().
+    virtual void report(std::FILE* out, std::uint64_t elapsed_us) const = 0;
+    // The counts since begin() a rate is printed for, in the same order every call.
+    virtual void counters(std::vector<PerfCounterV2>& out) const = 0;
+};
+
+class PerfRegistryV2 {
+  public:
+    void add(PerfSourceV2* source) { sources_.push_back(source); }
+
+    // Stamp the run's start and begin every source.
+    void start();
+    // Wall-clock microseconds since start().
+    std::uint64_t elapsed_us() const;
+    // When sample() last printed, as elapsed_us() read then; zero before it has.
+    std::uint64_t last_sample_us() const { return last_sample_us_; }
+
+    // One line of every counter's rate since the last sample, or since start(): "perf 2.000 s:
+    // cpu 512.3M instructions/s; ...". The second form takes the time instead of reading the
+    // clock, which is what lets a fixture pin the rates it prints.
+    void sample(std::FILE* out) { sample(out, elapsed_us()); }
+    void sample(std::FILE* out, std::uint64_t now_us);
+
+    // "performance report" and one block per source, over the time since start().
+    void emit(std::FILE* out) const { emit(out, elapsed_us()); }
+    void emit(std::FILE* out, std::uint64_t elapsed_us) const;
+
+  private:
+    std::vector<PerfSourceV2*> sources_;
+    // Per source, what the last sample saw and the highest rates it has printed.
+    std::vector<std::vector<PerfCounterV2>> last_;
+    std::vector<std::vector<double>> peaks_;
+    std::chrono::steady_clock::time_point start_{};
+    std::uint64_t last_sample_us_ = 0;
+    bool sampled_ = false;
+};
+
+// The interpreter: instructions retired, cycles, and MIPS. Always registered under --show-perf.
+class CpuPerfSourceV2 final : public PerfSourceV2 {
+  public:
+    explicit CpuPerfSourceV2(const InterpreterV2& machine) : machine_(machine) {}
+    const char* section() const override { return "cpu"; }
+    void begin() override;
+    void report(std::FILE* out, std::uint64_t elapsed_us) const override;
+    void counters(std::vector<PerfCounterV2>& out) const override;
+
+  private:
+    const InterpreterV2& machine_;
+    std::uint64_t steps_ = 0;
+    std::uint64_t cycles_ = 0;
+};
+
+// Address translation: hits, page-table walks, the hit rate, and what emptied the cache.
+class TranslatorPerfSourceV2 final : public PerfSourceV2 {
+  public:
+    explicit TranslatorPerfSourceV2(const InterpreterV2& machine) : machine_(machine) {}
+    const char* section() const override { return "translator"; }
+    void begin() override;
+    void report(std::FILE* out, std::uint64_t elapsed_us) const override;
+    void counters(std::vector<PerfCounterV2>& out) const override;
+
+  private:
+    const InterpreterV2& machine_;
+    std::uint64_t hits_ = 0;
+    std::uint64_t walks_ = 0;
+    std::uint64_t flushes_ = 0;
+    std::uint64_t invalidations_ = 0;
+};
+
+// The console: bytes the guest read and wrote.
+class ConsolePerfSourceV2 final : public PerfSourceV2 {
+  public:
+    explicit ConsolePerfSourceV2(const ConsoleDeviceV2& console) : console_(console) {}
+    const char* section() const override { return "console"; }
+    void begin() override;
+    void report(std::FILE* out, std::uint64_t elapsed_us) const override;
+    void counters(std::vector<PerfCounterV2>& out) const override;
+
+  private:
+    const ConsoleDeviceV2& console_;
+    std::uint64_t in_ = 0;
+    std::uint64_t out_ = 0;
+};
+
+// The timer: expiries, and the machine's time against the host's. The machine's is counted in
+// retired instructions (device_v2.h), so the ratio says how much faster or slower than the time
+// it keeps the machine is running on this host.
+class TimerPerfSourceV2 final : public PerfSourceV2 {
+  public:
+    explicit TimerPerfSourceV2(const TimerDeviceV2& timer) : timer_(timer) {}
+    const char* section() const override { return "timer"; }
+    void begin() override;
+    void report(std::FILE* out, std::uint64_t elapsed_us) const override;
+    void counters(std::vector<PerfCounterV2>& out) const override;
+
+  private:
+    const TimerDeviceV2& timer_;
+    std::uint64_t expiries_ = 0;
+    std::uint64_t nanoseconds_ = 0;
+};
+
+// The framebuffer: frames presented, and FPS. Registered only when one is attached.
+class DisplayPerfSourceV2 final : public PerfSourceV2 {
+  public:
+    explicit DisplayPerfSourceV2(const FramebufferDeviceV2& framebuffer)
+        : framebuffer_(framebuffer) {}
+    const char* section() const override { return "display"; }
+    void begin() override;
+    void report(std::FILE* out, std::uint64_t elapsed_us) const override;
+    void counters(std::vector<PerfCounterV2>& out) const override;
+
+  private:
+    const FramebufferDeviceV2& framebuffer_;
+    std::uint64_t frames_ = 0;
+};
+
+}  // namespace maize::v2
+
+#endif  // MAIZE_V2_PERF_V2_H
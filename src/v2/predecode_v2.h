@@ -0,0 +1,272 @@
+// predecode_v2.h (user-001): decoded instructions, cached per physical page.
+//
+// decode_v2 is a pure function of the bytes it reads, so once an instruction's bytes have been
+// decoded there is nothing left to learn from decoding them again until one of them changes. A
+// loop that has run a million times has been decoded a million times; this cache lets step()
+// decode it once.
+//
+// KEYED BY PHYSICAL ADDRESS, NOT VIRTUAL. The fetch is still translated on every step, under the
+// current paging root at the current privilege level, and that translation is what raises cause
+// 8 for a non-executable page. The cache answers only the question translation cannot, which is
+// what the bytes at a physical address decode to. Two virtual mappings of one code page share
+// its entries, and a paging-root write invalidates nothing here because nothing here depends on
+// a mapping. The program counter and the following-instruction address in a cached record are
+// the ones it was decoded at; a hit at that same address runs the record as it stands, and a
+// hit through any other mapping is run from a copy with both rewritten from the live program
+// counter.
+//
+// AN ENTRY NEVER SPANS TWO PAGES. An instruction whose bytes cross a page boundary is decoded
+// every time, which is rare and keeps the whole of one entry's validity in one page's
+// generation. Everything that IS cached is therefore judged by one question: has the page's
+// generation moved since the page was filled?
+//
+// COHERENCE WITH STORES IS THE MEMORY'S TO ENFORCE, NOT THIS CACHE'S. memory-model.md makes a
+// fetch coherent with every earlier store, including a store from the same program to the
+// instruction it is about to run. Every write to physical memory goes through MemoryV2, and
+// filling a page here asks MemoryV2 to watch it, so the first write after a fill bumps the
+// page's generation and the next lookup finds the page stale and empties it. A guest that
+// patches its own code therefore sees its patch on the very next fetch, with no instruction of
+// its own to flush anything, which is what the chapter requires.
+//
+// Negative results are never cached: a decode that trapped is decoded again next time, so a
+// trap is raised by exactly the code path that always raised it.
+//
+// A RECORD CARRIES ITS HANDLER (user-013). Decoding an instruction settles which opcode it is,
+// so the cache keeps, beside the decode, the execute-stage function specialized for that opcode,
+// and a hit hands both back. The machine then calls the handler directly instead of entering
+// the one large switch and branching on the opcode byte a second time, or, in the threaded run
+// loop, jumps to the label the opcode byte and the pair link below select. interpreter_v2.cpp
+// supplies the handlers and the labels; this file only carries the pointer.
+//
+// A RECORD MAY NAME THE ONE AFTER IT (user-014). fuses() below is a short, curated list of
+// adjacent pairs that compiled v2 code is made of: a compare feeding a branch, pc_add feeding a
+// load, a pointer or counter bumped by an immediate feeding a load, a store or a branch. When
+// both halves of such a pair are cached on one page, the first record carries the offset to the
+// second and a handler that runs the two back to back, without fetching the second or walking
+// the boundary between them when nothing could happen there (interpreter_v2.cpp,
+// execute_pair()). Both halves still retire as instructions of their own, and each is charged
+// its own cost, so a pair costs the sum of the two and a cycle limit still falls between them
+// where it falls for a machine stepping one at a time. The link lives and dies with the page's
+// records, so a store to the page unlinks the pair along with everything else in it.
+
+#ifndef MAIZE_V2_PREDECODE_V2_H
+#define MAIZE_V2_PREDECODE_V2_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "decode_v2.h"
+#include "memory_v2.h"
+
+namespace maize::v2 {
+
+class InterpreterV2;
+enum class CycleV2 : std::uint8_t;
+
+struct PredecodedV2;
+
+// The execute stage for one opcode, called with the machine and the instruction's record.
+using ExecuteHandlerV2 = CycleV2 (*)(InterpreterV2& machine, const PredecodedV2& record);
+
+struct PredecodedV2 {
+    DecodedV2 instruction{};
+    ExecuteHandlerV2 handler = nullptr;
+    // The distance, in records, to the record of the instruction this one fuses with, or zero.
+    std::int16_t pair = 0;
+
+    const PredecodedV2* fused() const { return pair != 0 ? this + pair : nullptr; }
+};
+
+// Whether an instruction can open a fused pair at all, which is the cheap question asked at
+// every decode; fuses() is the whole one.
+constexpr bool opens_pair(std::uint8_t first) {
+    return (first >= op::kCompareEq && first < op::kCompareImmBase + 10) ||
+           first == op::kPcAdd || first == op::kAddImm || first == op::kSubtractImm;
+}
+
+// The curated pairs. Every first half is an instruction that cannot trap, cannot transfer
+// control and touches neither memory, a control register nor a port, so it always advances to
+// the second and leaves nothing a boundary check could see changed.
+constexpr bool fuses(std::uint8_t first, std::uint8_t second) {
+    const bool branch = second >= op::kBranchBase && second < op::kBranchBase + 10;
+    const bool load = second >= op::kLoad && second < op::kLoadDisp + 7;
+    const bool store = second >= op::kStore && second < op::kStoreDisp + 4;
+    if (first >= op::kCompareEq && first < op::kCompareImmBase + 10) {
+        return branch;
+    }
+    if (first == op::kPcAdd) {
+        return load;
+    }
+    if (first == op::kAddImm || first == op::kSubtractImm) {
+        return load || store || branch;
+    }
+    return false;
+}
+
+class PredecodeCacheV2 {
+  public:
+    // A bound on the pages held at once. Reaching it empties the whole cache rather than
+    // choosing a victim, which costs one re-decode per instruction still in use and nothing
+    // else; a working set that large has bigger problems than this policy.
+    static constexpr std::size_t kMaxPages = 4096;
+
+    // The cached decode of the instruction whose opcode byte is at physical address `physical`,
+    // with its handler, or null. A non-null pointer is good until the next insert.
+    const PredecodedV2* find(const MemoryV2& memory, std::uint64_t physical) {
+        Page* page = page_for(physical >> MemoryV2::kPageShift);
+        if (page == nullptr) {
+            ++misses_;
+            return nullptr;
+        }
+        if (page->generation != memory.page_generation(physical)) {
+            // Something wrote to the page since it was filled. Every record in it goes, because
+            // the page's generation is all the cache knows about which bytes changed.
+            page->clear();
+            ++stale_pages_;
+            ++misses_;
+            return nullptr;
+        }
+        const std::uint16_t slot = page->slot[physical & (MemoryV2::kPageBytes - 1)];
+        if (slot == 0) {
+            ++misses_;
+            return nullptr;
+        }
+        ++hits_;
+        return &page->records[slot - 1u];
+    }
+
+    // Record a successful decode whose opcode byte is at `physical`. The caller has already
+    // established that every byte of the instruction is in that one physical page.
+    void insert(MemoryV2& memory, std::uint64_t physical, const DecodedV2& decoded,
+                ExecuteHandlerV2 handler) {
+        const std::uint64_t number = physical >> MemoryV2::kPageShift;
+        Page* page = page_for(number);
+        if (page == nullptr) {
+            if (pages_.size() >= kMaxPages) {
+                clear();
+            }
+            std::unique_ptr<Page>& created = pages_[number];
+            created = std::make_unique<Page>();
+            page = created.get();
+            last_number_ = number;
+            last_page_ = page;
+        }
+        const std::uint64_t generation = memory.page_generation(physical);
+        if (page->generation != generation) {
+            page->clear();
+            page->generation = generation;
+        }
+        // Watch after reading the generation, so the first write from here on moves the page
+        // past the generation just recorded.
+        memory.watch_page(physical);
+        std::uint16_t& slot = page->slot[physical & (MemoryV2::kPageBytes - 1)];
+        if (slot != 0) {
+            page->records[slot - 1u] = PredecodedV2{decoded, handler};
+            return;
+        }
+        page->records.push_back(PredecodedV2{decoded, handler});
+        slot = static_cast<std::uint16_t>(page->records.size());
+    }
+
+    // Link the cached record at `first` to the cached record at `second`, the instruction that
+    // follows it on the same page, when the two make a curated pair and were decoded at
+    // consecutive addresses, and give the first `pair_handler`. Returns whether they were linked.
+    bool fuse(std::uint64_t first, std::uint64_t second, ExecuteHandlerV2 pair_handler) {
+        Page* page = page_for(first >> MemoryV2::kPageShift);
+        if (page == nullptr ||
+            (second >> MemoryV2::kPageShift) != (first >> MemoryV2::kPageShift)) {
+            return false;
+        }
+        const std::uint16_t first_slot = page->slot[first & (MemoryV2::kPageBytes - 1)];
+        const std::uint16_t second_slot = page->slot[second & (MemoryV2::kPageBytes - 1)];
+        if (first_slot == 0 || second_slot == 0) {
+            return false;
+        }
+        PredecodedV2& opening = page->records[first_slot - 1u];
+        const PredecodedV2& closing = page->records[second_slot - 1u];
+        if (!fuses(opening.instruction.opcode, closing.instruction.opcode) ||
+            closing.instruction.pc != opening.instruction.next_pc) {
+            return false;
+        }
+        opening.pair = static_cast<std::int16_t>(second_slot - first_slot);
+        opening.handler = pair_handler;
+        return true;
+    }
+
+    // Whether the instruction at `physical` is cached, without counting a lookup.
+    bool holds(const MemoryV2& memory, std::uint64_t physical) {
+        Page* page = page_for(physical >> MemoryV2::kPageShift);
+        return page != nullptr && page->generation == memory.page_generation(physical) &&
+               page->slot[physical & (MemoryV2::kPageBytes - 1)] != 0;
+    }
+
+    // A fused pair's second half, which ran from its cached record without a lookup of its own
+    // and is counted as the hit it would have been, and as a fused one.
+    void count_fused_hit() {
+        ++hits_;
+        ++fused_;
+    }
+
+    void clear() {
+        pages_.clear();
+        last_page_ = nullptr;
+    }
+
+    // Host-visible only, like TranslatorV2's counters: nothing a guest executes can tell a
+    // machine with this cache from one without it.
+    std::uint64_t hits() const { return hits_; }
+    std::uint64_t misses() const { return misses_; }
+    std::uint64_t stale_pages() const { return stale_pages_; }
+    std::uint64_t fused() const { return fused_; }
+    std::size_t cached_pages() const { return pages_.size(); }
+
+  private:
+    struct Page {
+        // The page's write generation when its records were decoded. insert() re-reads it, so a
+        // new Page starts with whatever generation the memory holds at its first fill.
+        std::uint64_t generation = 0;
+        // Index plus one into `records` for the instruction whose opcode byte is at that offset,
+        // or zero. Sixteen bits hold it: a page has 4096 offsets and so at most 4096 records.
+        std::array<std::uint16_t, MemoryV2::kPageBytes> slot{};
+        std::vector<PredecodedV2> records;
+
+        void clear() {
+            slot.fill(0);
+            records.clear();
+        }
+    };
+
+    static_assert(MemoryV2::kPageBytes <= 0xFFFFu,
+                  "a page's record index has to fit the slot table's sixteen bits");
+
+    Page* page_for(std::uint64_t number) {
+        // A straight-line run stays on one page, so the last page looked at is nearly always the
+        // next one wanted.
+        if (last_page_ != nullptr && last_number_ == number) {
+            return last_page_;
+        }
+        const auto found = pages_.find(number);
+        if (found == pages_.end()) {
+            return nullptr;
+        }
+        last_number_ = number;
+        last_page_ = found->second.get();
+        return last_page_;
+    }
+
+    std::unordered_map<std::uint64_t, std::unique_ptr<Page>> pages_;
+    std::uint64_t last_number_ = 0;
+    Page* last_page_ = nullptr;
+    std::uint64_t hits_ = 0;
+    std::uint64_t misses_ = 0;
+    std::uint64_t stale_pages_ = 0;
+    std::uint64_t fused_ = 0;
+};
+
+}  // namespace maize::v2
+
+#endif  // MAIZE_V2_PREDECODE_V2_H
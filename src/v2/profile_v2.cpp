@@ -0,0 +1,254 @@
+// profile_v2.cpp (user-023): a profile's baseline and its text and JSON reports; user-024 adds
+// the shadow stack its samples are taken from and the folded report they are written to.
+
+#include "profile_v2.h"
+
+#include <algorithm>
+#include <cinttypes>
+#include <utility>
+#include <vector>
+
+#include "interpreter_v2.h"
+#include "mnemonic_v2.h"
+#include "symbols_v2.h"
+#include "trap_v2.h"
+
+namespace maize::v2 {
+namespace {
+
+// The mnemonic of every assigned byte, for the reports. Siblings that share a mnemonic share the
+// text here too, and the byte beside it tells them apart.
+std::array<const char*, 256> build_mnemonic_names() {
+    std::array<const char*, 256> names{};
+    names.fill("?");
+    for (const MnemonicEntry& entry : kMnemonics) {
+        names[entry.opcode] = entry.text;
+    }
+    return names;
+}
+
+const char* mnemonic_name(std::uint8_t opcode) {
+    static const std::array<const char*, 256> names = build_mnemonic_names();
+    return names[opcode];
+}
+
+// The blocks, most instructions first, and by address among equals so the order is the same
+// from one run to the next whatever order the map keeps them in.
+std::vector<std::pair<std::uint64_t, ProfileV2::BlockCounts>> ranked_blocks(
+    const std::unordered_map<std::uint64_t, ProfileV2::BlockCounts>& blocks) {
+    std::vector<std::pair<std::uint64_t, ProfileV2::BlockCounts>> ranked(blocks.begin(),
+                                                                         blocks.end());
+    std::sort(ranked.begin(), ranked.end(), [](const auto& left, const auto& right) {
+        if (left.second.instructions != right.second.instructions) {
+            return left.second.instructions > right.second.instructions;
+        }
+        return left.first < right.first;
+    });
+    return ranked;
+}
+
+double percent(std::uint64_t part, std::uint64_t whole) {
+    return whole == 0 ? 0.0 : 100.0 * static_cast<double>(part) / static_cast<double>(whole);
+}
+
+}  // namespace
+
+ProfileV2::Totals ProfileV2::totals(const InterpreterV2& machine) {
+    Totals now;
+    now.steps = machine.steps_taken();
+    now.cycles = machine.cycles();
+    now.hits = machine.translator().hits();
+    now.walks = machine.translator().walks();
+    now.flushes = machine.csr().translation_flushes();
+    now.invalidations = machine.translator().epoch();
+    return now;
+}
+
+void ProfileV2::begin(const InterpreterV2& machine) {
+    base_ = totals(machine);
+    root_ = machine.pc();
+    frames_.clear();
+    until_sample_ = sample_interval_;
+}
+
+void ProfileV2::push_frame(std::uint64_t entry, std::uint64_t return_address, bool trap) {
+    if (frames_.size() == kMaxFrames) {
+        frames_.erase(frames_.begin());
+    }
+    frames_.push_back(Frame{entry, return_address, trap});
+}
+
+// A return looks no further out than the innermost trap frame, since a handler returns to its
+// caller's code only through trap_return; a trap_return looks for that frame alone.
+void ProfileV2::pop_frames(std::uint64_t target, bool trap) {
+    for (std::size_t depth = frames_.size(); depth-- > 0;) {
+        const Frame& frame = frames_[depth];
+        if (trap ? frame.trap : (!frame.trap && frame.return_address == target)) {
+            frames_.resize(depth);
+            return;
+        }
+        if (frame.trap) {
+            return;
+        }
+    }
+}
+
+void ProfileV2::take_sample() {
+    until_sample_ = sample_interval_;
+    std::vector<std::uint64_t> stack;
+    stack.reserve(frames_.size() + 1);
+    stack.push_back(root_);
+    for (const Frame& frame : frames_) {
+        stack.push_back(frame.entry);
+    }
+    ++samples_[stack];
+}
+
+// A restore can put the step count and the flush count behind where they were at begin(), and
+// the subtraction stops at zero rather than wrapping round to a count nobody ran.
+ProfileV2::Totals ProfileV2::since_begin(const InterpreterV2& machine) const {
+    const Totals now = totals(machine);
+    const auto less = [](std::uint64_t a, std::uint64_t b) { return a > b ? a - b : 0; };
+    Totals counted;
+    counted.steps = less(now.steps, base_.steps);
+    counted.cycles = less(now.cycles, base_.cycles);
+    counted.hits = less(now.hits, base_.hits);
+    counted.walks = less(now.walks, base_.walks);
+    counted.flushes = less(now.flushes, base_.flushes);
+    counted.invalidations = less(now.invalidations, base_.invalidations);
+    return counted;
+}
+
+void ProfileV2::write_text(std::FILE* out, const InterpreterV2& machine,
+                           const SymbolTableV2* symbols) {
+    end_block();
+    const Totals counted = since_begin(machine);
+    std::fprintf(out, "profile: %" PRIu64 " instructions, %" PRIu64 " cycles\n", counted.steps,
+                 counted.cycles);
+
+    std::fprintf(out, "  retired by opcode:\n");
+    std::vector<unsigned> opcodes;
+    for (unsigned opcode = 0; opcode < 256; ++opcode) {
+        if (retired_[opcode] != 0) {
+            opcodes.push_back(opcode);
+        }
+    }
+    std::stable_sort(opcodes.begin(), opcodes.end(), [this](unsigned left, unsigned right) {
+        return retired_[left] > retired_[right];
+    });
+    for (const unsigned opcode : opcodes) {
+        std::fprintf(out, "    $%02X %-20s %14" PRIu64 "  %5.1f%%\n", opcode,
+                     mnemonic_name(static_cast<std::uint8_t>(opcode)), retired_[opcode],
+                     percent(retired_[opcode], counted.steps));
+    }
+
+    const auto ranked = ranked_blocks(blocks_);
+    std::fprintf(out, "  hottest blocks (%zu of %zu):\n",
+                 std::min(ranked.size(), kReportedBlocks), ranked.size());
+    for (std::size_t i = 0; i < ranked.size() && i < kReportedBlocks; ++i) {
+        const BlockCounts& counts = ranked[i].second;
+        const std::string name =
+            symbols != nullptr && !symbols->empty() ? "  " + symbols->describe(ranked[i].first)
+                                                    : std::string();
+        std::fprintf(out,
+                     "    $%016" PRIX64 " %14" PRIu64 " instructions  %5.1f%%  %12" PRIu64
+                     " entries%s\n",
+                     ranked[i].first, counts.instructions,
+                     percent(counts.instructions, counted.steps), counts.entries, name.c_str());
+    }
+
+    for (const bool interrupts : {false, true}) {
+        std::fprintf(out, "  %s by cause:", interrupts ? "interrupts" : "traps");
+        bool any = false;
+        for (unsigned number = 0; number < 256; ++number) {
+            if (traps_[number] != 0 && (number >= cause::kFirstExternalInterrupt) == interrupts) {
+                std::fprintf(out, " %u:%" PRIu64, number, traps_[number]);
+                any = true;
+            }
+        }
+        std::fprintf(out, "%s\n", any ? "" : " none");
+    }
+
+    std::fprintf(out,
+                 "  block bytes: block_copy %" PRIu64 ", block_copy_forward %" PRIu64
+                 ", block_set %" PRIu64 "\n",
+                 block_bytes_[0], block_bytes_[1], block_bytes_[2]);
+    std::fprintf(out,
+                 "  translation: %" PRIu64 " hits, %" PRIu64 " walks, %" PRIu64
+                 " paging-root flushes, %" PRIu64 " invalidations\n",
+                 counted.hits, counted.walks, counted.flushes, counted.invalidations);
+}
+
+// One object, its keys in a fixed order and every count a plain integer. Addresses are strings
+// in hex, because a 64-bit address does not survive a reader that takes every number for a
+// double.
+bool ProfileV2::write_json(std::FILE* out, const InterpreterV2& machine) {
+    end_block();
+    const Totals counted = since_begin(machine);
+    std::fprintf(out, "{\n  \"instructions\": %" PRIu64 ",\n  \"cycles\": %" PRIu64 ",\n",
+                 counted.steps, counted.cycles);
+
+    std::fprintf(out, "  \"opcodes\": [");
+    const char* separator = "\n";
+    for (unsigned opcode = 0; opcode < 256; ++opcode) {
+        if (retired_[opcode] != 0) {
+            std::fprintf(out,
+                         "%s    {\"opcode\": %u, \"mnemonic\": \"%s\", \"retired\": %" PRIu64
+                         "}",
+                         separator, opcode, mnemonic_name(static_cast<std::uint8_t>(opcode)),
+                         retired_[opcode]);
+            separator = ",\n";
+        }
+    }
+    std::fprintf(out, "\n  ],\n  \"blocks\": [");
+    separator = "\n";
+    for (const auto& [start, counts] : ranked_blocks(blocks_)) {
+        std::fprintf(out,
+                     "%s    {\"start\": \"0x%016" PRIX64 "\", \"entries\": %" PRIu64
+                     ", \"instructions\": %" PRIu64 "}",
+                     separator, start, counts.entries, counts.instructions);
+        separator = ",\n";
+    }
+    for (const bool interrupts : {false, true}) {
+        std::fprintf(out, "\n  ],\n  \"%s\": [", interrupts ? "interrupts" : "traps");
+        separator = "\n";
+        for (unsigned number = 0; number < 256; ++number) {
+            if (traps_[number] != 0 && (number >= cause::kFirstExternalInterrupt) == interrupts) {
+                std::fprintf(out, "%s    {\"cause\": %u, \"count\": %" PRIu64 "}", separator,
+                             number, traps_[number]);
+                separator = ",\n";
+            }
+        }
+    }
+    std::fprintf(out,
+                 "\n  ],\n  \"block_bytes\": {\"block_copy\": %" PRIu64
+                 ", \"block_copy_forward\": %" PRIu64 ", \"block_set\": %" PRIu64 "},\n",
+                 block_bytes_[0], block_bytes_[1], block_bytes_[2]);
+    std::fprintf(out,
+                 "  \"translation\": {\"hits\": %" PRIu64 ", \"walks\": %" PRIu64
+                 ", \"flushes\": %" PRIu64 ", \"invalidations\": %" PRIu64 "}\n}\n",
+                 counted.hits, counted.walks, counted.flushes, counted.invalidations);
+    return std::ferror(out) == 0 && std::fflush(out) == 0;
+}
+
+// Two stacks of different addresses can name the same, when a symbol table is coarser than the
+// entries (or empty), so the lines are gathered by name before they are written.
+bool ProfileV2::write_folded(std::FILE* out, const SymbolTableV2& symbols) const {
+    std::map<std::string, std::uint64_t> folded;
+    for (const auto& [stack, count] : samples_) {
+        std::string line;
+        for (const std::uint64_t entry : stack) {
+            if (!line.empty()) {
+                line.push_back(';');
+            }
+            line += symbols.describe(entry);
+        }
+        folded[line] += count;
+    }
+    for (const auto& [line, count] : folded) {
+        std::fprintf(out, "%s %" PRIu64 "\n", line.c_str(), count);
+    }
+    return std::ferror(out) == 0 && std::fflush(out) == 0;
+}
+
+}  // namespace maize::v2
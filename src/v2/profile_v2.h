@@ -0,0 +1,195 @@
+// profile_v2.h (user-023): what mzvm --profile counts, and the two reports it writes at exit.
+//
+// The machine keeps a step count, a cycle count and the translator's counters, and none of them
+// says where the steps went. A profile does: every instruction retired by opcode, every basic
+// block the guest entered with how often and how many instructions it retired there, every trap
+// and interrupt by cause, the bytes each block-memory instruction moved, and what translation
+// cost over the run. That is what says which of the interpreter's fast paths a real guest leans
+// on, and so which are worth having more of.
+//
+// A PROFILE COSTS NOTHING UNTIL IT IS ATTACHED. InterpreterV2::run() tests for one once a call,
+// as it tests for the JIT, and a profiled run goes round its own loop (run_profiled), which
+// counts after each cycle what the cycle already left behind: the opcode cycle() reports, where
+// the program counter went, and by how much cycles_ moved. Nothing is counted inside an
+// instruction, so the tight loop and every handler are the same code with a profile or without
+// one. A profiled machine runs interpreted and unfused, one instruction a cycle, because that is
+// what lets the counts be per instruction; the JIT is for a run that wants speed and the profile
+// for one that wants to know where the time went, and mzvm refuses to do both at once.
+//
+// A BLOCK IS A START ADDRESS. It runs from an instruction the machine reached by a transfer,
+// a trap or a resume, to the first branch, jump, call or return after it, or to the first
+// instruction that did not fall through to its neighbour, which covers sys, trap_return and a
+// trap raised part-way; a conditional branch ends its block whether or not it was taken, so a
+// block's address is a static place in the program, not a path through it. Entries and
+// instructions are both kept so a report can tell a long block entered rarely from a short one
+// entered constantly.
+//
+// A SAMPLE IS A CALL STACK (user-024). With an interval set, every interval-th instruction the
+// profile retires is a sample, taken by count rather than by a host timer so two runs of one
+// program sample the same instructions, and what it records is the stack the instruction ran
+// in. The machine keeps no stack of its own (a call leaves its return address in the link
+// register and nowhere else), so the profile keeps a shadow one from the transfers it already
+// sees: a call pushes a frame whose entry is where it went and whose return is the link it
+// wrote; a return pops back to the innermost frame that was to return where it went, the link
+// register's value, and pops nothing when none was, so a guest that returns through a link it
+// saved and restored itself is followed and one that jumps through its link is not mistaken
+// for a return; a delivered trap or interrupt pushes a frame at its handler, and a trap_return
+// pops back through the innermost one. The bottom frame is where the machine was when the
+// profile was attached. A stack deeper than kMaxFrames loses its outermost frames rather than
+// growing without bound under a guest that calls and never returns. Stacks are kept by their
+// entry addresses, and write_folded() names them from a symbol table in the folded form
+// flame-graph tools read: `start;draw;fill_row 42`, one line per distinct stack.
+
+#ifndef MAIZE_V2_PROFILE_V2_H
+#define MAIZE_V2_PROFILE_V2_H
+
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+#include "cost_v2.h"
+#include "opcode_v2.h"
+
+namespace maize::v2 {
+
+class InterpreterV2;
+class SymbolTableV2;
+
+class ProfileV2 {
+  public:
+    struct BlockCounts {
+        std::uint64_t entries = 0;
+        std::uint64_t instructions = 0;
+    };
+
+    // The blocks the text report lists; the JSON lists them all.
+    static constexpr std::size_t kReportedBlocks = 20;
+    // The deepest stack a sample keeps.
+    static constexpr std::size_t kMaxFrames = 1024;
+
+    // Sample every `instructions` retired instructions, or none for zero (the default). Set
+    // before the profile is attached.
+    void set_sample_interval(std::uint64_t instructions) { sample_interval_ = instructions; }
+    bool sampling() const { return sample_interval_ != 0; }
+
+    // Take the machine's counters as they stand, so the reports count from here. Called by
+    // InterpreterV2::host_attach_profile.
+    void begin(const InterpreterV2& machine);
+
+    // One instruction retired at `pc`, after which the machine is at `next_pc`. `extra_cycles` is
+    // what it cost beyond its opcode's table entry, which is its block bytes and nothing else.
+    void count_instruction(std::uint64_t pc, std::uint8_t opcode, std::uint64_t next_pc,
+                           std::uint64_t extra_cycles) {
+        ++retired_[opcode];
+        if (block_length_ == 0) {
+            block_start_ = pc;
+        }
+        ++block_length_;
+        if (extra_cycles != 0 && opcode >= op::kBlockCopy && opcode <= op::kBlockSet) {
+            block_bytes_[opcode - op::kBlockCopy] += extra_cycles / cycle_cost::kBlockByte;
+        }
+        if (ends_basic_block(opcode) || next_pc != pc + instruction_length(opcode)) {
+            end_block();
+        }
+        if (sample_interval_ != 0 && --until_sample_ == 0) {
+            take_sample();
+        }
+    }
+
+    // The shadow stack's view of an instruction that retired without a trap: a call, a return
+    // and a trap_return move it, and nothing else does. Called after count_instruction, so the
+    // sample a call or a return falls on is charged to the frame it ran in.
+    void follow_transfer(std::uint64_t pc, std::uint8_t opcode, std::uint64_t next_pc) {
+        if (opcode == op::kCallDisp || opcode == op::kCallReg) {
+            push_frame(next_pc, pc + instruction_length(opcode), false);
+        } else if (opcode == op::kReturn || opcode == op::kTrapReturn) {
+            pop_frames(next_pc, opcode == op::kTrapReturn);
+        }
+    }
+
+    // A trap or an interrupt the machine raised, delivered or not, by its cause number.
+    void count_trap(std::uint8_t cause_number) { ++traps_[cause_number]; }
+
+    // A trap or an interrupt delivered to `handler`, which the shadow stack enters.
+    void enter_handler(std::uint64_t handler) {
+        if (sample_interval_ != 0) {
+            push_frame(handler, 0, true);
+        }
+    }
+
+    // Close the block being counted, at a stop or before a report.
+    void end_block() {
+        if (block_length_ == 0) {
+            return;
+        }
+        BlockCounts& counts = blocks_[block_start_];
+        ++counts.entries;
+        counts.instructions += block_length_;
+        block_length_ = 0;
+    }
+
+    std::uint64_t retired(std::uint8_t opcode) const { return retired_[opcode]; }
+    std::uint64_t traps(std::uint8_t cause_number) const { return traps_[cause_number]; }
+    // The bytes block_copy, block_copy_forward and block_set moved, by opcode.
+    std::uint64_t block_bytes(std::uint8_t opcode) const {
+        return block_bytes_[opcode - op::kBlockCopy];
+    }
+    const std::unordered_map<std::uint64_t, BlockCounts>& blocks() const { return blocks_; }
+    // Each stack sampled, outermost entry first, and how many samples found it.
+    const std::map<std::vector<std::uint64_t>, std::uint64_t>& samples() const {
+        return samples_;
+    }
+
+    // The reports, from this profile and the machine's counters since begin(). Both close the
+    // open block first, so they are complete whenever the machine stopped. The text report names
+    // each hot block from `symbols` when it is given one.
+    void write_text(std::FILE* out, const InterpreterV2& machine,
+                    const SymbolTableV2* symbols = nullptr);
+    bool write_json(std::FILE* out, const InterpreterV2& machine);
+    // The samples as folded stacks, each frame named by `symbols`, the lines in name order.
+    bool write_folded(std::FILE* out, const SymbolTableV2& symbols) const;
+
+  private:
+    struct Frame {
+        std::uint64_t entry = 0;
+        std::uint64_t return_address = 0;
+        bool trap = false;
+    };
+
+    void push_frame(std::uint64_t entry, std::uint64_t return_address, bool trap);
+    void pop_frames(std::uint64_t target, bool trap);
+    void take_sample();
+
+    // The machine's totals the counts run from, and what each report takes off them.
+    struct Totals {
+        std::uint64_t steps = 0;
+        std::uint64_t cycles = 0;
+        std::uint64_t hits = 0;
+        std::uint64_t walks = 0;
+        std::uint64_t flushes = 0;
+        std::uint64_t invalidations = 0;
+    };
+    static Totals totals(const InterpreterV2& machine);
+    Totals since_begin(const InterpreterV2& machine) const;
+
+    std::array<std::uint64_t, 256> retired_{};
+    std::array<std::uint64_t, 256> traps_{};
+    std::array<std::uint64_t, 3> block_bytes_{};
+    std::unordered_map<std::uint64_t, BlockCounts> blocks_;
+    std::uint64_t block_start_ = 0;
+    std::uint64_t block_length_ = 0;
+    Totals base_{};
+
+    std::uint64_t sample_interval_ = 0;
+    std::uint64_t until_sample_ = 0;
+    std::uint64_t root_ = 0;
+    std::vector<Frame> frames_;
+    std::map<std::vector<std::uint64_t>, std::uint64_t> samples_;
+};
+
+}  // namespace maize::v2
+
+#endif  // MAIZE_V2_PROFILE_V2_H
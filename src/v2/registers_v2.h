@@ -41,6 +41,9 @@ class RegistersV2 {
     std::uint64_t raw(unsigned n) const { return file_[n]; }
     void set_raw(unsigned n, std::uint64_t value) { file_[n] = value; }
     void reset() { file_.fill(0); }
+    // The file itself, for the JIT's templates (user-002), which address registers in place.
+    // They read r0 as zero without reading it here and never write it.
+    std::uint64_t* host_file() { return file_.data(); }
 
   private:
     // boot.md: every general register holds zero when the first instruction executes, r30 and
@@ -0,0 +1,306 @@
+// snapshot_v2.cpp (user-007): taking, restoring, writing and reading machine snapshots, and
+// cloning a machine (user-008), which is a snapshot that never leaves the process.
+
+#include "snapshot_v2.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "interpreter_v2.h"
+#include "jit_v2.h"
+#include "state_stream_v2.h"
+
+namespace maize::v2 {
+namespace {
+
+// How many bytes of `page` a memory of `size` populates.
+std::uint64_t page_length(std::uint64_t page, std::uint64_t size) {
+    const std::uint64_t start = page << MemoryV2::kPageShift;
+    return size - start < MemoryV2::kPageBytes ? size - start : MemoryV2::kPageBytes;
+}
+
+// Append each listed page's populated bytes to the snapshot.
+void copy_pages(const MemoryV2& memory, MachineSnapshotV2& snapshot) {
+    const std::uint64_t size = memory.size();
+    for (const std::uint64_t page : snapshot.pages) {
+        const std::uint8_t* bytes = memory.host_bytes(page << MemoryV2::kPageShift);
+        snapshot.page_bytes.insert(snapshot.page_bytes.end(), bytes,
+                                   bytes + page_length(page, size));
+    }
+}
+
+// The page list is ascending, inside the snapshot's memory, and matched byte for byte by the
+// page data. Checked before a restore touches anything, so a bad snapshot changes nothing.
+bool pages_are_consistent(const MachineSnapshotV2& snapshot) {
+    const std::uint64_t populated =
+        (snapshot.memory_size + MemoryV2::kPageBytes - 1) >> MemoryV2::kPageShift;
+    std::uint64_t bytes = 0;
+    for (std::size_t i = 0; i < snapshot.pages.size(); ++i) {
+        const std::uint64_t page = snapshot.pages[i];
+        if (page >= populated || (i != 0 && page <= snapshot.pages[i - 1])) {
+            return false;
+        }
+        bytes += page_length(page, snapshot.memory_size);
+    }
+    return bytes == snapshot.page_bytes.size();
+}
+
+}  // namespace
+
+std::vector<std::uint8_t> InterpreterV2::save_machine_state() const {
+    std::vector<std::uint8_t> state;
+    StateWriterV2 out(state);
+    out.put_u64(pc_);
+    out.put_bool(halted_);
+    out.put_u64(steps_taken_);
+    out.put_u64(cycles());
+    for (unsigned n = 0; n < kRegisterCount; ++n) {
+        out.put_u64(registers_.raw(n));
+    }
+    csr_.save_state(out);
+    devices_.save_state(out);
+    return state;
+}
+
+bool InterpreterV2::load_machine_state(StateReaderV2& in) {
+    pc_ = in.get_u64();
+    halted_ = in.get_bool();
+    steps_taken_ = in.get_u64();
+    // The saved total is every cycle the walks made so far included, so they count from this
+    // translator's walks on.
+    cycles_ = in.get_u64();
+    walk_base_ = translator_.walks();
+    for (unsigned n = 0; n < kRegisterCount; ++n) {
+        registers_.set_raw(n, in.get_u64());
+    }
+    csr_.load_state(in);
+    return devices_.load_state(in) && in.ok();
+}
+
+MachineSnapshotV2 InterpreterV2::take_full_snapshot() {
+    // A block transfer still on its worker (user-018) lands in memory and the device's status
+    // first, so the snapshot holds its outcome rather than half of it.
+    devices_.host_finish_transfers();
+    MachineSnapshotV2 snapshot;
+    snapshot.machine = save_machine_state();
+    snapshot.memory_size = memory_.size();
+    // A page that reads zero throughout is what a restore's memory holds already, or is made to
+    // hold, so it is left out; a guest that has touched a few pages of a large memory gets a
+    // snapshot the size of those pages.
+    const std::uint64_t populated = memory_.populated_pages();
+    for (std::uint64_t page = 0; page < populated; ++page) {
+        if (!memory_.page_is_zero(page)) {
+            snapshot.pages.push_back(page);
+        }
+    }
+    copy_pages(memory_, snapshot);
+    memory_.start_dirty_tracking();
+    next_snapshot_sequence_ = 1;
+    return snapshot;
+}
+
+bool InterpreterV2::take_incremental_snapshot(MachineSnapshotV2& out) {
+    if (next_snapshot_sequence_ == 0 || !memory_.dirty_tracking()) {
+        return false;
+    }
+    devices_.host_finish_transfers();
+    MachineSnapshotV2 snapshot;
+    snapshot.incremental = true;
+    snapshot.sequence = next_snapshot_sequence_;
+    snapshot.machine = save_machine_state();
+    snapshot.memory_size = memory_.size();
+    // A page dirtied and then resized away is not populated now and has nothing to carry; if it
+    // comes back, the resize that brings it back records it again.
+    const std::uint64_t populated = memory_.populated_pages();
+    for (const std::uint64_t page : memory_.dirty_pages()) {
+        if (page < populated) {
+            snapshot.pages.push_back(page);
+        }
+    }
+    std::sort(snapshot.pages.begin(), snapshot.pages.end());
+    copy_pages(memory_, snapshot);
+    memory_.clear_dirty_pages();
+    ++next_snapshot_sequence_;
+    out = std::move(snapshot);
+    return true;
+}
+
+bool InterpreterV2::restore_snapshot(const MachineSnapshotV2& snapshot) {
+    if (snapshot.incremental &&
+        (next_snapshot_sequence_ == 0 || snapshot.sequence != next_snapshot_sequence_)) {
+        return false;
+    }
+    if (!snapshot.incremental && snapshot.sequence != 0) {
+        return false;
+    }
+    if (!pages_are_consistent(snapshot)) {
+        return false;
+    }
+    // The machine half is parsed into a scratch machine first, which is what lets a malformed
+    // one be refused before anything here has changed. The scratch shares this memory and never
+    // runs, and a parse writes nothing to memory.
+    {
+        InterpreterV2 scratch(memory_);
+        StateReaderV2 in(snapshot.machine.data(), snapshot.machine.size());
+        if (!scratch.load_machine_state(in) || !in.at_end()) {
+            return false;
+        }
+    }
+
+    if (snapshot.memory_size != memory_.size()) {
+        memory_.host_set_size(static_cast<std::size_t>(snapshot.memory_size));
+    }
+    // A full snapshot left out every page that read zero, so whatever memory holds there now is
+    // cleared. Pages already zero are only read, which commits nothing.
+    std::size_t listed = 0;
+    if (!snapshot.incremental) {
+        static const std::uint8_t kZeroPage[MemoryV2::kPageBytes] = {};
+        const std::uint64_t populated = memory_.populated_pages();
+        for (std::uint64_t page = 0; page < populated; ++page) {
+            if (listed < snapshot.pages.size() && snapshot.pages[listed] == page) {
+                ++listed;
+                continue;
+            }
+            if (!memory_.page_is_zero(page)) {
+                memory_.load_image(page << MemoryV2::kPageShift, kZeroPage,
+                                   static_cast<std::size_t>(page_length(page, memory_.size())));
+            }
+        }
+    }
+    const std::uint8_t* bytes = snapshot.page_bytes.data();
+    for (const std::uint64_t page : snapshot.pages) {
+        const std::uint64_t length = page_length(page, memory_.size());
+        memory_.load_image(page << MemoryV2::kPageShift, bytes, static_cast<std::size_t>(length));
+        bytes += length;
+    }
+
+    StateReaderV2 in(snapshot.machine.data(), snapshot.machine.size());
+    load_machine_state(in);
+
+    // The restore's own page writes moved the generation of every watched page it changed, so
+    // the predecode cache and the JIT see them as any store; translations are keyed on the
+    // paging root and privilege the load may have replaced, so they all go.
+    translator_.invalidate_all();
+    fetch_window_.valid = false;
+
+    // The chain goes on from here: the next incremental snapshot carries what changes after this
+    // restore, not the pages the restore itself wrote.
+    if (snapshot.incremental) {
+        memory_.clear_dirty_pages();
+    } else {
+        memory_.start_dirty_tracking();
+    }
+    next_snapshot_sequence_ = snapshot.sequence + 1;
+    return true;
+}
+
+std::unique_ptr<InterpreterV2> InterpreterV2::clone() {
+    devices_.host_finish_transfers();
+    std::unique_ptr<InterpreterV2> child(new InterpreterV2(memory_.clone(), pc_));
+    // The machine half goes across the way a snapshot carries it, so a clone holds exactly what
+    // a snapshot would and a class that gains state clones it the day it snapshots it.
+    const std::vector<std::uint8_t> state = save_machine_state();
+    StateReaderV2 in(state.data(), state.size());
+    child->load_machine_state(in);
+    child->translator_ = translator_;
+    child->walk_base_ = translator_.walks();
+    child->fetch_window_ = fetch_window_;
+    child->cycle_limit_ = cycle_limit_;
+    if (jit_ != nullptr) {
+        child->enable_jit(jit_->options());
+    }
+    return child;
+}
+
+bool write_snapshot(std::FILE* file, const MachineSnapshotV2& snapshot) {
+    std::vector<std::uint8_t> record;
+    StateWriterV2 out(record);
+    out.put_u64(MachineSnapshotV2::kMagic);
+    out.put_u64(MachineSnapshotV2::kFormatVersion);
+    out.put_bool(snapshot.incremental);
+    out.put_u64(snapshot.sequence);
+    out.put_bytes(snapshot.machine);
+    out.put_u64(snapshot.memory_size);
+    out.put_u64(snapshot.pages.size());
+    for (const std::uint64_t page : snapshot.pages) {
+        out.put_u64(page);
+    }
+    out.put_bytes(snapshot.page_bytes);
+    return std::fwrite(record.data(), 1, record.size(), file) == record.size() &&
+           std::fflush(file) == 0;
+}
+
+SnapshotReadV2 read_snapshot(std::FILE* file, MachineSnapshotV2& snapshot) {
+    // The fixed-size head names the variable-size parts' lengths, so the record is read in
+    // pieces and never needs the file's size up front. Each piece is read a mebibyte at a time,
+    // so a corrupt length runs into the end of the file rather than into an allocation the file
+    // could never fill.
+    auto read_exact = [file](std::vector<std::uint8_t>& buffer, std::uint64_t length) {
+        constexpr std::size_t kChunk = std::size_t{1} << 20;
+        buffer.clear();
+        while (buffer.size() < length) {
+            const std::size_t want = static_cast<std::size_t>(
+                std::min<std::uint64_t>(kChunk, length - buffer.size()));
+            const std::size_t at = buffer.size();
+            buffer.resize(at + want);
+            const std::size_t got = std::fread(buffer.data() + at, 1, want, file);
+            if (got != want) {
+                buffer.resize(at + got);
+                return false;
+            }
+        }
+        return true;
+    };
+
+    std::vector<std::uint8_t> head;
+    constexpr std::size_t kHeadBytes = 8 + 8 + 1 + 8 + 8;
+    if (!read_exact(head, kHeadBytes)) {
+        return head.empty() && std::ferror(file) == 0 ? SnapshotReadV2::End
+                                                      : SnapshotReadV2::Malformed;
+    }
+    StateReaderV2 in(head.data(), head.size());
+    if (in.get_u64() != MachineSnapshotV2::kMagic ||
+        in.get_u64() != MachineSnapshotV2::kFormatVersion) {
+        return SnapshotReadV2::Malformed;
+    }
+    MachineSnapshotV2 read;
+    read.incremental = in.get_bool();
+    read.sequence = in.get_u64();
+    const std::uint64_t machine_bytes = in.get_u64();
+    if (!in.ok() || !read_exact(read.machine, machine_bytes)) {
+        return SnapshotReadV2::Malformed;
+    }
+
+    std::vector<std::uint8_t> counts;
+    if (!read_exact(counts, 16)) {
+        return SnapshotReadV2::Malformed;
+    }
+    StateReaderV2 counted(counts.data(), counts.size());
+    read.memory_size = counted.get_u64();
+    const std::uint64_t page_count = counted.get_u64();
+    // The page list is ascending and inside the memory, so a count past the memory's page count
+    // is a corrupt record rather than a large one.
+    if (page_count > (read.memory_size >> MemoryV2::kPageShift) + 1) {
+        return SnapshotReadV2::Malformed;
+    }
+
+    std::vector<std::uint8_t> tail;
+    if (!read_exact(tail, page_count * 8 + 8)) {
+        return SnapshotReadV2::Malformed;
+    }
+    StateReaderV2 listed(tail.data(), tail.size());
+    read.pages.resize(static_cast<std::size_t>(page_count));
+    for (std::uint64_t& page : read.pages) {
+        page = listed.get_u64();
+    }
+    const std::uint64_t page_bytes = listed.get_u64();
+    if (page_bytes > page_count * MemoryV2::kPageBytes ||
+        !read_exact(read.page_bytes, page_bytes) ||
+        !pages_are_consistent(read)) {
+        return SnapshotReadV2::Malformed;
+    }
+    snapshot = std::move(read);
+    return SnapshotReadV2::Read;
+}
+
+}  // namespace maize::v2
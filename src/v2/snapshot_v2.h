@@ -0,0 +1,66 @@
+// snapshot_v2.h (user-007): full and incremental snapshots of a v2 machine.
+//
+// A snapshot is everything a guest could observe: the register file, the program counter, the
+// halted flag, the control-and-status registers, every device class's registers, and memory.
+// The step count travels with it too, because the timer counts time in retired instructions and
+// a host's step budget is judged against it, and so does the cycle count (user-022), which a
+// host's cycle limit is judged against. Nothing a guest cannot observe is saved: the
+// translation cache, the predecode cache and the JIT's code are rebuilt on demand after a
+// restore, which InterpreterV2::restore_snapshot arranges by invalidating them.
+//
+// A FULL snapshot carries every populated page that is not all zeros, and starts the memory's
+// dirty tracking (memory_v2.h). An INCREMENTAL snapshot carries the machine state whole, which
+// is a few hundred bytes, and only the pages written since the snapshot before it, so the cost of
+// taking one follows what the guest wrote rather than how much memory it has. The snapshots a
+// machine takes form a chain: sequence 0 is the full one and each incremental is numbered one
+// past the snapshot before it. Restoring the full snapshot and then each incremental in order
+// puts back the state at the last one, and restore_snapshot refuses an incremental that does not
+// follow the snapshot the machine last took or restored, since applying it out of order would
+// produce a memory image that never existed.
+//
+// The file form, written and read by write_snapshot and read_snapshot, is a sequence of records
+// with no header of its own, so a chain is one file that a host appends each new record to. Each
+// record begins with a magic word and a format version and is otherwise the fields below in
+// order, fixed little-endian through state_stream_v2.h.
+
+#ifndef MAIZE_V2_SNAPSHOT_V2_H
+#define MAIZE_V2_SNAPSHOT_V2_H
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+namespace maize::v2 {
+
+struct MachineSnapshotV2 {
+    // "MZSNAP" and a version, which moves whenever any class's saved layout does.
+    static constexpr std::uint64_t kMagic = 0x0000'5041'4E53'5A4Dull;
+    static constexpr std::uint64_t kFormatVersion = 2;
+
+    bool incremental = false;
+    std::uint64_t sequence = 0;
+    // The registers, program counter, halted flag, step and cycle counts, control-and-status
+    // registers and device state, as InterpreterV2 wrote them. Opaque to everything else.
+    std::vector<std::uint8_t> machine;
+    // The populated size, and the saved pages: their numbers, and their bytes end to end in the
+    // same order. Every page is MemoryV2::kPageBytes long except one that populated memory ends
+    // partway through, which is as long as the part of it that is populated.
+    std::uint64_t memory_size = 0;
+    std::vector<std::uint64_t> pages;
+    std::vector<std::uint8_t> page_bytes;
+};
+
+// Append one record. False when the stream refused a write.
+bool write_snapshot(std::FILE* file, const MachineSnapshotV2& snapshot);
+
+enum class SnapshotReadV2 : std::uint8_t {
+    Read,       // one record read into the snapshot
+    End,        // the stream was at its end before the record began
+    Malformed,  // a record began and is truncated, or is not a record of this format
+};
+
+SnapshotReadV2 read_snapshot(std::FILE* file, MachineSnapshotV2& snapshot);
+
+}  // namespace maize::v2
+
+#endif  // MAIZE_V2_SNAPSHOT_V2_H
@@ -0,0 +1,120 @@
+// state_stream_v2.h (user-007): the byte stream a machine's state is saved to and loaded from.
+//
+// A snapshot (snapshot_v2.h) has to carry state that lives in several classes, some of it
+// private: the control-and-status registers, each device class's registers, the interpreter's
+// own program counter and step count. Rather than have the snapshot code reach into every one of
+// them, each class writes its own state to one of these streams and reads it back, in an order
+// it alone decides. The classes stay the owners of their layouts, and a class that gains a field
+// changes its own save and load and nothing else.
+//
+// The encoding is fixed little-endian whatever the host, so a snapshot written on one host is
+// read back correctly on another. A reader that runs off the end does not throw; it latches a
+// failure, answers zero from then on, and a caller asks ok() once when it is done. That keeps
+// every load a straight-line sequence of reads, which is what makes it easy to check against the
+// save beside it.
+
+#ifndef MAIZE_V2_STATE_STREAM_V2_H
+#define MAIZE_V2_STATE_STREAM_V2_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace maize::v2 {
+
+class StateWriterV2 {
+  public:
+    explicit StateWriterV2(std::vector<std::uint8_t>& out) : out_(out) {}
+
+    void put_u64(std::uint64_t value) {
+        for (unsigned i = 0; i < 8; ++i) {
+            out_.push_back(static_cast<std::uint8_t>(value >> (i * 8)));
+        }
+    }
+
+    void put_bool(bool value) { out_.push_back(value ? 1u : 0u); }
+
+    void put_raw(const std::uint8_t* data, std::size_t length) {
+        out_.insert(out_.end(), data, data + length);
+    }
+
+    // A length-prefixed run of bytes, for state whose size varies, such as the console's
+    // buffered output.
+    void put_bytes(const std::vector<std::uint8_t>& bytes) {
+        put_u64(bytes.size());
+        put_raw(bytes.data(), bytes.size());
+    }
+
+  private:
+    std::vector<std::uint8_t>& out_;
+};
+
+class StateReaderV2 {
+  public:
+    StateReaderV2(const std::uint8_t* data, std::size_t size) : data_(data), size_(size) {}
+
+    std::uint64_t get_u64() {
+        if (!take(8)) {
+            return 0;
+        }
+        std::uint64_t value = 0;
+        for (unsigned i = 0; i < 8; ++i) {
+            value |= static_cast<std::uint64_t>(data_[position_ - 8 + i]) << (i * 8);
+        }
+        return value;
+    }
+
+    // Anything but zero or one is a malformed stream rather than a true.
+    bool get_bool() {
+        if (!take(1)) {
+            return false;
+        }
+        const std::uint8_t byte = data_[position_ - 1];
+        if (byte > 1u) {
+            failed_ = true;
+        }
+        return byte == 1u;
+    }
+
+    void get_raw(std::uint8_t* out, std::size_t length) {
+        if (take(length)) {
+            std::memcpy(out, data_ + position_ - length, length);
+        }
+    }
+
+    void get_bytes(std::vector<std::uint8_t>& out) {
+        const std::uint64_t length = get_u64();
+        // Judged against what is left before anything is allocated, so a corrupt length cannot
+        // ask for more memory than the stream itself could ever hold.
+        if (failed_ || length > size_ - position_) {
+            failed_ = true;
+            out.clear();
+            return;
+        }
+        out.assign(data_ + position_, data_ + position_ + length);
+        position_ += static_cast<std::size_t>(length);
+    }
+
+    bool ok() const { return !failed_; }
+    bool at_end() const { return position_ == size_; }
+
+  private:
+    bool take(std::size_t length) {
+        if (failed_ || length > size_ - position_) {
+            failed_ = true;
+            return false;
+        }
+        position_ += length;
+        return true;
+    }
+
+    const std::uint8_t* data_;
+    std::size_t size_;
+    std::size_t position_ = 0;
+    bool failed_ = false;
+};
+
+}  // namespace maize::v2
+
+#endif  // MAIZE_V2_STATE_STREAM_V2_H
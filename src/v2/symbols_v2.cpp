@@ -0,0 +1,124 @@
+// symbols_v2.cpp (user-024): reading, writing and looking up a symbol file.
+
+#include "symbols_v2.h"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <utility>
+
+namespace maize::v2 {
+namespace {
+
+std::string hex_address(std::uint64_t address) {
+    char text[24];
+    std::snprintf(text, sizeof(text), "0x%016" PRIX64, address);
+    return text;
+}
+
+// A name is what a folded stack can carry as one frame: something, and nothing that separates
+// frames (';') or ends the stack (a space).
+bool valid_name(const std::string& name) {
+    return !name.empty() && name.find_first_of("; \t") == std::string::npos;
+}
+
+}  // namespace
+
+void SymbolTableV2::add(std::uint64_t address, std::string name) {
+    const auto after = std::upper_bound(
+        entries_.begin(), entries_.end(), address,
+        [](std::uint64_t value, const Entry& entry) { return value < entry.address; });
+    entries_.insert(after, Entry{address, std::move(name)});
+}
+
+bool SymbolTableV2::read(const std::string& path, std::string& error) {
+    entries_.clear();
+    std::FILE* file = std::fopen(path.c_str(), "r");
+    if (file == nullptr) {
+        error = "cannot read '" + path + "'";
+        return false;
+    }
+    std::string text;
+    for (int c = std::fgetc(file); c != EOF; c = std::fgetc(file)) {
+        text.push_back(static_cast<char>(c));
+    }
+    bool ok = std::ferror(file) == 0;
+    if (!ok) {
+        error = "cannot read '" + path + "'";
+    }
+    if (!text.empty() && text.back() != '\n') {
+        text.push_back('\n');
+    }
+    unsigned line_number = 0;
+    for (std::size_t start = 0; ok && start < text.size();) {
+        const std::size_t end = text.find('\n', start);
+        std::string line = text.substr(start, end - start);
+        start = end + 1;
+        ++line_number;
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        // Sixteen hex digits, one space, a name: the one shape write() produces.
+        std::uint64_t address = 0;
+        bool digits = line.size() > 17 && line[16] == ' ';
+        for (std::size_t i = 0; digits && i < 16; ++i) {
+            const char d = line[i];
+            const int value = (d >= '0' && d <= '9')   ? d - '0'
+                              : (d >= 'A' && d <= 'F') ? d - 'A' + 10
+                              : (d >= 'a' && d <= 'f') ? d - 'a' + 10
+                                                       : -1;
+            digits = value >= 0;
+            address = (address << 4) | static_cast<std::uint64_t>(value & 0xF);
+        }
+        std::string name = digits ? line.substr(17) : std::string();
+        if (!valid_name(name)) {
+            error = path + ":" + std::to_string(line_number) +
+                    ": expected sixteen hex digits, a space and a name";
+            ok = false;
+        } else {
+            add(address, std::move(name));
+        }
+    }
+    std::fclose(file);
+    if (!ok) {
+        entries_.clear();
+    }
+    return ok;
+}
+
+bool SymbolTableV2::write(const std::string& path) const {
+    std::FILE* file = std::fopen(path.c_str(), "w");
+    if (file == nullptr) {
+        return false;
+    }
+    std::fprintf(file, "# maize v2 symbols: address, name\n");
+    for (const Entry& entry : entries_) {
+        std::fprintf(file, "%016" PRIX64 " %s\n", entry.address, entry.name.c_str());
+    }
+    const bool written = std::ferror(file) == 0;
+    return std::fclose(file) == 0 && written;
+}
+
+std::string SymbolTableV2::describe(std::uint64_t address) const {
+    auto after = std::upper_bound(
+        entries_.begin(), entries_.end(), address,
+        [](std::uint64_t value, const Entry& entry) { return value < entry.address; });
+    if (after == entries_.begin()) {
+        return hex_address(address);
+    }
+    auto at = after - 1;
+    while (at != entries_.begin() && (at - 1)->address == at->address) {
+        --at;
+    }
+    if (at->address == address) {
+        return at->name;
+    }
+    char offset[24];
+    std::snprintf(offset, sizeof(offset), "+0x%" PRIX64, address - at->address);
+    return at->name + offset;
+}
+
+}  // namespace maize::v2
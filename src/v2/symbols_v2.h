@@ -0,0 +1,58 @@
+// symbols_v2.h (user-024): the symbol file mzasm --symbols writes and mzvm reads to name guest
+// addresses.
+//
+// The assembler knows every label's address and throws the knowledge away when it writes a flat
+// image, and the machine knows only addresses. The symbol file is the smallest thing that carries
+// one to the other: a line per label, its address as sixteen hex digits, a space, and its name,
+//
+//     0000000000001000 start
+//     0000000000001024 emit_byte
+//
+// in address order. A line that is blank or starts with '#' is a comment. The format is text so a
+// person can read it and another tool can write it, and it carries nothing but names, because
+// what the machine wants from it is nothing but names: a profile's frames (profile_v2.h) are
+// entry addresses, and a report that says `emit_byte` says in a word what $1024 does not.
+//
+// Only a flat image has one: its labels are absolute addresses, where an object's are offsets
+// into sections the linker has still to place.
+
+#ifndef MAIZE_V2_SYMBOLS_V2_H
+#define MAIZE_V2_SYMBOLS_V2_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace maize::v2 {
+
+class SymbolTableV2 {
+  public:
+    struct Entry {
+        std::uint64_t address = 0;
+        std::string name;
+    };
+
+    // Keep `name` at `address`. Entries stay in address order, and two names at one address in
+    // the order they were added.
+    void add(std::uint64_t address, std::string name);
+
+    // Replace the table with the file at `path`. False, with the table empty and `error` saying
+    // why, when the file cannot be read or a line is not an address and a name.
+    bool read(const std::string& path, std::string& error);
+    bool write(const std::string& path) const;
+
+    // What a report calls `address`: the name of a label there; else the nearest label before it
+    // and the distance, as `emit_byte+0x6`; else, before every label or with none, the address
+    // in hex. The first name added at an address is the one reported for it.
+    std::string describe(std::uint64_t address) const;
+
+    bool empty() const { return entries_.empty(); }
+    const std::vector<Entry>& entries() const { return entries_; }
+
+  private:
+    std::vector<Entry> entries_;
+};
+
+}  // namespace maize::v2
+
+#endif  // MAIZE_V2_SYMBOLS_V2_H
@@ -141,10 +141,20 @@ constexpr bool leaf_permits(std::uint64_t permissions, AccessKind kind, Privileg
 
 class TranslatorV2 {
   public:
-    // How many translations the cache holds. The chapter makes the cache architecturally
-    // invisible, so this number is an implementation choice and nothing observable rests on it:
-    // a machine that caches nothing is fully conforming, and so is one that caches everything.
-    static constexpr unsigned kCapacity = 32;
+    // The cache's geometry. The chapter makes the cache architecturally invisible, so these
+    // numbers are an implementation choice and nothing observable rests on them: a machine that
+    // caches nothing is fully conforming, and so is one that caches everything.
+    //
+    // user-003 replaced maize-465's 32-entry linear scan, which ran once for every byte a paged
+    // instruction fetched, loaded or stored, with the shape v1 reached in maize-317 and maize-358:
+    // a set-indexed array of 4 KiB translations, a small fully associative array for superpages
+    // beside it, and one last-page entry per access kind in front of both. A superpage leaf is
+    // cached whole in its own array rather than split into 4 KiB pieces, so one leaf is still
+    // one walk and one cached translation, which is what fixtures_paging.cpp counts.
+    static constexpr unsigned kSets = 64;
+    static constexpr unsigned kWays = 4;
+    static constexpr unsigned kSuperpageEntries = 8;
+    static constexpr unsigned kCapacity = kSets * kWays + kSuperpageEntries;
 
     // Translate one virtual address for one access kind at one privilege level.
     //
@@ -166,7 +176,7 @@ class TranslatorV2 {
 
         const std::uint64_t translated = virtual_address & sv48::kTranslatedMask;
 
-        if (const CachedTranslation* hit = lookup(translated); hit != nullptr) {
+        if (const CachedTranslation* hit = lookup(translated, kind); hit != nullptr) {
             ++hits_;
             return finish(*hit, translated, virtual_address, kind, level);
         }
@@ -239,8 +249,32 @@ class TranslatorV2 {
         return page_fault(kind, page_fault_subcode::kNoMapping, virtual_address);
     }
 
+    // translate() for a caller that would rather not walk (user-022): bare mode and a cached
+    // translation are answered exactly as translate() answers them, hit counted, and anything
+    // else fails with no trap in it and no walk made.
+    TranslationResult translate_cached(std::uint64_t paging_root_value, Privilege level,
+                                       AccessKind kind, std::uint64_t virtual_address) {
+        if ((paging_root_value & paging_root::kModeMask) == paging_root::kModeBare) {
+            TranslationResult result;
+            result.ok = true;
+            result.physical = virtual_address;
+            return result;
+        }
+        const std::uint64_t translated = virtual_address & sv48::kTranslatedMask;
+        if (const CachedTranslation* hit = lookup(translated, kind); hit != nullptr) {
+            ++hits_;
+            return finish(*hit, translated, virtual_address, kind, level);
+        }
+        return TranslationResult{};
+    }
+
     // Invalidating event 2. Discards every cached translation.
-    void invalidate_all() { valid_.fill(false); }
+    void invalidate_all() {
+        ++epoch_;
+        for (CachedTranslation& record : entries_) {
+            record.valid = false;
+        }
+    }
 
     // Invalidating event 3. Discards any cached translation for the page containing this virtual
     // address. D-3 read "the page" as the extent of the leaf that was actually cached, up to a
@@ -252,11 +286,22 @@ class TranslatorV2 {
     // then "A machine may discard more translations than the instruction names, up to and
     // including all of them." Discarding the whole superpage is permitted outright, so no
     // granularity below the leaf can ever be required of any machine.
+    //
+    // A 4 KiB translation of this address can only be in the one set the address indexes, and a
+    // superpage can only be in the superpage array, so this touches a set and that array and
+    // never the rest of the cache.
     void invalidate_address(std::uint64_t virtual_address) {
+        ++epoch_;
         const std::uint64_t translated = virtual_address & sv48::kTranslatedMask;
-        for (unsigned i = 0; i < kCapacity; ++i) {
-            if (valid_[i] && (translated & ~entries_[i].offset_mask) == entries_[i].virtual_base) {
-                valid_[i] = false;
+        const unsigned set = set_of(translated) * kWays;
+        for (unsigned i = set; i < set + kWays; ++i) {
+            if (matches(entries_[i], translated)) {
+                entries_[i].valid = false;
+            }
+        }
+        for (unsigned i = kSuperpageBase; i < kCapacity; ++i) {
+            if (matches(entries_[i], translated)) {
+                entries_[i].valid = false;
             }
         }
     }
@@ -265,14 +310,25 @@ class TranslatorV2 {
     // architecturally invisible, so nothing a conformance suite asserts may rest on these; they
     // exist so THIS machine's caching can be tested for over-flushing and under-flushing, which
     // the chapter's own rules cannot distinguish (see fixtures_paging.cpp).
+    //
+    // A miss always walks, so misses() is walks() under the name a cache report gives it.
+    // fast_hits() counts the hits the last-page entries answered without indexing a set, and is
+    // included in hits(). evictions() counts valid translations displaced to make room, which
+    // is the number that says the cache is too small for a working set.
+    //
+    // epoch() moves on every invalidation, so a caller that remembers a translation outside
+    // this cache (the interpreter's fetch window, user-005) can tell whether it still stands
+    // without asking for it again.
+    std::uint64_t epoch() const { return epoch_; }
     std::uint64_t walks() const { return walks_; }
     std::uint64_t hits() const { return hits_; }
+    std::uint64_t misses() const { return walks_; }
+    std::uint64_t fast_hits() const { return fast_hits_; }
+    std::uint64_t evictions() const { return evictions_; }
     unsigned cached_count() const {
         unsigned count = 0;
-        for (unsigned i = 0; i < kCapacity; ++i) {
-            if (valid_[i]) {
-                ++count;
-            }
+        for (const CachedTranslation& record : entries_) {
+            count += record.valid ? 1u : 0u;
         }
         return count;
     }
@@ -283,6 +339,7 @@ class TranslatorV2 {
         std::uint64_t physical_base = 0;  // the leaf's address field
         std::uint64_t offset_mask = 0;    // the mapped page's size minus one
         std::uint64_t permissions = 0;    // R, W, X and U, in their page-table-entry positions
+        bool valid = false;
     };
 
     static TranslationResult fault(std::uint8_t cause_number, std::uint8_t subcode_number,
@@ -315,26 +372,85 @@ class TranslatorV2 {
         return result;
     }
 
-    const CachedTranslation* lookup(std::uint64_t translated) const {
-        for (unsigned i = 0; i < kCapacity; ++i) {
-            if (valid_[i] && (translated & ~entries_[i].offset_mask) == entries_[i].virtual_base) {
+    static bool matches(const CachedTranslation& record, std::uint64_t translated) {
+        return record.valid && (translated & ~record.offset_mask) == record.virtual_base;
+    }
+
+    // The set a 4 KiB page indexes. The low page-number bits are folded with the next six up, so
+    // a process's code, heap and stack, which commonly sit at the same offsets into regions a
+    // power of two apart, spread over the sets rather than contending for one.
+    static unsigned set_of(std::uint64_t translated) {
+        const std::uint64_t page = translated >> sv48::kPageOffsetBits;
+        return static_cast<unsigned>((page ^ (page >> 6)) & (kSets - 1));
+    }
+
+    // The last-page entry for this access kind first, then the set, then the superpages. A hit
+    // anywhere becomes the kind's last-page entry. That entry is an index into the cache rather
+    // than a copy, so an invalidation or an eviction of the translation it names is seen through
+    // it with nothing further to clear, and an index rather than a pointer so the translator
+    // stays copyable (the JIT's --jit-check snapshots it).
+    const CachedTranslation* lookup(std::uint64_t translated, AccessKind kind) {
+        std::uint16_t& fast = fast_[static_cast<unsigned>(kind)];
+        if (matches(entries_[fast], translated)) {
+            ++fast_hits_;
+            return &entries_[fast];
+        }
+        const unsigned set = set_of(translated) * kWays;
+        for (unsigned i = set; i < set + kWays; ++i) {
+            if (matches(entries_[i], translated)) {
+                fast = static_cast<std::uint16_t>(i);
+                return &entries_[i];
+            }
+        }
+        for (unsigned i = kSuperpageBase; i < kCapacity; ++i) {
+            if (matches(entries_[i], translated)) {
+                fast = static_cast<std::uint16_t>(i);
                 return &entries_[i];
             }
         }
         return nullptr;
     }
 
+    // A free way if the set has one, and otherwise the set's next victim in turn, which is the
+    // FIFO maize-465 used across the whole cache, now kept per set. Superpages share one FIFO.
     void insert(const CachedTranslation& record) {
-        entries_[next_] = record;
-        valid_[next_] = true;
-        next_ = (next_ + 1) % kCapacity;
+        unsigned first = kSuperpageBase;
+        unsigned count = kSuperpageEntries;
+        std::uint8_t* victim = &next_superpage_;
+        if (record.offset_mask == sv48::page_offset_mask(0)) {
+            const unsigned set = set_of(record.virtual_base);
+            first = set * kWays;
+            count = kWays;
+            victim = &victims_[set];
+        }
+        unsigned slot = first + *victim;
+        for (unsigned i = first; i < first + count; ++i) {
+            if (!entries_[i].valid) {
+                slot = i;
+                break;
+            }
+        }
+        if (entries_[slot].valid) {
+            ++evictions_;
+            *victim = static_cast<std::uint8_t>((*victim + 1) % count);
+        }
+        entries_[slot] = record;
+        entries_[slot].valid = true;
     }
 
+    // The 4 KiB sets, kWays entries each, then the superpage entries.
+    static constexpr unsigned kSuperpageBase = kSets * kWays;
+
     std::array<CachedTranslation, kCapacity> entries_{};
-    std::array<bool, kCapacity> valid_{};
-    unsigned next_ = 0;
+    std::array<std::uint8_t, kSets> victims_{};
+    std::uint8_t next_superpage_ = 0;
+    // The last-page entries, indexed by AccessKind.
+    std::array<std::uint16_t, 3> fast_{};
+    std::uint64_t epoch_ = 0;
     std::uint64_t walks_ = 0;
     std::uint64_t hits_ = 0;
+    std::uint64_t fast_hits_ = 0;
+    std::uint64_t evictions_ = 0;
 };
 
 }  // namespace maize::v2
@@ -125,6 +125,89 @@ void expect_unimplemented(const StepResult& result, std::uint8_t opcode, const c
     }
 }
 
+StepResult run_to_stop(InterpreterV2& interpreter) {
+    StepResult result;
+    for (unsigned calls = 0; calls < 100000; ++calls) {
+        result = interpreter.run(1000000);
+        if (result.status != StepStatus::Trapped ||
+            result.disposition != TrapDisposition::Delivered) {
+            break;
+        }
+    }
+    return result;
+}
+
+StepResult run_to_stop(Machine& machine) { return run_to_stop(machine.interpreter()); }
+
+MachineState capture(InterpreterV2& interpreter) {
+    constexpr std::uint16_t kTimerMonotonic = 0x0035;
+    MachineState state;
+    for (unsigned n = 0; n < kRegisterCount; ++n) {
+        state.registers[n] = interpreter.registers().raw(n);
+    }
+    for (std::size_t i = 0; i < std::size(kComparedCsrs); ++i) {
+        state.csrs[i] = interpreter.csr().host_read(kComparedCsrs[i]);
+    }
+    state.pc = interpreter.pc();
+    state.steps = interpreter.steps_taken();
+    state.cycles = interpreter.cycles();
+    state.monotonic = interpreter.device_surface().port_in(kTimerMonotonic);
+    state.halted = interpreter.halted();
+    state.console = interpreter.device_surface().console_output();
+    state.memory.resize(interpreter.memory().size());
+    for (std::size_t i = 0; i < state.memory.size(); ++i) {
+        state.memory[i] = interpreter.memory().read_byte(i);
+    }
+    return state;
+}
+
+MachineState capture(Machine& machine) { return capture(machine.interpreter()); }
+
+void expect_same(const MachineState& actual, const MachineState& expected, const char* what) {
+    char buffer[256];
+    std::snprintf(buffer, sizeof(buffer), "%s: program counter", what);
+    check_equal_u64(actual.pc, expected.pc, buffer, __FILE__, __LINE__);
+    std::snprintf(buffer, sizeof(buffer), "%s: steps taken", what);
+    check_equal_u64(actual.steps, expected.steps, buffer, __FILE__, __LINE__);
+    std::snprintf(buffer, sizeof(buffer), "%s: cycles", what);
+    check_equal_u64(actual.cycles, expected.cycles, buffer, __FILE__, __LINE__);
+    std::snprintf(buffer, sizeof(buffer), "%s: monotonic clock", what);
+    check_equal_u64(actual.monotonic, expected.monotonic, buffer, __FILE__, __LINE__);
+    std::snprintf(buffer, sizeof(buffer), "%s: halted", what);
+    check_equal_u64(actual.halted, expected.halted, buffer, __FILE__, __LINE__);
+    for (unsigned n = 0; n < kRegisterCount; ++n) {
+        std::snprintf(buffer, sizeof(buffer), "%s: r%u", what, n);
+        check_equal_u64(actual.registers[n], expected.registers[n], buffer, __FILE__, __LINE__);
+    }
+    for (std::size_t i = 0; i < std::size(kComparedCsrs); ++i) {
+        std::snprintf(buffer, sizeof(buffer), "%s: csr $%04X", what, kComparedCsrs[i]);
+        check_equal_u64(actual.csrs[i], expected.csrs[i], buffer, __FILE__, __LINE__);
+    }
+    std::snprintf(buffer, sizeof(buffer), "%s: console output length", what);
+    check_equal_u64(actual.console.size(), expected.console.size(), buffer, __FILE__, __LINE__);
+    if (actual.console != expected.console) {
+        record_failure(std::string(what) + ": console output differs");
+    }
+    std::snprintf(buffer, sizeof(buffer), "%s: memory size", what);
+    check_equal_u64(actual.memory.size(), expected.memory.size(), buffer, __FILE__, __LINE__);
+    for (std::size_t i = 0; i < actual.memory.size() && i < expected.memory.size(); ++i) {
+        if (actual.memory[i] != expected.memory[i]) {
+            std::snprintf(buffer, sizeof(buffer), "%s: memory byte $%05zX", what, i);
+            check_equal_u64(actual.memory[i], expected.memory[i], buffer, __FILE__, __LINE__);
+            break;
+        }
+    }
+}
+
+std::string read_back(std::FILE* file) {
+    std::string text;
+    std::rewind(file);
+    for (int c = std::fgetc(file); c != EOF; c = std::fgetc(file)) {
+        text.push_back(static_cast<char>(c));
+    }
+    return text;
+}
+
 }  // namespace maize::v2::test
 
 namespace {
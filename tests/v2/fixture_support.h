@@ -9,7 +9,9 @@
 #ifndef MAIZE_V2_TESTS_FIXTURE_SUPPORT_H
 #define MAIZE_V2_TESTS_FIXTURE_SUPPORT_H
 
+#include <array>
 #include <cstdint>
+#include <cstdio>
 #include <string>
 #include <utility>
 #include <vector>
@@ -98,6 +100,43 @@ void expect_disposition(const StepResult& result, TrapDisposition disposition, c
 void expect_halt_cause(Machine& machine, unsigned kind, std::uint8_t cause_number,
                        std::uint8_t subcode_number, const char* what);
 
+// Running and comparing whole machines, for the fixtures that judge one run against another
+// (user-002's JIT against the interpreter, user-007's restored snapshot and user-008's clones
+// against the machine they came from) or read back what a run wrote to a file (user-023,
+// user-025).
+
+// Run until something other than a delivered trap stops the machine, as mzvm does.
+StepResult run_to_stop(InterpreterV2& interpreter);
+StepResult run_to_stop(Machine& machine);
+
+// Everything a run leaves behind that a guest, or a person reading a dump, could tell apart.
+inline constexpr std::uint16_t kComparedCsrs[] = {
+    csr::kStatus,           csr::kTrapStack,         csr::kScratch,      csr::kTrapVectorBase,
+    csr::kInterruptEnable0, csr::kInterruptPending0, csr::kHaltCause,
+};
+
+struct MachineState {
+    std::array<std::uint64_t, kRegisterCount> registers{};
+    std::array<std::uint64_t, std::size(kComparedCsrs)> csrs{};
+    std::uint64_t pc = 0;
+    std::uint64_t steps = 0;
+    std::uint64_t cycles = 0;
+    std::uint64_t monotonic = 0;
+    bool halted = false;
+    std::vector<std::uint8_t> console;
+    std::vector<std::uint8_t> memory;
+};
+
+MachineState capture(InterpreterV2& interpreter);
+MachineState capture(Machine& machine);
+
+// Every field of `actual` against `expected`, and the first differing byte of memory only: one
+// is enough to say the runs diverged, and a dump of thousands would bury it.
+void expect_same(const MachineState& actual, const MachineState& expected, const char* what);
+
+// The whole of a file a run wrote, from its start.
+std::string read_back(std::FILE* file);
+
 }  // namespace maize::v2::test
 
 #endif  // MAIZE_V2_TESTS_FIXTURE_SUPPORT_H
@@ -0,0 +1,297 @@
+// fixtures_batch.cpp (user-009): many machines on a pool of worker threads.
+//
+// A batch can be wrong in two ways a single run cannot. Its results can come back attached to
+// the wrong jobs, which no individual result shows, so the first fixture gives every job a
+// program whose output names the job and checks each result against it, on several threads
+// and on one. And one job's failure can reach the others, by taking the pool down or by leaving
+// something behind on a worker, so the second fixture puts every kind of failure a job can have
+// between jobs that must still run cleanly.
+//
+// The last two fixtures are the one place jobs are meant to observe each other (user-020): two
+// machines on one network, each waiting on the other's frames, and two where one halts while
+// the other sleeps waiting for a frame that can now never come.
+
+#include <string>
+#include <vector>
+
+#include "batch_v2.h"
+#include "fixture_support.h"
+
+namespace maize::v2::test {
+namespace {
+
+constexpr std::uint64_t kLoadAddress = 0x1000;
+constexpr std::uint16_t kConsoleData = 0x0013;
+constexpr std::uint8_t kLtUnsigned = 6;
+constexpr std::uint8_t kEqual = 0;
+constexpr std::uint16_t kNetworkInterruptControl = 0x0062;
+constexpr std::uint16_t kNetworkTransmitBuffer = 0x0064;
+constexpr std::uint16_t kNetworkReceiveBuffer = 0x0065;
+constexpr std::uint16_t kNetworkTransmit = 0x0066;
+constexpr std::uint16_t kNetworkReceiveLength = 0x0067;
+constexpr std::uint64_t kReceiveBuffer = 0x3000;
+
+// A program that writes `letter` to the console `count` times and halts, so a job's output
+// says which job it was and its length says how long the job ran.
+std::vector<std::uint8_t> repeat_letter(char letter, std::uint64_t count) {
+    Encoder code(kLoadAddress);
+    code.op_r_i8(op::kMoveW, reg(3), static_cast<std::uint8_t>(letter));
+    code.op_r_i8(op::kMoveW, reg(4), kConsoleData);
+    code.op_r_i8(op::kMoveW, reg(10), 0);
+    code.op_r_i8(op::kMoveW, reg(11), count);
+    const std::uint64_t loop = code.current_address();
+    code.op_r_r(op::kPortOut, reg(3), reg(4));
+    code.op_r_r_i4(op::kAddImm, reg(10), reg(10), 1);
+    code.op_r_r_i4(op::kBranchBase + kLtUnsigned, reg(10), reg(11),
+                   loop - (code.current_address() + 7));
+    code.halt();
+    return code.bytes();
+}
+
+// port_out of an immediate, through r3 and r4.
+void emit_port_out(Encoder& code, std::uint16_t port, std::uint64_t value) {
+    code.op_r_i8(op::kMoveW, reg(3), value);
+    code.op_r_i8(op::kMoveW, reg(4), port);
+    code.op_r_r(op::kPortOut, reg(3), reg(4));
+}
+
+// Register the receive buffer, then spin on the receive length until a frame has come, leaving
+// its length in r5. `between` is emitted in the loop before each look.
+template <typename Between>
+void emit_receive(Encoder& code, Between between) {
+    emit_port_out(code, kNetworkReceiveBuffer, kReceiveBuffer);
+    const std::uint64_t loop = code.current_address();
+    between();
+    code.op_r_i8(op::kMoveW, reg(4), kNetworkReceiveLength);
+    code.op_r_r(op::kPortIn, reg(4), reg(5));
+    code.op_r_r_i4(op::kBranchBase + kEqual, reg(5), reg(0), loop - (code.current_address() + 7));
+}
+
+// A frame of `length` bytes from the MAC address ending in `from` to the one ending in `to`, or to
+// broadcast when `to` is zero.
+std::vector<std::uint8_t> frame_for(std::uint8_t to, std::uint8_t from, std::size_t length) {
+    std::vector<std::uint8_t> frame(length, 0x5A);
+    for (std::size_t i = 0; i < 6; ++i) {
+        frame[i] = to == 0 ? 0xFF : (i == 0 ? 0x02 : 0x00);
+        frame[6 + i] = i == 0 ? 0x02 : 0x00;
+    }
+    if (to != 0) {
+        frame[5] = to;
+    }
+    frame[11] = from;
+    return frame;
+}
+
+BatchJobV2 job_for(std::vector<std::uint8_t> image) {
+    BatchJobV2 job;
+    job.image = std::move(image);
+    job.memory_bytes = 0x4000;
+    job.load_address = kLoadAddress;
+    job.start_address = kLoadAddress;
+    return job;
+}
+
+}  // namespace
+
+V2_FIXTURE(a_batch_runs_every_job_and_reports_each_in_job_order) {
+    // Two hundred jobs whose lengths vary by a factor of a few hundred and are lumped, so the
+    // up-front deal leaves one worker far more to do than the others and the rest have to steal
+    // from it to finish together.
+    std::vector<BatchJobV2> jobs;
+    for (unsigned i = 0; i < 200; ++i) {
+        const std::uint64_t count = i < 50 ? 2000 + i : 1 + i % 7;
+        jobs.push_back(job_for(repeat_letter(static_cast<char>('A' + i % 26), count)));
+    }
+
+    BatchOptionsV2 options;
+    options.threads = 4;
+    BatchStatsV2 stats;
+    const std::vector<BatchResultV2> results = run_batch(jobs, options, &stats);
+    V2_CHECK_EQ(stats.threads, 4u);
+    V2_CHECK_EQ(results.size(), jobs.size());
+    for (unsigned i = 0; i < results.size() && i < jobs.size(); ++i) {
+        const std::uint64_t count = i < 50 ? 2000 + i : 1 + i % 7;
+        const BatchResultV2& result = results[i];
+        V2_CHECK(result.ran);
+        V2_CHECK(result.error.empty());
+        expect_halted(result.result, "a batch job");
+        V2_CHECK_EQ(result.steps, 4 + 3 * count + 1);
+        V2_CHECK(result.console ==
+                 std::vector<std::uint8_t>(count, static_cast<std::uint8_t>('A' + i % 26)));
+    }
+
+    // One thread runs the same jobs on the calling thread alone, and the results are the same
+    // result for result.
+    options.threads = 1;
+    const std::vector<BatchResultV2> serial = run_batch(jobs, options, &stats);
+    V2_CHECK_EQ(stats.threads, 1u);
+    V2_CHECK_EQ(stats.stolen, 0u);
+    V2_CHECK_EQ(serial.size(), results.size());
+    for (std::size_t i = 0; i < serial.size() && i < results.size(); ++i) {
+        V2_CHECK_EQ(serial[i].steps, results[i].steps);
+        V2_CHECK_EQ(serial[i].pc, results[i].pc);
+        V2_CHECK(serial[i].console == results[i].console);
+    }
+
+    // An empty batch is an empty report, and more threads than jobs start only as many as
+    // there are jobs.
+    V2_CHECK(run_batch({}, options).empty());
+    options.threads = 16;
+    V2_CHECK_EQ(run_batch({jobs.front(), jobs.back()}, options, &stats).size(), 2u);
+    V2_CHECK_EQ(stats.threads, 2u);
+}
+
+V2_FIXTURE(a_failing_job_is_that_jobs_failure_alone) {
+    std::vector<BatchJobV2> jobs;
+    jobs.push_back(job_for(repeat_letter('a', 3)));
+
+    // An image that cannot be read, and one that does not fit where it is loaded, never run.
+    BatchJobV2 missing;
+    missing.image_path = "no/such/batch/image.mzi";
+    jobs.push_back(missing);
+    BatchJobV2 too_big = job_for(repeat_letter('b', 3));
+    too_big.load_address = 0x3FF8;
+    jobs.push_back(too_big);
+
+    // A machine that never halts stops at its own step count.
+    BatchJobV2 endless = job_for(repeat_letter('c', UINT64_MAX));
+    endless.max_steps = 1000;
+    jobs.push_back(endless);
+
+    // A breakpoint with no handler installed halts that machine on the trap.
+    Encoder breakpoint(kLoadAddress);
+    breakpoint.op(op::kBreakpoint);
+    breakpoint.halt();
+    jobs.push_back(job_for(breakpoint.bytes()));
+
+    jobs.push_back(job_for(repeat_letter('d', 5)));
+
+    BatchOptionsV2 options;
+    options.threads = 3;
+    const std::vector<BatchResultV2> results = run_batch(jobs, options);
+    V2_CHECK_EQ(results.size(), jobs.size());
+    if (results.size() != jobs.size()) {
+        return;
+    }
+
+    expect_halted(results[0].result, "the job before the failures");
+    V2_CHECK(results[0].console == std::vector<std::uint8_t>(3, 'a'));
+
+    V2_CHECK(!results[1].ran);
+    V2_CHECK(results[1].error == "cannot read 'no/such/batch/image.mzi'");
+    V2_CHECK(!results[2].ran);
+    V2_CHECK(results[2].error == "the image does not fit in memory at the load address");
+
+    V2_CHECK(results[3].ran);
+    V2_CHECK(results[3].result.status == StepStatus::Advanced);
+    V2_CHECK_EQ(results[3].steps, 1000u);
+
+    V2_CHECK(results[4].ran);
+    V2_CHECK(results[4].result.status == StepStatus::Trapped);
+    V2_CHECK_EQ(results[4].result.trap.cause, cause::kBreakpoint);
+
+    expect_halted(results[5].result, "the job after the failures");
+    V2_CHECK(results[5].console == std::vector<std::uint8_t>(5, 'd'));
+}
+
+V2_FIXTURE(a_batch_network_carries_frames_between_its_machines) {
+    // A server that waits for any frame and answers it with a 77-byte frame, and a client that
+    // broadcasts a ping until an answer comes and writes the answer's length to its console. The
+    // client pings again and again because nothing says the server is listening yet, which is
+    // also what makes the fixture indifferent to which of the two starts first. A third job on no
+    // network runs in the pool beside them, as any job would, and they on threads of their own
+    // out of the same budget, which leaves the pool one. The same batch on a budget of one runs
+    // none of the networked machines, and says so.
+    constexpr std::uint64_t kFrameAt = kLoadAddress + 0x200;
+    const std::vector<std::uint8_t> answer = frame_for(0xB, 0xA, 77);
+    const std::vector<std::uint8_t> ping = frame_for(0, 0xB, 20);
+
+    Encoder server(kLoadAddress);
+    emit_receive(server, [] {});
+    emit_port_out(server, kNetworkTransmitBuffer, kFrameAt);
+    emit_port_out(server, kNetworkTransmit, answer.size());
+    server.halt();
+    std::vector<std::uint8_t> server_image = server.bytes();
+    server_image.resize(kFrameAt - kLoadAddress);
+    server_image.insert(server_image.end(), answer.begin(), answer.end());
+
+    Encoder client(kLoadAddress);
+    emit_port_out(client, kNetworkTransmitBuffer, kFrameAt);
+    emit_receive(client, [&client, &ping] { emit_port_out(client, kNetworkTransmit, ping.size()); });
+    client.op_r_i8(op::kMoveW, reg(4), kConsoleData);
+    client.op_r_r(op::kPortOut, reg(5), reg(4));
+    client.halt();
+    std::vector<std::uint8_t> client_image = client.bytes();
+    client_image.resize(kFrameAt - kLoadAddress);
+    client_image.insert(client_image.end(), ping.begin(), ping.end());
+
+    std::vector<BatchJobV2> jobs;
+    jobs.push_back(job_for(server_image));
+    jobs.push_back(job_for(repeat_letter('n', 3)));
+    jobs.push_back(job_for(client_image));
+    jobs[0].network = "lan";
+    jobs[2].network = "lan";
+    // A bound, so a machine whose frames never come stops rather than spinning the suite out.
+    jobs[0].max_steps = 100000000;
+    jobs[2].max_steps = 100000000;
+
+    BatchOptionsV2 options;
+    options.threads = 3;
+    BatchStatsV2 stats;
+    const std::vector<BatchResultV2> results = run_batch(jobs, options, &stats);
+    V2_CHECK_EQ(results.size(), jobs.size());
+    if (results.size() != jobs.size()) {
+        return;
+    }
+    V2_CHECK_EQ(stats.threads, 1u);
+    expect_halted(results[0].result, "the server");
+    expect_halted(results[1].result, "the job on no network");
+    expect_halted(results[2].result, "the client");
+    V2_CHECK(results[1].console == std::vector<std::uint8_t>(3, 'n'));
+    V2_CHECK(results[2].console == std::vector<std::uint8_t>(1, answer.size()));
+
+    options.threads = 1;
+    const std::vector<BatchResultV2> refused = run_batch(jobs, options);
+    V2_CHECK(!refused[0].ran && !refused[2].ran);
+    V2_CHECK(refused[0].error == "2 networked machines need a thread each, and the batch has 1");
+    V2_CHECK(refused[2].error == refused[0].error);
+    expect_halted(refused[1].result, "the job on no network, alone");
+}
+
+V2_FIXTURE(a_machine_waiting_on_a_network_its_peers_have_left_is_suspended) {
+    // A listener that enables the network line and waits for a frame, and a peer that halts at
+    // once without sending one. Whichever ends first, the listener must not wait for ever: a
+    // wait begun before the peer hung up is woken by it, and one begun after sees nobody left
+    // on the switch and suspends at once, as a wait on no device at all does. The step bound
+    // only keeps a broken build from hanging the suite, and the wait retires no steps anyway.
+    Encoder listener(kLoadAddress);
+    emit_port_out(listener, kNetworkReceiveBuffer, kReceiveBuffer);
+    emit_port_out(listener, kNetworkInterruptControl, 1);
+    const std::uint64_t wait_at = listener.current_address();
+    listener.op(op::kWaitForInterrupt);
+    listener.halt();
+
+    Encoder peer(kLoadAddress);
+    peer.halt();
+
+    std::vector<BatchJobV2> jobs;
+    jobs.push_back(job_for(listener.bytes()));
+    jobs.push_back(job_for(peer.bytes()));
+    for (BatchJobV2& job : jobs) {
+        job.network = "lan";
+        job.max_steps = 1000;
+    }
+
+    BatchOptionsV2 options;
+    options.threads = 2;
+    const std::vector<BatchResultV2> results = run_batch(jobs, options);
+    V2_CHECK_EQ(results.size(), jobs.size());
+    if (results.size() != jobs.size()) {
+        return;
+    }
+    V2_CHECK(results[0].result.status == StepStatus::Suspended);
+    V2_CHECK_EQ(results[0].pc, wait_at);
+    expect_halted(results[1].result, "the peer");
+}
+
+}  // namespace maize::v2::test
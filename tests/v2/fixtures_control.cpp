@@ -301,4 +301,137 @@ V2_FIXTURE(halt_stops_the_machine) {
     V2_CHECK_EQ(machine.get(4), 7u);
 }
 
+namespace {
+
+// The loop a_fused_pair_is_two_instructions_to_everything_but_the_dispatch runs: every pair
+// predecode_v2.h fuses, each with its second half doing something a wrong fusion would show.
+// It copies twelve words from kFuseSource to kFuseDest, adds the word at kFuseConstant into r18
+// on every pass through a pc_add and load, counts one pass in r19 through a compare and branch
+// that skip an increment on every other pass, and leaves r20 clear unless a branch that must
+// not be taken is.
+// The data is pages away from the code, so the stores never move the code page's generation and
+// the loop runs from cached records.
+constexpr std::size_t kFuseMemory = 0x4000;
+constexpr std::uint64_t kFuseSource = 0x2000;
+constexpr std::uint64_t kFuseDest = 0x3000;
+constexpr std::uint64_t kFuseConstant = 0x1800;
+
+Encoder fused_pair_loop() {
+    Encoder program(kBase);
+    program.op_r_i8(op::kMoveW, reg(10), 0)
+        .op_r_i8(op::kMoveW, reg(11), 12)
+        .op_r_i8(op::kMoveW, reg(15), kFuseSource - 8)
+        .op_r_i8(op::kMoveW, reg(17), kFuseDest - 8);
+    const std::uint64_t loop = program.current_address();
+    program.op_r_r_i4(op::kAddImm, reg(15), reg(15), 8)
+        .op_r_r(op::kLoad, reg(15), reg(16))
+        .op_r_r_i4(op::kAddImm, reg(17), reg(17), 8)
+        .op_r_r(op::kStore, reg(16), reg(17));
+    program.op_r_i4(op::kPcAdd, reg(13), kFuseConstant - (program.current_address() + 6))
+        .op_r_r(op::kLoad, reg(13), reg(14))
+        .op_r_r_r(op::kAdd, reg(14), reg(18), reg(18))
+        .op_r_r_i4(op::kCompareImmBase, reg(10), reg(12), 5)
+        .op_r_r_i4(op::kBranchBase, reg(12), reg(0), 7)
+        .op_r_r_i4(op::kAddImm, reg(19), reg(19), 1)
+        .op_r_r_i4(op::kAddImm, reg(10), reg(10), 1)
+        .op_r_r_r(op::kCompareLtUnsigned, reg(10), reg(11), reg(12));
+    program.op_r_r_i4(op::kBranchBase + 1, reg(12), reg(0), loop - (program.current_address() + 7))
+        .op_r_r_i4(op::kSubtractImm, reg(11), reg(11), 12)
+        .op_r_r_i4(op::kBranchBase + 1, reg(11), reg(0), 1)
+        .halt()
+        .op_r_i1(op::kMoveZb, reg(20), 1)
+        .halt();
+    return program;
+}
+
+void load_fused_pair_loop(Machine& machine) {
+    machine.load(fused_pair_loop());
+    for (std::uint64_t i = 0; i < 12; ++i) {
+        machine.memory().write_little_endian(kFuseSource + 8 * i, 8, 0x1111111111111111ull * (i + 1));
+    }
+    machine.memory().write_little_endian(kFuseConstant, 8, 0x0123456789ull);
+}
+
+}  // namespace
+
+V2_FIXTURE(a_fused_pair_is_two_instructions_to_everything_but_the_dispatch) {
+    // A fused pair (user-014) runs its second half straight from the first's handler, and the
+    // only thing allowed to differ from stepping the two one at a time is that lookup. A run and
+    // a machine that is only ever stepped, which never fuses, finish with the same registers,
+    // the same memory, the same program counter and the same step count.
+    Machine run(kFuseMemory);
+    Machine stepped(kFuseMemory);
+    load_fused_pair_loop(run);
+    load_fused_pair_loop(stepped);
+    expect_halted(run.run(), "the fused pair loop, run");
+    StepResult last{};
+    for (unsigned i = 0; i < 10000 && !stepped.interpreter().halted(); ++i) {
+        last = stepped.step();
+    }
+    expect_halted(last, "the fused pair loop, stepped");
+    for (unsigned number = 0; number < 32; ++number) {
+        V2_CHECK_EQ(run.get(number), stepped.get(number));
+    }
+    V2_CHECK_EQ(run.get(18), 12 * 0x0123456789ull);
+    V2_CHECK_EQ(run.get(19), 1u);
+    V2_CHECK_EQ(run.get(20), 0u);
+    for (std::uint64_t i = 0; i < 12; ++i) {
+        V2_CHECK_EQ(run.memory().read_little_endian(kFuseDest + 8 * i, 8), 0x1111111111111111ull * (i + 1));
+    }
+    V2_CHECK_EQ(run.interpreter().pc(), stepped.interpreter().pc());
+    V2_CHECK_EQ(run.interpreter().steps_taken(), stepped.interpreter().steps_taken());
+    V2_CHECK_EQ(stepped.interpreter().predecode().fused(), 0u);
+#if MAIZE_V2_THREADED_DISPATCH
+    V2_CHECK(run.interpreter().predecode().fused() > 0u);
+#endif
+
+    // A budget is counted in instructions, so a pair whose first half is a budget's last step
+    // stops there, and runs of three stop exactly where three steps at a time do.
+    Machine chunked(kFuseMemory);
+    Machine counted(kFuseMemory);
+    load_fused_pair_loop(chunked);
+    load_fused_pair_loop(counted);
+    for (unsigned chunk = 0; chunk < 1000 && !chunked.interpreter().halted(); ++chunk) {
+        const StepResult ran = chunked.run(3);
+        StepResult took{};
+        for (unsigned i = 0; i < 3 && !counted.interpreter().halted(); ++i) {
+            took = counted.step();
+        }
+        V2_CHECK(ran.status == took.status);
+        V2_CHECK_EQ(chunked.interpreter().pc(), counted.interpreter().pc());
+        V2_CHECK_EQ(chunked.interpreter().steps_taken(), counted.interpreter().steps_taken());
+    }
+    V2_CHECK(counted.interpreter().halted());
+
+    // A second half that faults is the fault of the instruction that it is: the same cause, at
+    // the same program counter, after the same number of steps, with the first half's write
+    // kept, because the first half retired.
+    Encoder faulting(kBase);
+    faulting.op_r_i8(op::kMoveW, reg(15), 0xFE0);
+    const std::uint64_t walk = faulting.current_address();
+    faulting.op_r_r_i4(op::kAddImm, reg(15), reg(15), 8).op_r_r(op::kLoad, reg(15), reg(16));
+    const std::uint64_t load = walk + 7;
+    faulting.op_r_r_i4(op::kBranchBase, reg(0), reg(0), walk - (faulting.current_address() + 7));
+    Machine fault_run;
+    Machine fault_stepped;
+    fault_run.load(faulting);
+    fault_stepped.load(faulting);
+    const StepResult faulted = fault_run.run();
+    StepResult stepped_fault{};
+    for (unsigned i = 0; i < 100 && stepped_fault.status != StepStatus::Trapped; ++i) {
+        stepped_fault = fault_stepped.step();
+    }
+    V2_CHECK(faulted.status == StepStatus::Trapped);
+    V2_CHECK(stepped_fault.status == StepStatus::Trapped);
+    V2_CHECK_EQ(faulted.trap.cause, cause::kPhysicalMemoryFault);
+    V2_CHECK_EQ(faulted.trap.cause, stepped_fault.trap.cause);
+    V2_CHECK_EQ(faulted.trap.pc, load);
+    V2_CHECK_EQ(stepped_fault.trap.pc, load);
+    V2_CHECK_EQ(fault_run.get(15), 0x1000u);
+    V2_CHECK_EQ(fault_run.interpreter().steps_taken(), fault_stepped.interpreter().steps_taken());
+#if MAIZE_V2_THREADED_DISPATCH
+    V2_CHECK(fault_run.interpreter().predecode().fused() > 0u);
+#endif
+}
+
 }  // namespace maize::v2::test
@@ -0,0 +1,189 @@
+// fixtures_cost.cpp (user-022): the cycle cost model, the cycle limit, and the count's survival
+// across a snapshot and a clone.
+//
+// THE NUMBERS ARE PINNED HERE IN DIGITS. cost_v2.h says a change to its table is a change to this
+// file too, and the first fixture is why: it sums a short program by hand, so a cost that moved
+// by accident fails it rather than being carried silently into every count a host has recorded.
+// The others assert the model's properties instead of its numbers: that the limit stops a run on
+// the boundary a machine stepping one instruction at a time would have stopped on, and that the
+// count carries on across everything that carries the step count on. The JIT's agreement with the
+// interpreter is fixtures_jit.cpp's and fixtures_paging.cpp's to assert, with the rest of it.
+
+#include <cstdio>
+#include <vector>
+
+#include "batch_v2.h"
+#include "fixture_support.h"
+#include "snapshot_v2.h"
+
+namespace maize::v2::test {
+namespace {
+
+constexpr std::size_t kMemoryBytes = 0x4000;
+constexpr std::uint64_t kProgramBase = 0x100;
+constexpr std::uint64_t kFill = 0x900;
+
+constexpr std::uint8_t kLtUnsigned = 6;
+
+// One instruction of every band the first fixture sums, then a hundred-byte fill.
+Encoder costed_program() {
+    Encoder code(kProgramBase);
+    code.op_r_i8(op::kMoveW, reg(1), 7);
+    code.op_r_i8(op::kMoveW, reg(2), 3);
+    code.op_r_r_r(op::kMultiply, reg(1), reg(2), reg(3));
+    code.op_r_r_r(op::kDivideUnsigned, reg(1), reg(2), reg(4));
+    code.op_r_i8(op::kMoveW, reg(5), 0x800);
+    code.op_r_r(op::kStore, reg(3), reg(5));
+    code.op_r_r(op::kLoad, reg(5), reg(6));
+    code.op_r_i8(op::kMoveW, reg(7), 0xAB);
+    code.op_r_i8(op::kMoveW, reg(8), kFill);
+    code.op_r_i8(op::kMoveW, reg(9), 100);
+    code.op_r_r_r(op::kBlockSet, reg(7), reg(8), reg(9));
+    code.halt();
+    return code;
+}
+
+// Two hundred iterations of a multiply and an add_imm that fuses with the branch after it, so a
+// limit has a pair to stop in the middle of and instructions of two costs to land on.
+Encoder limited_loop() {
+    Encoder code(kProgramBase);
+    code.op_r_i8(op::kMoveW, reg(10), 0);
+    code.op_r_i8(op::kMoveW, reg(11), 200);
+    const std::uint64_t loop = code.current_address();
+    code.op_r_r_r(op::kMultiply, reg(10), reg(10), reg(12));
+    code.op_r_r_i4(op::kAddImm, reg(10), reg(10), 1);
+    code.op_r_r_i4(op::kBranchBase + kLtUnsigned, reg(10), reg(11),
+                   loop - (code.current_address() + 7));
+    code.halt();
+    return code;
+}
+
+// The cycle count after each step of a run taken one step() at a time, from zero steps on.
+std::vector<std::uint64_t> stepped_cycles(const Encoder& program) {
+    Machine machine(kMemoryBytes);
+    machine.load(program);
+    std::vector<std::uint64_t> cycles{machine.interpreter().cycles()};
+    for (unsigned steps = 0; steps < 100000 && !machine.interpreter().halted(); ++steps) {
+        machine.step();
+        cycles.push_back(machine.interpreter().cycles());
+    }
+    return cycles;
+}
+
+}  // namespace
+
+V2_FIXTURE(cycles_are_charged_by_opcode_and_by_block_byte) {
+    // Six moves at 1, a multiply at 3, a divide at 20, a store and a load at 2 each, a block_set
+    // at 4 plus 100 for the bytes it fills, and the halt at 1.
+    constexpr std::uint64_t kExpected = 6 + 3 + 20 + 2 + 2 + 4 + 100 + 1;
+    V2_CHECK_EQ(kExpected, 138u);
+
+    Machine stepped(kMemoryBytes);
+    stepped.load(costed_program());
+    std::uint64_t before = 0;
+    while (!stepped.interpreter().halted()) {
+        const StepResult result = stepped.step();
+        V2_CHECK(result.status == StepStatus::Advanced || result.status == StepStatus::Halted);
+        V2_CHECK(stepped.interpreter().cycles() > before);
+        before = stepped.interpreter().cycles();
+    }
+    V2_CHECK_EQ(stepped.interpreter().cycles(), kExpected);
+    V2_CHECK_EQ(stepped.interpreter().steps_taken(), 12u);
+    V2_CHECK_EQ(stepped.memory().read_byte(kFill + 99), 0xABu);
+
+    Machine run(kMemoryBytes);
+    run.load(costed_program());
+    expect_halted(run.run(), "the costed program");
+    V2_CHECK_EQ(run.interpreter().cycles(), kExpected);
+    V2_CHECK_EQ(run.interpreter().steps_taken(), 12u);
+    // No page tables, so nothing walked.
+    V2_CHECK_EQ(run.interpreter().translator().walks(), 0u);
+}
+
+V2_FIXTURE(a_cycle_limit_stops_run_at_the_boundary_that_reaches_it) {
+    const Encoder program = limited_loop();
+    const std::vector<std::uint64_t> oracle = stepped_cycles(program);
+    const std::uint64_t total = oracle.back();
+    V2_CHECK_EQ(oracle.size() - 1, 2u + 3u * 200u + 1u);
+    V2_CHECK_EQ(total, 2u + 5u * 200u + 1u);
+
+    // Every limit across the first iterations, so the stop lands on each instruction of the loop
+    // and on both halves of the pair, and then a spread across the rest of the run.
+    std::vector<std::uint64_t> limits;
+    for (std::uint64_t limit = 1; limit <= 24; ++limit) {
+        limits.push_back(limit);
+    }
+    for (const std::uint64_t limit : {97u, 500u, 998u, 1002u}) {
+        limits.push_back(limit);
+    }
+    limits.push_back(total);
+    for (const std::uint64_t limit : limits) {
+        std::uint64_t expected_steps = 0;
+        while (oracle[expected_steps] < limit) {
+            ++expected_steps;
+        }
+        Machine machine(kMemoryBytes);
+        machine.load(program);
+        machine.interpreter().set_cycle_limit(limit);
+        const StepResult result = machine.run(1000000);
+        char what[64];
+        std::snprintf(what, sizeof(what), "a limit of %u", static_cast<unsigned>(limit));
+        if (limit == total) {
+            // The halt is what reaches it, and a halt is reported as one.
+            expect_halted(result, what);
+        } else {
+            check_equal_u64(static_cast<std::uint64_t>(result.status),
+                            static_cast<std::uint64_t>(StepStatus::Advanced), what, __FILE__,
+                            __LINE__);
+        }
+        check_equal_u64(machine.interpreter().steps_taken(), expected_steps, what, __FILE__,
+                        __LINE__);
+        check_equal_u64(machine.interpreter().cycles(), oracle[expected_steps], what, __FILE__,
+                        __LINE__);
+        // A limit leaves pairs fused short of the last few cycles before it, so a run that
+        // reaches it well after the loop has started has run some. A build that dispatches
+        // through the switch (user-013) never runs a pair's handler, and so never fuses.
+#if MAIZE_V2_THREADED_DISPATCH
+        if (limit > 50) {
+            check(machine.interpreter().predecode().fused() > 0, what, __FILE__, __LINE__);
+        }
+#endif
+
+        // run_until is how mzvm drives a run, and it does not run past a limit already reached.
+        const std::uint64_t steps = machine.interpreter().steps_taken();
+        run_until(machine.interpreter(), 0);
+        check_equal_u64(machine.interpreter().steps_taken(), steps, what, __FILE__, __LINE__);
+    }
+
+    // A limit the run never reaches changes nothing.
+    Machine unreached(kMemoryBytes);
+    unreached.load(program);
+    unreached.interpreter().set_cycle_limit(total + 1);
+    expect_halted(run_until(unreached.interpreter(), 0), "a limit beyond the run");
+    V2_CHECK_EQ(unreached.interpreter().cycles(), total);
+}
+
+V2_FIXTURE(cycles_carry_across_a_snapshot_and_a_clone) {
+    const Encoder program = limited_loop();
+    Machine original(kMemoryBytes);
+    original.load(program);
+    original.run(250);
+    const std::uint64_t at_snapshot = original.interpreter().cycles();
+    V2_CHECK(at_snapshot > 250u);
+    const MachineSnapshotV2 snapshot = original.interpreter().take_full_snapshot();
+    std::unique_ptr<InterpreterV2> clone = original.interpreter().clone();
+
+    Machine restored(kMemoryBytes);
+    V2_CHECK(restored.interpreter().restore_snapshot(snapshot));
+    V2_CHECK_EQ(restored.interpreter().cycles(), at_snapshot);
+    V2_CHECK_EQ(clone->cycles(), at_snapshot);
+
+    expect_halted(original.run(), "the original");
+    expect_halted(restored.run(), "the restored machine");
+    expect_halted(clone->run(), "the clone");
+    V2_CHECK_EQ(original.interpreter().cycles(), 2u + 5u * 200u + 1u);
+    V2_CHECK_EQ(restored.interpreter().cycles(), original.interpreter().cycles());
+    V2_CHECK_EQ(clone->cycles(), original.interpreter().cycles());
+}
+
+}  // namespace maize::v2::test
@@ -9,11 +9,26 @@
 // than about the devices: that port_in and port_out reach the port space at all, and that both
 // carry the privileged-operation guard.
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <mutex>
 #include <string>
+#include <system_error>
+#include <thread>
 #include <vector>
 
+#include "block_storage_v2.h"
+#include "console_stream_v2.h"
 #include "device_v2.h"
+#include "entropy_v2.h"
 #include "fixture_support.h"
+#include "framebuffer_v2.h"
+#include "network_v2.h"
 
 namespace maize::v2::test {
 namespace {
@@ -28,12 +43,197 @@ constexpr std::uint16_t kConsoleId = 0x0010;
 constexpr std::uint16_t kConsoleStatus = 0x0011;
 constexpr std::uint16_t kConsoleControl = 0x0012;
 constexpr std::uint16_t kConsoleData = 0x0013;
+constexpr std::uint16_t kBlockId = 0x0040;
+constexpr std::uint16_t kBlockStatus = 0x0041;
+constexpr std::uint16_t kBlockControl = 0x0042;
+constexpr std::uint16_t kBlockSize = 0x0043;
+constexpr std::uint16_t kBlockCapacity = 0x0044;
+constexpr std::uint16_t kBlockNumber = 0x0045;
+constexpr std::uint16_t kBlockBuffer = 0x0046;
+constexpr std::uint16_t kBlockLength = 0x0047;
+constexpr std::uint16_t kBlockCommand = 0x0048;
+constexpr std::uint16_t kFramebufferId = 0x0050;
+constexpr std::uint16_t kFramebufferStatus = 0x0051;
+constexpr std::uint16_t kFramebufferControl = 0x0052;
+constexpr std::uint16_t kFramebufferWidth = 0x0053;
+constexpr std::uint16_t kFramebufferHeight = 0x0054;
+constexpr std::uint16_t kFramebufferFormat = 0x0055;
+constexpr std::uint16_t kFramebufferSurfaces = 0x0056;
+constexpr std::uint16_t kFramebufferSelect = 0x0057;
+constexpr std::uint16_t kFramebufferBase = 0x0058;
+constexpr std::uint16_t kFramebufferPresent = 0x0059;
+constexpr std::uint16_t kFramebufferScanout = 0x005A;
+constexpr std::uint16_t kNetworkId = 0x0060;
+constexpr std::uint16_t kNetworkStatus = 0x0061;
+constexpr std::uint16_t kNetworkControl = 0x0062;
+constexpr std::uint16_t kNetworkMaxFrame = 0x0063;
+constexpr std::uint16_t kNetworkTransmitBuffer = 0x0064;
+constexpr std::uint16_t kNetworkReceiveBuffer = 0x0065;
+constexpr std::uint16_t kNetworkTransmit = 0x0066;
+constexpr std::uint16_t kNetworkReceiveLength = 0x0067;
+constexpr std::uint16_t kEntropyId = 0x0070;
+constexpr std::uint16_t kEntropyStatus = 0x0071;
+constexpr std::uint16_t kEntropyControl = 0x0072;
+constexpr std::uint16_t kEntropyData = 0x0073;
 
 std::string console_text(const DeviceSurfaceV2& surface) {
     const std::vector<std::uint8_t>& bytes = surface.console_output();
     return std::string(bytes.begin(), bytes.end());
 }
 
+// A sink that keeps what it is given, so a fixture can see what reached it and in what order.
+class RecordingSink final : public ConsoleSinkV2 {
+  public:
+    void put(std::uint8_t byte) override { bytes.push_back(byte); }
+    std::vector<std::uint8_t> bytes;
+};
+
+// A source whose stream is whatever the fixture put in it, and which counts how often the console
+// asked, so a fixture can see when a guest's input is being looked for and when it is not.
+class ScriptedSource final : public ConsoleSourceV2 {
+  public:
+    bool take(std::vector<std::uint8_t>& into, std::size_t limit) override {
+        ++takes;
+        const std::size_t count = std::min(limit, bytes.size() - given);
+        into.insert(into.end(), bytes.begin() + static_cast<std::ptrdiff_t>(given),
+                    bytes.begin() + static_cast<std::ptrdiff_t>(given + count));
+        given += count;
+        return ended && given == bytes.size();
+    }
+    void wait(std::uint64_t nanoseconds) override { (void)nanoseconds; }
+
+    std::vector<std::uint8_t> bytes;
+    std::size_t given = 0;
+    bool ended = false;
+    unsigned takes = 0;
+};
+
+// An image held in host memory, which a fixture can stop in the middle of a transfer, so the
+// transfer is still in flight when the fixture looks, and can have move no more than `limit`
+// bytes a call, which is how a host that fails partway looks to the device.
+class HeldImage final : public BlockImageV2 {
+  public:
+    explicit HeldImage(std::size_t length) : bytes(length) {
+        for (std::size_t i = 0; i < length; ++i) {
+            bytes[i] = static_cast<std::uint8_t>(i * 7 + 3);
+        }
+    }
+
+    std::uint64_t size() const override { return bytes.size(); }
+
+    std::size_t read(std::uint64_t offset, std::uint8_t* into, std::size_t length) override {
+        pass();
+        const std::size_t count = std::min(length, limit);
+        std::memcpy(into, bytes.data() + offset, count);
+        return count;
+    }
+
+    std::size_t write(std::uint64_t offset, const std::uint8_t* from, std::size_t length) override {
+        pass();
+        const std::size_t count = std::min(length, limit);
+        std::memcpy(bytes.data() + offset, from, count);
+        return count;
+    }
+
+    void hold() {
+        std::lock_guard<std::mutex> guard(lock);
+        held = true;
+    }
+
+    void release() {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            held = false;
+        }
+        opened.notify_all();
+    }
+
+    std::vector<std::uint8_t> bytes;
+    std::size_t limit = SIZE_MAX;
+    unsigned calls = 0;
+
+  private:
+    void pass() {
+        std::unique_lock<std::mutex> guard(lock);
+        ++calls;
+        opened.wait(guard, [this] { return !held; });
+    }
+
+    std::mutex lock;
+    std::condition_variable opened;
+    bool held = false;
+};
+
+// A display that keeps a copy of every frame it is given and the last surface scanned out, so a
+// fixture can see exactly what a present handed over.
+class RecordingDisplay final : public FramebufferSinkV2 {
+  public:
+    void present(unsigned surface, const std::uint8_t* pixels, std::size_t bytes) override {
+        frames.push_back({surface, std::vector<std::uint8_t>(pixels, pixels + bytes)});
+    }
+    void scan_out(unsigned surface) override { scanned_out = surface; }
+
+    struct Frame {
+        unsigned surface;
+        std::vector<std::uint8_t> pixels;
+    };
+    std::vector<Frame> frames;
+    unsigned scanned_out = 0;
+};
+
+// A frame of `length` bytes from the MAC address ending in `from` to the one ending in `to`, or to
+// broadcast when `to` is zero, with a payload that says which frame it is.
+std::vector<std::uint8_t> ethernet_frame(std::uint8_t to, std::uint8_t from, std::size_t length,
+                                         std::uint8_t tag) {
+    std::vector<std::uint8_t> frame(length, tag);
+    const std::uint8_t prefix[5] = {0x02, 0x00, 0x00, 0x00, 0x00};
+    for (std::size_t i = 0; i < 5; ++i) {
+        frame[i] = to == 0 ? 0xFF : prefix[i];
+        frame[6 + i] = prefix[i];
+    }
+    frame[5] = to == 0 ? 0xFF : to;
+    frame[11] = from;
+    return frame;
+}
+
+// Put `frame` in the guest's transmit buffer at `base` and transmit it, the way a driver would.
+void transmit_frame(DeviceSurfaceV2& ports, MemoryV2& memory, std::uint64_t base,
+                    const std::vector<std::uint8_t>& frame) {
+    for (std::size_t i = 0; i < frame.size(); ++i) {
+        memory.write_byte(base + i, frame[i]);
+    }
+    ports.port_out(kNetworkTransmitBuffer, base);
+    ports.port_out(kNetworkTransmit, frame.size());
+}
+
+// Issue one block command the way a driver would: block number, buffer, length, then the command.
+void block_command(DeviceSurfaceV2& ports, std::uint64_t command, std::uint64_t block,
+                   std::uint64_t buffer, std::uint64_t length) {
+    ports.port_out(kBlockNumber, block);
+    ports.port_out(kBlockBuffer, buffer);
+    ports.port_out(kBlockLength, length);
+    ports.port_out(kBlockCommand, command);
+}
+
+std::vector<std::uint8_t> guest_bytes(MemoryV2& memory, std::uint64_t address, std::size_t length) {
+    std::vector<std::uint8_t> bytes;
+    for (std::size_t i = 0; i < length; ++i) {
+        bytes.push_back(memory.read_byte(address + i));
+    }
+    return bytes;
+}
+
+std::vector<std::uint8_t> read_whole(std::FILE* file) {
+    std::vector<std::uint8_t> bytes;
+    std::rewind(file);
+    std::uint8_t buffer[4096];
+    std::size_t got = 0;
+    while ((got = std::fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        bytes.insert(bytes.end(), buffer, buffer + got);
+    }
+    return bytes;
+}
+
 }  // namespace
 
 V2_FIXTURE(device_machine_block_identification_and_presence) {
@@ -155,6 +355,207 @@ V2_FIXTURE(device_console_output_accumulates_bytes) {
     V2_CHECK((ports.port_in(kConsoleStatus) & status_mask(console_status_bit::kOverrun)) == 0);
 }
 
+V2_FIXTURE(device_console_sink_takes_the_bytes_the_buffer_would_have) {
+    // user-016: an attached sink is where the output goes INSTEAD of the buffer, so a guest that
+    // prints for hours grows nothing in the machine, and detaching it puts the buffer back.
+    Machine machine;
+    DeviceSurfaceV2& ports = machine.interpreter().device_surface();
+    RecordingSink sink;
+    ports.console().host_attach_sink(&sink);
+
+    const std::string text = std::string("to the sink\n") + '\0' + "\xFF";
+    for (char c : text) {
+        ports.port_out(kConsoleData, 0xFFFFFFFFFFFFFF00ull | static_cast<std::uint8_t>(c));
+    }
+    V2_CHECK(std::string(sink.bytes.begin(), sink.bytes.end()) == text);
+    V2_CHECK(ports.console_output().empty());
+    V2_CHECK((ports.port_in(kConsoleStatus) & status_mask(console_status_bit::kOverrun)) == 0);
+
+    // A console that is not ready loses the byte with a sink attached exactly as without one.
+    ports.console().host_set_output_ready(false);
+    ports.port_out(kConsoleData, 'x');
+    V2_CHECK_EQ(sink.bytes.size(), text.size());
+    V2_CHECK((ports.port_in(kConsoleStatus) & status_mask(console_status_bit::kOverrun)) != 0);
+    ports.console().host_set_output_ready(true);
+
+    ports.console().host_attach_sink(nullptr);
+    ports.port_out(kConsoleData, 'b');
+    V2_CHECK_EQ(sink.bytes.size(), text.size());
+    V2_CHECK(console_text(ports) == "b");
+}
+
+V2_FIXTURE(device_console_stream_writes_every_byte_in_order_through_a_small_buffer) {
+    // A buffer of sixteen bytes against a guest writing thousands, so put() overtakes the writer
+    // over and over and has to wait for it, and a byte lost or reordered at a swap shows up in
+    // the file. Line flushing is on, and the output is mostly line feeds, so the writer is woken
+    // from both directions at once.
+    std::FILE* file = std::tmpfile();
+    V2_CHECK(file != nullptr);
+    if (file == nullptr) {
+        return;
+    }
+    std::vector<std::uint8_t> expected;
+    for (unsigned i = 0; i < 5000; ++i) {
+        expected.push_back(i % 3 == 0 ? '\n' : static_cast<std::uint8_t>(i * 7));
+    }
+    {
+        Machine machine;
+        DeviceSurfaceV2& ports = machine.interpreter().device_surface();
+        ConsoleStreamOptionsV2 options;
+        options.capacity = 16;
+        options.threshold = 5;
+        options.line_flush = true;
+        StreamingConsoleSinkV2 sink(file, options);
+        ports.console().host_attach_sink(&sink);
+        for (std::uint8_t byte : expected) {
+            ports.port_out(kConsoleData, byte);
+        }
+        sink.close();
+        V2_CHECK(!sink.failed());
+        V2_CHECK(ports.console_output().empty());
+        // Closed is closed: a byte after it goes nowhere, rather than to a stream the host has
+        // since moved on from.
+        ports.port_out(kConsoleData, 'z');
+    }
+    V2_CHECK(read_whole(file) == expected);
+    std::fclose(file);
+
+    // A prompt has no line feed and comes nowhere near the threshold, and it still reaches the
+    // stream while the sink is open, at the writer's tick. The file is read through a handle of
+    // its own, so the fixture never touches the stream the writer owns.
+    std::error_code ec;
+    const std::filesystem::path path =
+        std::filesystem::temp_directory_path(ec) /
+        ("mzvm-console-stream-" +
+         std::to_string(std::chrono::steady_clock::now().time_since_epoch().count()));
+    std::FILE* out = std::fopen(path.string().c_str(), "wb");
+    V2_CHECK(out != nullptr);
+    if (out == nullptr) {
+        return;
+    }
+    {
+        ConsoleStreamOptionsV2 options;
+        options.tick = std::chrono::milliseconds(5);
+        StreamingConsoleSinkV2 sink(out, options);
+        for (char c : std::string("name? ")) {
+            sink.put(static_cast<std::uint8_t>(c));
+        }
+        const auto give_up = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+        while (std::filesystem::file_size(path, ec) < 6 &&
+               std::chrono::steady_clock::now() < give_up) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        V2_CHECK_EQ(std::filesystem::file_size(path, ec), 6u);
+    }
+    std::fclose(out);
+    std::filesystem::remove(path, ec);
+}
+
+V2_FIXTURE(device_console_stream_drops_rather_than_waits_once_its_stream_fails) {
+    // A stream opened for reading refuses every write, which is the shape of a reader that went
+    // away. The guest writes far more than the buffer holds, and a sink that kept waiting for a
+    // writer that can never drain it would hang here rather than fail.
+    std::error_code ec;
+    const std::filesystem::path path =
+        std::filesystem::temp_directory_path(ec) /
+        ("mzvm-console-refused-" +
+         std::to_string(std::chrono::steady_clock::now().time_since_epoch().count()));
+    std::FILE* create = std::fopen(path.string().c_str(), "wb");
+    V2_CHECK(create != nullptr);
+    if (create == nullptr) {
+        return;
+    }
+    std::fclose(create);
+    std::FILE* refusing = std::fopen(path.string().c_str(), "rb");
+    V2_CHECK(refusing != nullptr);
+    if (refusing == nullptr) {
+        return;
+    }
+    {
+        ConsoleStreamOptionsV2 options;
+        options.capacity = 8;
+        StreamingConsoleSinkV2 sink(refusing, options);
+        for (unsigned i = 0; i < 1000; ++i) {
+            sink.put('x');
+        }
+        sink.close();
+        V2_CHECK(sink.failed());
+    }
+    std::fclose(refusing);
+    std::filesystem::remove(path, ec);
+}
+
+V2_FIXTURE(device_console_source_is_asked_only_by_a_guest_reading_input) {
+    // user-017. A console with a source asks it for input when the guest reads the status or data
+    // port, and at the run loop's settles while the guest has the line enabled, and at no other
+    // time. The stream is longer than the console's window, so it also has to arrive in order
+    // across many asks, with no more of it inside the machine at once than the window.
+    Machine machine;
+    DeviceSurfaceV2& ports = machine.interpreter().device_surface();
+    ScriptedSource source;
+    for (unsigned i = 0; i < 3 * ConsoleDeviceV2::kInputWindow + 5; ++i) {
+        source.bytes.push_back(static_cast<std::uint8_t>(i * 13));
+    }
+    ports.console().host_attach_source(&source);
+
+    // Probing the console, and enabling and disabling its line, reads no input.
+    V2_CHECK_EQ(ports.port_in(kConsoleId) & 0xFFFFu, 1u);
+    ports.port_out(kConsoleControl, 1);
+    ports.port_out(kConsoleControl, 0);
+    V2_CHECK_EQ(source.takes, 0u);
+
+    // A status read does, and the console holds one window of the stream and no more.
+    V2_CHECK((ports.port_in(kConsoleStatus) & status_mask(console_status_bit::kInputAvailable)) !=
+             0);
+    V2_CHECK_EQ(source.takes, 1u);
+    V2_CHECK_EQ(ports.console().host_pending_input(), ConsoleDeviceV2::kInputWindow);
+
+    // Every byte comes out in order, and the end is latched only once the last one has been
+    // queued, not when the source first said it had nothing more.
+    source.ended = true;
+    std::vector<std::uint8_t> read;
+    while (read.size() < source.bytes.size()) {
+        const std::uint64_t status = ports.port_in(kConsoleStatus);
+        if (source.given < source.bytes.size()) {
+            V2_CHECK((status & status_mask(console_status_bit::kEndOfInput)) == 0);
+        }
+        read.push_back(static_cast<std::uint8_t>(ports.port_in(kConsoleData)));
+        if (ports.console().host_pending_input() > ConsoleDeviceV2::kInputWindow) {
+            record_failure("the console took more than its window from the source");
+            return;
+        }
+    }
+    V2_CHECK(read == source.bytes);
+    const std::uint64_t ended = ports.port_in(kConsoleStatus);
+    V2_CHECK((ended & status_mask(console_status_bit::kEndOfInput)) != 0);
+    V2_CHECK((ended & status_mask(console_status_bit::kInputAvailable)) == 0);
+    // And an ended stream is not asked again.
+    const unsigned asked = source.takes;
+    ports.port_in(kConsoleStatus);
+    V2_CHECK_EQ(source.takes, asked);
+
+    // A guest that never touches the console is never polled for it while it runs, and one that
+    // has enabled the line is, without reading a port, and sees the byte on the line.
+    Machine running;
+    Encoder spin(kBase);
+    const std::uint64_t loop = spin.current_address();
+    spin.op_r_r_i4(op::kBranchBase, reg(0), reg(0), loop - (spin.current_address() + 7));
+    running.load(spin);
+    DeviceSurfaceV2& spinning = running.interpreter().device_surface();
+    ScriptedSource typed;
+    typed.bytes.push_back('y');
+    spinning.console().host_attach_source(&typed);
+    V2_CHECK(running.run(4 * DeviceSurfaceV2::kHostPollInstructions).status ==
+             StepStatus::Advanced);
+    V2_CHECK_EQ(typed.takes, 0u);
+    spinning.port_out(kConsoleControl, 1);
+    V2_CHECK(running.run(4 * DeviceSurfaceV2::kHostPollInstructions).status ==
+             StepStatus::Advanced);
+    V2_CHECK(typed.takes > 0);
+    V2_CHECK_EQ(spinning.console().host_pending_input(), 1u);
+    V2_CHECK_EQ(spinning.asserted_interrupt_lines(), std::uint64_t{1} << 1);
+}
+
 V2_FIXTURE(device_console_input_is_permanently_absent) {
     // No host input source is wired to the console in this build, so a machine nobody hands a
     // byte to holds input-available clear and never asserts end-of-input. Reading offset 3 with
@@ -263,6 +664,687 @@ V2_FIXTURE(device_interrupt_control_reads_back_what_it_stores) {
     V2_CHECK_EQ(ports.port_in(kConsoleControl), 0u);
 }
 
+V2_FIXTURE(device_block_storage_moves_blocks_between_its_image_and_guest_memory) {
+    // user-018. A machine with no image attached carries no block storage, and one with an image
+    // carries the class, answers for it in the presence bitmap, and moves whole blocks between
+    // the image file and a buffer anywhere in guest memory, page boundaries included, touching
+    // no byte outside the buffer.
+    Machine machine(0x10000);
+    DeviceSurfaceV2& ports = machine.interpreter().device_surface();
+    MemoryV2& memory = machine.memory();
+    V2_CHECK_EQ(ports.port_in(kMachinePresence), 0x000000000000000Aull);
+    V2_CHECK_EQ(ports.port_in(kBlockId), 0u);
+
+    std::error_code ec;
+    const std::filesystem::path path =
+        std::filesystem::temp_directory_path(ec) /
+        ("mzvm-block-image-" +
+         std::to_string(std::chrono::steady_clock::now().time_since_epoch().count()));
+    std::vector<std::uint8_t> contents(8 * BlockStorageDeviceV2::kBlockBytes + 100);
+    for (std::size_t i = 0; i < contents.size(); ++i) {
+        contents[i] = static_cast<std::uint8_t>(i * 7 + 3);
+    }
+    std::FILE* file = std::fopen(path.string().c_str(), "wb");
+    V2_CHECK(file != nullptr);
+    if (file == nullptr) {
+        return;
+    }
+    V2_CHECK_EQ(std::fwrite(contents.data(), 1, contents.size(), file), contents.size());
+    std::fclose(file);
+
+    {
+        FileBlockImageV2 image;
+        V2_CHECK(!FileBlockImageV2().open((path / "not-a-file").string()));
+        V2_CHECK(image.open(path.string()));
+        ports.block_storage().host_attach_image(&image);
+
+        // Present, with the reset state the chapter gives: no transfer done, and the block,
+        // buffer and length ports reading zero. The hundred bytes past the last whole block are
+        // not a block, so the capacity leaves them out.
+        V2_CHECK_EQ(ports.port_in(kMachinePresence), 0x000000000000001Aull);
+        V2_CHECK_EQ(ports.port_in(kBlockId), 0x0000000000010004ull);
+        V2_CHECK_EQ(ports.port_in(kBlockStatus), 0u);
+        V2_CHECK_EQ(ports.port_in(kBlockSize), 512u);
+        V2_CHECK_EQ(ports.port_in(kBlockCapacity), 8u);
+        V2_CHECK_EQ(ports.port_in(kBlockNumber), 0u);
+        V2_CHECK_EQ(ports.port_in(kBlockBuffer), 0u);
+        V2_CHECK_EQ(ports.port_in(kBlockLength), 0u);
+
+        // Three blocks from block 2 into a buffer that starts mid-page and crosses a page, on
+        // pages nothing has written, which the host call must find committed.
+        block_command(ports, block_storage_offset::kCommandRead, 2, 0x2345, 3);
+        V2_CHECK_EQ(ports.port_in(kBlockStatus),
+                    status_mask(block_storage_status_bit::kTransferComplete));
+        V2_CHECK(guest_bytes(memory, 0x2345, 3 * 512) ==
+                 std::vector<std::uint8_t>(contents.begin() + 2 * 512, contents.begin() + 5 * 512));
+        V2_CHECK_EQ(memory.read_byte(0x2344), 0u);
+        V2_CHECK_EQ(memory.read_byte(0x2345 + 3 * 512), 0u);
+        // The registers keep what was written, and the command port reads nothing back.
+        V2_CHECK_EQ(ports.port_in(kBlockNumber), 2u);
+        V2_CHECK_EQ(ports.port_in(kBlockBuffer), 0x2345u);
+        V2_CHECK_EQ(ports.port_in(kBlockLength), 3u);
+        V2_CHECK_EQ(ports.port_in(kBlockCommand), 0u);
+
+        // Transfer-complete is acknowledged like any event bit, and it is the line.
+        ports.port_out(kBlockStatus, status_mask(block_storage_status_bit::kTransferComplete));
+        V2_CHECK_EQ(ports.port_in(kBlockStatus), 0u);
+        ports.port_out(kBlockControl, 1);
+        V2_CHECK_EQ(ports.asserted_interrupt_lines(), 0u);
+
+        // The last block written from guest memory lands in the file, and only that block.
+        for (std::uint64_t i = 0; i < 512; ++i) {
+            memory.write_byte(0x7F00 + i, static_cast<std::uint8_t>(0xA5 ^ i));
+        }
+        block_command(ports, block_storage_offset::kCommandWrite, 7, 0x7F00, 1);
+        V2_CHECK_EQ(ports.asserted_interrupt_lines(), std::uint64_t{1} << 4);
+        ports.port_out(kBlockStatus, status_mask(block_storage_status_bit::kTransferComplete));
+        V2_CHECK_EQ(ports.asserted_interrupt_lines(), 0u);
+
+        // And a buffer the guest never wrote is written out as the zeros it reads.
+        block_command(ports, block_storage_offset::kCommandWrite, 6, 0xA000, 1);
+        V2_CHECK_EQ(ports.port_in(kBlockStatus),
+                    status_mask(block_storage_status_bit::kTransferComplete));
+        ports.port_out(kBlockStatus, status_mask(block_storage_status_bit::kTransferComplete));
+
+        ports.block_storage().host_attach_image(nullptr);
+        V2_CHECK_EQ(ports.port_in(kMachinePresence), 0x000000000000000Aull);
+    }
+
+    file = std::fopen(path.string().c_str(), "rb");
+    V2_CHECK(file != nullptr);
+    if (file != nullptr) {
+        std::vector<std::uint8_t> expected = contents;
+        for (std::size_t i = 0; i < 512; ++i) {
+            expected[6 * 512 + i] = 0;
+            expected[7 * 512 + i] = static_cast<std::uint8_t>(0xA5 ^ i);
+        }
+        V2_CHECK(read_whole(file) == expected);
+        std::fclose(file);
+    }
+    std::filesystem::remove(path, ec);
+}
+
+V2_FIXTURE(device_block_storage_refuses_what_it_cannot_transfer_whole) {
+    // Every refusal the chapter names is invalid-request with nothing transferred: the image is
+    // never asked and the buffer is never written. A transfer the host could not finish is the
+    // other kind of failure, reported as complete with transfer-error, with what did arrive in
+    // the buffer and the rest of it as it was.
+    Machine machine(0x10000);
+    DeviceSurfaceV2& ports = machine.interpreter().device_surface();
+    MemoryV2& memory = machine.memory();
+    HeldImage image(4 * 512);
+    ports.block_storage().host_attach_image(&image);
+    const std::uint64_t refused = status_mask(block_storage_status_bit::kInvalidRequest);
+    auto expect_refused = [&](const char* what) {
+        if (ports.port_in(kBlockStatus) != refused) {
+            record_failure(std::string("block storage did not refuse ") + what);
+        }
+        ports.port_out(kBlockStatus, refused);
+    };
+
+    // Nothing registered yet, so even a well-formed read is refused.
+    ports.port_out(kBlockLength, 1);
+    ports.port_out(kBlockCommand, block_storage_offset::kCommandRead);
+    expect_refused("a buffer never registered");
+
+    block_command(ports, block_storage_offset::kCommandRead, 0, 0x1000, 0);
+    expect_refused("a length of zero");
+    block_command(ports, block_storage_offset::kCommandRead, 3, 0x1000, 2);
+    expect_refused("a transfer past the last block");
+    block_command(ports, block_storage_offset::kCommandRead, 4, 0x1000, 1);
+    expect_refused("a transfer starting at the capacity");
+    block_command(ports, block_storage_offset::kCommandRead, UINT64_MAX, 0x1000, 2);
+    expect_refused("a block number that wraps");
+    block_command(ports, block_storage_offset::kCommandRead, 0, 0x10000 - 256, 1);
+    expect_refused("a buffer that runs out of memory");
+    block_command(ports, 3, 0, 0x1000, 1);
+    expect_refused("a command the contract does not name");
+    V2_CHECK_EQ(image.calls, 0u);
+    V2_CHECK(guest_bytes(memory, 0x1000, 512) == std::vector<std::uint8_t>(512, 0));
+    V2_CHECK(guest_bytes(memory, 0x10000 - 256, 256) == std::vector<std::uint8_t>(256, 0));
+
+    // A read the host gives up on 700 bytes in.
+    image.limit = 700;
+    block_command(ports, block_storage_offset::kCommandRead, 1, 0x3000, 2);
+    V2_CHECK_EQ(ports.port_in(kBlockStatus),
+                status_mask(block_storage_status_bit::kTransferComplete) |
+                    status_mask(block_storage_status_bit::kTransferError));
+    V2_CHECK(guest_bytes(memory, 0x3000, 700) ==
+             std::vector<std::uint8_t>(image.bytes.begin() + 512, image.bytes.begin() + 1212));
+    V2_CHECK(guest_bytes(memory, 0x3000 + 700, 1024 - 700) ==
+             std::vector<std::uint8_t>(1024 - 700, 0));
+}
+
+V2_FIXTURE(device_block_storage_completes_asynchronously_and_raises_its_line) {
+    // A host that attaches its image asynchronously gets busy while the worker has the transfer,
+    // a refusal for any command issued meanwhile, and the transfer as it was accepted once the
+    // worker is done, picked up by a status read, by the run loop's settles when the line is
+    // enabled, and by a snapshot, which never holds half a transfer.
+    Machine machine(0x10000);
+    DeviceSurfaceV2& ports = machine.interpreter().device_surface();
+    MemoryV2& memory = machine.memory();
+    HeldImage image(16 * 512);
+    ports.block_storage().host_attach_image(&image, true);
+
+    image.hold();
+    block_command(ports, block_storage_offset::kCommandRead, 3, 0x1200, 4);
+    V2_CHECK_EQ(ports.port_in(kBlockStatus), status_mask(block_storage_status_bit::kBusy));
+    block_command(ports, block_storage_offset::kCommandWrite, 0, 0x8000, 1);
+    V2_CHECK_EQ(ports.port_in(kBlockStatus),
+                status_mask(block_storage_status_bit::kBusy) |
+                    status_mask(block_storage_status_bit::kInvalidRequest));
+    ports.port_out(kBlockStatus, status_mask(block_storage_status_bit::kInvalidRequest));
+    V2_CHECK(guest_bytes(memory, 0x1200, 4 * 512) == std::vector<std::uint8_t>(4 * 512, 0));
+
+    image.release();
+    const auto give_up = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    std::uint64_t status = 0;
+    while (((status = ports.port_in(kBlockStatus)) &
+            status_mask(block_storage_status_bit::kBusy)) != 0 &&
+           std::chrono::steady_clock::now() < give_up) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    V2_CHECK_EQ(status, status_mask(block_storage_status_bit::kTransferComplete));
+    V2_CHECK(guest_bytes(memory, 0x1200, 4 * 512) ==
+             std::vector<std::uint8_t>(image.bytes.begin() + 3 * 512,
+                                       image.bytes.begin() + 7 * 512));
+    ports.port_out(kBlockStatus, status_mask(block_storage_status_bit::kTransferComplete));
+
+    // A guest spinning with the line enabled reads no port, and the settles pick the transfer up
+    // and raise the line.
+    Encoder spin(kBase);
+    const std::uint64_t loop = spin.current_address();
+    spin.op_r_r_i4(op::kBranchBase, reg(0), reg(0), loop - (spin.current_address() + 7));
+    machine.load(spin);
+    ports.port_out(kBlockControl, 1);
+    for (std::uint64_t i = 0; i < 512; ++i) {
+        memory.write_byte(0x8000 + i, static_cast<std::uint8_t>(i ^ 0x3C));
+    }
+    block_command(ports, block_storage_offset::kCommandWrite, 15, 0x8000, 1);
+    while (ports.block_storage().host_transfer_in_flight() &&
+           std::chrono::steady_clock::now() < give_up) {
+        V2_CHECK(machine.run(4 * DeviceSurfaceV2::kHostPollInstructions).status ==
+                 StepStatus::Advanced);
+    }
+    V2_CHECK_EQ(ports.asserted_interrupt_lines(), std::uint64_t{1} << 4);
+    V2_CHECK(std::vector<std::uint8_t>(image.bytes.end() - 512, image.bytes.end()) ==
+             guest_bytes(memory, 0x8000, 512));
+    ports.port_out(kBlockStatus, status_mask(block_storage_status_bit::kTransferComplete));
+
+    // A snapshot taken while the worker still has a transfer waits for it, and holds it done.
+    image.hold();
+    block_command(ports, block_storage_offset::kCommandRead, 0, 0x4000, 1);
+    std::thread releaser([&image] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        image.release();
+    });
+    const MachineSnapshotV2 snapshot = machine.interpreter().take_full_snapshot();
+    releaser.join();
+    V2_CHECK(!ports.block_storage().host_transfer_in_flight());
+    V2_CHECK_EQ(ports.port_in(kBlockStatus),
+                status_mask(block_storage_status_bit::kTransferComplete));
+    V2_CHECK(guest_bytes(memory, 0x4000, 512) ==
+             std::vector<std::uint8_t>(image.bytes.begin(), image.bytes.begin() + 512));
+    V2_CHECK(!snapshot.machine.empty());
+}
+
+V2_FIXTURE(device_framebuffer_claims_presents_and_scans_out) {
+    // user-019. A machine with no display attached carries no framebuffer. One with a display
+    // reports the host's geometry, accepts a claim of a whole frame of populated memory and
+    // refuses anything else, hands the display the guest's buffer once per present, and sets
+    // frame-pending, the line's condition, only for a present of the surface scanned out.
+    Machine machine(0x10000);
+    DeviceSurfaceV2& ports = machine.interpreter().device_surface();
+    MemoryV2& memory = machine.memory();
+    V2_CHECK_EQ(ports.port_in(kMachinePresence), 0x000000000000000Aull);
+    V2_CHECK_EQ(ports.port_in(kFramebufferId), 0u);
+
+    RecordingDisplay display;
+    ports.framebuffer().host_attach_display(&display, {4, 3, 2});
+    const std::uint64_t frame = 4 * 3 * 4;
+    const std::uint64_t refused = status_mask(framebuffer_status_bit::kInvalidRequest);
+    V2_CHECK_EQ(ports.port_in(kMachinePresence), 0x000000000000002Aull);
+    V2_CHECK_EQ(ports.port_in(kFramebufferId), 0x0000000000010005ull);
+    V2_CHECK_EQ(ports.port_in(kFramebufferStatus), 0u);
+    V2_CHECK_EQ(ports.port_in(kFramebufferWidth), 4u);
+    V2_CHECK_EQ(ports.port_in(kFramebufferHeight), 3u);
+    V2_CHECK_EQ(ports.port_in(kFramebufferFormat), framebuffer_offset::kFormatXrgb8888);
+    V2_CHECK_EQ(ports.port_in(kFramebufferSurfaces), 2u);
+    V2_CHECK_EQ(ports.port_in(kFramebufferSelect), 0u);
+    V2_CHECK_EQ(ports.port_in(kFramebufferBase), 0u);
+    V2_CHECK_EQ(ports.port_in(kFramebufferScanout), 0u);
+
+    // Surface 0, claimed across a page boundary, drawn and presented: the display gets exactly
+    // the guest's bytes, and the frame went out, so it is pending and the enabled line is up.
+    ports.port_out(kFramebufferControl, 1);
+    ports.port_out(kFramebufferBase, 0x1FF0);
+    V2_CHECK_EQ(ports.port_in(kFramebufferBase), 0x1FF0u);
+    for (std::uint64_t i = 0; i < frame; ++i) {
+        memory.write_byte(0x1FF0 + i, static_cast<std::uint8_t>(i * 5 + 1));
+    }
+    V2_CHECK_EQ(ports.asserted_interrupt_lines(), 0u);
+    ports.port_out(kFramebufferPresent, 1);
+    V2_CHECK_EQ(display.frames.size(), 1u);
+    V2_CHECK_EQ(display.frames.back().surface, 0u);
+    V2_CHECK(display.frames.back().pixels == guest_bytes(memory, 0x1FF0, frame));
+    V2_CHECK_EQ(ports.port_in(kFramebufferStatus),
+                status_mask(framebuffer_status_bit::kFramePending));
+    V2_CHECK_EQ(ports.asserted_interrupt_lines(), std::uint64_t{1} << 5);
+    ports.port_out(kFramebufferStatus, status_mask(framebuffer_status_bit::kFramePending));
+    V2_CHECK_EQ(ports.asserted_interrupt_lines(), 0u);
+    V2_CHECK_EQ(ports.framebuffer().host_presents(), 1u);
+
+    // Surface 1: a claim that runs past the end of memory is refused and leaves it unclaimed,
+    // and a present of an unclaimed surface reaches nothing.
+    ports.port_out(kFramebufferSelect, 1);
+    ports.port_out(kFramebufferBase, 0x10000 - frame + 1);
+    V2_CHECK_EQ(ports.port_in(kFramebufferBase), 0u);
+    V2_CHECK_EQ(ports.port_in(kFramebufferStatus), refused);
+    ports.port_out(kFramebufferStatus, refused);
+    ports.port_out(kFramebufferPresent, 1);
+    V2_CHECK_EQ(ports.port_in(kFramebufferStatus), refused);
+    ports.port_out(kFramebufferStatus, refused);
+    V2_CHECK_EQ(display.frames.size(), 1u);
+
+    // Claimed properly, its present reaches the display but scans nothing out, so nothing is
+    // pending until the guest makes it the scanned-out surface and presents again.
+    ports.port_out(kFramebufferBase, 0x10000 - frame);
+    ports.port_out(kFramebufferPresent, 1);
+    V2_CHECK_EQ(display.frames.size(), 2u);
+    V2_CHECK_EQ(display.frames.back().surface, 1u);
+    V2_CHECK_EQ(ports.port_in(kFramebufferStatus), 0u);
+    ports.port_out(kFramebufferScanout, 1);
+    V2_CHECK_EQ(display.scanned_out, 1u);
+    V2_CHECK_EQ(ports.port_in(kFramebufferScanout), 1u);
+    ports.port_out(kFramebufferPresent, 1);
+    V2_CHECK_EQ(ports.port_in(kFramebufferStatus),
+                status_mask(framebuffer_status_bit::kFramePending));
+    ports.port_out(kFramebufferStatus, status_mask(framebuffer_status_bit::kFramePending));
+
+    // Surfaces the device does not provide are refused, and the selection and the scanout stay.
+    ports.port_out(kFramebufferSelect, 2);
+    ports.port_out(kFramebufferScanout, 2);
+    V2_CHECK_EQ(ports.port_in(kFramebufferStatus), refused);
+    V2_CHECK_EQ(ports.port_in(kFramebufferSelect), 1u);
+    V2_CHECK_EQ(ports.port_in(kFramebufferScanout), 1u);
+    V2_CHECK_EQ(display.scanned_out, 1u);
+    ports.port_out(kFramebufferStatus, refused);
+
+    // Zero releases, and a released surface presents nothing.
+    ports.port_out(kFramebufferSelect, 0);
+    ports.port_out(kFramebufferBase, 0);
+    ports.port_out(kFramebufferPresent, 1);
+    V2_CHECK_EQ(ports.port_in(kFramebufferStatus), refused);
+    V2_CHECK_EQ(display.frames.size(), 3u);
+    V2_CHECK_EQ(ports.framebuffer().host_presents(), 3u);
+
+    ports.framebuffer().host_attach_display(nullptr);
+    V2_CHECK_EQ(ports.port_in(kMachinePresence), 0x000000000000000Aull);
+}
+
+V2_FIXTURE(device_framebuffer_presents_headless_and_into_a_shared_segment) {
+    // The two displays mzvm attaches. Headless counts presents and keeps nothing. The shared
+    // segment takes each present into its surface's slot and rings the doorbell, and a second
+    // mapping of it by name, the way a presenter process maps it, sees the frame, the sequence
+    // and the scanout.
+    Machine machine(0x10000);
+    DeviceSurfaceV2& ports = machine.interpreter().device_surface();
+    MemoryV2& memory = machine.memory();
+    const FramebufferGeometryV2 geometry{8, 2, 2};
+    const std::uint64_t frame = 8 * 2 * 4;
+    for (std::uint64_t i = 0; i < 2 * frame; ++i) {
+        memory.write_byte(0x3000 + i, static_cast<std::uint8_t>(i ^ 0x5A));
+    }
+
+    HeadlessFramebufferV2 headless;
+    ports.framebuffer().host_attach_display(&headless, geometry);
+    ports.port_out(kFramebufferBase, 0x3000);
+    for (int i = 0; i < 3; ++i) {
+        ports.port_out(kFramebufferPresent, 1);
+    }
+    V2_CHECK_EQ(headless.presents(), 3u);
+    V2_CHECK_EQ(ports.framebuffer().host_presents(), 3u);
+
+    const std::string name =
+        "mzvm-fb-" +
+        std::to_string(std::chrono::steady_clock::now().time_since_epoch().count() % 1000000007);
+    SharedFramebufferV2 segment;
+    V2_CHECK(!SharedFramebufferV2().open(name));
+    V2_CHECK(segment.create(name, geometry));
+    if (!segment.is_open()) {
+        return;
+    }
+    SharedFramebufferV2 presenter;
+    V2_CHECK(presenter.open(name));
+    if (!presenter.is_open()) {
+        return;
+    }
+    V2_CHECK_EQ(presenter.control()->width, 8u);
+    V2_CHECK_EQ(presenter.control()->height, 2u);
+    V2_CHECK_EQ(presenter.control()->surfaces, 2u);
+    V2_CHECK_EQ(presenter.control()->present_sequence.load(), 0u);
+    V2_CHECK(presenter.frame(2) == nullptr);
+
+    // Attaching starts the surfaces over, so both are claimed again.
+    ports.framebuffer().host_attach_display(&segment, geometry);
+    ports.port_out(kFramebufferBase, 0x3000);
+    ports.port_out(kFramebufferSelect, 1);
+    ports.port_out(kFramebufferBase, 0x3000 + frame);
+    ports.port_out(kFramebufferPresent, 1);
+    ports.port_out(kFramebufferScanout, 1);
+    V2_CHECK_EQ(presenter.control()->present_sequence.load(), 1u);
+    V2_CHECK_EQ(presenter.control()->last_presented.load(), 1u);
+    V2_CHECK_EQ(presenter.control()->scanout.load(), 1u);
+    V2_CHECK(std::vector<std::uint8_t>(presenter.frame(1), presenter.frame(1) + frame) ==
+             guest_bytes(memory, 0x3000 + frame, frame));
+    V2_CHECK(std::vector<std::uint8_t>(presenter.frame(0), presenter.frame(0) + frame) ==
+             std::vector<std::uint8_t>(frame, 0));
+
+    // The latest present is the one the slot holds.
+    memory.write_byte(0x3000 + frame, 0xEE);
+    ports.port_out(kFramebufferPresent, 1);
+    V2_CHECK_EQ(presenter.control()->present_sequence.load(), 2u);
+    V2_CHECK_EQ(presenter.frame(1)[0], 0xEEu);
+
+    ports.framebuffer().host_attach_display(nullptr);
+    presenter.close();
+    segment.close();
+    V2_CHECK(!SharedFramebufferV2().open(name));
+}
+
+V2_FIXTURE(device_network_moves_frames_between_machines_through_a_switch) {
+    // user-020. A machine with no link attached carries no network device. Machines plugged into
+    // one switch send each other frames memory to memory: a transmit is refused when its length or
+    // its buffer is, a frame reaches the receive buffer whole and raises receive-available, reading
+    // the length consumes it and brings in the next, and a frame with no receive buffer to go to
+    // is dropped and reported as an overrun. The switch learns where each address is, so a frame
+    // for one machine reaches only that machine, and a broadcast reaches every other.
+    Machine a(0x10000);
+    Machine b(0x10000);
+    Machine c(0x10000);
+    DeviceSurfaceV2& pa = a.interpreter().device_surface();
+    DeviceSurfaceV2& pb = b.interpreter().device_surface();
+    DeviceSurfaceV2& pc = c.interpreter().device_surface();
+    V2_CHECK_EQ(pa.port_in(kMachinePresence), 0x000000000000000Aull);
+    V2_CHECK_EQ(pa.port_in(kNetworkId), 0u);
+
+    VirtualSwitchV2 network;
+    pa.network().host_attach_link(network.connect());
+    pb.network().host_attach_link(network.connect());
+    pc.network().host_attach_link(network.connect());
+    V2_CHECK_EQ(network.ports(), 3u);
+    V2_CHECK_EQ(pa.port_in(kMachinePresence), 0x000000000000004Aull);
+    V2_CHECK_EQ(pa.port_in(kNetworkId), 0x0000000000010006ull);
+    V2_CHECK_EQ(pa.port_in(kNetworkStatus), 0u);
+    V2_CHECK_EQ(pa.port_in(kNetworkMaxFrame), 1514u);
+    V2_CHECK_EQ(pa.port_in(kNetworkReceiveLength), 0u);
+    const std::uint64_t refused = status_mask(network_status_bit::kInvalidRequest);
+    const std::uint64_t available = status_mask(network_status_bit::kReceiveAvailable);
+    const std::uint64_t overrun = status_mask(network_status_bit::kOverrun);
+
+    // Nothing registered, a length of zero, a length past the maximum, and a buffer past the end
+    // of memory are all refused, and nothing reaches the switch.
+    pa.port_out(kNetworkTransmit, 64);
+    V2_CHECK_EQ(pa.port_in(kNetworkStatus), refused);
+    pa.port_out(kNetworkStatus, refused);
+    pa.port_out(kNetworkTransmitBuffer, 0x1000);
+    V2_CHECK_EQ(pa.port_in(kNetworkTransmitBuffer), 0x1000u);
+    pa.port_out(kNetworkTransmit, 0);
+    pa.port_out(kNetworkTransmit, 1515);
+    pa.port_out(kNetworkTransmitBuffer, 0x10000 - 63);
+    pa.port_out(kNetworkTransmit, 64);
+    V2_CHECK_EQ(pa.port_in(kNetworkStatus), refused);
+    pa.port_out(kNetworkStatus, refused);
+    V2_CHECK_EQ(network.delivered(), 0u);
+
+    // B and C register receive buffers, and a broadcast from A reaches both, with nothing outside
+    // the frame written. A's own port is not sent its own frame.
+    pb.port_out(kNetworkReceiveBuffer, 0x2FF0);
+    pc.port_out(kNetworkReceiveBuffer, 0x4000);
+    pa.port_out(kNetworkReceiveBuffer, 0x5000);
+    pb.port_out(kNetworkControl, 1);
+    const std::vector<std::uint8_t> hello = ethernet_frame(0, 0xA, 60, 0x11);
+    transmit_frame(pa, a.memory(), 0x1000, hello);
+    V2_CHECK_EQ(network.delivered(), 2u);
+    V2_CHECK_EQ(pb.port_in(kNetworkStatus), available);
+    V2_CHECK_EQ(pb.asserted_interrupt_lines(), std::uint64_t{1} << 6);
+    V2_CHECK(guest_bytes(b.memory(), 0x2FF0, hello.size()) == hello);
+    V2_CHECK_EQ(b.memory().read_byte(0x2FF0 + hello.size()), 0u);
+    V2_CHECK_EQ(pb.port_in(kNetworkReceiveLength), hello.size());
+    V2_CHECK_EQ(pb.port_in(kNetworkStatus), 0u);
+    V2_CHECK_EQ(pb.asserted_interrupt_lines(), 0u);
+    V2_CHECK_EQ(pc.port_in(kNetworkReceiveLength), hello.size());
+    V2_CHECK(guest_bytes(c.memory(), 0x4000, hello.size()) == hello);
+    V2_CHECK_EQ(pa.port_in(kNetworkReceiveLength), 0u);
+
+    // A and B have each been seen sending now, so frames between them go to nobody else, and
+    // each waits in the link behind the last until the guest consumes it.
+    const std::vector<std::uint8_t> reply = ethernet_frame(0xA, 0xB, 42, 0x22);
+    transmit_frame(pb, b.memory(), 0x1000, reply);
+    V2_CHECK_EQ(pa.port_in(kNetworkStatus), available);
+    V2_CHECK_EQ(pc.port_in(kNetworkStatus), 0u);
+    const std::vector<std::uint8_t> first = ethernet_frame(0xB, 0xA, 100, 0x33);
+    const std::vector<std::uint8_t> second = ethernet_frame(0xB, 0xA, 80, 0x44);
+    transmit_frame(pa, a.memory(), 0x1000, first);
+    transmit_frame(pa, a.memory(), 0x1100, second);
+    V2_CHECK_EQ(pb.port_in(kNetworkReceiveLength), first.size());
+    V2_CHECK_EQ(pb.port_in(kNetworkStatus), available);
+    V2_CHECK(guest_bytes(b.memory(), 0x2FF0, second.size()) == second);
+    V2_CHECK_EQ(pb.port_in(kNetworkReceiveLength), second.size());
+    V2_CHECK_EQ(pb.port_in(kNetworkStatus), 0u);
+    V2_CHECK_EQ(pc.port_in(kNetworkStatus), 0u);
+    V2_CHECK_EQ(pa.port_in(kNetworkReceiveLength), reply.size());
+    V2_CHECK(guest_bytes(a.memory(), 0x5000, reply.size()) == reply);
+
+    // A machine with no receive buffer registered drops what reaches it, and says so.
+    Machine d(0x10000);
+    DeviceSurfaceV2& pd = d.interpreter().device_surface();
+    VirtualSwitchV2 pair;
+    pd.network().host_attach_link(pair.connect());
+    NetworkLinkV2* far_end = pair.connect();
+    far_end->send(hello.data(), hello.size());
+    V2_CHECK_EQ(pd.port_in(kNetworkStatus), overrun);
+    V2_CHECK_EQ(pd.port_in(kNetworkReceiveLength), 0u);
+    pd.port_out(kNetworkStatus, overrun);
+    V2_CHECK_EQ(pd.port_in(kNetworkStatus), 0u);
+
+    pa.network().host_attach_link(nullptr);
+    pb.network().host_attach_link(nullptr);
+    pc.network().host_attach_link(nullptr);
+    pd.network().host_attach_link(nullptr);
+    V2_CHECK_EQ(pa.port_in(kMachinePresence), 0x000000000000000Aull);
+}
+
+V2_FIXTURE(device_network_switch_rings_take_frames_from_many_threads_at_once) {
+    // The rings are the one thing here shared between threads. Four senders each send a numbered
+    // run of frames to one receiver that drains its ring as they arrive, on a switch whose rings
+    // are small enough to fill: every frame is either received whole or counted as dropped, none
+    // twice, and each sender's frames arrive in the order it sent them. A full ring is reported
+    // to the receiving device as an overrun.
+    VirtualSwitchOptionsV2 options;
+    options.max_frame = 64;
+    options.queue_frames = 8;
+    VirtualSwitchV2 network(options);
+    NetworkLinkV2* receiver = network.connect();
+    constexpr unsigned kSenders = 4;
+    constexpr std::uint32_t kFrames = 20000;
+    std::vector<NetworkLinkV2*> senders;
+    for (unsigned i = 0; i < kSenders; ++i) {
+        senders.push_back(network.connect());
+    }
+
+    // The receiver says who it is first, so the senders' frames go to it alone rather than
+    // flooding each other's rings too. The senders' own rings take that one frame.
+    const std::vector<std::uint8_t> announce = ethernet_frame(0, 0xF, 16, 0);
+    receiver->send(announce.data(), announce.size());
+
+    std::atomic<unsigned> finished{0};
+    std::vector<std::thread> threads;
+    for (unsigned i = 0; i < kSenders; ++i) {
+        threads.emplace_back([&senders, &finished, i] {
+            std::vector<std::uint8_t> frame = ethernet_frame(0xF, static_cast<std::uint8_t>(i),
+                                                             20 + i, 0);
+            for (std::uint32_t n = 0; n < kFrames; ++n) {
+                std::memcpy(frame.data() + 12, &n, sizeof(n));
+                senders[i]->send(frame.data(), frame.size());
+            }
+            finished.fetch_add(1);
+        });
+    }
+
+    std::vector<std::int64_t> last(kSenders, -1);
+    std::uint64_t received = 0;
+    bool in_order = true;
+    bool whole = true;
+    std::uint8_t frame[64];
+    for (;;) {
+        const bool done = finished.load() == kSenders;
+        std::size_t length = 0;
+        while ((length = receiver->peek()) != 0) {
+            receiver->receive(frame);
+            const unsigned sender = frame[11];
+            std::uint32_t n = 0;
+            std::memcpy(&n, frame + 12, sizeof(n));
+            whole = whole && sender < kSenders && length == 20 + sender;
+            if (sender < kSenders) {
+                in_order = in_order && static_cast<std::int64_t>(n) > last[sender];
+                last[sender] = n;
+            }
+            ++received;
+        }
+        if (done) {
+            break;
+        }
+        std::this_thread::yield();
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    V2_CHECK(whole);
+    V2_CHECK(in_order);
+    const std::uint64_t dropped = receiver->take_dropped();
+    V2_CHECK_EQ(received + dropped, std::uint64_t{kSenders} * kFrames);
+    V2_CHECK_EQ(network.delivered(), received + kSenders);
+    V2_CHECK_EQ(network.dropped(), dropped);
+    V2_CHECK_EQ(receiver->take_dropped(), 0u);
+
+    // What a device makes of a full ring.
+    VirtualSwitchV2 small(options);
+    Machine machine(0x10000);
+    DeviceSurfaceV2& ports = machine.interpreter().device_surface();
+    ports.network().host_attach_link(small.connect());
+    NetworkLinkV2* sender = small.connect();
+    ports.port_out(kNetworkReceiveBuffer, 0x2000);
+    const std::vector<std::uint8_t> burst = ethernet_frame(0, 0xC, 16, 0x55);
+    for (std::size_t i = 0; i < options.queue_frames + 1; ++i) {
+        sender->send(burst.data(), burst.size());
+    }
+    V2_CHECK_EQ(ports.port_in(kNetworkStatus),
+                status_mask(network_status_bit::kReceiveAvailable) |
+                    status_mask(network_status_bit::kOverrun));
+    for (std::size_t i = 0; i < options.queue_frames; ++i) {
+        V2_CHECK_EQ(ports.port_in(kNetworkReceiveLength), burst.size());
+    }
+    V2_CHECK_EQ(ports.port_in(kNetworkReceiveLength), 0u);
+    ports.network().host_attach_link(nullptr);
+}
+
+V2_FIXTURE(device_entropy_reads_a_word_a_port_read_and_refills_in_bulk) {
+    // user-021. A machine with no source attached carries no entropy device. With one, the
+    // device answers for class 7, holds data-available set for as long as the source is there,
+    // and hands out a word a read from a buffer it refills a whole buffer at a time. A seeded
+    // source gives the same words to every machine given the seed, and a host-keyed one gives
+    // words no other source repeats.
+    Machine machine(0x10000);
+    DeviceSurfaceV2& ports = machine.interpreter().device_surface();
+    V2_CHECK_EQ(ports.port_in(kMachinePresence), 0x000000000000000Aull);
+    V2_CHECK_EQ(ports.port_in(kEntropyId), 0u);
+    V2_CHECK_EQ(ports.port_in(kEntropyData), 0u);
+
+    // The cipher underneath, against RFC 8439's block function test vector (section 2.3.2),
+    // whose 32-bit counter and 96-bit nonce are this layout's counter with the nonce's first
+    // word in its upper half.
+    std::uint32_t key[8];
+    for (std::uint32_t i = 0; i < 8; ++i) {
+        const std::uint32_t b = i * 4;
+        key[i] = b | ((b + 1) << 8) | ((b + 2) << 16) | ((b + 3) << 24);
+    }
+    std::uint32_t block[16];
+    chacha20_block(key, 0x0900000000000001ull, 0x4A000000ull, block);
+    const std::uint32_t expected[16] = {
+        0xE4E7F110u, 0x15593BD1u, 0x1FDD0F50u, 0xC47120A3u, 0xC7F4D1C7u, 0x0368C033u,
+        0x9AAA2204u, 0x4E6CD4C3u, 0x466482D2u, 0x09AA9F07u, 0x05D7C214u, 0xA2028BD9u,
+        0xD19C12B5u, 0xB94E16DEu, 0xE883D0CBu, 0x4E3C50A2u};
+    V2_CHECK(std::equal(block, block + 16, expected));
+
+    ChaChaEntropyV2 seeded;
+    seeded.seed(42);
+    ports.entropy().host_attach_source(&seeded);
+    V2_CHECK_EQ(ports.port_in(kMachinePresence), 0x000000000000008Aull);
+    V2_CHECK_EQ(ports.port_in(kEntropyId), 0x0000000000010007ull);
+    const std::uint64_t available = status_mask(entropy_status_bit::kDataAvailable);
+    V2_CHECK_EQ(ports.port_in(kEntropyStatus), available);
+    V2_CHECK_EQ(ports.entropy().host_refills(), 0u);
+
+    // Three buffers' worth, with data-available never dropping, the source asked once a buffer,
+    // and no word repeated.
+    constexpr std::size_t kWords = EntropyDeviceV2::kBufferWords * 3;
+    std::vector<std::uint64_t> words;
+    bool always_available = true;
+    for (std::size_t i = 0; i < kWords; ++i) {
+        always_available = always_available && ports.port_in(kEntropyStatus) == available;
+        words.push_back(ports.port_in(kEntropyData));
+    }
+    V2_CHECK(always_available);
+    V2_CHECK_EQ(ports.entropy().host_refills(), 3u);
+    std::vector<std::uint64_t> sorted = words;
+    std::sort(sorted.begin(), sorted.end());
+    V2_CHECK(std::adjacent_find(sorted.begin(), sorted.end()) == sorted.end());
+
+    // Acknowledging cannot clear a held bit, and the condition is the interrupt condition.
+    ports.port_out(kEntropyStatus, available);
+    V2_CHECK_EQ(ports.port_in(kEntropyStatus), available);
+    V2_CHECK_EQ(ports.asserted_interrupt_lines(), 0u);
+    ports.port_out(kEntropyControl, 1);
+    V2_CHECK_EQ(ports.asserted_interrupt_lines(), std::uint64_t{1} << 7);
+    ports.port_out(kEntropyControl, 0);
+
+    // The same seed is the same words on another machine, and another seed is other words.
+    Machine twin(0x10000);
+    DeviceSurfaceV2& twin_ports = twin.interpreter().device_surface();
+    ChaChaEntropyV2 same;
+    same.seed(42);
+    twin_ports.entropy().host_attach_source(&same);
+    bool reproduced = true;
+    for (std::size_t i = 0; i < kWords; ++i) {
+        reproduced = reproduced && twin_ports.port_in(kEntropyData) == words[i];
+    }
+    V2_CHECK(reproduced);
+    ChaChaEntropyV2 other;
+    other.seed(43);
+    twin_ports.entropy().host_attach_source(&other);
+    V2_CHECK(twin_ports.port_in(kEntropyData) != words[0]);
+
+    // Keyed from the host: two sources agree on nothing.
+    ChaChaEntropyV2 first;
+    ChaChaEntropyV2 second;
+    V2_CHECK(first.seed_from_host());
+    V2_CHECK(second.seed_from_host());
+    V2_CHECK(first.from_host() && !seeded.from_host());
+    ports.entropy().host_attach_source(&first);
+    twin_ports.entropy().host_attach_source(&second);
+    bool differ = true;
+    for (std::size_t i = 0; i < 8; ++i) {
+        differ = differ && ports.port_in(kEntropyData) != twin_ports.port_in(kEntropyData);
+    }
+    V2_CHECK(differ);
+
+    ports.entropy().host_attach_source(nullptr);
+    twin_ports.entropy().host_attach_source(nullptr);
+    V2_CHECK_EQ(ports.port_in(kMachinePresence), 0x000000000000000Aull);
+    V2_CHECK_EQ(ports.port_in(kEntropyStatus), 0u);
+}
+
 V2_FIXTURE(port_instructions_reach_the_port_space) {
     // The two instructions themselves, executed rather than called: a byte written through
     // port_out arrives at the console, and a word read through port_in arrives in the
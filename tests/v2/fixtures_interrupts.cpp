@@ -34,10 +34,21 @@
 // it is the reason none of them depends on how long anything takes, which conformance.md
 // prohibits outright.
 
+#include <chrono>
 #include <cstdio>
+#include <thread>
 #include <vector>
 
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "console_stream_v2.h"
 #include "fixture_support.h"
+#include "network_v2.h"
 
 namespace maize::v2::test {
 namespace {
@@ -79,6 +90,9 @@ constexpr std::uint16_t kTimerStatus = 0x0031;
 constexpr std::uint16_t kTimerControl = 0x0032;
 constexpr std::uint16_t kTimerPeriod = 0x0033;
 constexpr std::uint16_t kTimerMode = 0x0034;
+constexpr std::uint16_t kNetworkControl = 0x0062;
+constexpr std::uint16_t kNetworkReceiveBuffer = 0x0065;
+constexpr std::uint16_t kNetworkReceiveLength = 0x0067;
 
 // The status words a kernel writes, spelled as the literals trap-model.md's "The status word"
 // fixes: privilege in bits 1:0 and the interrupt-enable bit at bit 2. NOT bits 15:14, which is
@@ -1300,4 +1314,331 @@ V2_FIXTURE(a_wait_with_nothing_armed_suspends_rather_than_spinning) {
     V2_CHECK(kernel.csr().pending(40));
 }
 
+namespace {
+
+// A host stream whose far end the fixture holds (user-017): the machine's source reads one end
+// and the fixture writes to, or closes, the other. The write end always closes first, and the
+// read end only once the source has seen the end, so the source's reader is never left reading
+// a descriptor that has been closed under it.
+class HostPipe {
+  public:
+    HostPipe() {
+#ifdef _WIN32
+        ok_ = _pipe(ends_, 4096, _O_BINARY) == 0;
+#else
+        ok_ = pipe(ends_) == 0;
+#endif
+    }
+    ~HostPipe() {
+        close_write();
+        if (ends_[0] >= 0) {
+#ifdef _WIN32
+            _close(ends_[0]);
+#else
+            close(ends_[0]);
+#endif
+        }
+    }
+
+    bool ok() const { return ok_; }
+    int read_end() const { return ends_[0]; }
+
+    void write_byte(std::uint8_t byte) {
+#ifdef _WIN32
+        V2_CHECK(_write(ends_[1], &byte, 1) == 1);
+#else
+        V2_CHECK(write(ends_[1], &byte, 1) == 1);
+#endif
+    }
+
+    void close_write() {
+        if (ends_[1] >= 0) {
+#ifdef _WIN32
+            _close(ends_[1]);
+#else
+            close(ends_[1]);
+#endif
+            ends_[1] = -1;
+        }
+    }
+
+    // Close the write end and wait for the source to see it, which is its reader leaving.
+    void finish(StreamingConsoleSourceV2& source) {
+        close_write();
+        if (!source.started()) {
+            return;
+        }
+        std::vector<std::uint8_t> rest;
+        while (!source.take(rest, SIZE_MAX)) {
+            source.wait(UINT64_MAX);
+        }
+    }
+
+  private:
+    int ends_[2] = {-1, -1};
+    bool ok_ = false;
+};
+
+}  // namespace
+
+V2_FIXTURE(a_wait_on_console_input_sleeps_on_the_host_until_a_byte_arrives) {
+    // user-017. With a host stream attached and the console line enabled, a wait that only input
+    // could end is a wait on the HOST: the machine sleeps until the byte comes, and then retires
+    // the wait on the console's pending bit exactly as it would on a byte pushed in beforehand.
+    // Without the stream the same program suspends, which a_wait_with_nothing_armed_suspends_
+    // rather_than_spinning pins; here it must not, and the byte it reads must be the one that
+    // arrived after it went to sleep. The global gate stays closed, as in the masked idle loop,
+    // so the wake is the wait's own and no handler is involved.
+    HostPipe pipe;
+    V2_CHECK(pipe.ok());
+    if (!pipe.ok()) {
+        return;
+    }
+    StreamingConsoleSourceV2 source(pipe.read_end());
+
+    Kernel kernel;
+    emit_port_out(kernel.program(), kConsoleControl, 1);
+    emit_csr_load(kernel.program(), csr::kInterruptEnable0, std::uint64_t{1} << 33);
+    emit_csr_load(kernel.program(), csr::kStatus, kSupervisorInterruptsOff);
+    kernel.program().op(op::kWaitForInterrupt);
+    emit_port_in(kernel.program(), kConsoleData, 10);
+    emit_store_absolute(kernel.program(), 10, kMark0);
+    kernel.program().halt();
+    kernel.start();
+    kernel.devices().console().host_attach_source(&source);
+    V2_CHECK(!source.started());
+
+    std::thread typist([&pipe] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        pipe.write_byte('k');
+    });
+    const StepResult woken = kernel.run();
+    typist.join();
+    expect_halted(woken, "the wait that input ended");
+    V2_CHECK_EQ(kernel.word(kMark0), 'k');
+    V2_CHECK_EQ(kernel.trap_stack(), kTrapStackTop);
+    kernel.devices().console().host_attach_source(nullptr);
+
+    // Once the stream has ended, no input can ever end a wait, and the same wait suspends and
+    // says so rather than sleeping forever on a stream with nothing more to give.
+    Kernel ended;
+    emit_port_out(ended.program(), kConsoleControl, 1);
+    emit_csr_load(ended.program(), csr::kInterruptEnable0, std::uint64_t{1} << 33);
+    const std::uint64_t wait_pc = ended.here();
+    ended.program().op(op::kWaitForInterrupt);
+    ended.program().halt();
+    ended.start();
+    ended.devices().console().host_attach_source(&source);
+    pipe.finish(source);
+    const StepResult suspended = ended.run();
+    V2_CHECK(suspended.status == StepStatus::Suspended);
+    V2_CHECK_EQ(suspended.pc, wait_pc);
+    V2_CHECK((ended.devices().console().status() &
+              status_mask(console_status_bit::kEndOfInput)) != 0);
+    ended.devices().console().host_attach_source(nullptr);
+}
+
+V2_FIXTURE(a_wait_on_the_network_sleeps_on_the_host_until_a_frame_arrives) {
+    // user-020, the network's version of the fixture above. A guest with its network line enabled
+    // and nothing waiting parks in wait_for_interrupt on the host, a frame sent from another
+    // thread through the switch wakes it, and the frame is in its receive buffer, whole, when it
+    // reads the length.
+    VirtualSwitchV2 network;
+    NetworkLinkV2* guest_end = network.connect();
+    NetworkLinkV2* host_end = network.connect();
+
+    Kernel kernel;
+    emit_port_out(kernel.program(), kNetworkReceiveBuffer, 0x3000);
+    emit_port_out(kernel.program(), kNetworkControl, 1);
+    emit_csr_load(kernel.program(), csr::kInterruptEnable0, std::uint64_t{1} << 38);
+    emit_csr_load(kernel.program(), csr::kStatus, kSupervisorInterruptsOff);
+    kernel.program().op(op::kWaitForInterrupt);
+    emit_port_in(kernel.program(), kNetworkReceiveLength, 10);
+    emit_store_absolute(kernel.program(), 10, kMark0);
+    kernel.program().halt();
+    kernel.start();
+    kernel.devices().network().host_attach_link(guest_end);
+
+    std::vector<std::uint8_t> frame(60);
+    for (std::size_t i = 0; i < frame.size(); ++i) {
+        frame[i] = static_cast<std::uint8_t>(0xFF - i);
+    }
+    std::thread peer([host_end, &frame] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        host_end->send(frame.data(), frame.size());
+    });
+    const StepResult woken = kernel.run();
+    peer.join();
+    expect_halted(woken, "the wait a frame ended");
+    V2_CHECK_EQ(kernel.word(kMark0), frame.size());
+    for (std::size_t i = 0; i < frame.size(); ++i) {
+        V2_CHECK_EQ(kernel.machine().memory().read_byte(0x3000 + i), frame[i]);
+    }
+    V2_CHECK_EQ(kernel.trap_stack(), kTrapStackTop);
+    kernel.devices().network().host_attach_link(nullptr);
+}
+
+namespace {
+
+// The lines word worked out the slow way, by asking each class, which is what the surface's
+// published word has to agree with after every change to any class (user-010).
+std::uint64_t lines_by_asking(const DeviceSurfaceV2& ports) {
+    std::uint64_t lines = 0;
+    if (ports.console().interrupt_asserted()) {
+        lines |= std::uint64_t{1} << 1;
+    }
+    if (ports.timer().interrupt_asserted()) {
+        lines |= std::uint64_t{1} << 3;
+    }
+    return lines;
+}
+
+}  // namespace
+
+V2_FIXTURE(published_lines_follow_every_path_that_moves_a_level) {
+    // The published word is a cache of the classes' levels, and a cache is wrong the moment one
+    // path that moves a level forgets to update it. A machine with that bug passes every fixture
+    // that raises a line the common way, and misses or keeps an interrupt on the path it forgot,
+    // so this fixture walks each path in turn and checks the word against the classes after
+    // every one, both before and after the line moves.
+    Machine machine;
+    DeviceSurfaceV2& ports = machine.interpreter().device_surface();
+    const auto agree = [&ports](std::uint64_t expected) {
+        V2_CHECK_EQ(ports.asserted_interrupt_lines(), lines_by_asking(ports));
+        V2_CHECK_EQ(ports.asserted_interrupt_lines(), expected);
+    };
+    constexpr std::uint64_t kConsoleLine = std::uint64_t{1} << 1;
+    constexpr std::uint64_t kTimerLine = std::uint64_t{1} << 3;
+
+    // Input pushed by the host, with the line disabled and then enabled, and enabled first and
+    // input pushed after.
+    ports.console().host_push_input('x');
+    agree(0);
+    ports.port_out(kConsoleControl, 1);
+    agree(kConsoleLine);
+    ports.port_out(kConsoleControl, 0);
+    agree(0);
+    V2_CHECK_EQ(ports.port_in(kConsoleData), 'x');
+    ports.port_out(kConsoleControl, 1);
+    agree(0);
+    ports.console().host_push_input('y');
+    agree(kConsoleLine);
+
+    // The timer's expiry, which arrives from advancing time rather than from any port access.
+    ports.port_out(kTimerControl, 1);
+    ports.port_out(kTimerPeriod, 100);
+    ports.port_out(kTimerMode, 1);
+    ports.advance_time(99);
+    agree(kConsoleLine);
+    ports.advance_time(1);
+    agree(kConsoleLine | kTimerLine);
+
+    // A snapshot of both lines high, restored over a surface with both low.
+    std::vector<std::uint8_t> saved;
+    StateWriterV2 writer(saved);
+    ports.save_state(writer);
+
+    // The guest consuming the byte, and acknowledging the expiry.
+    V2_CHECK_EQ(ports.port_in(kConsoleData), 'y');
+    agree(kTimerLine);
+    ports.port_out(kTimerStatus, 1);
+    agree(0);
+
+    StateReaderV2 reader(saved.data(), saved.size());
+    V2_CHECK(ports.load_state(reader));
+    agree(kConsoleLine | kTimerLine);
+
+    // And the CPU's sample: the pending bits take the published word at the next boundary with
+    // the global gate closed, and let the line go when the device does.
+    Kernel kernel;
+    emit_csr_load(kernel.program(), csr::kStatus, kSupervisorInterruptsOff);
+    kernel.program().op(op::kNop);
+    kernel.program().op(op::kNop);
+    kernel.program().halt();
+    kernel.start();
+    kernel.devices().port_out(kConsoleControl, 1);
+    kernel.devices().console().host_push_input('z');
+    V2_CHECK(kernel.step().status == StepStatus::Advanced);
+    V2_CHECK(kernel.csr().pending(cause::kConsoleInterrupt));
+    V2_CHECK_EQ(kernel.devices().port_in(kConsoleData), 'z');
+    V2_CHECK(kernel.step().status == StepStatus::Advanced);
+    V2_CHECK(!kernel.csr().pending(cause::kConsoleInterrupt));
+}
+
+namespace {
+
+constexpr std::uint64_t kExpiryLog = 0x3000;
+
+// A kernel whose periodic timer interrupts a long counting loop, and whose handler
+// logs, for every expiry, how far the interrupted program had got and what the clock read.
+void build_logged_periodic_timer(Kernel& kernel) {
+    emit_port_out(kernel.program(), kTimerControl, 1);
+    emit_csr_load(kernel.program(), csr::kInterruptEnable0, std::uint64_t{1} << 35);
+    emit_csr_load(kernel.program(), csr::kStatus, kSupervisorInterruptsOn);
+    // A period that is not a whole number of instructions, so the expiry falls inside one and
+    // its boundary is the rounding a deferred clock has to reproduce.
+    emit_timer_arm(kernel.program(), 40 * kOneInstruction + 300, 3);
+    kernel.program().op_r_i8(op::kMoveW, reg(21), 300);
+    const std::uint64_t loop = kernel.here();
+    kernel.program().op_r_r_i4(op::kAddImm, reg(20), reg(20), 1);
+    kernel.program().op_r_r_i4(op::kBranchBase + 6, reg(20), reg(21),  // lt.u
+                               loop - (kernel.here() + 7));
+    kernel.program().halt();
+
+    Encoder handler(kHandlerBase);
+    emit_handler_prologue(handler);
+    handler.op_r_i8(op::kMoveW, reg(kHandlerScratch4), kSequence);
+    handler.op_r_r(op::kLoad, reg(kHandlerScratch4), reg(kHandlerScratch4));
+    handler.op_r_r(op::kStore, reg(20), reg(kHandlerScratch4));
+    handler.op_r_i8(op::kMoveW, reg(kHandlerScratch3), 0x0035);
+    handler.op_r_r(op::kPortIn, reg(kHandlerScratch3), reg(kHandlerScratch3));
+    handler.op_r_r_i2(op::kStoreDisp, reg(kHandlerScratch3), reg(kHandlerScratch4), 8);
+    handler.op_r_r_i4(op::kAddImm, reg(kHandlerScratch4), reg(kHandlerScratch4), 16);
+    handler.op_r_i8(op::kMoveW, reg(kHandlerScratch3), kSequence);
+    handler.op_r_r(op::kStore, reg(kHandlerScratch4), reg(kHandlerScratch3));
+    emit_timer_acknowledge(handler);
+    emit_handler_epilogue(handler);
+    kernel.load_at(handler);
+    kernel.install_handler(cause::kTimerInterrupt, kHandlerBase);
+    kernel.machine().memory().write_little_endian(kSequence, 8, kExpiryLog);
+    kernel.start();
+}
+
+}  // namespace
+
+V2_FIXTURE(a_run_settles_the_clock_at_the_same_boundaries_a_single_step_does) {
+    // run() hands the devices their time at the next device deadline rather than after every
+    // instruction (user-011), and step() hands it over before it returns. A deferred clock that
+    // settled one instruction late would deliver every expiry one boundary late, and one that
+    // rounded the deadline down would deliver it early; either shows here as a log that differs
+    // from the one the machine writes when it is stepped instruction by instruction.
+    Kernel stepped;
+    build_logged_periodic_timer(stepped);
+    StepResult result;
+    for (unsigned i = 0; i < 100000 && result.status != StepStatus::Halted; ++i) {
+        result = stepped.step();
+    }
+    expect_halted(result, "the stepped machine");
+
+    Kernel ran;
+    build_logged_periodic_timer(ran);
+    expect_halted(ran.run_to_halt(128), "the machine that ran");
+
+    const std::uint64_t log_end = stepped.word(kSequence);
+    V2_CHECK_EQ(ran.word(kSequence), log_end);
+    // The handler's own instructions take time as well, so expiries are further apart than the
+    // period in the program's count, but there are still more than ten of them.
+    V2_CHECK(log_end > kExpiryLog + 16 * 10);
+    for (std::uint64_t entry = kExpiryLog; entry < log_end; entry += 8) {
+        V2_CHECK_EQ(ran.word(entry), stepped.word(entry));
+    }
+    V2_CHECK_EQ(ran.machine().interpreter().steps_taken(),
+                stepped.machine().interpreter().steps_taken());
+    V2_CHECK_EQ(ran.devices().timer().monotonic_nanoseconds(),
+                stepped.devices().timer().monotonic_nanoseconds());
+    // And the clock is the machine's step count, settled, whichever way it was driven.
+    V2_CHECK_EQ(ran.devices().timer().monotonic_nanoseconds(),
+                ran.machine().interpreter().steps_taken() * kNanosecondsPerInstruction);
+}
+
 }  // namespace maize::v2::test
@@ -0,0 +1,482 @@
+// fixtures_jit.cpp (user-002): the template JIT, judged against the interpreter.
+//
+// THE JIT HAS NO SPECIFICATION OF ITS OWN, and that is the whole of how it is tested. Nothing in
+// docs/spec-v2 mentions it and nothing may: a compiled block is required to be invisible, so the
+// only correct answer to "what should the machine do under --jit" is "exactly what it does
+// without it". Every fixture below therefore runs one program twice, once interpreted and once
+// with the JIT enabled at a low threshold, and asserts the two machines are identical at the end:
+// every register, the program counter, the step count, the clock, the control and status
+// registers a run can move, and every byte of memory.
+//
+// WHAT MAKES A DIFFERENTIAL FIXTURE WORTH HAVING is a program that gives the JIT a chance to be
+// wrong. A hot loop proves a block and its self-chain retire the right instructions; a store
+// into the loop's own code proves a stale block is not run; a periodic timer proves the bulk
+// clock never moves a delivery off its boundary; a chopped-up step budget proves a chain stops
+// where the interpreter would. On a host without a backend each fixture still runs both machines
+// and still compares them, which is then a comparison of the interpreter with itself; the
+// assertions about what the JIT compiled are the only ones that need the backend.
+
+#include <cstdio>
+#include <vector>
+
+#include "fixture_support.h"
+#include "jit_v2.h"
+
+namespace maize::v2::test {
+namespace {
+
+constexpr std::size_t kMemoryBytes = 0x10000;
+constexpr std::uint64_t kProgramBase = 0x100;
+constexpr std::uint64_t kHandlerBase = 0x800;
+constexpr std::uint64_t kVectorTable = 0x1000;  // through $17FF
+constexpr std::uint64_t kTrapStackTop = 0x2000;
+constexpr std::uint64_t kSaveArea = 0x2400;
+constexpr std::uint64_t kLogCursor = 0x2500;
+constexpr std::uint64_t kData = 0x3000;
+constexpr std::uint64_t kLog = 0x8000;
+
+constexpr std::uint16_t kTimerStatus = 0x0031;
+constexpr std::uint16_t kTimerControl = 0x0032;
+constexpr std::uint16_t kTimerPeriod = 0x0033;
+constexpr std::uint16_t kTimerMode = 0x0034;
+
+constexpr std::uint64_t kSupervisorInterruptsOn = 0x5;
+
+// Low enough that every loop in this file compiles in its first few iterations, so most of each
+// run is compiled code rather than the interpreter warming up.
+constexpr std::uint32_t kFixtureHotness = 2;
+
+constexpr std::uint8_t kLtUnsigned = 6;
+constexpr std::uint8_t kNe = 1;
+
+// A program: the images to load, the words to poke in before it starts, and where it starts.
+struct Program {
+    std::vector<Encoder> images;
+    std::vector<std::pair<std::uint64_t, std::uint64_t>> words;
+    std::uint64_t start = kProgramBase;
+};
+
+// A run's machine, and how it stopped and what the JIT made of it.
+struct Outcome : MachineState {
+    StepResult result;
+    JitStatsV2 jit{};
+    std::string check_failure;
+};
+
+void load(Machine& machine, const Program& program) {
+    for (const Encoder& image : program.images) {
+        V2_CHECK(machine.memory().load_image(image.base_address(), image.bytes().data(),
+                                             image.bytes().size()));
+    }
+    for (const auto& [address, value] : program.words) {
+        machine.memory().write_little_endian(address, 8, value);
+    }
+    machine.interpreter().set_pc(program.start);
+}
+
+Outcome capture(Machine& machine, const StepResult& result) {
+    Outcome outcome;
+    static_cast<MachineState&>(outcome) = test::capture(machine);
+    outcome.result = result;
+    if (const JitV2* jit = machine.interpreter().jit()) {
+        outcome.jit = jit->stats();
+        outcome.check_failure = jit->check_failure();
+    }
+    return outcome;
+}
+
+// Run until something other than a delivered trap stops the machine, in run() calls of
+// `slice` steps each, which is how mzvm drives it and how a chopped budget is exercised. A
+// `cycle_limit` is set on the machine before it starts, and the run ends where it is reached.
+Outcome run_program(const Program& program, const JitOptionsV2* jit, std::uint64_t slice = 0,
+                    std::uint64_t cycle_limit = 0) {
+    Machine machine(kMemoryBytes);
+    load(machine, program);
+    if (jit != nullptr) {
+        machine.interpreter().enable_jit(*jit);
+    }
+    machine.interpreter().set_cycle_limit(cycle_limit);
+    StepResult result;
+    for (unsigned calls = 0; calls < 100000; ++calls) {
+        result = machine.interpreter().run(slice == 0 ? 1000000 : slice);
+        const bool delivered = result.status == StepStatus::Trapped &&
+                               result.disposition == TrapDisposition::Delivered;
+        const bool sliced = slice != 0 && result.status == StepStatus::Advanced;
+        if (!delivered && !sliced) {
+            break;
+        }
+    }
+    return capture(machine, result);
+}
+
+JitOptionsV2 fixture_jit_options() {
+    JitOptionsV2 options;
+    options.hotness = kFixtureHotness;
+    return options;
+}
+
+void expect_same(const Outcome& compiled, const Outcome& interpreted, const char* what) {
+    char buffer[256];
+    std::snprintf(buffer, sizeof(buffer), "%s: stop status", what);
+    check_equal_u64(static_cast<std::uint64_t>(compiled.result.status),
+                    static_cast<std::uint64_t>(interpreted.result.status), buffer, __FILE__,
+                    __LINE__);
+    std::snprintf(buffer, sizeof(buffer), "%s: stopping instruction", what);
+    check_equal_u64(compiled.result.pc, interpreted.result.pc, buffer, __FILE__, __LINE__);
+    test::expect_same(static_cast<const MachineState&>(compiled),
+                      static_cast<const MachineState&>(interpreted), what);
+}
+
+// A counted loop over memory: ALU, a store, a load of what it stored, a pointer bump and a
+// backward branch, five hundred times. Every instruction in the body is covered, so the body is
+// one block whose taken edge chains to itself.
+Program hot_loop_program() {
+    Program program;
+    Encoder code(kProgramBase);
+    code.op_r_i8(op::kMoveW, reg(10), 0);
+    code.op_r_i8(op::kMoveW, reg(11), 500);
+    code.op_r_i8(op::kMoveW, reg(12), kData);
+    code.op_r_i8(op::kMoveW, reg(13), 0x9E3779B97F4A7C15ull);
+    const std::uint64_t loop = code.current_address();
+    code.op_r_r_r(op::kAdd, reg(10), reg(13), reg(13));
+    code.op_r_r_r(op::kMultiply, reg(13), reg(10), reg(14));
+    code.op_r_r_i2(op::kStoreDisp, reg(14), reg(12), 0);
+    code.op_r_r_i2(op::kLoadDisp, reg(12), reg(15), 0);
+    code.op_r_r_r(op::kXor, reg(15), reg(13), reg(13));
+    code.op_r_r_i4(op::kAddImm, reg(12), reg(12), 8);
+    code.op_r_r_i4(op::kAddImm, reg(10), reg(10), 1);
+    code.op_r_r_i4(op::kBranchBase + kLtUnsigned, reg(10), reg(11),
+                   loop - (code.current_address() + 7));
+    code.halt();
+    program.images.push_back(code);
+    return program;
+}
+
+// Every instruction the JIT emits as a template rather than a call (jit_v2.cpp), three hundred
+// times over values that cover both signs and both halves of the unsigned range. r13 is a
+// multiplicative sequence and r14 is r13 with its top and bottom halves mixed, except on every
+// fourth pass, when it is r13 itself, so each of the ten predicates is asked about less, equal
+// and greater, in the register form, in the immediate form against a negative literal and
+// against a small one, and as a branch that skips one instruction when taken. Each answer is
+// folded into r15 by r15 = 3 * r15 + answer, so one wrong answer anywhere in the run shows in it
+// at the end. r0 appears as a source on either side and as a destination that must stay zero.
+Program template_program() {
+    Program program;
+    Encoder code(kProgramBase);
+    code.op_r_i8(op::kMoveW, reg(10), 0);
+    code.op_r_i8(op::kMoveW, reg(11), 300);
+    code.op_r_i8(op::kMoveW, reg(12), 0x9E3779B97F4A7C15ull);
+    code.op_r_i8(op::kMoveW, reg(13), 1);
+    code.op_r_i8(op::kMoveW, reg(15), 0);
+    const auto fold = [&code](unsigned answer) {
+        code.op_r_r_r(op::kAdd, reg(15), reg(15), reg(17));
+        code.op_r_r_r(op::kAdd, reg(15), reg(17), reg(15));
+        code.op_r_r_r(op::kAdd, reg(15), reg(answer), reg(15));
+    };
+    const std::uint64_t loop = code.current_address();
+    code.op_r_r_r(op::kMultiply, reg(13), reg(12), reg(13));
+    code.op_r_r_r(op::kAdd, reg(13), reg(10), reg(13));
+    code.op_r_r_i1(op::kShiftRightLogicalImm, reg(13), reg(14), 32);
+    code.op_r_r_r(op::kXor, reg(14), reg(13), reg(14));
+    code.op_r_r_i4(op::kAndImm, reg(10), reg(16), 3);
+    code.op_r_r_r(op::kSelectZ, reg(13), reg(16), reg(14));
+    for (std::uint8_t predicate = 0; predicate < 10; ++predicate) {
+        code.op_r_r_r(op::kCompareEq + predicate, reg(13), reg(14), reg(16));
+        fold(16);
+        code.op_r_r_i4(op::kCompareImmBase + predicate, reg(13), reg(16), 0xFFFFFFFBu);
+        fold(16);
+        code.op_r_r_i4(op::kCompareImmBase + predicate, reg(10), reg(16), 150);
+        fold(16);
+        code.op_r_r_i4(op::kBranchBase + predicate, reg(13), reg(14), 4);
+        code.op_r_r_r(op::kXor, reg(15), reg(13), reg(15));
+    }
+    code.op_r_r_r(op::kAdd, reg(0), reg(13), reg(18));
+    code.op_r_r_r(op::kSubtract, reg(13), reg(0), reg(19));
+    code.op_r_r(op::kMove, reg(13), reg(0));
+    code.op_r_r_r(op::kOr, reg(13), reg(14), reg(0));
+    code.op_r_r_i4(op::kAddImm, reg(0), reg(20), 7);
+    code.op_r_r_i4(op::kOrImm, reg(13), reg(21), 0xFFFFFF00u);
+    code.op_r_r_i4(op::kAndImm, reg(13), reg(22), 0x80000000u);
+    code.op_r_r_i4(op::kXorImm, reg(13), reg(23), 0x7FFFFFFFu);
+    code.op_r_r_i4(op::kSubtractImm, reg(13), reg(24), 0xFFFFFFFFu);
+    code.op_r_r_r(op::kSubtract, reg(13), reg(14), reg(25));
+    code.op_r_r_r(op::kAnd, reg(13), reg(14), reg(26));
+    code.op_r_r_r(op::kOr, reg(13), reg(14), reg(27));
+    code.op_r_r(op::kMove, reg(0), reg(28));
+    code.op_r_i8(op::kMoveW, reg(29), 0x8000000000000001ull);
+    code.op_r_i8(op::kMoveW, reg(0), 5);
+    code.op_r_r_r(op::kCompareEq, reg(0), reg(0), reg(30));
+    for (unsigned answer = 18; answer <= 30; ++answer) {
+        fold(answer);
+    }
+    code.op_r_r_i4(op::kAddImm, reg(10), reg(10), 1);
+    code.op_r_r_i4(op::kBranchBase + kLtUnsigned, reg(10), reg(11),
+                   loop - (code.current_address() + 7));
+    code.halt();
+    program.images.push_back(code);
+    return program;
+}
+
+V2_FIXTURE(jit_runs_a_hot_loop_to_the_interpreters_state) {
+    const Program program = hot_loop_program();
+    const JitOptionsV2 options = fixture_jit_options();
+    const Outcome interpreted = run_program(program, nullptr);
+    const Outcome compiled = run_program(program, &options);
+
+    expect_halted(interpreted.result, "the interpreted loop");
+    expect_same(compiled, interpreted, "the hot loop");
+    V2_CHECK_EQ(interpreted.registers[10], 500);
+
+    // The differential check above passes on a JIT that never compiled anything, so on a host
+    // with a backend the fixture also asks that the loop body really ran as compiled code and
+    // really chained to itself rather than returning to the dispatcher every iteration.
+    if (JitV2::kHasBackend) {
+        V2_CHECK(compiled.jit.blocks_compiled >= 1);
+        V2_CHECK(compiled.jit.instructions >= 8 * 450);
+        V2_CHECK(compiled.jit.chained_entries >= 400);
+    }
+}
+
+V2_FIXTURE(jit_stops_on_the_step_budget_where_the_interpreter_does) {
+    // run() with a budget stops after exactly that many Advanced instructions, and a chain of
+    // compiled blocks has to honour it mid-chain. Slices of 37 land on every offset into the
+    // eight-instruction body over the course of the run, so a JIT that admitted a block past
+    // the budget, or counted a chained entry wrong, stops somewhere else in at least one slice.
+    const Program program = hot_loop_program();
+    const JitOptionsV2 options = fixture_jit_options();
+    for (const std::uint64_t slice : {1u, 7u, 37u, 301u}) {
+        const Outcome interpreted = run_program(program, nullptr, slice);
+        const Outcome compiled = run_program(program, &options, slice);
+        char what[64];
+        std::snprintf(what, sizeof(what), "slices of %u", static_cast<unsigned>(slice));
+        expect_same(compiled, interpreted, what);
+    }
+}
+
+V2_FIXTURE(jit_stops_on_the_cycle_limit_where_the_interpreter_does) {
+    // The cycle limit (user-022) is the step budget's counterpart in cycles, and the JIT honours
+    // it as each instruction retires, in a template or in the call, so a compiled block is left
+    // at the instruction that reaches it. The loop body costs twelve cycles over eight
+    // instructions, and these limits fall on different instructions of it, in the warm-up and
+    // deep in the compiled iterations.
+    const Program program = hot_loop_program();
+    const JitOptionsV2 options = fixture_jit_options();
+    for (const std::uint64_t limit : {1u, 29u, 100u, 1003u, 2517u, 5000u, 5999u}) {
+        const Outcome interpreted = run_program(program, nullptr, 0, limit);
+        const Outcome compiled = run_program(program, &options, 0, limit);
+        char what[64];
+        std::snprintf(what, sizeof(what), "a limit of %u cycles", static_cast<unsigned>(limit));
+        expect_same(compiled, interpreted, what);
+        check_equal_u64(static_cast<std::uint64_t>(interpreted.result.status),
+                        static_cast<std::uint64_t>(StepStatus::Advanced), what, __FILE__,
+                        __LINE__);
+        // Reached, and by no more than the instruction that reached it could add.
+        V2_CHECK(interpreted.cycles >= limit && interpreted.cycles < limit + 3);
+    }
+}
+
+V2_FIXTURE(jit_templates_match_the_interpreter_on_every_operand_and_predicate) {
+    // The templates are the one place the JIT carries instruction semantics of its own, so they
+    // get what the handlers it calls do not need: a program of nothing else, run to the end, to
+    // cycle limits that stop it on a template, and under --jit-check, which compares every block.
+    const Program program = template_program();
+    const Outcome interpreted = run_program(program, nullptr);
+    expect_halted(interpreted.result, "the interpreted templates");
+    V2_CHECK_EQ(interpreted.registers[0], 0u);
+    V2_CHECK_EQ(interpreted.registers[30], 1u);
+
+    const JitOptionsV2 options = fixture_jit_options();
+    expect_same(run_program(program, &options), interpreted, "the templates");
+    for (const std::uint64_t limit : {7u, 611u, 4099u, 20001u}) {
+        char what[64];
+        std::snprintf(what, sizeof(what), "the templates to %u cycles",
+                      static_cast<unsigned>(limit));
+        expect_same(run_program(program, &options, 0, limit),
+                    run_program(program, nullptr, 0, limit), what);
+    }
+
+    JitOptionsV2 checked_options = options;
+    checked_options.check = true;
+    const Outcome checked = run_program(program, &checked_options);
+    expect_same(checked, interpreted, "the checked templates");
+    V2_CHECK(checked.check_failure.empty());
+    if (JitV2::kHasBackend) {
+        V2_CHECK(checked.jit.checked_blocks >= 250);
+    }
+}
+
+V2_FIXTURE(jit_runs_a_patched_instruction_rather_than_its_stale_compile) {
+    // memory-model.md makes a fetch coherent with every earlier store, and a compiled block is a
+    // fetch that happened once and was kept. On the hundredth iteration the loop stores a new
+    // immediate into its own move_zb, so every later iteration must add $22 instead of $11. A
+    // JIT that kept running the block it compiled before the store adds $11 all the way.
+    struct Layout {
+        std::uint64_t loop = 0;
+        std::uint64_t skip_branch = 0;
+        std::uint64_t skip = 0;
+    };
+    // Built twice: the first pass measures the loop and the skip over the store, and the second
+    // bakes those into the image. Every instruction here has a fixed length, so the addresses
+    // the first pass measures are the ones the second pass occupies.
+    const auto build = [](const Layout& known, Layout& measured) {
+        Encoder code(kProgramBase);
+        code.op_r_i8(op::kMoveW, reg(10), 0);
+        code.op_r_i8(op::kMoveW, reg(11), 500);
+        code.op_r_i8(op::kMoveW, reg(16), 100);
+        code.op_r_i8(op::kMoveW, reg(17), 0x22);
+        code.op_r_i8(op::kMoveW, reg(21), 0);
+        // The move_zb's immediate is two bytes past its opcode: opcode, operand, immediate.
+        code.op_r_i8(op::kMoveW, reg(18), known.loop + 2);
+        measured.loop = code.current_address();
+        code.op_r_i1(op::kMoveZb, reg(20), 0x11);
+        code.op_r_r_r(op::kAdd, reg(21), reg(20), reg(21));
+        measured.skip_branch = code.current_address();
+        code.op_r_r_i4(op::kBranchBase + kNe, reg(10), reg(16), known.skip - (known.skip_branch + 7));
+        code.op_r_r(op::kStoreB, reg(17), reg(18));
+        measured.skip = code.current_address();
+        code.op_r_r_i4(op::kAddImm, reg(10), reg(10), 1);
+        code.op_r_r_i4(op::kBranchBase + kLtUnsigned, reg(10), reg(11),
+                       measured.loop - (code.current_address() + 7));
+        code.halt();
+        return code;
+    };
+    Layout layout;
+    Layout unused;
+    build(Layout{}, layout);
+    Program program;
+    program.images.push_back(build(layout, unused));
+
+    const JitOptionsV2 options = fixture_jit_options();
+    const Outcome interpreted = run_program(program, nullptr);
+    const Outcome compiled = run_program(program, &options);
+
+    expect_halted(interpreted.result, "the self-patching loop");
+    expect_same(compiled, interpreted, "the self-patching loop");
+    // Iterations 0 through 100 add the original immediate, since the store on iteration 100
+    // follows that iteration's add, and the other 399 add the patched one. In digits, so a
+    // machine that served the stale compile fails here even if it failed identically twice.
+    V2_CHECK_EQ(compiled.registers[21], 101 * 0x11 + 399 * 0x22);
+    if (JitV2::kHasBackend) {
+        V2_CHECK(compiled.jit.invalidations >= 1);
+        V2_CHECK(compiled.jit.blocks_compiled >= 2);
+    }
+}
+
+V2_FIXTURE(jit_keeps_timer_interrupts_on_their_instruction_boundaries) {
+    // A periodic timer every thirty-one instruction-times against a hot loop. The handler appends the
+    // captured program counter of every interrupt to a log, so the log is the exact sequence of
+    // boundaries the machine chose, and a JIT whose bulk clock let one expiry slip by even one
+    // instruction writes a different address into it.
+    Program program;
+    Encoder code(kProgramBase);
+    const auto csr_load = [&code](std::uint16_t number, std::uint64_t value) {
+        code.op_r_i8(op::kMoveW, reg(1), value);
+        code.op_r_i2(op::kCsrWrite, reg(1), number);
+    };
+    const auto port_out = [&code](std::uint16_t port, std::uint64_t value) {
+        code.op_r_i8(op::kMoveW, reg(1), value);
+        code.op_r_i8(op::kMoveW, reg(30), port);
+        code.op_r_r(op::kPortOut, reg(1), reg(30));
+    };
+    csr_load(csr::kTrapVectorBase, kVectorTable);
+    csr_load(csr::kTrapStack, kTrapStackTop);
+    csr_load(csr::kScratch, kSaveArea);
+    csr_load(csr::kInterruptEnable0, std::uint64_t{1} << cause::kTimerInterrupt);
+    port_out(kTimerControl, 1);
+    csr_load(csr::kStatus, kSupervisorInterruptsOn);
+    port_out(kTimerPeriod, 31 * kNanosecondsPerInstruction);
+    port_out(kTimerMode, 3);  // counting, periodic
+    code.op_r_i8(op::kMoveW, reg(10), 0);
+    code.op_r_i8(op::kMoveW, reg(11), 400);
+    const std::uint64_t loop = code.current_address();
+    code.op_r_r_r(op::kAdd, reg(10), reg(12), reg(12));
+    code.op_r_r_i4(op::kXorImm, reg(12), reg(13), 0x5A5A);
+    code.op_r_r_r(op::kMultiply, reg(13), reg(12), reg(14));
+    code.op_r_r_i4(op::kAddImm, reg(10), reg(10), 1);
+    code.op_r_r_i4(op::kBranchBase + kLtUnsigned, reg(10), reg(11),
+                   loop - (code.current_address() + 7));
+    // Stop the timer before halting, so both machines end with nothing scheduled.
+    port_out(kTimerMode, 0);
+    code.halt();
+    program.images.push_back(code);
+
+    // The handler banks three registers through the scratch register, as every interrupt handler
+    // in fixtures_interrupts.cpp does, because the frame saves none.
+    Encoder handler(kHandlerBase);
+    handler.op_r_r_i2(op::kCsrSwap, reg(2), reg(2), csr::kScratch);
+    handler.op_r_r_i2(op::kStoreDisp, reg(3), reg(2), 0);
+    handler.op_r_r_i2(op::kStoreDisp, reg(4), reg(2), 8);
+    handler.op_r_r_i2(op::kStoreDisp, reg(5), reg(2), 16);
+    handler.op_r_i8(op::kMoveW, reg(3), kTrapStackTop - trap_frame::kBytes);
+    handler.op_r_r_i2(op::kLoadDisp, reg(3), reg(3), trap_frame::kPcOffset);
+    handler.op_r_i8(op::kMoveW, reg(4), kLogCursor);
+    handler.op_r_r(op::kLoad, reg(4), reg(5));
+    handler.op_r_r(op::kStore, reg(3), reg(5));
+    handler.op_r_r_i4(op::kAddImm, reg(5), reg(5), 8);
+    handler.op_r_r(op::kStore, reg(5), reg(4));
+    handler.op_r_i8(op::kMoveW, reg(3), 1);
+    handler.op_r_i8(op::kMoveW, reg(4), kTimerStatus);
+    handler.op_r_r(op::kPortOut, reg(3), reg(4));
+    handler.op_r_r_i2(op::kLoadDisp, reg(2), reg(3), 0);
+    handler.op_r_r_i2(op::kLoadDisp, reg(2), reg(4), 8);
+    handler.op_r_r_i2(op::kLoadDisp, reg(2), reg(5), 16);
+    handler.op_r_r_i2(op::kCsrSwap, reg(2), reg(2), csr::kScratch);
+    handler.op(op::kTrapReturn);
+    program.images.push_back(handler);
+
+    program.words.emplace_back(vector_table::entry_address(kVectorTable, cause::kTimerInterrupt),
+                               kHandlerBase);
+    program.words.emplace_back(kLogCursor, kLog);
+
+    const JitOptionsV2 options = fixture_jit_options();
+    const Outcome interpreted = run_program(program, nullptr);
+    const Outcome compiled = run_program(program, &options);
+
+    expect_halted(interpreted.result, "the interrupted loop");
+    expect_same(compiled, interpreted, "the interrupted loop");
+    // Enough interrupts that the comparison above compared something: the loop alone is two
+    // thousand instructions and the timer fires every thirty-one.
+    const std::uint64_t cursor =
+        interpreted.memory[kLogCursor] | (std::uint64_t{interpreted.memory[kLogCursor + 1]} << 8);
+    V2_CHECK((cursor - kLog) / 8 >= 50);
+    if (JitV2::kHasBackend) {
+        V2_CHECK(compiled.jit.blocks_compiled >= 1);
+        V2_CHECK(compiled.jit.instructions >= 1000);
+    }
+}
+
+V2_FIXTURE(jit_check_passes_a_faithful_block_and_catches_an_injected_miscompile) {
+    // --jit-check is only worth running if it can fail. The faithful run proves it does not
+    // cry wolf on a correct block; the injected run corrupts the first add-immediate of every
+    // block and proves the check names it. Either way the interpreter's state is the one that
+    // stands, so both runs still end exactly where the interpreter ends.
+    const Program program = hot_loop_program();
+    const Outcome interpreted = run_program(program, nullptr);
+
+    JitOptionsV2 faithful = fixture_jit_options();
+    faithful.check = true;
+    const Outcome checked = run_program(program, &faithful);
+    expect_same(checked, interpreted, "the checked run");
+    V2_CHECK(checked.check_failure.empty());
+
+    JitOptionsV2 broken = faithful;
+    broken.inject_miscompile = true;
+    const Outcome caught = run_program(program, &broken);
+    expect_same(caught, interpreted, "the miscompiled run");
+    if (JitV2::kHasBackend) {
+        V2_CHECK(checked.jit.checked_blocks >= 100);
+        V2_CHECK(!caught.check_failure.empty());
+        // The report names the register the corrupted add-immediate wrote, in the form
+        // mzvm prints.
+        if (caught.check_failure.find("r12 is") == std::string::npos &&
+            caught.check_failure.find("r10 is") == std::string::npos) {
+            record_failure("the miscompile report does not name the corrupted register: " +
+                           caught.check_failure);
+        }
+        // One failure turns the JIT off, so it checked no further block after it.
+        V2_CHECK(caught.jit.checked_blocks <= checked.jit.checked_blocks);
+    }
+}
+
+}  // namespace
+}  // namespace maize::v2::test
@@ -1,6 +1,10 @@
 // fixtures_memory.cpp (maize-418): loads and stores, extract and insert, bitfield, block memory.
 
+#include <algorithm>
 #include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
 #include <vector>
 
 #include "fixture_support.h"
@@ -872,4 +876,202 @@ V2_FIXTURE(block_memory_restart_invariant) {
     }
 }
 
+V2_FIXTURE(block_memory_over_many_pages_matches_the_byte_at_a_time_transfer) {
+    // user-015 moves a block-memory transfer a run at a time, each run ending at a page edge on
+    // either side, at the end of populated memory or at a 64-byte interrupt point. Every run
+    // edge is a place the result could come apart from the byte-at-a-time transfer the chapter
+    // defines, so these transfers are several pages long, start at an odd offset on each side,
+    // and overlap at distances shorter than a run, equal to one, and longer than a page. The
+    // reference is the definition computed over a copy of the window.
+    constexpr std::uint64_t kWindowBase = 0x1000;
+    constexpr std::uint64_t kWindow = 0x8000;
+    constexpr std::uint64_t kSource = 0x2345;
+    constexpr std::uint64_t kCount = 0x2100;
+    const std::int64_t distances[] = {1, 3, 64, 100, 0x1001, 0x3000, -5, -0x1001};
+
+    for (const std::int64_t distance : distances) {
+        for (const std::uint8_t opcode : {op::kBlockCopy, op::kBlockCopyForward}) {
+            Machine machine(0x10000);
+            Encoder program(kBase);
+            program.op_r_r_r(opcode, reg(4), reg(5), reg(6)).halt();
+            machine.load(program);
+            fill_pattern(machine.memory(), kWindowBase, kWindow, 0x5B);
+            std::vector<std::uint8_t> expected = snapshot(machine.memory(), kWindowBase, kWindow);
+            const std::uint64_t destination =
+                static_cast<std::uint64_t>(static_cast<std::int64_t>(kSource) + distance);
+            const std::size_t from = static_cast<std::size_t>(kSource - kWindowBase);
+            const std::size_t to = static_cast<std::size_t>(destination - kWindowBase);
+            if (opcode == op::kBlockCopyForward) {
+                for (std::size_t i = 0; i < kCount; ++i) {
+                    expected[to + i] = expected[from + i];
+                }
+            } else {
+                const std::vector<std::uint8_t> staged(expected.begin() + from,
+                                                       expected.begin() + from + kCount);
+                std::copy(staged.begin(), staged.end(), expected.begin() + to);
+            }
+
+            machine.set(4, kSource);
+            machine.set(5, destination);
+            machine.set(6, kCount);
+            char label[128];
+            std::snprintf(label, sizeof(label), "%s over 0x%llx bytes at distance %lld",
+                          opcode == op::kBlockCopy ? "block_copy" : "block_copy_forward",
+                          static_cast<unsigned long long>(kCount),
+                          static_cast<long long>(distance));
+            expect_halted(machine.run(), label);
+            if (snapshot(machine.memory(), kWindowBase, kWindow) != expected) {
+                record_failure(std::string(label) + ": the transferred bytes do not match");
+            }
+            check_equal_u64(machine.get(4), kSource + kCount, label, __FILE__, __LINE__);
+            check_equal_u64(machine.get(5), destination + kCount, label, __FILE__, __LINE__);
+            check_equal_u64(machine.get(6), 0, label, __FILE__, __LINE__);
+        }
+    }
+
+    // block_set over the same span.
+    {
+        Machine machine(0x10000);
+        Encoder program(kBase);
+        program.op_r_r_r(op::kBlockSet, reg(3), reg(5), reg(6)).halt();
+        machine.load(program);
+        fill_pattern(machine.memory(), kWindowBase, kWindow, 0x5B);
+        std::vector<std::uint8_t> expected = snapshot(machine.memory(), kWindowBase, kWindow);
+        std::fill(expected.begin() + (kSource - kWindowBase),
+                  expected.begin() + (kSource - kWindowBase + kCount), 0xE1);
+        machine.set(3, 0x77E1);  // only the low byte is the fill
+        machine.set(5, kSource);
+        machine.set(6, kCount);
+        expect_halted(machine.run(), "block_set over several pages");
+        V2_CHECK(snapshot(machine.memory(), kWindowBase, kWindow) == expected);
+        V2_CHECK_EQ(machine.get(5), kSource + kCount);
+        V2_CHECK_EQ(machine.get(6), 0u);
+    }
+
+    // A transfer that runs off the end of populated memory part-way through a page, and off
+    // the end part-way through a run, faults on the first byte that is not there, with every
+    // byte below it transferred and none above it.
+    {
+        constexpr std::uint64_t kPopulated = 0x5123;
+        Machine machine(0x10000);
+        Encoder program(kBase);
+        program.op_r_r_r(op::kBlockCopyForward, reg(4), reg(5), reg(6)).halt();
+        machine.load(program);
+        fill_pattern(machine.memory(), 0x1000, 0x2000, 0x19);
+        const std::vector<std::uint8_t> source = snapshot(machine.memory(), 0x1000, 0x2000);
+        machine.memory().host_set_size(kPopulated);
+        machine.set(4, 0x1000);
+        machine.set(5, 0x4000);
+        machine.set(6, 0x2000);
+
+        const StepResult result = machine.step();
+        expect_trap(result, cause::kPhysicalMemoryFault, 0, kPopulated, kBase,
+                    "block_copy_forward running off the end of populated memory");
+        const std::uint64_t moved = kPopulated - 0x4000;
+        V2_CHECK_EQ(machine.get(4), 0x1000 + moved);
+        V2_CHECK_EQ(machine.get(5), kPopulated);
+        V2_CHECK_EQ(machine.get(6), 0x2000 - moved);
+        V2_CHECK(snapshot(machine.memory(), 0x4000, moved) ==
+                 std::vector<std::uint8_t>(source.begin(), source.begin() + moved));
+    }
+}
+
+V2_FIXTURE(a_store_over_a_decoded_instruction_is_fetched_next_time) {
+    // memory-model.md makes an instruction fetch coherent with every earlier store, the
+    // program's own stores to its own code included. This machine caches decoded instructions
+    // (user-001), and that cache is exactly the thing that would serve the OLD bytes if a store
+    // failed to reach it. The program runs an instruction, overwrites that instruction's
+    // immediate byte with a store, and branches back to run it again: the second pass has to
+    // see the new byte with no flush of any kind in between.
+    Machine machine(0x400);
+    Encoder program(kBase);
+    const std::uint64_t patched = program.current_address();
+    program.op_r_i1(op::kMoveZb, reg(3), 0x11);
+    const std::uint64_t branch = program.current_address();
+    program.op_r_r_i4(op::kBranchBase + 1, reg(4), reg(0), 0);  // branch_ne r4 r0, fixed below
+    program.op_r_i1(op::kMoveZb, reg(4), 1);
+    program.op_r_r(op::kStoreB, reg(5), reg(6));  // the move's immediate byte becomes $22
+    const std::uint64_t jump = program.current_address();
+    program.op_i4(op::kJumpDisp, static_cast<std::uint32_t>(patched - (jump + 5)));
+    const std::uint64_t done = program.current_address();
+    program.halt();
+    machine.load(program);
+    // The branch displacement is measured from the instruction after the branch.
+    machine.memory().write_little_endian(branch + 3, 4, done - (branch + 7));
+    machine.set(5, 0x22);
+    machine.set(6, patched + 2);
+
+    expect_halted(machine.run(), "a program that patches an instruction it already ran");
+    V2_CHECK_EQ(machine.get(3), 0x22u);
+    // Implementation-visible, like the translation cache's counters: the patched page was
+    // found stale once, which is the cache noticing the store rather than never having held
+    // the instruction.
+    V2_CHECK(machine.interpreter().predecode().stale_pages() >= 1u);
+
+    // And a loop that does not patch itself is served from the cache after its first pass.
+    Machine looping(0x400);
+    Encoder counted(kBase);
+    counted.op_r_i1(op::kMoveZb, reg(2), 50);
+    const std::uint64_t top = counted.current_address();
+    counted.op_r_r_i4(op::kSubtractImm, reg(2), reg(2), 1);
+    const std::uint64_t back = counted.current_address();
+    counted.op_r_r_i4(op::kBranchBase + 1, reg(2), reg(0),
+                      static_cast<std::uint32_t>(top - (back + 7)));
+    counted.halt();
+    looping.load(counted);
+    expect_halted(looping.run(), "a counted loop");
+    V2_CHECK_EQ(looping.get(2), 0u);
+    V2_CHECK(looping.interpreter().predecode().hits() >= 90u);
+}
+
+V2_FIXTURE(memory_is_committed_on_touch_and_reads_zero_where_it_was_given_back) {
+    // user-006 put physical memory on one lazily committed host mapping. Two things about that
+    // are observable and both are asserted here. A large memory is usable at once: sixteen GiB
+    // is constructed, written at both ends and read back, which a zero-filled buffer could not
+    // do in a fixture's time budget. And a resize keeps the bytes below the new size and makes
+    // every byte above it read zero when it returns, across a partial host page at the new end
+    // and across a regrowth past the original mapping, which moves it.
+    if constexpr (sizeof(std::size_t) >= 8) {
+        constexpr std::uint64_t kLarge = std::uint64_t{16} << 30;
+        MemoryV2 large(static_cast<std::size_t>(kLarge));
+        V2_CHECK_EQ(large.size(), kLarge);
+        large.write_little_endian(0, 8, kSentinel);
+        large.write_little_endian(kLarge - 8, 8, kSentinel);
+        V2_CHECK_EQ(large.read_little_endian(0, 8), kSentinel);
+        V2_CHECK_EQ(large.read_little_endian(kLarge - 8, 8), kSentinel);
+        V2_CHECK_EQ(large.read_byte(kLarge / 2), 0u);
+    }
+
+    MemoryV2 memory(0x10000);
+    fill_pattern(memory, 0, 0x10000, 0x5A);
+    const std::vector<std::uint8_t> kept = snapshot(memory, 0, 0x3001);
+    memory.host_set_size(0x3001);
+    memory.host_set_size(0x40000);
+    V2_CHECK(snapshot(memory, 0, 0x3001) == kept);
+    bool zero = true;
+    for (std::uint64_t address = 0x3001; address < 0x40000; ++address) {
+        zero = zero && memory.read_byte(address) == 0u;
+    }
+    V2_CHECK(zero);
+
+    // Memory commits a page itself on its first write rather than waiting for a fault, so the
+    // runs a device hands to a host call are committed before it sees them: a run over pages
+    // nothing has written reads zero, and one written through host_range_for_write reads back.
+    const std::uint8_t* untouched = memory.host_range(0x20000, 0x3000);
+    V2_CHECK(std::all_of(untouched, untouched + 0x3000, [](std::uint8_t b) { return b == 0u; }));
+    std::memset(memory.host_range_for_write(0x24000, 0x2000), 0xC3, 0x2000);
+    V2_CHECK_EQ(memory.read_byte(0x24000), 0xC3u);
+    V2_CHECK_EQ(memory.read_byte(0x25FFF), 0xC3u);
+    V2_CHECK_EQ(memory.read_byte(0x26000), 0u);
+
+    // A page that was untouched when a memory was cloned is not in the clone's image, so the
+    // parent's first write to it is its own, and the next clone freezes again to see it.
+    std::unique_ptr<MemoryV2> before = memory.clone();
+    memory.write_byte(0x30000, 0x77);
+    std::unique_ptr<MemoryV2> after = memory.clone();
+    V2_CHECK_EQ(before->read_byte(0x30000), 0u);
+    V2_CHECK_EQ(after->read_byte(0x30000), 0x77u);
+    V2_CHECK_EQ(after->read_byte(0x24000), 0xC3u);
+}
+
 }  // namespace maize::v2::test
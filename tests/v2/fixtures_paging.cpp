@@ -28,10 +28,13 @@
 // fixtures would pass unchanged if a constant were given the wrong value. The digits fixture is
 // the one that would not, and it is the reason the others may use names.
 
+#include <algorithm>
 #include <cstdio>
+#include <memory>
 #include <vector>
 
 #include "fixture_support.h"
+#include "jit_v2.h"
 
 namespace maize::v2::test {
 namespace {
@@ -1381,6 +1384,197 @@ V2_FIXTURE(the_translation_cache_neither_over_flushes_nor_under_flushes) {
     V2_CHECK_EQ(paged.translator().walks() - mark, 2u);
 }
 
+V2_FIXTURE(the_translation_cache_holds_a_working_set_wider_than_the_old_scan) {
+    // user-003 replaced the 32-entry FIFO with 64 sets of four ways and a last-page entry per
+    // access kind. The fixture touches forty data pages, more than the old cache held in total,
+    // and then touches them all again, twice each: this machine walks forty times the first pass
+    // and not at all the second, evicts nothing, and answers each page's second load from the
+    // load entry. Like the fixture above it, this is a statement about THIS machine's counters
+    // and no requirement on another; the old machine was conforming and walked eighty times.
+    constexpr unsigned kPages = 40;
+    Paged paged;
+    paged.identity_map();
+    for (unsigned page = 0; page < kPages; ++page) {
+        paged.tables().map(kFarVirtual + page * sv48::page_bytes(0), kDataPage, kLeafRWX);
+    }
+    paged.machine().memory().write_little_endian(kDataPage, 8, kSentinel);
+    paged.machine().memory().write_little_endian(kDataPage + 8, 8, kReplacement);
+    paged.emit_enable();
+    for (unsigned page = 0; page < kPages; ++page) {
+        paged.emit_move(2, kFarVirtual + page * sv48::page_bytes(0));
+        paged.emit_load(2, 3);
+    }
+    for (unsigned page = 0; page < kPages; ++page) {
+        paged.program().op_r_i8(op::kMoveW, reg(2), kFarVirtual + page * sv48::page_bytes(0));
+        paged.program().op_r_r(op::kLoad, reg(2), reg(3));
+        paged.program().op_r_r_i2(op::kLoadDisp, reg(2), reg(4), 8);
+    }
+    paged.program().halt();
+    paged.start();
+    paged.run_setup();
+
+    const std::uint64_t walks_before = paged.translator().walks();
+    const std::uint64_t hits_before = paged.translator().hits();
+    const std::uint64_t fast_before = paged.translator().fast_hits();
+    for (unsigned i = 0; i < 3 * kPages; ++i) {
+        V2_CHECK(paged.step().status == StepStatus::Advanced);
+    }
+    V2_CHECK_EQ(paged.machine().get(3), kSentinel);
+    V2_CHECK_EQ(paged.machine().get(4), kReplacement);
+    V2_CHECK_EQ(paged.translator().walks() - walks_before, 0u);
+    V2_CHECK_EQ(paged.translator().misses(), paged.translator().walks());
+    V2_CHECK_EQ(paged.translator().evictions(), 0u);
+    // Both loads of every page hit, and the second of each hit the load entry without indexing
+    // a set at all.
+    V2_CHECK(paged.translator().hits() - hits_before >= 2 * kPages);
+    V2_CHECK(paged.translator().fast_hits() - fast_before >= kPages);
+    V2_CHECK(paged.translator().cached_count() >= kPages);
+}
+
+V2_FIXTURE(a_loop_on_one_code_page_fetches_without_translating) {
+    // user-005. The interpreter keeps the translation of the page it last fetched from, and a
+    // decode reads the rest of an instruction out of a window on that page, so a loop whose
+    // instructions are already predecoded asks the translation cache for nothing at all: not a
+    // walk and not a hit. The window is keyed on the paging root, the privilege level and the
+    // cache's epoch, and the tlb_invalidate_all at the end proves the epoch is read, because the
+    // fetch after it has to walk again. Implementation-visible, like every counter fixture here.
+    Paged paged;
+    paged.identity_map();
+    paged.emit_enable();
+    paged.emit_move(10, 0);
+    paged.emit_move(11, 100);
+    const std::uint64_t loop = paged.here();
+    paged.program().op_r_r_r(op::kAdd, reg(10), reg(12), reg(12));
+    paged.program().op_r_r_i4(op::kAddImm, reg(10), reg(10), 1);
+    paged.program().op_r_r_i4(op::kBranchBase + 6, reg(10), reg(11),
+                              loop - (paged.here() + 7));  // branch.lt_unsigned, back
+    paged.program().op(op::kTlbInvalidateAll);
+    paged.program().op_r_r_r(op::kAdd, reg(10), reg(12), reg(12));
+    paged.program().halt();
+    paged.start();
+    paged.run_setup();
+
+    // Two passes warm the predecode cache; the other ninety-eight run out of it.
+    for (unsigned i = 0; i < 2 * 3; ++i) {
+        V2_CHECK(paged.step().status == StepStatus::Advanced);
+    }
+    const std::uint64_t walks_before = paged.translator().walks();
+    const std::uint64_t hits_before = paged.translator().hits();
+    for (unsigned i = 0; i < 98 * 3; ++i) {
+        V2_CHECK(paged.step().status == StepStatus::Advanced);
+    }
+    V2_CHECK_EQ(paged.machine().get(10), 100u);
+    V2_CHECK_EQ(paged.translator().walks() - walks_before, 0u);
+    V2_CHECK_EQ(paged.translator().hits() - hits_before, 0u);
+
+    // tlb_invalidate_all, then an instruction on the same page: its fetch walks once.
+    V2_CHECK(paged.step().status == StepStatus::Advanced);
+    const std::uint64_t walks_after = paged.translator().walks();
+    V2_CHECK(paged.step().status == StepStatus::Advanced);
+    V2_CHECK_EQ(paged.translator().walks() - walks_after, 1u);
+}
+
+V2_FIXTURE(one_code_page_under_two_mappings_runs_at_each_mappings_address) {
+    // user-013. The predecode cache is keyed by physical address and runs a record in place when
+    // the program counter is the one it was decoded at, so a page mapped twice is the case where
+    // a hit has to be copied and given the live program counter instead. pc_add reads its own
+    // address, which makes a record run at the wrong one visible in a register. The third run,
+    // back at the first mapping, shows the copy left the cache's own record as it was.
+    Paged paged;
+    paged.identity_map();
+    paged.tables().map(kTestVirtual, kDataPage, kLeafRWX);
+    paged.tables().map(kSecondVirtual, kDataPage, kLeafRWX);
+    paged.emit_enable();
+    paged.program().halt();
+    paged.start();
+    paged.run_setup();
+
+    Encoder code(kDataPage);
+    code.op_r_i4(op::kPcAdd, reg(5), 0);
+    code.halt();
+    paged.load_image(code);
+
+    InterpreterV2& interpreter = paged.machine().interpreter();
+    const std::uint64_t hits_before = interpreter.predecode().hits();
+    for (const std::uint64_t at : {kTestVirtual, kSecondVirtual, kTestVirtual}) {
+        interpreter.host_resume_at(at);
+        V2_CHECK(paged.step().status == StepStatus::Advanced);
+        V2_CHECK_EQ(paged.machine().get(5), at + 6);
+        V2_CHECK_EQ(interpreter.pc(), at + 6);
+    }
+    // The second and third runs were both hits on the one record.
+    V2_CHECK_EQ(interpreter.predecode().hits() - hits_before, 2u);
+}
+
+V2_FIXTURE(a_block_transfer_follows_each_virtual_page_to_its_own_physical_page) {
+    // user-015. A block-memory transfer moves a page's worth of bytes at a time, so every page
+    // edge it crosses has to be translated again rather than assumed to continue in physical
+    // memory. The two test pages are mapped in reverse physical order, so a transfer that carried
+    // on past the edge of the first into the physical page after it would write the wrong page.
+    // The first transfer crosses the edge ascending and the second, an overlapping block_copy,
+    // crosses it descending, both part-way between two 64-byte interrupt points, so the edge
+    // falls inside a run rather than on the boundary that would have ended one anyway.
+    constexpr std::uint64_t kSourcePhysical = 0x4000;
+    constexpr std::uint64_t kCount = 0x100;
+    Paged paged;
+    paged.identity_map();
+    paged.tables().map(kTestVirtual, kOtherPage, kLeafRWX);
+    paged.tables().map(kSecondVirtual, kDataPage, kLeafRWX);
+    MemoryV2& memory = paged.machine().memory();
+    for (std::uint64_t i = 0; i < kCount; ++i) {
+        memory.write_byte(kSourcePhysical + i, static_cast<std::uint8_t>(0x90 + i * 5));
+    }
+    for (std::uint64_t i = 0; i < sv48::page_bytes(0); ++i) {
+        memory.write_byte(kOtherPage + i, static_cast<std::uint8_t>(i * 3));
+        memory.write_byte(kDataPage + i, static_cast<std::uint8_t>(0x40 + i * 11));
+    }
+
+    // The two pages as the program sees them, and the two transfers applied to that view by
+    // their definitions.
+    std::vector<std::uint8_t> expected;
+    for (std::uint64_t i = 0; i < 2 * sv48::page_bytes(0); ++i) {
+        expected.push_back(memory.read_byte(i < sv48::page_bytes(0)
+                                                ? kOtherPage + i
+                                                : kDataPage + (i - sv48::page_bytes(0))));
+    }
+    for (std::uint64_t i = 0; i < kCount; ++i) {
+        expected[0xFA3 + i] = memory.read_byte(kSourcePhysical + i);
+    }
+    const std::vector<std::uint8_t> staged(expected.begin() + 0xF13,
+                                           expected.begin() + 0xF13 + kCount);
+    std::copy(staged.begin(), staged.end(), expected.begin() + 0xF57);
+
+    paged.emit_enable();
+    paged.program().op_r_i8(op::kMoveW, reg(4), kSourcePhysical);
+    paged.program().op_r_i8(op::kMoveW, reg(5), kTestVirtual + 0xFA3);
+    paged.program().op_r_i8(op::kMoveW, reg(6), kCount);
+    paged.program().op_r_r_r(op::kBlockCopyForward, reg(4), reg(5), reg(6));
+    paged.program().op_r_i8(op::kMoveW, reg(4), kTestVirtual + 0xF13);
+    paged.program().op_r_i8(op::kMoveW, reg(5), kTestVirtual + 0xF57);
+    paged.program().op_r_i8(op::kMoveW, reg(6), kCount);
+    paged.program().op_r_r_r(op::kBlockCopy, reg(4), reg(5), reg(6));
+    paged.program().halt();
+    paged.start();
+    paged.run_setup();
+    expect_halted(paged.machine().run(), "two block transfers across reversed pages");
+
+    for (std::uint64_t i = 0; i < 2 * sv48::page_bytes(0); ++i) {
+        const std::uint64_t physical = i < sv48::page_bytes(0)
+                                           ? kOtherPage + i
+                                           : kDataPage + (i - sv48::page_bytes(0));
+        if (memory.read_byte(physical) != expected[static_cast<std::size_t>(i)]) {
+            char buffer[128];
+            std::snprintf(buffer, sizeof(buffer), "byte $%llx of the two mapped pages",
+                          static_cast<unsigned long long>(i));
+            record_failure(buffer);
+            break;
+        }
+    }
+    V2_CHECK_EQ(paged.machine().get(4), kTestVirtual + 0xF13 + kCount);
+    V2_CHECK_EQ(paged.machine().get(5), kTestVirtual + 0xF57 + kCount);
+    V2_CHECK_EQ(paged.machine().get(6), 0u);
+}
+
 // ---------------------------------------------------------------------------------------------
 // THE SEAM BETWEEN TRANSLATION AND INTERRUPT DELIVERY (maize-466 over maize-465).
 //
@@ -1665,4 +1859,114 @@ V2_FIXTURE(a_block_interrupt_and_the_page_fault_after_it_compose_and_lose_nothin
     V2_CHECK_EQ(paged.machine().interpreter().device_surface().console().host_pending_input(), 1);
 }
 
+V2_FIXTURE(translation_walks_cost_the_same_with_the_jit_as_without) {
+    // A walk costs cycles (user-022), charged off the translator's walk count, so a run's cycles
+    // agree with and without the JIT only if the two walk the page tables the same number of
+    // times. Like the_translation_cache_neither_over_flushes_nor_under_flushes this asserts THIS
+    // implementation's caching, not conformance. Five hundred and twelve virtual pages, all on
+    // one physical page, are twice what the cache holds, so every pass of the loop below walks
+    // for every load while its own fetches stay on one page, and a JIT whose dispatcher walked
+    // to find a block, or skipped a walk the interpreter takes, is off by a walk a load.
+    constexpr unsigned kPages = 512;
+    constexpr unsigned kPasses = 3;
+    const auto run = [&](bool jit) {
+        auto paged = std::make_unique<Paged>();
+        paged->identity_map();
+        for (unsigned page = 0; page < kPages; ++page) {
+            paged->tables().map(kTestVirtual + page * sv48::page_bytes(0), kDataPage, kLeafRWX);
+        }
+        paged->machine().memory().write_little_endian(kDataPage, 8, 1);
+        paged->emit_enable();
+        paged->emit_move(20, 0);
+        paged->emit_move(21, kPasses);
+        Encoder& code = paged->program();
+        const std::uint64_t outer = paged->here();
+        code.op_r_i8(op::kMoveW, reg(15), kTestVirtual);
+        code.op_r_i8(op::kMoveW, reg(18), 0);
+        code.op_r_i8(op::kMoveW, reg(19), kPages);
+        const std::uint64_t inner = paged->here();
+        code.op_r_r(op::kLoad, reg(15), reg(16));
+        code.op_r_r_r(op::kAdd, reg(16), reg(17), reg(17));
+        code.op_r_r_i4(op::kAddImm, reg(15), reg(15), sv48::page_bytes(0));
+        code.op_r_r_i4(op::kAddImm, reg(18), reg(18), 1);
+        code.op_r_r_i4(op::kBranchBase + 6, reg(18), reg(19), inner - (paged->here() + 7));
+        code.op_r_r_i4(op::kAddImm, reg(20), reg(20), 1);
+        code.op_r_r_i4(op::kBranchBase + 6, reg(20), reg(21), outer - (paged->here() + 7));
+        code.halt();
+        paged->start();
+        if (jit) {
+            JitOptionsV2 options;
+            options.hotness = 2;
+            paged->machine().interpreter().enable_jit(options);
+        }
+        expect_halted(paged->machine().run(1000000),
+                      jit ? "the compiled run" : "the interpreted run");
+        return paged;
+    };
+    const std::unique_ptr<Paged> interpreted = run(false);
+    const std::unique_ptr<Paged> compiled = run(true);
+    InterpreterV2& plain = interpreted->machine().interpreter();
+    InterpreterV2& fast = compiled->machine().interpreter();
+
+    V2_CHECK_EQ(plain.registers().raw(17), kPages * kPasses);
+    V2_CHECK(plain.translator().walks() >= kPages * kPasses);
+    V2_CHECK_EQ(fast.steps_taken(), plain.steps_taken());
+    V2_CHECK_EQ(fast.translator().walks(), plain.translator().walks());
+    V2_CHECK_EQ(fast.cycles(), plain.cycles());
+    if (JitV2::kHasBackend) {
+        V2_CHECK(fast.jit()->stats().blocks_compiled >= 1);
+    }
+
+    // The walks already counted stay counted through a snapshot restored onto the same machine,
+    // whose translator is flushed by it, and through a clone, whose translator starts afresh.
+    const std::uint64_t cycles = plain.cycles();
+    const MachineSnapshotV2 snapshot = plain.take_full_snapshot();
+    V2_CHECK(plain.restore_snapshot(snapshot));
+    V2_CHECK_EQ(plain.cycles(), cycles);
+    V2_CHECK_EQ(plain.clone()->cycles(), cycles);
+}
+
+V2_FIXTURE(a_compiled_block_runs_at_each_mappings_address) {
+    // user-002. A compiled block is keyed by physical address, as a predecode record is, and the
+    // handlers it calls read the addresses in its records, so a block compiled under one mapping
+    // of its page and entered under another has to be moved to the live page before it runs.
+    // pc_add reads its own address into r5 on every pass of a loop hot enough to be compiled
+    // under the first mapping, and the loop is run again, compiled, under the second and then
+    // under the first once more.
+    Paged paged;
+    paged.identity_map();
+    paged.tables().map(kTestVirtual, kDataPage, kLeafRWX);
+    paged.tables().map(kSecondVirtual, kDataPage, kLeafRWX);
+    paged.emit_enable();
+    paged.program().halt();
+    paged.start();
+    paged.run_setup();
+
+    Encoder code(kDataPage);
+    code.op_r_i8(op::kMoveW, reg(6), 0);
+    const std::uint64_t loop = code.current_address();
+    code.op_r_i4(op::kPcAdd, reg(5), 0);
+    code.op_r_r_i4(op::kAddImm, reg(6), reg(6), 1);
+    code.op_r_r_i4(op::kBranchBase + 6, reg(6), reg(7), loop - (code.current_address() + 7));
+    code.halt();
+    paged.load_image(code);
+
+    InterpreterV2& interpreter = paged.machine().interpreter();
+    JitOptionsV2 options;
+    options.hotness = 2;
+    interpreter.enable_jit(options);
+    paged.machine().set(7, 50);
+    std::uint64_t compiled = 0;
+    for (const std::uint64_t at : {kTestVirtual, kSecondVirtual, kTestVirtual}) {
+        interpreter.host_resume_at(at);
+        expect_halted(paged.machine().run(1000), "the loop");
+        V2_CHECK_EQ(paged.machine().get(5), at + (loop - kDataPage) + 6);
+        // Every run after the first is compiled code nearly throughout.
+        if (JitV2::kHasBackend && at != kTestVirtual) {
+            V2_CHECK(interpreter.jit()->stats().instructions - compiled >= 100);
+        }
+        compiled = interpreter.jit() != nullptr ? interpreter.jit()->stats().instructions : 0;
+    }
+}
+
 }  // namespace maize::v2::test
@@ -0,0 +1,114 @@
+// fixtures_perf.cpp (user-025): what the performance registry reports, given the time.
+//
+// Rates are over wall-clock time and so differ from run to run, which is why the registry takes
+// the time as an argument where a fixture needs it to: with the time pinned, every number it
+// prints is a count of the machine's, and the counts are exact. The program writes two bytes to
+// the console and counts in a loop while a one-shot timer runs out once, and the registry starts
+// between the two bytes, so a count that ran from the reset rather than from start() shows.
+
+#include <cstdio>
+#include <string>
+
+#include "fixture_support.h"
+#include "perf_v2.h"
+
+namespace maize::v2::test {
+namespace {
+
+constexpr std::size_t kMemoryBytes = 0x4000;
+constexpr std::uint64_t kLoadAddress = 0x1000;
+constexpr std::uint16_t kConsoleData = 0x0013;
+constexpr std::uint16_t kTimerPeriod = 0x0033;
+constexpr std::uint16_t kTimerMode = 0x0034;
+constexpr std::uint64_t kIterations = 5000;
+constexpr std::uint8_t kLtUnsigned = 6;
+
+// Three instructions to the first byte out, one to the second, two to set up the loop, two an
+// iteration, and the halt.
+constexpr std::uint64_t kBeforeStart = 3;
+constexpr std::uint64_t kSteps = 4 + 2 + 2 * kIterations + 1;
+
+Encoder program() {
+    Encoder code(kLoadAddress);
+    code.op_r_i8(op::kMoveW, reg(3), 'A');
+    code.op_r_i8(op::kMoveW, reg(4), kConsoleData);
+    code.op_r_r(op::kPortOut, reg(3), reg(4));
+    code.op_r_r(op::kPortOut, reg(3), reg(4));
+    code.op_r_i8(op::kMoveW, reg(10), 0);
+    code.op_r_i8(op::kMoveW, reg(11), kIterations);
+    const std::uint64_t loop = code.current_address();
+    code.op_r_r_i4(op::kAddImm, reg(10), reg(10), 1);
+    code.op_r_r_i4(op::kBranchBase + kLtUnsigned, reg(10), reg(11),
+                   loop - (code.current_address() + 7));
+    code.halt();
+    return code;
+}
+
+void expect_in(const std::string& haystack, const std::string& needle) {
+    if (haystack.find(needle) == std::string::npos) {
+        record_failure("the report lacks '" + needle + "':\n" + haystack);
+    }
+}
+
+}  // namespace
+
+V2_FIXTURE(the_perf_registry_counts_the_run_from_start_and_keeps_peak_rates) {
+    Machine machine(kMemoryBytes);
+    machine.load(program());
+    machine.run(kBeforeStart);
+    DeviceSurfaceV2& devices = machine.interpreter().device_surface();
+    V2_CHECK_EQ(devices.console().host_bytes_out(), 1u);
+    // A one-shot interval of fifty instructions, which runs out once and is not re-armed.
+    devices.port_out(kTimerPeriod, 50 * kNanosecondsPerInstruction);
+    devices.port_out(kTimerMode, timer_offset::kModeCountingEnabled);
+
+    PerfRegistryV2 perf;
+    CpuPerfSourceV2 cpu(machine.interpreter());
+    TranslatorPerfSourceV2 translator(machine.interpreter());
+    ConsolePerfSourceV2 console(devices.console());
+    TimerPerfSourceV2 timer(devices.timer());
+    perf.add(&cpu);
+    perf.add(&translator);
+    perf.add(&console);
+    perf.add(&timer);
+    perf.start();
+
+    std::FILE* file = std::tmpfile();
+    V2_CHECK(file != nullptr);
+    if (file == nullptr) {
+        return;
+    }
+    // A thousand instructions in the first half second, the second byte and the expiry among
+    // them, and the rest of the run in the second.
+    machine.run(1000);
+    perf.sample(file, 500000);
+    expect_halted(machine.run(), "the measured run");
+    perf.sample(file, 1000000);
+    V2_CHECK_EQ(perf.last_sample_us(), 1000000u);
+    perf.emit(file, 2000000);
+    const std::string text = read_back(file);
+    std::fclose(file);
+
+    V2_CHECK_EQ(machine.interpreter().steps_taken(), kSteps);
+    expect_in(text,
+              "perf 0.500 s: cpu 2.0k instructions/s; translator 0 hits/s, 0 walks/s, "
+              "0 flushes/s; console 0 bytes in/s, 2 bytes out/s; timer 2 expiries/s\n");
+    expect_in(text,
+              "perf 1.000 s: cpu 18.0k instructions/s; translator 0 hits/s, 0 walks/s, "
+              "0 flushes/s; console 0 bytes in/s, 0 bytes out/s; timer 0 expiries/s\n");
+    expect_in(text, "performance report\n  [cpu]\n");
+    expect_in(text, "    instructions : " + std::to_string(kSteps - kBeforeStart) + "\n");
+    expect_in(text, "    elapsed      : 2000 ms\n");
+    expect_in(text, "    peak         : 18.0k instructions/s\n");
+    expect_in(text, "    hit rate     : none translated\n");
+    expect_in(text, "    bytes out    : 1\n");
+    expect_in(text, "    peak         : 0 bytes in/s, 2 bytes out/s\n");
+    expect_in(text, "    expiries     : 1\n");
+    // The machine's time is a microsecond an instruction, counted from the start too.
+    expect_in(text, "    virtual time : " + std::to_string(kSteps - kBeforeStart) + " us\n");
+    expect_in(text, "    wall time    : 2000000 us\n");
+    // No display was registered, so there is no section for one.
+    V2_CHECK(text.find("[display]") == std::string::npos);
+}
+
+}  // namespace maize::v2::test
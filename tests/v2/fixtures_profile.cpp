@@ -0,0 +1,288 @@
+// fixtures_profile.cpp (user-023): what a profile counts, and that counting changes nothing.
+//
+// A profile is a host's view of a run and no guest can read it, so there is no contract to test
+// it against; what there is, is the run itself. The program below has a block of every kind
+// profile_v2.h names, ended by a call, by a return, by a trap, by a trap_return and by a branch,
+// and every count it leaves is worked out here by hand from the program's shape. A profiled
+// machine must also end exactly where an unprofiled one does, since the profile is a different
+// loop over the same cycle(), and stepping it must count what running it counts.
+//
+// The samples (user-024) are worked out the same way: sampling every instruction makes the sample
+// counts the instruction counts of each frame, and the program's call, system call, return and
+// trap_return are each a push or a pop the shadow stack has to get right for those to come out.
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "fixture_support.h"
+#include "profile_v2.h"
+#include "symbols_v2.h"
+
+namespace maize::v2::test {
+namespace {
+
+constexpr std::size_t kMemoryBytes = 0x4000;
+constexpr std::uint64_t kProgramBase = 0x100;
+constexpr std::uint64_t kHandlerBase = 0x800;
+constexpr std::uint64_t kVectorTable = 0x1000;
+constexpr std::uint64_t kTrapStackTop = 0x2000;
+constexpr std::uint64_t kFill = 0x3000;
+constexpr std::uint64_t kFillBytes = 16;
+constexpr std::uint64_t kIterations = 50;
+
+constexpr std::uint8_t kLtUnsigned = 6;
+
+// Where the program's blocks start, as the build below measures them.
+struct Layout {
+    std::uint64_t loop = 0;
+    std::uint64_t after_call = 0;
+    std::uint64_t after_sys = 0;
+    std::uint64_t halt = 0;
+    std::uint64_t subroutine = 0;
+};
+
+// Fifty iterations of: call a subroutine that fills sixteen bytes and multiplies, make a system
+// call whose handler returns at once, and count. Built twice, the first pass measuring the
+// addresses the second bakes in.
+Encoder build(const Layout& known, Layout& measured) {
+    Encoder code(kProgramBase);
+    code.op_r_i8(op::kMoveW, reg(1), kVectorTable);
+    code.op_r_i2(op::kCsrWrite, reg(1), csr::kTrapVectorBase);
+    code.op_r_i8(op::kMoveW, reg(1), kTrapStackTop);
+    code.op_r_i2(op::kCsrWrite, reg(1), csr::kTrapStack);
+    code.op_r_i8(op::kMoveW, reg(10), 0);
+    code.op_r_i8(op::kMoveW, reg(11), kIterations);
+    code.op_r_i8(op::kMoveW, reg(7), 0xAB);
+    code.op_r_i8(op::kMoveW, reg(12), 3);
+    code.op_r_i8(op::kMoveW, reg(13), 5);
+    measured.loop = code.current_address();
+    code.op_i4(op::kCallDisp, known.subroutine - (code.current_address() + 5));
+    measured.after_call = code.current_address();
+    code.op_i1(op::kSysImm, 0x2A);
+    measured.after_sys = code.current_address();
+    code.op_r_r_i4(op::kAddImm, reg(10), reg(10), 1);
+    code.op_r_r_i4(op::kBranchBase + kLtUnsigned, reg(10), reg(11),
+                   measured.loop - (code.current_address() + 7));
+    measured.halt = code.current_address();
+    code.halt();
+    measured.subroutine = code.current_address();
+    code.op_r_i8(op::kMoveW, reg(8), kFill);
+    code.op_r_i8(op::kMoveW, reg(9), kFillBytes);
+    code.op_r_r_r(op::kBlockSet, reg(7), reg(8), reg(9));
+    code.op_r_r_r(op::kMultiply, reg(12), reg(13), reg(12));
+    code.op(op::kReturn);
+    return code;
+}
+
+void load(Machine& machine, Layout& layout) {
+    Layout unused;
+    build(Layout{}, layout);
+    machine.load(build(layout, unused));
+    Encoder handler(kHandlerBase);
+    handler.op(op::kTrapReturn);
+    V2_CHECK(machine.memory().load_image(handler.base_address(), handler.bytes().data(),
+                                         handler.bytes().size()));
+    machine.memory().write_little_endian(
+        vector_table::entry_address(kVectorTable, cause::kSyscall), 8, kHandlerBase);
+}
+
+std::uint64_t block_instructions(const ProfileV2& profile, std::uint64_t start) {
+    const auto found = profile.blocks().find(start);
+    return found == profile.blocks().end() ? 0 : found->second.instructions;
+}
+
+std::uint64_t block_entries(const ProfileV2& profile, std::uint64_t start) {
+    const auto found = profile.blocks().find(start);
+    return found == profile.blocks().end() ? 0 : found->second.entries;
+}
+
+}  // namespace
+
+V2_FIXTURE(a_profile_counts_opcodes_blocks_traps_and_block_bytes) {
+    Layout layout;
+    Machine plain(kMemoryBytes);
+    load(plain, layout);
+    expect_halted(run_to_stop(plain), "the unprofiled run");
+
+    Machine profiled(kMemoryBytes);
+    load(profiled, layout);
+    ProfileV2 profile;
+    profiled.interpreter().host_attach_profile(&profile);
+    expect_halted(run_to_stop(profiled), "the profiled run");
+    profile.end_block();
+
+    // Counting changes nothing.
+    V2_CHECK_EQ(profiled.interpreter().steps_taken(), plain.interpreter().steps_taken());
+    V2_CHECK_EQ(profiled.interpreter().cycles(), plain.interpreter().cycles());
+    V2_CHECK_EQ(profiled.get(12), plain.get(12));
+
+    // Nine setup instructions and the first call; forty-nine more calls; five instructions of
+    // subroutine, a sys and its handler's trap_return fifty times each; two to count; the halt.
+    constexpr std::uint64_t kSteps = 10 + 49 + 50 * 5 + 50 + 50 + 50 * 2 + 1;
+    V2_CHECK_EQ(plain.interpreter().steps_taken(), kSteps);
+
+    V2_CHECK_EQ(profile.retired(op::kMoveW), 7 + 2 * kIterations);
+    V2_CHECK_EQ(profile.retired(op::kCallDisp), kIterations);
+    V2_CHECK_EQ(profile.retired(op::kBlockSet), kIterations);
+    V2_CHECK_EQ(profile.retired(op::kMultiply), kIterations);
+    V2_CHECK_EQ(profile.retired(op::kSysImm), kIterations);
+    V2_CHECK_EQ(profile.retired(op::kTrapReturn), kIterations);
+    V2_CHECK_EQ(profile.retired(op::kHalt), 1u);
+    V2_CHECK_EQ(profile.traps(cause::kSyscall), kIterations);
+    V2_CHECK_EQ(profile.block_bytes(op::kBlockSet), kIterations * kFillBytes);
+    V2_CHECK_EQ(profile.block_bytes(op::kBlockCopy), 0u);
+
+    // Every retired instruction is in exactly one block.
+    std::uint64_t in_blocks = 0;
+    for (const auto& [start, counts] : profile.blocks()) {
+        in_blocks += counts.instructions;
+    }
+    V2_CHECK_EQ(in_blocks, kSteps);
+    V2_CHECK_EQ(profile.blocks().size(), 7u);
+    // The setup runs on into the first call, so the loop's own block is entered from the
+    // branch only.
+    V2_CHECK_EQ(block_instructions(profile, kProgramBase), 10u);
+    V2_CHECK_EQ(block_entries(profile, layout.loop), kIterations - 1);
+    V2_CHECK_EQ(block_instructions(profile, layout.subroutine), 5 * kIterations);
+    V2_CHECK_EQ(block_entries(profile, layout.subroutine), kIterations);
+    V2_CHECK_EQ(block_instructions(profile, layout.after_call), kIterations);
+    V2_CHECK_EQ(block_instructions(profile, kHandlerBase), kIterations);
+    V2_CHECK_EQ(block_instructions(profile, layout.after_sys), 2 * kIterations);
+    V2_CHECK_EQ(block_entries(profile, layout.halt), 1u);
+
+    // Stepping counts what running counts.
+    Machine stepped(kMemoryBytes);
+    load(stepped, layout);
+    ProfileV2 step_profile;
+    stepped.interpreter().host_attach_profile(&step_profile);
+    while (!stepped.interpreter().halted()) {
+        stepped.step();
+    }
+    step_profile.end_block();
+    V2_CHECK_EQ(stepped.interpreter().steps_taken(), kSteps);
+    V2_CHECK_EQ(step_profile.blocks().size(), profile.blocks().size());
+    for (const auto& [start, counts] : profile.blocks()) {
+        V2_CHECK_EQ(block_instructions(step_profile, start), counts.instructions);
+        V2_CHECK_EQ(block_entries(step_profile, start), counts.entries);
+    }
+    V2_CHECK_EQ(step_profile.traps(cause::kSyscall), kIterations);
+}
+
+V2_FIXTURE(a_profile_reports_as_text_and_as_json) {
+    Layout layout;
+    Machine machine(kMemoryBytes);
+    load(machine, layout);
+    // Begun partway, so the reports count from the attach rather than from the reset.
+    machine.run(9);
+    ProfileV2 profile;
+    machine.interpreter().host_attach_profile(&profile);
+    expect_halted(run_to_stop(machine), "the profiled run");
+
+    std::FILE* text_file = std::tmpfile();
+    std::FILE* json_file = std::tmpfile();
+    V2_CHECK(text_file != nullptr && json_file != nullptr);
+    if (text_file == nullptr || json_file == nullptr) {
+        return;
+    }
+    profile.write_text(text_file, machine.interpreter());
+    V2_CHECK(profile.write_json(json_file, machine.interpreter()));
+    const std::string text = read_back(text_file);
+    const std::string json = read_back(json_file);
+    std::fclose(text_file);
+    std::fclose(json_file);
+
+    const std::uint64_t counted = machine.interpreter().steps_taken() - 9;
+    const std::string instructions = std::to_string(counted) + " instructions";
+    const auto expect_in = [](const std::string& haystack, const std::string& needle,
+                              const char* what) {
+        if (haystack.find(needle) == std::string::npos) {
+            record_failure(std::string(what) + " lacks '" + needle + "':\n" + haystack);
+        }
+    };
+    expect_in(text, "profile: " + instructions, "the text report");
+    expect_in(text, "block_set", "the text report");
+    expect_in(text, "traps by cause: 7:50", "the text report");
+    expect_in(text, "interrupts by cause: none", "the text report");
+    expect_in(text, "block_set 800", "the text report");
+
+    expect_in(json, "\"instructions\": " + std::to_string(counted) + ",", "the JSON report");
+    expect_in(json, "{\"opcode\": 178, \"mnemonic\": \"block_set\", \"retired\": 50}",
+              "the JSON report");
+    expect_in(json, "\"traps\": [\n    {\"cause\": 7, \"count\": 50}\n  ]", "the JSON report");
+    expect_in(json, "\"interrupts\": [\n  ]", "the JSON report");
+    expect_in(json, "\"block_set\": 800}", "the JSON report");
+    // The hottest block first: the subroutine's 250 instructions.
+    char hottest[96];
+    std::snprintf(hottest, sizeof(hottest),
+                  "\"blocks\": [\n    {\"start\": \"0x%016llX\", \"entries\": 50, "
+                  "\"instructions\": 250}",
+                  static_cast<unsigned long long>(layout.subroutine));
+    expect_in(json, hottest, "the JSON report");
+    V2_CHECK(json.back() == '\n');
+}
+
+V2_FIXTURE(samples_follow_calls_and_traps_into_folded_stacks) {
+    Layout layout;
+    Machine machine(kMemoryBytes);
+    load(machine, layout);
+    ProfileV2 profile;
+    profile.set_sample_interval(1);
+    machine.interpreter().host_attach_profile(&profile);
+    expect_halted(run_to_stop(machine), "the sampled run");
+
+    // The call and the sys are charged to the frame they ran in and the return and the
+    // trap_return to the one they left: nine setup instructions, the call, the sys, two to count
+    // and the halt in the outermost frame; the subroutine's five and the handler's one in theirs.
+    const std::vector<std::uint64_t> outermost{kProgramBase};
+    const std::vector<std::uint64_t> in_subroutine{kProgramBase, layout.subroutine};
+    const std::vector<std::uint64_t> in_handler{kProgramBase, kHandlerBase};
+    V2_CHECK_EQ(profile.samples().size(), 3u);
+    const auto samples_of = [&profile](const std::vector<std::uint64_t>& stack) {
+        const auto found = profile.samples().find(stack);
+        return found == profile.samples().end() ? std::uint64_t{0} : found->second;
+    };
+    V2_CHECK_EQ(samples_of(outermost), 9 + kIterations * 4 + 1);
+    V2_CHECK_EQ(samples_of(in_subroutine), 5 * kIterations);
+    V2_CHECK_EQ(samples_of(in_handler), kIterations);
+
+    // Named, and with the lines in name order.
+    SymbolTableV2 symbols;
+    symbols.add(layout.subroutine, "fill");
+    symbols.add(kHandlerBase, "on_sys");
+    symbols.add(kProgramBase, "main");
+    symbols.add(kProgramBase, "main_alias");
+    char inside[32];
+    std::snprintf(inside, sizeof(inside), "main+0x%llX",
+                  static_cast<unsigned long long>(layout.loop - kProgramBase));
+    V2_CHECK(symbols.describe(layout.loop) == inside);
+    V2_CHECK(symbols.describe(kProgramBase - 1) == "0x00000000000000FF");
+    std::FILE* file = std::tmpfile();
+    V2_CHECK(file != nullptr);
+    if (file == nullptr) {
+        return;
+    }
+    V2_CHECK(profile.write_folded(file, symbols));
+    const std::string folded = read_back(file);
+    std::fclose(file);
+    const std::string expected = "main 210\nmain;fill 250\nmain;on_sys 50\n";
+    if (folded != expected) {
+        record_failure("the folded stacks are:\n" + folded + "expected:\n" + expected);
+    }
+
+    // Sampled less often, the same run gives every seventh of the same samples.
+    Machine sparse(kMemoryBytes);
+    load(sparse, layout);
+    ProfileV2 sparse_profile;
+    sparse_profile.set_sample_interval(7);
+    sparse.interpreter().host_attach_profile(&sparse_profile);
+    expect_halted(run_to_stop(sparse), "the sparsely sampled run");
+    std::uint64_t taken = 0;
+    for (const auto& [stack, count] : sparse_profile.samples()) {
+        V2_CHECK(samples_of(stack) != 0);
+        taken += count;
+    }
+    V2_CHECK_EQ(taken, sparse.interpreter().steps_taken() / 7);
+}
+
+}  // namespace maize::v2::test
@@ -0,0 +1,451 @@
+// fixtures_snapshot.cpp (user-007): dirty-page tracking and machine snapshots.
+//
+// A SNAPSHOT HAS TWO WAYS TO BE WRONG, and each fixture below is aimed at one. An incremental
+// snapshot that misses a page is wrong silently: the restored machine runs on from memory that
+// never existed, and nothing fails until much later, somewhere else. So the first fixture names
+// every kind of store the machine makes, an instruction's, a block-memory transfer's and a trap
+// frame's, and asserts the exact set of pages the snapshot carries, neither more nor fewer. A
+// restore that puts back most of the machine is wrong the same way, so the second fixture runs a
+// program to its halt, restores a chain taken partway through it into a second machine, runs
+// that on, and asserts the two finish identical in every register, control-and-status register,
+// device register and byte of memory.
+//
+// A CLONE (user-008) is a snapshot that never leaves the process, and is wrong the same two ways
+// plus one of its own: a page shared copy-on-write that one side's write leaks into the other.
+// The clone fixtures write on each side of every clone and read on the other, and run a fan-out
+// of clones against machines that reached the same point from scratch.
+
+#include <memory>
+#include <vector>
+
+#include "fixture_support.h"
+#include "jit_v2.h"
+
+namespace maize::v2::test {
+namespace {
+
+constexpr std::uint64_t kProgramBase = 0x100;
+constexpr std::uint64_t kHandlerBase = 0x800;
+constexpr std::uint64_t kVectorTable = 0x1000;  // through $17FF, page 1
+constexpr std::uint64_t kTrapStackTop = 0x3000;  // frames land on page 2
+constexpr std::uint64_t kSaveArea = 0x3800;
+
+constexpr std::uint16_t kConsoleData = 0x0013;
+constexpr std::uint16_t kTimerStatus = 0x0031;
+constexpr std::uint16_t kTimerControl = 0x0032;
+constexpr std::uint16_t kTimerPeriod = 0x0033;
+constexpr std::uint16_t kTimerMode = 0x0034;
+
+constexpr std::uint64_t kSupervisorInterruptsOn = 0x5;
+constexpr std::uint8_t kLtUnsigned = 6;
+
+std::uint64_t page_of(std::uint64_t address) { return address >> MemoryV2::kPageShift; }
+
+void load_csr(Encoder& code, std::uint16_t number, std::uint64_t value) {
+    code.op_r_i8(op::kMoveW, reg(1), value);
+    code.op_r_i2(op::kCsrWrite, reg(1), number);
+}
+
+void port_out(Encoder& code, std::uint16_t port, std::uint64_t value) {
+    code.op_r_i8(op::kMoveW, reg(1), value);
+    code.op_r_i8(op::kMoveW, reg(30), port);
+    code.op_r_r(op::kPortOut, reg(1), reg(30));
+}
+
+// The program the chain and clone fixtures run: a loop that stores a product of r13 across ten
+// pages from kLoopData, 64 bytes apart, under a periodic timer whose handler writes a byte to the
+// console and banks two registers through the scratch register on every expiry.
+constexpr std::uint64_t kLoopData = 0x10000;
+
+void load_interrupted_loop(Machine& machine) {
+    Encoder code(kProgramBase);
+    load_csr(code, csr::kTrapVectorBase, kVectorTable);
+    load_csr(code, csr::kTrapStack, kTrapStackTop);
+    load_csr(code, csr::kScratch, kSaveArea);
+    load_csr(code, csr::kInterruptEnable0, std::uint64_t{1} << cause::kTimerInterrupt);
+    port_out(code, kTimerControl, 1);
+    load_csr(code, csr::kStatus, kSupervisorInterruptsOn);
+    port_out(code, kTimerPeriod, 97 * kNanosecondsPerInstruction);
+    port_out(code, kTimerMode, 3);  // counting, periodic
+    code.op_r_i8(op::kMoveW, reg(10), 0);
+    code.op_r_i8(op::kMoveW, reg(11), 640);
+    code.op_r_i8(op::kMoveW, reg(12), kLoopData);
+    code.op_r_i8(op::kMoveW, reg(13), 0x9E3779B97F4A7C15ull);
+    const std::uint64_t loop = code.current_address();
+    code.op_r_r_r(op::kMultiply, reg(13), reg(10), reg(14));
+    code.op_r_r_i2(op::kStoreDisp, reg(14), reg(12), 0);
+    code.op_r_r_i4(op::kXorImm, reg(14), reg(13), 0x5A5A);
+    code.op_r_r_i4(op::kAddImm, reg(12), reg(12), 64);
+    code.op_r_r_i4(op::kAddImm, reg(10), reg(10), 1);
+    code.op_r_r_i4(op::kBranchBase + kLtUnsigned, reg(10), reg(11),
+                   loop - (code.current_address() + 7));
+    port_out(code, kTimerMode, 0);
+    code.halt();
+
+    Encoder handler(kHandlerBase);
+    handler.op_r_r_i2(op::kCsrSwap, reg(2), reg(2), csr::kScratch);
+    handler.op_r_r_i2(op::kStoreDisp, reg(3), reg(2), 0);
+    handler.op_r_r_i2(op::kStoreDisp, reg(4), reg(2), 8);
+    handler.op_r_i8(op::kMoveW, reg(3), 'a');
+    handler.op_r_r_r(op::kAdd, reg(3), reg(10), reg(3));
+    handler.op_r_i8(op::kMoveW, reg(4), kConsoleData);
+    handler.op_r_r(op::kPortOut, reg(3), reg(4));
+    handler.op_r_i8(op::kMoveW, reg(3), 1);
+    handler.op_r_i8(op::kMoveW, reg(4), kTimerStatus);
+    handler.op_r_r(op::kPortOut, reg(3), reg(4));
+    handler.op_r_r_i2(op::kLoadDisp, reg(2), reg(3), 0);
+    handler.op_r_r_i2(op::kLoadDisp, reg(2), reg(4), 8);
+    handler.op_r_r_i2(op::kCsrSwap, reg(2), reg(2), csr::kScratch);
+    handler.op(op::kTrapReturn);
+
+    machine.load(code);
+    V2_CHECK(machine.memory().load_image(handler.base_address(), handler.bytes().data(),
+                                         handler.bytes().size()));
+    machine.memory().write_little_endian(
+        vector_table::entry_address(kVectorTable, cause::kTimerInterrupt), 8, kHandlerBase);
+}
+
+// Run until exactly `target` instructions have retired, through any delivered traps.
+void run_to_step(InterpreterV2& interpreter, std::uint64_t target) {
+    while (interpreter.steps_taken() < target) {
+        const StepResult result = interpreter.run(target - interpreter.steps_taken());
+        if (result.status != StepStatus::Advanced &&
+            !(result.status == StepStatus::Trapped &&
+              result.disposition == TrapDisposition::Delivered)) {
+            break;
+        }
+    }
+}
+
+}  // namespace
+
+V2_FIXTURE(an_incremental_snapshot_carries_exactly_the_pages_written_since_the_last) {
+    // Four kinds of store, each onto a page of its own: a store instruction onto page 4, a
+    // block_set across pages 6 and 7, a block_copy onto page 9, and the frame a breakpoint's
+    // delivery pushes onto page 2. The code and the vector table, on pages 0 and 1, are read and
+    // never written. A machine that tracked only the instruction's store, which is the easy
+    // place to put the hook, carries page 4 and misses the other four.
+    constexpr std::uint64_t kStoreTarget = 0x4008;
+    constexpr std::uint64_t kSetTarget = 0x6000;
+    constexpr std::uint64_t kSetCount = 0x1800;
+    constexpr std::uint64_t kCopyTarget = 0x9000;
+
+    Machine machine(0x10000);
+    Encoder code(kProgramBase);
+    load_csr(code, csr::kTrapVectorBase, kVectorTable);
+    load_csr(code, csr::kTrapStack, kTrapStackTop);
+    code.op_r_i8(op::kMoveW, reg(4), 0x1122334455667788ull);
+    code.op_r_i8(op::kMoveW, reg(5), kStoreTarget);
+    code.op_r_r(op::kStore, reg(4), reg(5));
+    code.op_r_i8(op::kMoveW, reg(6), 0xAB);
+    code.op_r_i8(op::kMoveW, reg(7), kSetTarget);
+    code.op_r_i8(op::kMoveW, reg(8), kSetCount);
+    code.op_r_r_r(op::kBlockSet, reg(6), reg(7), reg(8));
+    code.op_r_i8(op::kMoveW, reg(9), kStoreTarget & ~std::uint64_t{0xF});
+    code.op_r_i8(op::kMoveW, reg(10), kCopyTarget);
+    code.op_r_i8(op::kMoveW, reg(11), 16);
+    code.op_r_r_r(op::kBlockCopy, reg(9), reg(10), reg(11));
+    code.op(op::kBreakpoint);
+    code.halt();
+    machine.load(code);
+    Encoder handler(kHandlerBase);
+    handler.op(op::kTrapReturn);
+    V2_CHECK(machine.memory().load_image(handler.base_address(), handler.bytes().data(),
+                                         handler.bytes().size()));
+    machine.memory().write_little_endian(
+        vector_table::entry_address(kVectorTable, cause::kBreakpoint), 8, kHandlerBase);
+
+    InterpreterV2& interpreter = machine.interpreter();
+    MachineSnapshotV2 unchained;
+    V2_CHECK(!interpreter.take_incremental_snapshot(unchained));
+
+    // The full snapshot leaves out every page that reads zero, which is all but the two the
+    // fixture wrote before it.
+    const MachineSnapshotV2 full = interpreter.take_full_snapshot();
+    V2_CHECK(!full.incremental);
+    V2_CHECK_EQ(full.sequence, 0u);
+    V2_CHECK(full.pages == (std::vector<std::uint64_t>{0, 1}));
+    V2_CHECK_EQ(full.page_bytes.size(), 2 * MemoryV2::kPageBytes);
+
+    expect_halted(run_to_stop(machine), "the storing program");
+    V2_CHECK_EQ(machine.memory().read_little_endian(kCopyTarget + 8, 8), 0x1122334455667788ull);
+
+    MachineSnapshotV2 first;
+    V2_CHECK(interpreter.take_incremental_snapshot(first));
+    V2_CHECK(first.incremental);
+    V2_CHECK_EQ(first.sequence, 1u);
+    const std::vector<std::uint64_t> expected = {
+        page_of(kTrapStackTop - trap_frame::kBytes), page_of(kStoreTarget), page_of(kSetTarget),
+        page_of(kSetTarget + kSetCount - 1), page_of(kCopyTarget)};
+    V2_CHECK(first.pages == expected);
+    V2_CHECK_EQ(first.page_bytes.size(), expected.size() * MemoryV2::kPageBytes);
+
+    // Nothing ran since, so the next one carries no page at all, and a page written twice in
+    // one interval is carried once.
+    MachineSnapshotV2 second;
+    V2_CHECK(interpreter.take_incremental_snapshot(second));
+    V2_CHECK_EQ(second.sequence, 2u);
+    V2_CHECK(second.pages.empty());
+    machine.memory().write_byte(kStoreTarget, 1);
+    machine.memory().write_byte(kStoreTarget + 1, 2);
+    MachineSnapshotV2 third;
+    V2_CHECK(interpreter.take_incremental_snapshot(third));
+    V2_CHECK(third.pages == (std::vector<std::uint64_t>{page_of(kStoreTarget)}));
+
+    // A host resize makes no promise about any page, so the next snapshot carries all of them.
+    machine.memory().host_set_size(0x8000);
+    MachineSnapshotV2 resized;
+    V2_CHECK(interpreter.take_incremental_snapshot(resized));
+    V2_CHECK_EQ(resized.memory_size, 0x8000u);
+    V2_CHECK_EQ(resized.pages.size(), 8u);
+}
+
+V2_FIXTURE(a_restored_snapshot_chain_runs_on_to_the_original_machines_end) {
+    // A loop that writes across ten pages while a periodic timer interrupts it, and whose
+    // handler writes a byte to the console and banks registers through the scratch register on
+    // every expiry. The original machine takes a full snapshot, then an incremental one every
+    // 500 instructions into a file, and runs to its halt. A second machine with a different
+    // memory size restores the file's records up to the middle of the run and runs on; it must
+    // finish identical to the first, which it cannot do unless the chain carried every register,
+    // the timer's interval in flight, the console's output and every page the loop wrote.
+    constexpr std::size_t kMemoryBytes = 0x40000;
+    constexpr std::uint64_t kInterval = 500;
+
+    // The original run, snapshotting into a file as mzvm's --snapshot-out does.
+    std::FILE* file = std::tmpfile();
+    V2_CHECK(file != nullptr);
+    if (file == nullptr) {
+        return;
+    }
+    Machine original(kMemoryBytes);
+    load_interrupted_loop(original);
+    InterpreterV2& running = original.interpreter();
+    std::vector<MachineSnapshotV2> chain;
+    chain.push_back(running.take_full_snapshot());
+    V2_CHECK(write_snapshot(file, chain.back()));
+    StepResult result;
+    for (unsigned slices = 0; slices < 1000; ++slices) {
+        result = running.run(kInterval - running.steps_taken() % kInterval);
+        if (result.status == StepStatus::Trapped &&
+            result.disposition == TrapDisposition::Delivered) {
+            continue;
+        }
+        if (result.status != StepStatus::Advanced) {
+            break;
+        }
+        chain.emplace_back();
+        V2_CHECK(running.take_incremental_snapshot(chain.back()));
+        V2_CHECK(write_snapshot(file, chain.back()));
+    }
+    expect_halted(result, "the original run");
+    const MachineState finished = capture(original);
+    V2_CHECK(chain.size() >= 6);
+    V2_CHECK(finished.console.size() >= 20);
+
+    // Each interval writes a few of the loop's pages, the trap-stack page and the save area, so
+    // an incremental snapshot is a small fraction of the machine's 64 pages.
+    for (std::size_t i = 1; i < chain.size(); ++i) {
+        V2_CHECK(chain[i].pages.size() <= 6);
+    }
+
+    // The file holds the chain record for record.
+    std::rewind(file);
+    std::vector<MachineSnapshotV2> reread;
+    MachineSnapshotV2 record;
+    while (read_snapshot(file, record) == SnapshotReadV2::Read) {
+        reread.push_back(record);
+    }
+    std::fclose(file);
+    V2_CHECK_EQ(reread.size(), chain.size());
+    for (std::size_t i = 0; i < reread.size() && i < chain.size(); ++i) {
+        V2_CHECK(reread[i].incremental == chain[i].incremental);
+        V2_CHECK_EQ(reread[i].sequence, chain[i].sequence);
+        V2_CHECK(reread[i].machine == chain[i].machine);
+        V2_CHECK(reread[i].pages == chain[i].pages);
+        V2_CHECK(reread[i].page_bytes == chain[i].page_bytes);
+    }
+
+    // Restored into a machine of another size, up to the middle of the run.
+    const std::size_t middle = reread.size() / 2;
+    Machine resumed(0x1000);
+    InterpreterV2& restoring = resumed.interpreter();
+    V2_CHECK(!restoring.restore_snapshot(reread[1]));  // no chain to follow yet
+    for (std::size_t i = 0; i <= middle; ++i) {
+        V2_CHECK(restoring.restore_snapshot(reread[i]));
+    }
+    V2_CHECK_EQ(resumed.memory().size(), kMemoryBytes);
+    V2_CHECK_EQ(restoring.steps_taken(), middle * kInterval);
+    // Out of order is refused and changes nothing.
+    const std::uint64_t pc = restoring.pc();
+    V2_CHECK(!restoring.restore_snapshot(reread[middle + 2]));
+    V2_CHECK(!restoring.restore_snapshot(reread[middle]));
+    V2_CHECK_EQ(restoring.pc(), pc);
+    expect_halted(run_to_stop(resumed), "the resumed run");
+    expect_same(capture(resumed), finished, "resumed from the middle of the chain");
+
+    // Back to the start on the original machine itself, whose memory, predecode cache and
+    // translation state all belong to the end of the run: the full snapshot puts every page
+    // back, zeroing the ones the loop wrote, and the run repeats exactly.
+    V2_CHECK(running.restore_snapshot(chain.front()));
+    V2_CHECK_EQ(running.steps_taken(), 0u);
+    V2_CHECK(finished.memory[kLoopData + 64] != 0u);
+    V2_CHECK_EQ(original.memory().read_little_endian(kLoopData + 64, 8), 0u);
+    expect_halted(run_to_stop(original), "the rerun");
+    expect_same(capture(original), finished, "rerun from the full snapshot");
+}
+
+V2_FIXTURE(a_cloned_memory_shares_its_pages_until_either_side_touches_them) {
+    // Five pages and a half, with a byte on pages 0, 3 and the partial page 5.
+    constexpr std::size_t kBytes = 5 * MemoryV2::kPageBytes + 0x800;
+    constexpr std::uint64_t kPartial = 5 * MemoryV2::kPageBytes + 0x7FF;
+    MemoryV2 parent(kBytes);
+    parent.write_byte(0x0010, 0x11);
+    parent.write_byte(0x3010, 0x33);
+    parent.write_byte(kPartial, 0x55);
+    parent.start_dirty_tracking();
+
+    std::unique_ptr<MemoryV2> child = parent.clone();
+    V2_CHECK_EQ(child->size(), kBytes);
+    V2_CHECK_EQ(parent.copied_pages(), 0u);
+    V2_CHECK_EQ(child->copied_pages(), 0u);
+    // Judging a shared page does not copy it.
+    V2_CHECK(!child->page_is_zero(3));
+    V2_CHECK(child->page_is_zero(4));
+    V2_CHECK_EQ(child->copied_pages(), 0u);
+
+    // A write on either side is invisible to the other, and the parent's dirty tracking still
+    // hears its own write.
+    parent.write_byte(0x3010, 0xA3);
+    V2_CHECK_EQ(child->read_byte(0x3010), 0x33u);
+    child->write_byte(0x0010, 0xB1);
+    V2_CHECK_EQ(parent.read_byte(0x0010), 0x11u);
+    V2_CHECK_EQ(child->read_byte(0x0010), 0xB1u);
+    V2_CHECK_EQ(child->read_byte(kPartial), 0x55u);
+    V2_CHECK(parent.dirty_pages() == (std::vector<std::uint64_t>{3}));
+    V2_CHECK_EQ(parent.copied_pages(), 1u);  // page 3, written; page 0 was only read
+    V2_CHECK_EQ(child->copied_pages(), 1u);  // page 0, written; pages 3 and 5 were only read
+
+    // A clone of a clone that has touched pages layers over the image before it: it sees the
+    // child's write, the original bytes the child never changed, and neither memory's later
+    // writes, and it outlives the child.
+    std::unique_ptr<MemoryV2> grandchild = child->clone();
+    child->write_byte(kPartial, 0xC5);
+    parent.write_byte(0x1000, 0xA1);
+    child.reset();
+    V2_CHECK_EQ(grandchild->read_byte(0x0010), 0xB1u);
+    V2_CHECK_EQ(grandchild->read_byte(0x3010), 0x33u);
+    V2_CHECK_EQ(grandchild->read_byte(kPartial), 0x55u);
+    V2_CHECK_EQ(grandchild->read_byte(0x1000), 0u);
+    V2_CHECK_EQ(grandchild->copied_pages(), 0u);
+
+    // A shrink through a shared page keeps the part below the new end and zeroes the rest, and
+    // a page that comes back after it reads zero rather than the image's bytes.
+    std::unique_ptr<MemoryV2> resized = parent.clone();
+    resized->host_set_size(0x3020);
+    V2_CHECK_EQ(resized->read_byte(0x3010), 0xA3u);
+    resized->host_set_size(kBytes);
+    V2_CHECK_EQ(resized->read_byte(0x3010), 0xA3u);
+    V2_CHECK_EQ(resized->read_byte(0x3020), 0u);
+    V2_CHECK_EQ(resized->read_byte(kPartial), 0u);
+    V2_CHECK_EQ(parent.read_byte(kPartial), 0x55u);
+}
+
+V2_FIXTURE(a_clone_copies_the_pages_it_writes_and_none_it_only_reads) {
+    // Every byte of every page of a child is read, through each way memory is read, and not one
+    // page is copied; only the page written afterwards is. Then a line of clones of clones, each
+    // writing one page, keeps its image one level deep and holds only the layers its pages are
+    // still in, however long the line.
+    constexpr std::size_t kPages = 16;
+    constexpr std::size_t kBytes = kPages * MemoryV2::kPageBytes;
+    MemoryV2 parent(kBytes);
+    for (std::size_t page = 0; page < kPages; ++page) {
+        parent.write_byte(page * MemoryV2::kPageBytes + page, static_cast<std::uint8_t>(page + 1));
+    }
+    std::unique_ptr<MemoryV2> child = parent.clone();
+    std::uint64_t sum = 0;
+    for (std::uint64_t address = 0; address < kBytes; ++address) {
+        sum += child->read_byte(address);
+    }
+    for (std::uint64_t address = 0; address < kBytes; address += 8) {
+        sum += child->read_within_page(address, 8) != 0u ? 1u : 0u;
+    }
+    const std::uint8_t* whole = child->host_range(0, kBytes);
+    for (std::size_t page = 0; page < kPages; ++page) {
+        V2_CHECK_EQ(whole[page * MemoryV2::kPageBytes + page], page + 1);
+    }
+    V2_CHECK_EQ(sum, kPages * (kPages + 1) / 2 + kPages);
+    V2_CHECK_EQ(child->copied_pages(), 0u);
+    V2_CHECK_EQ(parent.copied_pages(), 0u);
+
+    // A write copies its page, and a run that straddles the copy and the image reads as both.
+    child->write_byte(5 * MemoryV2::kPageBytes, 0xEE);
+    V2_CHECK_EQ(child->copied_pages(), 1u);
+    const std::uint8_t* straddle = child->host_range(5 * MemoryV2::kPageBytes - 1, 8);
+    V2_CHECK_EQ(straddle[1], 0xEEu);
+    V2_CHECK_EQ(straddle[6], 6u);
+    V2_CHECK_EQ(parent.read_byte(5 * MemoryV2::kPageBytes), 0u);
+
+    std::unique_ptr<MemoryV2> line = std::move(child);
+    for (unsigned generation = 0; generation < 200; ++generation) {
+        std::unique_ptr<MemoryV2> next = line->clone();
+        next->write_byte(3 * MemoryV2::kPageBytes, static_cast<std::uint8_t>(generation));
+        line = std::move(next);
+    }
+    // The parent's layer holds every page but 5, the first child's holds page 5, and the one
+    // before the last holds page 3 as the last found it: three layers, not two hundred.
+    V2_CHECK_EQ(line->shared_layers(), 3u);
+    V2_CHECK_EQ(line->read_byte(3 * MemoryV2::kPageBytes), 199u);
+    V2_CHECK_EQ(line->read_byte(5 * MemoryV2::kPageBytes), 0xEEu);
+    V2_CHECK_EQ(line->read_byte(9 * MemoryV2::kPageBytes + 9), 10u);
+}
+
+V2_FIXTURE(cloned_machines_fan_out_from_a_warm_parent_and_run_independently) {
+    // The parent runs the interrupted loop partway, past its set-up and through several timer
+    // expiries, and is cloned four times. Each clone is given its own multiplier and run to its
+    // halt, and must finish exactly as a machine that ran from scratch to the same step and was
+    // given the same multiplier there; the parent, run on afterwards, must finish as though it
+    // had never been cloned. Between them the clones write every loop page, and each must have
+    // copied only the pages it touched.
+    constexpr std::size_t kMemoryBytes = 0x40000;
+    constexpr std::uint64_t kForkStep = 1500;
+    constexpr std::uint64_t kMultipliers[] = {3, 0x100000001ull, 0xFFFF'FFFF'FFFF'FFFFull, 7};
+
+    const auto reference = [&](std::uint64_t multiplier, bool replace) {
+        Machine machine(kMemoryBytes);
+        load_interrupted_loop(machine);
+        run_to_step(machine.interpreter(), kForkStep);
+        if (replace) {
+            machine.set(13, multiplier);
+        }
+        expect_halted(run_to_stop(machine), "the reference run");
+        return capture(machine);
+    };
+
+    Machine parent(kMemoryBytes);
+    load_interrupted_loop(parent);
+    const bool jit = parent.interpreter().enable_jit(JitOptionsV2{});
+    run_to_step(parent.interpreter(), kForkStep);
+    V2_CHECK_EQ(parent.interpreter().steps_taken(), kForkStep);
+    V2_CHECK(!parent.interpreter().device_surface().console_output().empty());
+
+    std::vector<std::unique_ptr<InterpreterV2>> clones;
+    for (const std::uint64_t multiplier : kMultipliers) {
+        clones.push_back(parent.interpreter().clone());
+        clones.back()->registers().set_raw(13, multiplier);
+        V2_CHECK(clones.back()->jit() != nullptr || !jit);
+    }
+    for (std::size_t i = 0; i < clones.size(); ++i) {
+        InterpreterV2& clone = *clones[i];
+        V2_CHECK_EQ(clone.steps_taken(), kForkStep);
+        expect_halted(run_to_stop(clone), "a clone");
+        // The code page, the vector table, the trap-stack page, the save area and the loop's
+        // pages, out of the machine's 64.
+        V2_CHECK(clone.memory().copied_pages() <= 16);
+        expect_same(capture(clone), reference(kMultipliers[i], true), "a clone");
+    }
+
+    expect_halted(run_to_stop(parent), "the parent");
+    expect_same(capture(parent), reference(0, false), "the parent after the fan-out");
+}
+
+}  // namespace maize::v2::test
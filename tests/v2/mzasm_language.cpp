@@ -961,6 +961,110 @@ MZ_FIXTURE(mzvm_runs_what_mzasm_wrote) {
     }
 }
 
+MZ_FIXTURE(mzvm_samples_stacks_named_from_the_symbols_mzasm_wrote) {
+    // user-024. mzasm --symbols writes the labels beside the image, and mzvm samples every
+    // instruction and names its frames from them. Sampling every instruction makes each folded
+    // count the instructions retired in that frame, which the program's shape fixes: work keeps
+    // its link in r20 across the call to inner and puts it back to return, so the stack has to
+    // follow a return through a restored link to come out right.
+    ScratchDir scratch("sample");
+    const std::string source =
+        "    origin $1000\n"
+        "start:\n"
+        "    move.zb #20 r10\n"
+        "    move.zb #0 r11\n"
+        "loop:\n"
+        "    call work\n"
+        "    add r11 #1 r11\n"
+        "    branch_ne r11 r10 loop\n"
+        "    halt\n"
+        "work:\n"
+        "    move r31 r20\n"
+        "    call inner\n"
+        "    move r20 r31\n"
+        "    return\n"
+        "inner:\n"
+        "    add r12 #1 r12\n"
+        "    return\n";
+    const std::string input = scratch.write("sample.mzasm", source);
+    const RunResult assembled = run_mzasm({"--symbols", input});
+    MZ_CHECK_EQ(static_cast<std::uint64_t>(assembled.exit_code), 0u);
+    std::string symbols;
+    MZ_CHECK(read_file_text(scratch.file("sample.sym"), symbols));
+    if (symbols.find("0000000000001000 start\n") == std::string::npos ||
+        symbols.find(" inner\n") == std::string::npos) {
+        record_failure("the symbol file does not list the labels:\n" + symbols);
+    }
+
+    // An object's labels are not addresses yet, so -c refuses to name them.
+    const RunResult object = run_mzasm({"-c", "--symbols", input});
+    MZ_CHECK(object.exit_code != 0);
+
+    const std::string mzvm = sibling_binary("mzvm");
+    MZ_CHECK(file_exists(mzvm));
+    if (!file_exists(mzvm)) {
+        return;
+    }
+    const std::string folded_path = scratch.file("sample.folded");
+    const RunResult ran =
+        run_binary(mzvm, {"--folded-out", folded_path, "--sample-every", "1", "--symbols",
+                          scratch.file("sample.sym"), scratch.file("sample.mzi")});
+    MZ_CHECK_EQ(static_cast<std::uint64_t>(ran.exit_code), 0u);
+    std::string folded;
+    MZ_CHECK(read_file_text(folded_path, folded));
+    MZ_CHECK_TEXT(folded, std::string("start 63\nstart;work 80\nstart;work;inner 40\n"));
+
+    // A sample interval with nowhere to write the samples is refused, not ignored.
+    const RunResult unwritten =
+        run_binary(mzvm, {"--sample-every", "1", scratch.file("sample.mzi")});
+    MZ_CHECK_EQ(static_cast<std::uint64_t>(unwritten.exit_code), 2u);
+}
+
+MZ_FIXTURE(mzvm_show_perf_reports_each_source_after_the_run) {
+    // user-025. The report goes to stderr after the status line, one section per source, and a
+    // run with no display has no display section. The counts are exact even though the rates are
+    // not, so those are what is checked: four instructions, and the one byte the guest wrote.
+    ScratchDir scratch("perf");
+    const std::string source =
+        "    origin $1000\n"
+        "    move.zb #65 r4\n"
+        "    move.zb #19 r5\n"
+        "    port_out r4 r5\n"
+        "    halt\n";
+    const std::string input = scratch.write("perf.mzasm", source);
+    const RunResult assembled = run_mzasm({input});
+    MZ_CHECK_EQ(static_cast<std::uint64_t>(assembled.exit_code), 0u);
+
+    const std::string mzvm = sibling_binary("mzvm");
+    MZ_CHECK(file_exists(mzvm));
+    if (!file_exists(mzvm)) {
+        return;
+    }
+    const RunResult ran = run_binary(mzvm, {"--show-perf", scratch.file("perf.mzi")});
+    MZ_CHECK_EQ(static_cast<std::uint64_t>(ran.exit_code), 0u);
+    const std::string& report = ran.standard_error;
+    const std::size_t halted = report.find("halted");
+    const std::size_t header = report.find("performance report\n");
+    if (halted == std::string::npos || header == std::string::npos || header < halted) {
+        record_failure("the report does not follow the status line:\n" + report);
+    }
+    for (const char* expected :
+         {"  [cpu]\n    instructions : 4\n", "  [translator]\n", "  [console]\n",
+          "    bytes out    : 1\n", "  [timer]\n"}) {
+        if (report.find(expected) == std::string::npos) {
+            record_failure(std::string("the report lacks '") + expected + "':\n" + report);
+        }
+    }
+    if (report.find("[display]") != std::string::npos) {
+        record_failure("a run with no display reported one:\n" + report);
+    }
+    MZ_CHECK(ran.standard_output.find("performance") == std::string::npos);
+
+    // An interval of nothing is refused rather than read as every instruction.
+    const RunResult zero = run_binary(mzvm, {"--perf-every", "0", scratch.file("perf.mzi")});
+    MZ_CHECK_EQ(static_cast<std::uint64_t>(zero.exit_code), 2u);
+}
+
 MZ_FIXTURE(mzvm_prints_hello_world) {
     // maize-451, and the milestone the whole card exists for: the SHIPPED asm/v2/hello.mzasm
     // assembles with the SHIPPED mzasm and prints through the SHIPPED mzvm. Nothing here is
@@ -1024,6 +1128,73 @@ MZ_FIXTURE(mzvm_prints_hello_world) {
     }
 }
 
+MZ_FIXTURE(mzvm_batch_reports_every_machine_in_manifest_order) {
+    // user-009. A manifest of four machines run on three threads: two that halt, one whose
+    // image is missing, and one stopped by its own max-steps setting with its console sent to a
+    // file. The report is the whole of standard output, in manifest order whatever order the
+    // machines finished in, and the summary is on stderr.
+    ScratchDir scratch("batch");
+    const std::string source =
+        "    origin $1000\n"
+        "    move.zb #65 r4\n"
+        "    move.zb #19 r5\n"
+        "    port_out r4 r5\n"
+        "    port_out r4 r5\n"
+        "    halt\n";
+    const std::string input = scratch.write("twice.mzasm", source);
+    const RunResult assembled = run_mzasm({input});
+    MZ_CHECK_EQ(static_cast<std::uint64_t>(assembled.exit_code), 0u);
+    if (assembled.exit_code != 0) {
+        record_failure("mzasm rejected the batch program:\n" + assembled.output);
+        return;
+    }
+
+    const std::string mzvm = sibling_binary("mzvm");
+    MZ_CHECK(file_exists(mzvm));
+    if (!file_exists(mzvm)) {
+        return;
+    }
+    const std::string image = scratch.file("twice.mzi");
+    const std::string missing = scratch.file("missing.mzi");
+    const std::string captured = scratch.file("third.out");
+    const std::string manifest = scratch.write(
+        "manifest.txt", "# four machines\n" + image + "\n\n" + missing + " memory=8192\n" +
+                            image + " max-steps=3 output=" + captured + "\n" + image +
+                            " load-at=0x2000\n");
+
+    const RunResult ran = run_binary(mzvm, {"--batch", manifest, "--threads", "3"});
+    MZ_CHECK_EQ(static_cast<std::uint64_t>(ran.exit_code), 1u);
+    const std::string expected =
+        "== 1 " + image + ": halted at $000000000000100C after 5 instructions; 2 console bytes\n"
+        "AA\n"
+        "== 2 " + missing + ": cannot read '" + missing + "'; 0 console bytes\n"
+        "\n"
+        "== 3 " + image + ": step limit reached at $0000000000001009; 0 console bytes\n"
+        "\n"
+        "== 4 " + image + ": halted at $000000000000200C after 5 instructions; 2 console bytes\n"
+        "AA\n";
+    MZ_CHECK_TEXT(ran.standard_output, expected);
+    if (ran.standard_error.find("4 machines on 3 threads: 2 halted, 2 did not") ==
+        std::string::npos) {
+        record_failure("mzvm did not summarize the batch on stderr:\n" + ran.standard_error);
+    }
+    std::string third;
+    MZ_CHECK(read_file_text(captured, third));
+    MZ_CHECK_TEXT(third, "A");
+
+    // --batch names its own machines, and --threads means nothing without it.
+    const RunResult both = run_binary(mzvm, {"--batch", manifest, image});
+    MZ_CHECK_EQ(static_cast<std::uint64_t>(both.exit_code), 2u);
+    const RunResult stray = run_binary(mzvm, {"--threads", "2", image});
+    MZ_CHECK_EQ(static_cast<std::uint64_t>(stray.exit_code), 2u);
+    const std::string bad = scratch.write("bad.txt", image + " memory=0\n");
+    const RunResult refused = run_binary(mzvm, {"--batch", bad});
+    MZ_CHECK_EQ(static_cast<std::uint64_t>(refused.exit_code), 2u);
+    if (refused.output.find(bad + ":1: memory value '0' is out of range") == std::string::npos) {
+        record_failure("mzvm did not place a bad manifest value:\n" + refused.output);
+    }
+}
+
 MZ_FIXTURE(mzvm_refuses_out_of_range_numeric_arguments) {
     // maize-467. Every numeric option mzvm takes went through one helper that checked only
     // whether the text parsed, so a value past the width of the result saturated at the largest
@@ -1243,7 +1414,7 @@ MZ_FIXTURE(mzvm_leading_whitespace_cannot_hide_a_minus_sign) {
 // and what it cannot do, the console machine's own text is untouched by the twin's, and the
 // naming reaches every diagnostic rather than only the banner.
 
-MZ_FIXTURE(mzvmg_help_names_itself_and_says_it_has_no_display) {
+MZ_FIXTURE(mzvmg_help_names_itself_and_says_it_opens_no_window) {
     const std::string mzvmg = sibling_binary("mzvmg");
     MZ_CHECK(file_exists(mzvmg));
     if (!file_exists(mzvmg)) {
@@ -1262,9 +1433,15 @@ MZ_FIXTURE(mzvmg_help_names_itself_and_says_it_has_no_display) {
 
     // The display status, asserted as the TEXT rather than as the topic. A banner that merely
     // mentions a display would satisfy a looser check while saying something wrong, and what an
-    // operator needs from this paragraph is the specific claim that the device is absent.
-    if (help.standard_output.find("no display device yet (maize-456)") == std::string::npos) {
-        record_failure("mzvmg --help does not say it has no display device yet:\n" +
+    // operator needs from this paragraph is the specific claim that no window is coming. Since
+    // the framebuffer landed (user-019) the claim is the window's absence, not the device's, so
+    // the sentence that said the device was absent is asserted gone as well.
+    if (help.standard_output.find("no window yet (maize-456)") == std::string::npos) {
+        record_failure("mzvmg --help does not say it has no window yet:\n" +
+                       help.standard_output);
+    }
+    if (help.standard_output.find("no display device yet") != std::string::npos) {
+        record_failure("mzvmg --help still says it has no display device:\n" +
                        help.standard_output);
     }
 }
@@ -1293,10 +1470,10 @@ MZ_FIXTURE(mzvm_help_does_not_mention_the_graphical_twin) {
 
     // The name check above does not cover the paragraph on its own. The display note is built
     // from the program name, so printed unconditionally it would come out reading "mzvm has no
-    // display device yet" and carry the string "mzvmg" nowhere, which is a false statement that
-    // passes a check for the twin's name. The sentence is therefore asserted absent by its own
-    // text as well.
-    if (help.output.find("no display device yet") != std::string::npos) {
+    // window yet" and carry the string "mzvmg" nowhere, which is a false statement that passes a
+    // check for the twin's name. The sentence is therefore asserted absent by its own text as
+    // well.
+    if (help.output.find("no window yet") != std::string::npos) {
         record_failure("mzvm's own output carries the graphical twin's display note:\n" +
                        help.output);
     }